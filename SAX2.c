@@ -822,6 +822,9 @@ xmlSAX2StartDocument(void *ctx)
 	    doc->dict = ctxt->dict;
 	    xmlDictReference(doc->dict);
 	}
+        if ((ctxt->options & XML_PARSE_ARENA) &&
+            (xmlDocEnableArena(doc) < 0))
+            xmlSAX2ErrMemory(ctxt);
     }
     if ((ctxt->myDoc != NULL) && (ctxt->myDoc->URL == NULL) &&
 	(ctxt->input != NULL) && (ctxt->input->filename != NULL)) {
@@ -889,6 +892,21 @@ xmlSAX2EndDocument(void *ctx)
     }
 }
 
+/*
+ * With XML_PARSE_OFFSETS, store the offset of the construct which
+ * created the node, plus one, in the psvi field. See xmlGetNodeOffset.
+ * Nodes from entities are left alone.
+ */
+static void
+xmlSAX2SetOffset(xmlParserCtxtPtr ctxt, xmlNodePtr node) {
+    xmlParserInputPtr input = ctxt->input;
+
+    if ((input == NULL) || (input != ctxt->inputTab[0]))
+        return;
+
+    node->psvi = XML_INT_TO_PTR(ctxt->nodeOffset + 1);
+}
+
 static void
 xmlSAX2AppendChild(xmlParserCtxtPtr ctxt, xmlNodePtr node) {
     xmlNodePtr parent;
@@ -921,6 +939,8 @@ xmlSAX2AppendChild(xmlParserCtxtPtr ctxt, xmlNodePtr node) {
             node->line = ctxt->input->line;
         else
             node->line = USHRT_MAX;
+        if (ctxt->lineIndex != NULL)
+            xmlSAX2SetOffset(ctxt, node);
     }
 }
 
@@ -1012,7 +1032,7 @@ xmlSAX1Attribute(xmlParserCtxtPtr ctxt, const xmlChar *fullname,
 	}
 
 	/* a default namespace definition */
-	nsret = xmlNewNs(ctxt->node, val, NULL);
+	nsret = xmlDocNewNs(ctxt->myDoc, ctxt->node, val, NULL);
         if (nsret == NULL) {
             xmlSAX2ErrMemory(ctxt);
         }
@@ -1073,7 +1093,7 @@ xmlSAX1Attribute(xmlParserCtxtPtr ctxt, const xmlChar *fullname,
 	}
 
 	/* a standard namespace definition */
-	nsret = xmlNewNs(ctxt->node, val, name);
+	nsret = xmlDocNewNs(ctxt->myDoc, ctxt->node, val, name);
 	xmlFree(ns);
 
         if (nsret == NULL) {
@@ -1431,7 +1451,7 @@ xmlSAX1StartElement(void *ctx, const xmlChar *fullname, const xmlChar **atts)
         xmlNsWarnMsg(ctxt, XML_NS_ERR_UNDEFINED_NAMESPACE,
                      "Namespace prefix %s is not defined\n",
                      prefix, NULL);
-        ns = xmlNewNs(ret, NULL, prefix);
+        ns = xmlDocNewNs(ret->doc, ret, NULL, prefix);
         if (ns == NULL)
             xmlSAX2ErrMemory(ctxt);
     }
@@ -1690,7 +1710,7 @@ xmlSAX2TextNode(xmlParserCtxtPtr ctxt, xmlDocPtr doc, const xmlChar *str,
 	ctxt->freeElems = ret->next;
 	ctxt->freeElemsNr--;
     } else {
-	ret = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+	ret = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     }
     if (ret == NULL) {
         xmlCtxtErrMemory(ctxt);
@@ -1716,7 +1736,7 @@ xmlSAX2TextNode(xmlParserCtxtPtr ctxt, xmlDocPtr doc, const xmlChar *str,
 	    intern = xmlDictLookup(ctxt->dict, str, len);
             if (intern == NULL) {
                 xmlSAX2ErrMemory(ctxt);
-                xmlFree(ret);
+                xmlDocFreeMem(doc, ret);
                 return(NULL);
             }
 	} else if (IS_BLANK_CH(*str) && (len < 60) && (cur == '<') &&
@@ -1729,7 +1749,7 @@ xmlSAX2TextNode(xmlParserCtxtPtr ctxt, xmlDocPtr doc, const xmlChar *str,
 	    intern = xmlDictLookup(ctxt->dict, str, len);
             if (intern == NULL) {
                 xmlSAX2ErrMemory(ctxt);
-                xmlFree(ret);
+                xmlDocFreeMem(doc, ret);
                 return(NULL);
             }
 	}
@@ -1740,10 +1760,10 @@ skip:
 
     ret->name = xmlStringText;
     if (intern == NULL) {
-	ret->content = xmlStrndup(str, len);
+	ret->content = xmlDocStrndup(doc, str, len);
 	if (ret->content == NULL) {
 	    xmlSAX2ErrMemory(ctxt);
-	    xmlFree(ret);
+	    xmlDocFreeMem(doc, ret);
 	    return(NULL);
 	}
     } else
@@ -1830,7 +1850,7 @@ xmlSAX2AttributeNs(xmlParserCtxtPtr ctxt,
 	ctxt->freeAttrs = ret->next;
 	ctxt->freeAttrsNr--;
     } else {
-        ret = xmlMalloc(sizeof(*ret));
+        ret = xmlDocMalloc(ctxt->node->doc, sizeof(*ret));
         if (ret == NULL) {
             xmlSAX2ErrMemory(ctxt);
             return(NULL);
@@ -1856,7 +1876,7 @@ xmlSAX2AttributeNs(xmlParserCtxtPtr ctxt,
     if (ctxt->dictNames) {
         ret->name = localname;
     } else {
-        ret->name = xmlStrdup(localname);
+        ret->name = xmlDocStrdup(ret->doc, localname);
         if (ret->name == NULL)
             xmlSAX2ErrMemory(ctxt);
     }
@@ -2134,7 +2154,7 @@ xmlSAX2StartElementNs(void *ctx,
     for (i = 0,j = 0;j < nb_namespaces;j++) {
         pref = namespaces[i++];
 	uri = namespaces[i++];
-	ns = xmlNewNs(NULL, uri, pref);
+	ns = xmlDocNewNs(ret->doc, NULL, uri, pref);
 	if (ns != NULL) {
 	    if (last == NULL) {
 	        ret->nsDef = last = ns;
@@ -2196,7 +2216,7 @@ xmlSAX2StartElementNs(void *ctx,
                 xmlSAX2ErrMemory(ctxt);
 	}
 	if (ret->ns == NULL) {
-	    ns = xmlNewNs(ret, NULL, prefix);
+	    ns = xmlDocNewNs(ret->doc, ret, NULL, prefix);
 	    if (ns == NULL) {
 
 	        xmlSAX2ErrMemory(ctxt);
@@ -2397,6 +2417,8 @@ xmlSAX2Text(xmlParserCtxtPtr ctxt, const xmlChar *ch, int len,
         } else {
             xmlSAX2AppendChild(ctxt, node);
         }
+        if (ctxt->lineIndex != NULL)
+            xmlSAX2SetOffset(ctxt, node);
 
         ctxt->nodelen = len;
         ctxt->nodemem = len + 1;
@@ -2435,15 +2457,16 @@ xmlSAX2Text(xmlParserCtxtPtr ctxt, const xmlChar *ch, int len,
                 capacity = newSize > INT_MAX / 2 ? INT_MAX : newSize * 2;
 
             /*
-             * If the content was stored in properties or in
-             * the dictionary, don't realloc.
+             * If the content was stored in properties, in the
+             * dictionary or in the document arena, don't realloc.
              */
             if ((content == (xmlChar *) &lastChild->properties) ||
                 ((ctxt->nodemem == oldSize + 1) &&
-                 (xmlDictOwns(ctxt->dict, content)))) {
+                 (xmlDictOwns(ctxt->dict, content))) ||
+                (xmlDocOwnsMem(lastChild->doc, content))) {
                 xmlChar *newContent;
 
-                newContent = xmlMalloc(capacity);
+                newContent = xmlDocMalloc(lastChild->doc, capacity);
                 if (newContent == NULL) {
                     xmlSAX2ErrMemory(ctxt);
                     return;
@@ -2476,7 +2499,8 @@ xmlSAX2Text(xmlParserCtxtPtr ctxt, const xmlChar *ch, int len,
             lastChild->line = ctxt->input->line;
         else {
             lastChild->line = USHRT_MAX;
-            if (ctxt->options & XML_PARSE_BIG_LINES)
+            if ((ctxt->options & XML_PARSE_BIG_LINES) &&
+                (ctxt->lineIndex == NULL))
                 lastChild->psvi = XML_INT_TO_PTR(ctxt->input->line);
         }
     }
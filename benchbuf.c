@@ -0,0 +1,330 @@
+/*
+ * benchbuf.c: replay xmlBuf operation traces against a buffer backend
+ *
+ * This program is built once per xmlBuf implementation (buf_old.c and
+ * the Rust port in rust/src/buf.rs) so both can be compared on the
+ * access patterns of real workloads. It reports the time per operation
+ * and the number of heap allocations per replay.
+ *
+ * Traces are recorded with the Rust library built with the "trace"
+ * cargo feature, for example:
+ *
+ *   XML_BUF_TRACE=test/buf/parse.trace xmllint --noout doc.xml
+ *
+ * Each line holds "<op> <id> <arg>" where op is one of
+ *
+ *   c  create with initial size arg
+ *   m  create from memory of size arg, M for static memory
+ *   a  add arg bytes
+ *   t  cat a string of arg bytes
+ *   g  grow by arg bytes
+ *   l  add arg bytes written in place
+ *   s  shrink by arg bytes
+ *   e  empty
+ *   d  detach
+ *   q  query content, use or available size
+ *   f  free
+ *
+ * See Copyright for the status of this software.
+ */
+
+#include "libxml.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xmlmemory.h>
+
+#include "private/buf.h"
+
+#ifndef BUF_BACKEND
+  #define BUF_BACKEND "unknown"
+#endif
+
+#define POOL_SIZE (1024 * 1024)
+#define MIN_BENCH_TIME 0.25
+
+typedef struct {
+    char op;
+    unsigned id;
+    size_t arg;
+} benchOp;
+
+typedef struct {
+    const char *name;
+    benchOp *ops;
+    size_t nbOps;
+    unsigned nbIds;
+} benchTrace;
+
+static xmlChar pool[POOL_SIZE + 1];
+static volatile size_t sink;
+
+/*
+ * Count every heap allocation, including those of the Rust global
+ * allocator which bypass xmlMalloc.
+ */
+#ifdef __GLIBC__
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static size_t nbAllocs;
+
+void *
+malloc(size_t size) {
+    nbAllocs++;
+    return(__libc_malloc(size));
+}
+
+void *
+calloc(size_t nmemb, size_t size) {
+    nbAllocs++;
+    return(__libc_calloc(nmemb, size));
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    nbAllocs++;
+    return(__libc_realloc(ptr, size));
+}
+
+#define HAVE_ALLOC_COUNT
+
+#endif /* __GLIBC__ */
+
+static double
+now(void) {
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static int
+loadTrace(const char *filename, benchTrace *trace) {
+    FILE *f;
+    size_t max = 1024;
+    char op;
+    unsigned id;
+    size_t arg;
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s\n", filename);
+        return(-1);
+    }
+
+    trace->name = filename;
+    trace->nbOps = 0;
+    trace->nbIds = 0;
+    trace->ops = malloc(max * sizeof(trace->ops[0]));
+    if (trace->ops == NULL)
+        goto oom;
+
+    while (fscanf(f, " %c %u %zu", &op, &id, &arg) == 3) {
+        if (trace->nbOps >= max) {
+            benchOp *tmp;
+
+            max *= 2;
+            tmp = realloc(trace->ops, max * sizeof(trace->ops[0]));
+            if (tmp == NULL)
+                goto oom;
+            trace->ops = tmp;
+        }
+        if (arg > POOL_SIZE)
+            arg = POOL_SIZE;
+        trace->ops[trace->nbOps].op = op;
+        trace->ops[trace->nbOps].id = id;
+        trace->ops[trace->nbOps].arg = arg;
+        trace->nbOps++;
+        if (id >= trace->nbIds)
+            trace->nbIds = id + 1;
+    }
+
+    fclose(f);
+    return(0);
+
+oom:
+    fprintf(stderr, "Out of memory loading %s\n", filename);
+    fclose(f);
+    return(-1);
+}
+
+/*
+ * Replay a trace once. Returns the number of operations which failed.
+ */
+static size_t
+replayTrace(const benchTrace *trace, xmlBuf **bufs) {
+    size_t i, failed = 0;
+    unsigned id;
+
+    for (i = 0; i < trace->nbOps; i++) {
+        const benchOp *op = &trace->ops[i];
+        xmlBuf *buf = bufs[op->id];
+        const xmlChar *tail = pool + POOL_SIZE - op->arg;
+
+        if ((buf == NULL) &&
+            (op->op != 'c') && (op->op != 'm') && (op->op != 'M')) {
+            failed++;
+            continue;
+        }
+
+        switch (op->op) {
+            case 'c':
+                bufs[op->id] = xmlBufCreate(op->arg);
+                if (bufs[op->id] == NULL)
+                    failed++;
+                break;
+            case 'm':
+            case 'M':
+                bufs[op->id] = xmlBufCreateMem(tail, op->arg, op->op == 'M');
+                if (bufs[op->id] == NULL)
+                    failed++;
+                break;
+            case 'a':
+                if (xmlBufAdd(buf, pool, op->arg) < 0)
+                    failed++;
+                break;
+            case 't':
+                if (xmlBufCat(buf, tail) < 0)
+                    failed++;
+                break;
+            case 'g':
+                if (xmlBufGrow(buf, op->arg) < 0)
+                    failed++;
+                break;
+            case 'l':
+                if (xmlBufAddLen(buf, op->arg) < 0)
+                    failed++;
+                break;
+            case 's':
+                xmlBufShrink(buf, op->arg);
+                break;
+            case 'e':
+                xmlBufEmpty(buf);
+                break;
+            case 'd': {
+                xmlChar *content = xmlBufDetach(buf);
+
+                if (content == NULL)
+                    failed++;
+                xmlFree(content);
+                break;
+            }
+            case 'q':
+                if (xmlBufContent(buf) == NULL)
+                    failed++;
+                sink += xmlBufUse(buf) + xmlBufAvail(buf);
+                break;
+            case 'f':
+                xmlBufFree(buf);
+                bufs[op->id] = NULL;
+                break;
+            default:
+                failed++;
+                break;
+        }
+    }
+
+    /* Buffers still alive at the end of the recording */
+    for (id = 0; id < trace->nbIds; id++) {
+        if (bufs[id] != NULL) {
+            xmlBufFree(bufs[id]);
+            bufs[id] = NULL;
+        }
+    }
+
+    return(failed);
+}
+
+static int
+benchTraceFile(const benchTrace *trace, int check) {
+    xmlBuf **bufs;
+    size_t failed, reps = 0;
+    size_t allocs = 0;
+    double start, elapsed;
+
+    bufs = calloc(trace->nbIds + 1, sizeof(bufs[0]));
+    if (bufs == NULL)
+        return(-1);
+
+#ifdef HAVE_ALLOC_COUNT
+    allocs = nbAllocs;
+#endif
+    failed = replayTrace(trace, bufs);
+#ifdef HAVE_ALLOC_COUNT
+    allocs = nbAllocs - allocs;
+#endif
+
+    if (check) {
+        if (failed > 0)
+            fprintf(stderr, "%s: %s: %lu operations failed\n",
+                    BUF_BACKEND, trace->name, (unsigned long) failed);
+        free(bufs);
+        return(failed > 0 ? -1 : 0);
+    }
+
+    start = now();
+    do {
+        replayTrace(trace, bufs);
+        reps++;
+        elapsed = now() - start;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    printf("%-8s %-28s %9lu %8.1f ", BUF_BACKEND, trace->name,
+           (unsigned long) trace->nbOps,
+           elapsed * 1e9 / ((double) reps * trace->nbOps));
+#ifdef HAVE_ALLOC_COUNT
+    printf("%9lu", (unsigned long) allocs);
+#else
+    printf("%9s", "-");
+#endif
+    printf(" %7lu\n", (unsigned long) failed);
+
+    free(bufs);
+    return(0);
+}
+
+int
+main(int argc, char **argv) {
+    int check = 0;
+    int ret = 0;
+    int i;
+
+    memset(pool, 'x', POOL_SIZE);
+    pool[POOL_SIZE] = 0;
+
+    if ((argc > 1) && (strcmp(argv[1], "--check") == 0)) {
+        check = 1;
+        argc--;
+        argv++;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "Usage: benchbuf [--check] trace...\n");
+        return(1);
+    }
+
+    if (!check)
+        printf("%-8s %-28s %9s %8s %9s %7s\n",
+               "backend", "trace", "ops", "ns/op", "allocs", "failed");
+
+    for (i = 1; i < argc; i++) {
+        benchTrace trace;
+
+        if (loadTrace(argv[i], &trace) < 0) {
+            ret = 1;
+            continue;
+        }
+        if (benchTraceFile(&trace, check) < 0)
+            ret = 1;
+        free(trace.ops);
+    }
+
+    return(ret);
+}
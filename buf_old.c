@@ -108,6 +108,21 @@ xmlBufCreate(size_t size) {
     return(ret);
 }
 
+/**
+ * Create a buffer for streaming input.
+ *
+ * The Rust implementation switches such buffers to a double-mapped
+ * ring once they hold a lot of unconsumed data. This implementation
+ * always uses a regular buffer.
+ *
+ * @param size  initial buffer size
+ * @returns  the new structure
+ */
+xmlBuf *
+xmlBufCreateRing(size_t size) {
+    return(xmlBufCreate(size));
+}
+
 /**
  * Create a buffer initialized with memory.
  *
@@ -21,9 +21,21 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if HAVE_DECL_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  /* seems needed for Solaris */
+  #ifndef MAP_FAILED
+    #define MAP_FAILED ((void *) -1)
+  #endif
+#endif
+
 #include "private/dict.h"
 #include "private/error.h"
 #include "private/globals.h"
@@ -66,14 +78,27 @@ struct _xmlDict {
     size_t size;
     unsigned int nbElems;
     xmlDictStringsPtr strings;
+    /* number of resizes, for statistics */
+    unsigned nbGrows;
 
     struct _xmlDict *subdict;
     /* used for randomization */
     unsigned seed;
     /* used to impose a limit on size */
     size_t limit;
+    /* read-only, can be shared between threads */
+    int frozen;
+    /* subdict was already frozen when this dict was created */
+    int subFrozen;
+    /* file loaded with xmlDictLoadFile, holds the strings */
+    void *file;
+    size_t fileSize;
+    int fileMapped;
 };
 
+static int
+xmlDictGrow(xmlDictPtr dict, unsigned size);
+
 /*
  * A mutex for modifying the reference counter for shared
  * dictionaries.
@@ -260,6 +285,12 @@ xmlDictCreate(void) {
         return(NULL);
     dict->ref_counter = 1;
     dict->limit = 0;
+    dict->frozen = 0;
+    dict->subFrozen = 0;
+    dict->nbGrows = 0;
+    dict->file = NULL;
+    dict->fileSize = 0;
+    dict->fileMapped = 0;
 
     dict->size = 0;
     dict->nbElems = 0;
@@ -289,11 +320,80 @@ xmlDictCreateSub(xmlDict *sub) {
     if ((dict != NULL) && (sub != NULL)) {
         dict->seed = sub->seed;
         dict->subdict = sub;
+        dict->subFrozen = sub->frozen;
 	xmlDictReference(dict->subdict);
     }
     return(dict);
 }
 
+/**
+ * Make a dictionary read-only.
+ *
+ * Lookups in a frozen dictionary never add strings, so it can be
+ * used by any number of threads without locking. The intended use is
+ * as the parent of per-thread or per-document sub-dictionaries created
+ * with #xmlDictCreateSub: strings of a shared vocabulary are interned
+ * once and stay pointer-comparable across documents, while lookups
+ * in the sub-dictionaries probe the frozen parent first.
+ *
+ * The hash table is resized for a lower load factor to shorten probe
+ * sequences. Strings aren't moved, so pointers returned before
+ * freezing remain valid.
+ *
+ * @since 2.15.0
+ *
+ * @param dict  the dictionary
+ * @returns 0 in case of success and -1 in case of error
+ */
+int
+xmlDictFreeze(xmlDict *dict) {
+    if (dict == NULL)
+        return(-1);
+    if (dict->frozen)
+        return(0);
+
+    /*
+     * Keep the table at most half full. This is only an optimization,
+     * so a failed allocation is ignored.
+     */
+    if ((dict->size > 0) && (dict->size < MAX_HASH_SIZE) &&
+        (dict->nbElems > dict->size / 2)) {
+        unsigned newSize = dict->size * 2;
+
+        xmlDictGrow(dict, newSize);
+    }
+
+    dict->frozen = 1;
+    return(0);
+}
+
+/**
+ * @param dict  the dictionary
+ * @returns 1 if the dictionary is frozen, 0 otherwise.
+ */
+int
+xmlDictIsFrozen(const xmlDict *dict) {
+    if (dict == NULL)
+        return(0);
+    return(dict->frozen);
+}
+
+/**
+ * @param dict  the dictionary
+ * @returns 1 if the dictionary has more than one reference, 0 otherwise.
+ */
+int
+xmlDictIsShared(xmlDict *dict) {
+    int ret;
+
+    if (dict == NULL)
+        return(0);
+    xmlMutexLock(&xmlDictMutex);
+    ret = (dict->ref_counter > 1);
+    xmlMutexUnlock(&xmlDictMutex);
+    return(ret);
+}
+
 /**
  * Increment the reference counter of a dictionary
  *
@@ -345,6 +445,14 @@ xmlDictFree(xmlDict *dict) {
 	xmlFree(pool);
 	pool = nextp;
     }
+    if (dict->file != NULL) {
+#if HAVE_DECL_MMAP
+        if (dict->fileMapped)
+            munmap(dict->file, dict->fileSize);
+        else
+#endif
+            xmlFree(dict->file);
+    }
     xmlFree(dict);
 }
 
@@ -368,6 +476,10 @@ xmlDictOwns(xmlDict *dict, const xmlChar *str) {
 	    return(1);
 	pool = pool->next;
     }
+    if ((dict->file != NULL) &&
+        (str >= (const xmlChar *) dict->file) &&
+        (str < (const xmlChar *) dict->file + dict->fileSize))
+        return(1);
     if (dict->subdict)
         return(xmlDictOwns(dict->subdict, str));
     return(0);
@@ -430,53 +542,150 @@ xmlDictGetUsage(xmlDict *dict) {
     return(limit);
 }
 
-/*****************************************************************
+/**
+ * Compute statistics of the hash table of a dictionary. Only
+ * strings owned by `dict` itself are taken into account, not those
+ * of a parent dictionary.
  *
- * The code below was rewritten and is additionally licensed under
- * the main license in file 'Copyright'.
+ * The table is scanned on every call, so this is meant for
+ * diagnostics, not for hot paths.
  *
- *****************************************************************/
-
+ * @since 2.15.0
+ *
+ * @param dict  the dictionary
+ * @param stats  result
+ * @returns 0 in case of success or -1 in case of error
+ */
 ATTRIBUTE_NO_SANITIZE_INTEGER
-static unsigned
-xmlDictHashName(unsigned seed, const xmlChar* data, size_t maxLen,
-                size_t *plen) {
-    unsigned h1, h2;
+int
+xmlDictGetStats(xmlDict *dict, xmlHashStats *stats) {
+    xmlDictStringsPtr pool;
     size_t i;
 
-    HASH_INIT(h1, h2, seed);
+    if ((dict == NULL) || (stats == NULL))
+        return(-1);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->size = dict->size;
+    stats->nbGrows = dict->nbGrows;
+    stats->memory = dict->size * sizeof(dict->table[0]) + dict->fileSize;
 
-    for (i = 0; i < maxLen && data[i]; i++) {
-        HASH_UPDATE(h1, h2, data[i]);
+    for (i = 0; i < dict->size; i++) {
+        const xmlDictEntry *entry = &dict->table[i];
+        size_t probe;
+
+        if (entry->hashValue == 0)
+            continue;
+
+        probe = ((i - entry->hashValue) & (dict->size - 1)) + 1;
+        stats->nbElems++;
+        stats->totalProbe += probe;
+        if (probe > stats->maxProbe)
+            stats->maxProbe = probe;
     }
 
-    HASH_FINISH(h1, h2);
+    pool = dict->strings;
+    while (pool != NULL) {
+        stats->memory += sizeof(*pool) + pool->size;
+	pool = pool->next;
+    }
 
-    *plen = i;
-    return(h2 | MAX_HASH_SIZE);
+    return(0);
 }
 
-ATTRIBUTE_NO_SANITIZE_INTEGER
-static unsigned
-xmlDictHashQName(unsigned seed, const xmlChar *prefix, const xmlChar *name,
-                 size_t *pplen, size_t *plen) {
-    unsigned h1, h2;
-    size_t i;
+/*****************************************************************
+ *
+ * The code below was rewritten and is additionally licensed under
+ * the main license in file 'Copyright'.
+ *
+ *****************************************************************/
 
-    HASH_INIT(h1, h2, seed);
+/*
+ * Names are hashed four bytes at a time. Bytes are combined into
+ * little-endian words regardless of the platform's byte order and fed
+ * into a GoodOAAT-style update, so the state stays keyed by the seed.
+ * Since names can't contain null bytes, padding the last word with
+ * zeros is unambiguous.
+ *
+ * QNames are hashed as "prefix:name", so xmlDictQLookup and
+ * xmlDictLookup of the full name agree.
+ */
 
-    for (i = 0; prefix[i] != 0; i++) {
-        HASH_UPDATE(h1, h2, prefix[i]);
+#define HASH_UPDATE_WORD(h1, h2, w) \
+    do { \
+        h1 += (w); \
+        h1 += h1 << 3; \
+        h1 = HASH_ROL(h1, 13); \
+        h2 += h1; \
+        h2 = HASH_ROL(h2, 7); \
+        h2 += h2 << 2; \
+    } while (0)
+
+#define HASH_LOAD_WORD(p) \
+    ((unsigned) (p)[0] | \
+     (unsigned) (p)[1] << 8 | \
+     (unsigned) (p)[2] << 16 | \
+     (unsigned) (p)[3] << 24)
+
+typedef struct {
+    unsigned h1;
+    unsigned h2;
+    unsigned pending;   /* bytes of an incomplete word */
+    unsigned shift;     /* 8 times the number of pending bytes */
+} xmlDictHashState;
+
+static void
+xmlDictHashInit(xmlDictHashState *state, unsigned seed) {
+    HASH_INIT(state->h1, state->h2, seed);
+    state->pending = 0;
+    state->shift = 0;
+}
+
+/*
+ * Hash `len` bytes which must not contain a null byte.
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static void
+xmlDictHashUpdate(xmlDictHashState *state, const xmlChar *data,
+                  size_t len) {
+    unsigned h1 = state->h1;
+    unsigned h2 = state->h2;
+
+    /* Complete a pending word, only happens for QNames */
+    while ((state->shift != 0) && (len > 0)) {
+        state->pending |= (unsigned) *data++ << state->shift;
+        len--;
+        state->shift += 8;
+        if (state->shift == 32) {
+            HASH_UPDATE_WORD(h1, h2, state->pending);
+            state->pending = 0;
+            state->shift = 0;
+        }
     }
-    *pplen = i;
 
-    HASH_UPDATE(h1, h2, ':');
+    while (len >= 4) {
+        HASH_UPDATE_WORD(h1, h2, HASH_LOAD_WORD(data));
+        data += 4;
+        len -= 4;
+    }
 
-    for (i = 0; name[i] != 0; i++) {
-        HASH_UPDATE(h1, h2, name[i]);
+    while (len > 0) {
+        state->pending |= (unsigned) *data++ << state->shift;
+        state->shift += 8;
+        len--;
     }
-    *plen = i;
 
+    state->h1 = h1;
+    state->h2 = h2;
+}
+
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static unsigned
+xmlDictHashFinish(xmlDictHashState *state) {
+    unsigned h1 = state->h1;
+    unsigned h2 = state->h2;
+
+    HASH_UPDATE_WORD(h1, h2, state->pending);
     HASH_FINISH(h1, h2);
 
     /*
@@ -486,6 +695,44 @@ xmlDictHashQName(unsigned seed, const xmlChar *prefix, const xmlChar *name,
     return(h2 | MAX_HASH_SIZE);
 }
 
+static unsigned
+xmlDictHashName(unsigned seed, const xmlChar* data, size_t maxLen,
+                size_t *plen) {
+    xmlDictHashState state;
+    size_t len;
+
+    /* The length is found with the C library's vectorized routines */
+    if (maxLen == SIZE_MAX) {
+        len = strlen((const char *) data);
+    } else {
+        const xmlChar *end = memchr(data, 0, maxLen);
+
+        len = (end != NULL) ? (size_t) (end - data) : maxLen;
+    }
+
+    xmlDictHashInit(&state, seed);
+    xmlDictHashUpdate(&state, data, len);
+
+    *plen = len;
+    return(xmlDictHashFinish(&state));
+}
+
+static unsigned
+xmlDictHashQName(unsigned seed, const xmlChar *prefix, const xmlChar *name,
+                 size_t *pplen, size_t *plen) {
+    xmlDictHashState state;
+
+    *pplen = strlen((const char *) prefix);
+    *plen = strlen((const char *) name);
+
+    xmlDictHashInit(&state, seed);
+    xmlDictHashUpdate(&state, prefix, *pplen);
+    xmlDictHashUpdate(&state, BAD_CAST ":", 1);
+    xmlDictHashUpdate(&state, name, *plen);
+
+    return(xmlDictHashFinish(&state));
+}
+
 /**
  * Compute the hash value of a C string.
  *
@@ -587,6 +834,42 @@ xmlDictFindEntry(const xmlDict *dict, const xmlChar *prefix,
     return(entry);
 }
 
+/**
+ * Look up a string in the parent dictionary.
+ *
+ * @param dict  dict
+ * @param prefix  optional QName prefix
+ * @param name  string
+ * @param len  length of name
+ * @param klen  length of the key including prefix
+ * @param hashValue  hash value of the string in `dict`
+ * @returns the entry or NULL if not found.
+ */
+static const xmlDictEntry *
+xmlDictFindSubEntry(const xmlDict *dict, const xmlChar *prefix,
+                    const xmlChar *name, size_t len, size_t klen,
+                    unsigned hashValue) {
+    const xmlDict *sub = dict->subdict;
+    const xmlDictEntry *entry;
+    size_t plen;
+    int found;
+
+    if ((sub == NULL) || (sub->size == 0))
+        return(NULL);
+
+    /* Sub-dictionaries inherit the seed, so the hash can be reused */
+    if (sub->seed != dict->seed) {
+        if (prefix == NULL)
+            hashValue = xmlDictHashName(sub->seed, name, len, &len);
+        else
+            hashValue = xmlDictHashQName(sub->seed, prefix, name,
+                                         &plen, &len);
+    }
+
+    entry = xmlDictFindEntry(sub, prefix, name, klen, hashValue, &found);
+    return(found ? entry : NULL);
+}
+
 /**
  * Resize the dictionary hash table.
  *
@@ -644,6 +927,7 @@ xmlDictGrow(xmlDictPtr dict, unsigned size) {
     }
 
     xmlFree(dict->table);
+    dict->nbGrows++;
 
 done:
     dict->table = table;
@@ -652,6 +936,44 @@ done:
     return(0);
 }
 
+/*
+ * Store a new entry at `entry`, the insertion point returned by a
+ * failed search, shifting the remainder of the probe sequence to the
+ * right.
+ */
+static void
+xmlDictInsertEntry(xmlDictPtr dict, xmlDictEntry *entry, unsigned hashValue,
+                   const xmlChar *name) {
+    if (entry->hashValue != 0) {
+        const xmlDictEntry *end = &dict->table[dict->size];
+        const xmlDictEntry *cur = entry;
+
+        do {
+            cur++;
+            if (cur >= end)
+                cur = dict->table;
+        } while (cur->hashValue != 0);
+
+        if (cur < entry) {
+            /*
+             * If we traversed the end of the buffer, handle the part
+             * at the start of the buffer.
+             */
+            memmove(&dict->table[1], dict->table,
+                    (char *) cur - (char *) dict->table);
+            cur = end - 1;
+            dict->table[0] = *cur;
+        }
+
+        memmove(&entry[1], entry, (char *) cur - (char *) entry);
+    }
+
+    entry->hashValue = hashValue;
+    entry->name = name;
+
+    dict->nbElems++;
+}
+
 /**
  * Internal lookup and update function.
  *
@@ -691,6 +1013,19 @@ xmlDictLookupInternal(xmlDict *dict, const xmlChar *prefix,
     if ((dict->limit > 0) && (klen >= dict->limit))
         return(NULL);
 
+    /*
+     * A frozen parent holds the shared vocabulary, so most names are
+     * found there. It can be read without synchronization.
+     */
+    if (dict->subFrozen) {
+        const xmlDictEntry *subEntry;
+
+        subEntry = xmlDictFindSubEntry(dict, prefix, name, len, klen,
+                                       hashValue);
+        if (subEntry != NULL)
+            return(subEntry);
+    }
+
     /*
      * Check for an existing entry
      */
@@ -710,23 +1045,16 @@ xmlDictLookupInternal(xmlDict *dict, const xmlChar *prefix,
         }
     }
 
-    if ((dict->subdict != NULL) && (dict->subdict->size > 0)) {
-        xmlDictEntry *subEntry;
-        unsigned subHashValue;
+    if ((dict->subdict != NULL) && (!dict->subFrozen)) {
+        const xmlDictEntry *subEntry;
 
-        if (prefix == NULL)
-            subHashValue = xmlDictHashName(dict->subdict->seed, name, len,
-                                           &len);
-        else
-            subHashValue = xmlDictHashQName(dict->subdict->seed, prefix, name,
-                                            &plen, &len);
-        subEntry = xmlDictFindEntry(dict->subdict, prefix, name, klen,
-                                    subHashValue, &found);
-        if (found)
+        subEntry = xmlDictFindSubEntry(dict, prefix, name, len, klen,
+                                       hashValue);
+        if (subEntry != NULL)
             return(subEntry);
     }
 
-    if (!update)
+    if ((!update) || (dict->frozen))
         return(NULL);
 
     /*
@@ -763,42 +1091,73 @@ xmlDictLookupInternal(xmlDict *dict, const xmlChar *prefix,
     if (ret == NULL)
         return(NULL);
 
-    /*
-     * Shift the remainder of the probe sequence to the right
-     */
-    if (entry->hashValue != 0) {
-        const xmlDictEntry *end = &dict->table[dict->size];
-        const xmlDictEntry *cur = entry;
+    xmlDictInsertEntry(dict, entry, hashValue, ret);
 
-        do {
-            cur++;
-            if (cur >= end)
-                cur = dict->table;
-        } while (cur->hashValue != 0);
+    return(entry);
+}
 
-        if (cur < entry) {
-            /*
-             * If we traversed the end of the buffer, handle the part
-             * at the start of the buffer.
-             */
-            memmove(&dict->table[1], dict->table,
-                    (char *) cur - (char *) dict->table);
-            cur = end - 1;
-            dict->table[0] = *cur;
-        }
+/**
+ * Move the strings of `sub`, a sub-dictionary of `dict` without other
+ * users, into `dict` and free `sub`.
+ *
+ * Strings keep their address, so pointers returned by lookups in
+ * `sub` remain valid and are owned by `dict` afterwards. If a string
+ * is found in both dictionaries, lookups keep returning the copy of
+ * `dict`.
+ *
+ * @param dict  the dictionary
+ * @param sub  a sub-dictionary of `dict`
+ * @returns 0 in case of success, -1 in case of error. Strings are
+ * owned by `dict` even if a memory allocation failed.
+ */
+int
+xmlDictMergeSub(xmlDict *dict, xmlDict *sub) {
+    xmlDictStringsPtr *last;
+    size_t i;
+    int ret = 0;
 
-        memmove(&entry[1], entry, (char *) cur - (char *) entry);
-    }
+    if ((dict == NULL) || (sub == NULL) || (sub->subdict != dict) ||
+        (dict->frozen))
+        return(-1);
 
-    /*
-     * Populate entry
-     */
-    entry->hashValue = hashValue;
-    entry->name = ret;
+    last = &dict->strings;
+    while (*last != NULL)
+        last = &(*last)->next;
+    *last = sub->strings;
+    sub->strings = NULL;
 
-    dict->nbElems++;
+    for (i = 0; i < sub->size; i++) {
+        const xmlDictEntry *subEntry = &sub->table[i];
+        xmlDictEntry *entry;
+        int found;
 
-    return(entry);
+        if (subEntry->hashValue == 0)
+            continue;
+
+        if (dict->nbElems + 1 > dict->size / MAX_FILL_DENOM * MAX_FILL_NUM) {
+            unsigned newSize;
+
+            if (dict->size >= MAX_HASH_SIZE) {
+                ret = -1;
+                break;
+            }
+            newSize = (dict->size == 0) ? MIN_HASH_SIZE : dict->size * 2;
+            if (xmlDictGrow(dict, newSize) != 0) {
+                ret = -1;
+                break;
+            }
+        }
+
+        entry = xmlDictFindEntry(dict, NULL, subEntry->name,
+                                 strlen((const char *) subEntry->name),
+                                 subEntry->hashValue, &found);
+        if (!found)
+            xmlDictInsertEntry(dict, entry, subEntry->hashValue,
+                               subEntry->name);
+    }
+
+    xmlDictFree(sub);
+    return(ret);
 }
 
 /**
@@ -884,6 +1243,312 @@ xmlDictQLookup(xmlDict *dict, const xmlChar *prefix, const xmlChar *name) {
     return(entry->name);
 }
 
+/*
+ * Dictionary files
+ *
+ * A dictionary file holds the hash table and the strings of a
+ * dictionary in a relocatable layout, so it can be mapped read-only
+ * and used as the base of new dictionaries without inserting every
+ * string again. All numbers are 32-bit little-endian.
+ *
+ *   header   magic "XMLDICT\0", version, seed, table size, number of
+ *            entries, size of the strings area, reserved
+ *   table    table size times (hash value, string offset), empty
+ *            buckets have a zero hash value
+ *   strings  null-terminated strings
+ */
+
+#define DICT_FILE_MAGIC "XMLDICT"
+#define DICT_FILE_VERSION 1
+#define DICT_FILE_HEADER_SIZE 32
+#define DICT_FILE_ENTRY_SIZE 8
+
+static void
+xmlDictPutInt(xmlChar *p, unsigned v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static unsigned
+xmlDictGetInt(const xmlChar *p) {
+    return((unsigned) p[0] |
+           (unsigned) p[1] << 8 |
+           (unsigned) p[2] << 16 |
+           (unsigned) p[3] << 24);
+}
+
+/**
+ * Save the strings of a dictionary to a file which can be loaded with
+ * #xmlDictLoadFile. Only strings owned by `dict` itself are saved,
+ * not those of a parent dictionary.
+ *
+ * The file contains the random seed of the dictionary, so every
+ * dictionary loaded from it uses the same hash function.
+ *
+ * @since 2.15.0
+ *
+ * @param dict  the dictionary
+ * @param filename  the output file
+ * @returns 0 in case of success and -1 in case of error
+ */
+int
+xmlDictSaveFile(xmlDict *dict, const char *filename) {
+    xmlChar *table = NULL;
+    xmlChar header[DICT_FILE_HEADER_SIZE];
+    FILE *out = NULL;
+    size_t tableSize, stringsSize = 0, i;
+    int ret = -1;
+
+    if ((dict == NULL) || (filename == NULL))
+        return(-1);
+
+    tableSize = dict->size * DICT_FILE_ENTRY_SIZE;
+    if (tableSize > 0) {
+        table = xmlMalloc(tableSize);
+        if (table == NULL)
+            return(-1);
+    }
+
+    /* Strings are stored in table order */
+    for (i = 0; i < dict->size; i++) {
+        const xmlDictEntry *entry = &dict->table[i];
+        xmlChar *p = &table[i * DICT_FILE_ENTRY_SIZE];
+
+        if (entry->hashValue == 0) {
+            xmlDictPutInt(p, 0);
+            xmlDictPutInt(p + 4, 0);
+        } else {
+            size_t len = strlen((const char *) entry->name) + 1;
+
+            if (stringsSize > 0xFFFFFFFFu - len)
+                goto error;
+            xmlDictPutInt(p, entry->hashValue);
+            xmlDictPutInt(p + 4, stringsSize);
+            stringsSize += len;
+        }
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, DICT_FILE_MAGIC, sizeof(DICT_FILE_MAGIC));
+    xmlDictPutInt(header + 8, DICT_FILE_VERSION);
+    xmlDictPutInt(header + 12, dict->seed);
+    xmlDictPutInt(header + 16, dict->size);
+    xmlDictPutInt(header + 20, dict->nbElems);
+    xmlDictPutInt(header + 24, stringsSize);
+
+    out = fopen(filename, "wb");
+    if (out == NULL)
+        goto error;
+    if (fwrite(header, 1, sizeof(header), out) != sizeof(header))
+        goto error;
+    if ((tableSize > 0) && (fwrite(table, 1, tableSize, out) != tableSize))
+        goto error;
+    for (i = 0; i < dict->size; i++) {
+        const xmlDictEntry *entry = &dict->table[i];
+
+        if (entry->hashValue != 0) {
+            size_t len = strlen((const char *) entry->name) + 1;
+
+            if (fwrite(entry->name, 1, len, out) != len)
+                goto error;
+        }
+    }
+
+    ret = 0;
+
+error:
+    if ((out != NULL) && (fclose(out) != 0))
+        ret = -1;
+    xmlFree(table);
+    return(ret);
+}
+
+/*
+ * Read or map a whole file.
+ */
+static int
+xmlDictReadFile(const char *filename, void **pmem, size_t *psize,
+                int *pmapped) {
+    FILE *in;
+    xmlChar *mem = NULL;
+    size_t size = 0, max = 0;
+
+#if HAVE_DECL_MMAP
+    {
+        struct stat st;
+        void *map;
+        int fd;
+
+        fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            return(-1);
+        if ((fstat(fd, &st) == 0) && (S_ISREG(st.st_mode)) &&
+            (st.st_size > 0) && ((off_t) (size_t) st.st_size == st.st_size)) {
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                close(fd);
+                *pmem = map;
+                *psize = st.st_size;
+                *pmapped = 1;
+                return(0);
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    in = fopen(filename, "rb");
+    if (in == NULL)
+        return(-1);
+
+    while (1) {
+        size_t n;
+
+        if (size == max) {
+            xmlChar *tmp;
+
+            if (max > SIZE_MAX / 2)
+                goto error;
+            max = (max == 0) ? 4096 : max * 2;
+            tmp = xmlRealloc(mem, max);
+            if (tmp == NULL)
+                goto error;
+            mem = tmp;
+        }
+
+        n = fread(mem + size, 1, max - size, in);
+        size += n;
+        if (n == 0)
+            break;
+    }
+    if (ferror(in))
+        goto error;
+
+    fclose(in);
+    *pmem = mem;
+    *psize = size;
+    *pmapped = 0;
+    return(0);
+
+error:
+    fclose(in);
+    xmlFree(mem);
+    return(-1);
+}
+
+/**
+ * Load a dictionary saved with #xmlDictSaveFile.
+ *
+ * The file is mapped read-only if possible, so the strings aren't
+ * copied and their pages are shared between processes loading the
+ * same file. Only the hash table is rebuilt in private memory. The
+ * file is validated, including the hash value of every string.
+ *
+ * The result is frozen, see #xmlDictFreeze. It's meant to be the
+ * parent of dictionaries created with #xmlDictCreateSub.
+ *
+ * @since 2.15.0
+ *
+ * @param filename  the dictionary file
+ * @returns the new dictionary or NULL if the file couldn't be read or
+ * is invalid.
+ */
+xmlDict *
+xmlDictLoadFile(const char *filename) {
+    xmlDictPtr dict = NULL;
+    const xmlChar *base, *table, *strings;
+    void *mem = NULL;
+    size_t size = 0, stringsSize, i;
+    unsigned seed, tableSize, nbElems, count = 0;
+    int mapped = 0;
+
+    if (filename == NULL)
+        return(NULL);
+
+    if (xmlDictReadFile(filename, &mem, &size, &mapped) < 0)
+        return(NULL);
+    base = mem;
+
+    if ((size < DICT_FILE_HEADER_SIZE) ||
+        (memcmp(base, DICT_FILE_MAGIC, sizeof(DICT_FILE_MAGIC)) != 0) ||
+        (xmlDictGetInt(base + 8) != DICT_FILE_VERSION))
+        goto error;
+
+    seed = xmlDictGetInt(base + 12);
+    tableSize = xmlDictGetInt(base + 16);
+    nbElems = xmlDictGetInt(base + 20);
+    stringsSize = xmlDictGetInt(base + 24);
+
+    if ((tableSize > MAX_HASH_SIZE) ||
+        ((tableSize & (tableSize - 1)) != 0) ||
+        ((tableSize > 0) && (tableSize < MIN_HASH_SIZE)) ||
+        (nbElems > tableSize) ||
+        ((size - DICT_FILE_HEADER_SIZE) / DICT_FILE_ENTRY_SIZE < tableSize))
+        goto error;
+    table = base + DICT_FILE_HEADER_SIZE;
+    strings = table + (size_t) tableSize * DICT_FILE_ENTRY_SIZE;
+    if ((size_t) (base + size - strings) != stringsSize)
+        goto error;
+    /* Makes sure that every string is terminated */
+    if ((stringsSize > 0) && (strings[stringsSize - 1] != 0))
+        goto error;
+
+    dict = xmlDictCreate();
+    if (dict == NULL)
+        goto error;
+    dict->seed = seed;
+
+    if (tableSize > 0) {
+        dict->table = xmlMalloc(tableSize * sizeof(dict->table[0]));
+        if (dict->table == NULL)
+            goto error;
+        dict->size = tableSize;
+    }
+
+    for (i = 0; i < tableSize; i++) {
+        xmlDictEntry *entry = &dict->table[i];
+        const xmlChar *p = &table[i * DICT_FILE_ENTRY_SIZE];
+        unsigned hashValue = xmlDictGetInt(p);
+        size_t offset = xmlDictGetInt(p + 4);
+        size_t len;
+
+        entry->hashValue = hashValue;
+        entry->name = NULL;
+        if (hashValue == 0)
+            continue;
+
+        if (offset >= stringsSize)
+            goto error;
+        entry->name = strings + offset;
+
+        /* Rejects files from other versions of the hash function */
+        if (xmlDictHashName(seed, entry->name, SIZE_MAX, &len) != hashValue)
+            goto error;
+        count++;
+    }
+    if (count != nbElems)
+        goto error;
+
+    dict->nbElems = nbElems;
+    dict->file = mem;
+    dict->fileSize = size;
+    dict->fileMapped = mapped;
+    dict->frozen = 1;
+    return(dict);
+
+error:
+    xmlDictFree(dict);
+#if HAVE_DECL_MMAP
+    if (mapped)
+        munmap(mem, size);
+    else
+#endif
+        xmlFree(mem);
+    return(NULL);
+}
+
 /*
  * Pseudo-random generator
  */
@@ -1081,6 +1081,15 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_ATTRIBUTE_NOT_STARTED:
             errmsg = "AttValue: \" or ' expected";
             break;
+        case XML_ERR_ATTRIBUTE_NOT_FINISHED:
+            errmsg = "AttValue: ' expected";
+            break;
+        case XML_ERR_ATTRIBUTE_WITHOUT_VALUE:
+            errmsg = "Specification mandates value for attribute";
+            break;
+        case XML_ERR_ATTRIBUTE_REDEFINED:
+            errmsg = "Attribute redefined";
+            break;
         case XML_ERR_LT_IN_ATTRIBUTE:
             errmsg = "Unescaped '<' not allowed in attributes values";
             break;
@@ -1093,6 +1102,9 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_MISPLACED_CDATA_END:
             errmsg = "Sequence ']]>' not allowed in content";
             break;
+        case XML_ERR_CDATA_NOT_FINISHED:
+            errmsg = "CData section not finished";
+            break;
         case XML_ERR_URI_REQUIRED:
             errmsg = "SYSTEM or PUBLIC, the URI is missing";
             break;
@@ -1102,9 +1114,15 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_HYPHEN_IN_COMMENT:
             errmsg = "Comment must not contain '--' (double-hyphen)";
             break;
+        case XML_ERR_COMMENT_NOT_FINISHED:
+            errmsg = "Comment not terminated";
+            break;
         case XML_ERR_PI_NOT_STARTED:
             errmsg = "xmlParsePI : no target name";
             break;
+        case XML_ERR_PI_NOT_FINISHED:
+            errmsg = "PI not terminated";
+            break;
         case XML_ERR_RESERVED_XML_NAME:
             errmsg = "Invalid PI name";
             break;
@@ -1148,6 +1166,12 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_GT_REQUIRED:
             errmsg = "expected '>'";
             break;
+        case XML_ERR_TAG_NAME_MISMATCH:
+            errmsg = "Opening and ending tag mismatch";
+            break;
+        case XML_ERR_TAG_NOT_FINISHED:
+            errmsg = "Premature end of data in tag";
+            break;
         case XML_ERR_CONDSEC_INVALID:
             errmsg = "XML conditional section '[' expected";
             break;
@@ -1176,6 +1200,9 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_ENTITYREF_SEMICOL_MISSING:
             errmsg = "EntityRef: expecting ';'";
             break;
+        case XML_ERR_UNDECLARED_ENTITY:
+            errmsg = "Entity not defined";
+            break;
         case XML_ERR_DOCTYPE_NOT_FINISHED:
             errmsg = "DOCTYPE improperly terminated";
             break;
@@ -1215,6 +1242,12 @@ xmlErrString(xmlParserErrors code) {
         case XML_ERR_NAME_TOO_LONG:
             errmsg = "Name too long";
             break;
+        case XML_ERR_NAME_REQUIRED:
+            errmsg = "Name required";
+            break;
+        case XML_ERR_SPACE_REQUIRED:
+            errmsg = "Blank needed here";
+            break;
         case XML_ERR_INVALID_ENCODING:
             errmsg = "Invalid bytes in character encoding";
             break;
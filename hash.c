@@ -30,12 +30,30 @@
 #define MIN_HASH_SIZE 8
 #define MAX_HASH_SIZE (1u << 31)
 
+/*
+ * Tables with at least this many buckets are resized incrementally.
+ * Each insertion then migrates a few probe sequences of the old table
+ * until it's empty, instead of rehashing millions of entries at once.
+ */
+#define INCREMENTAL_MIN_SIZE (1u << 16)
+/* Minimum number of old buckets migrated per insertion */
+#define INCREMENTAL_STEP 8
+
+/*
+ * Frozen tables, see xmlHashFreeze. Keys are spread over buckets
+ * holding FROZEN_BUCKET_LOAD keys on average, each bucket gets a
+ * displacement which sends its keys to free slots.
+ */
+#define FROZEN_MAX_ELEMS (1u << 16)
+#define FROZEN_BUCKET_LOAD 4
+#define FROZEN_MAX_BUCKET 32
+#define FROZEN_MAX_DISPL (1u << 20)
+#define FROZEN_ATTEMPTS 8
+
 /*
  * A single entry in the hash table
  */
 typedef struct {
-    unsigned hashValue; /* 0 means unoccupied, occupied entries have the
-                         * MAX_HASH_SIZE bit set to 1 */
     xmlChar *key;
     xmlChar *key2; /* TODO: Don't allocate possibly empty keys */
     xmlChar *key3;
@@ -47,15 +65,45 @@ typedef struct {
  */
 struct _xmlHashTable {
     xmlHashEntry *table;
+    /*
+     * Hash values of the entries, stored apart from the entries so
+     * probe sequences scan 16 buckets per cache line and only touch an
+     * entry if its full hash value matches. 0 means unoccupied,
+     * occupied buckets have the MAX_HASH_SIZE bit set to 1. Allocated
+     * in the same block as the entries.
+     */
+    unsigned *hashes;
     unsigned size; /* power of two */
-    unsigned nbElems;
+    unsigned nbElems; /* including entries of the old table */
     xmlDictPtr dict;
     unsigned randomSeed;
+    unsigned nbGrows; /* number of resizes, for statistics */
+    /*
+     * Old table during an incremental resize. Buckets are migrated
+     * starting at an empty bucket, so the migrated buckets always form
+     * complete probe sequences.
+     */
+    xmlHashEntry *oldTable;
+    unsigned *oldHashes;
+    unsigned oldSize;
+    unsigned migrateStart;
+    unsigned migrated;
+    /*
+     * Displacements of the buckets of a frozen table, allocated in the
+     * same block as the entries. NULL unless the table is frozen. A
+     * frozen table holds exactly `size` slots, which is generally not a
+     * power of two, and removed entries leave a hash value of 0.
+     */
+    unsigned *bucketDispl;
+    unsigned nbBuckets; /* power of two */
 };
 
 static int
 xmlHashGrow(xmlHashTablePtr hash, unsigned size);
 
+static void
+xmlHashMigrate(xmlHashTablePtr hash, unsigned count);
+
 ATTRIBUTE_NO_SANITIZE_INTEGER
 static unsigned
 xmlHashValue(unsigned seed, const xmlChar *key, const xmlChar *key2,
@@ -166,7 +214,16 @@ xmlHashCreate(int size) {
     hash->dict = NULL;
     hash->size = 0;
     hash->table = NULL;
+    hash->hashes = NULL;
     hash->nbElems = 0;
+    hash->nbGrows = 0;
+    hash->oldTable = NULL;
+    hash->oldHashes = NULL;
+    hash->oldSize = 0;
+    hash->migrateStart = 0;
+    hash->migrated = 0;
+    hash->bucketDispl = NULL;
+    hash->nbBuckets = 0;
     hash->randomSeed = xmlRandom();
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     hash->randomSeed = 0;
@@ -213,6 +270,30 @@ xmlHashCreateDict(int size, xmlDict *dict) {
     return(hash);
 }
 
+static void
+xmlHashFreeEntries(xmlHashTablePtr hash, const xmlHashEntry *table,
+                   const unsigned *hashes, unsigned size,
+                   xmlHashDeallocator dealloc) {
+    unsigned i;
+
+    for (i = 0; i < size; i++) {
+        const xmlHashEntry *entry = &table[i];
+
+        if (hashes[i] == 0)
+            continue;
+        if ((dealloc != NULL) && (entry->payload != NULL))
+            dealloc(entry->payload, entry->key);
+        if (hash->dict == NULL) {
+            if (entry->key)
+                xmlFree(entry->key);
+            if (entry->key2)
+                xmlFree(entry->key2);
+            if (entry->key3)
+                xmlFree(entry->key3);
+        }
+    }
+}
+
 /**
  * Free the hash and its contents. The payload is deallocated with
  * `dealloc` if provided.
@@ -226,26 +307,15 @@ xmlHashFree(xmlHashTable *hash, xmlHashDeallocator dealloc) {
         return;
 
     if (hash->table) {
-        const xmlHashEntry *end = &hash->table[hash->size];
-        const xmlHashEntry *entry;
-
-        for (entry = hash->table; entry < end; entry++) {
-            if (entry->hashValue == 0)
-                continue;
-            if ((dealloc != NULL) && (entry->payload != NULL))
-                dealloc(entry->payload, entry->key);
-            if (hash->dict == NULL) {
-                if (entry->key)
-                    xmlFree(entry->key);
-                if (entry->key2)
-                    xmlFree(entry->key2);
-                if (entry->key3)
-                    xmlFree(entry->key3);
-            }
-        }
-
+        xmlHashFreeEntries(hash, hash->table, hash->hashes, hash->size,
+                           dealloc);
         xmlFree(hash->table);
     }
+    if (hash->oldTable) {
+        xmlHashFreeEntries(hash, hash->oldTable, hash->oldHashes,
+                           hash->oldSize, dealloc);
+        xmlFree(hash->oldTable);
+    }
 
     if (hash->dict)
         xmlDictFree(hash->dict);
@@ -268,12 +338,66 @@ xmlFastStrEqual(const xmlChar *s1, const xmlChar *s2) {
                (strcmp((const char *) s1, (const char *) s2) == 0));
 }
 
+/**
+ * Compare the keys of an entry.
+ *
+ * @param hash  hash table
+ * @param entry  hash table entry
+ * @param key  first string key, non-NULL
+ * @param key2  second string key
+ * @param key3  third string key
+ * @returns 1 if the keys are equal, 0 otherwise.
+ */
+static int
+xmlHashEntryEqual(const xmlHashTable *hash, const xmlHashEntry *entry,
+                  const xmlChar *key, const xmlChar *key2,
+                  const xmlChar *key3) {
+    if ((hash->dict) &&
+        (entry->key == key) &&
+        (entry->key2 == key2) &&
+        (entry->key3 == key3))
+        return(1);
+
+    return((strcmp((const char *) entry->key, (const char *) key) == 0) &&
+           (xmlFastStrEqual(entry->key2, key2)) &&
+           (xmlFastStrEqual(entry->key3, key3)));
+}
+
+/**
+ * Compute the slot of a key in a frozen table.
+ *
+ * @param hashValue  hash value of the key with MAX_HASH_SIZE set
+ * @param displ  displacement of the key's bucket
+ * @param size  size of the frozen table
+ * @returns the position
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static unsigned
+xmlHashFrozenPos(unsigned hashValue, unsigned displ, unsigned size) {
+    unsigned h = hashValue ^ displ;
+
+    /*
+     * The hash value is well mixed already. Multiplicative hashing
+     * moves the displacement into the high bits used below.
+     */
+    h = (h * 0x9E3779B1u) & 0xFFFFFFFF;
+
+    /*
+     * Map to [0, size) with (h * size) >> 32 instead of a division.
+     * The product is split in 16-bit halves which don't overflow
+     * since size <= FROZEN_MAX_ELEMS.
+     */
+    return(((h >> 16) * size + (((h & 0xFFFF) * size) >> 16)) >> 16);
+}
+
 /**
  * Try to find a matching hash table entry. If an entry was found, set
- * `found` to 1 and return the entry. Otherwise, set `found` to 0 and return
- * the location where a new entry should be inserted.
+ * `found` to 1 and return its position. Otherwise, set `found` to 0 and
+ * return the position where a new entry should be inserted. Frozen
+ * tables must be thawed before inserting.
  *
  * @param hash  hash table, non-NULL, size > 0
+ * @param old  whether to search the old table of an incremental resize
  * @param key  first string key, non-NULL
  * @param key2  second string key
  * @param key3  third string key
@@ -281,19 +405,31 @@ xmlFastStrEqual(const xmlChar *s1, const xmlChar *s2) {
  * @param pfound  result of search
  */
 ATTRIBUTE_NO_SANITIZE_INTEGER
-static xmlHashEntry *
-xmlHashFindEntry(const xmlHashTable *hash, const xmlChar *key,
+static unsigned
+xmlHashFindEntry(const xmlHashTable *hash, int old, const xmlChar *key,
                  const xmlChar *key2, const xmlChar *key3,
                  unsigned hashValue, int *pfound) {
-    xmlHashEntry *entry;
-    unsigned mask, pos, displ;
+    const xmlHashEntry *table = old ? hash->oldTable : hash->table;
+    const unsigned *hashes = old ? hash->oldHashes : hash->hashes;
+    unsigned mask, pos, displ, cur;
     int found = 0;
 
-    mask = hash->size - 1;
+    if (hash->bucketDispl != NULL) {
+        /* Frozen tables have a single candidate slot */
+        hashValue |= MAX_HASH_SIZE;
+        pos = xmlHashFrozenPos(hashValue,
+                hash->bucketDispl[hashValue & (hash->nbBuckets - 1)],
+                hash->size);
+        *pfound = (hashes[pos] == hashValue) &&
+                  (xmlHashEntryEqual(hash, &table[pos], key, key2, key3));
+        return(pos);
+    }
+
+    mask = (old ? hash->oldSize : hash->size) - 1;
     pos = hashValue & mask;
-    entry = &hash->table[pos];
+    cur = hashes[pos];
 
-    if (entry->hashValue != 0) {
+    if (cur != 0) {
         /*
          * Robin hood hashing: abort if the displacement of the entry
          * is smaller than the displacement of the key we look for.
@@ -303,64 +439,185 @@ xmlHashFindEntry(const xmlHashTable *hash, const xmlChar *key,
         hashValue |= MAX_HASH_SIZE;
 
         do {
-            if (entry->hashValue == hashValue) {
-                if (hash->dict) {
-                    if ((entry->key == key) &&
-                        (entry->key2 == key2) &&
-                        (entry->key3 == key3)) {
-                        found = 1;
-                        break;
-                    }
-                }
-                if ((strcmp((const char *) entry->key,
-                            (const char *) key) == 0) &&
-                    (xmlFastStrEqual(entry->key2, key2)) &&
-                    (xmlFastStrEqual(entry->key3, key3))) {
-                    found = 1;
-                    break;
-                }
+            if ((cur == hashValue) &&
+                (xmlHashEntryEqual(hash, &table[pos], key, key2, key3))) {
+                found = 1;
+                break;
             }
 
             displ++;
-            pos++;
-            entry++;
-            if ((pos & mask) == 0)
-                entry = hash->table;
-        } while ((entry->hashValue != 0) &&
-                 (((pos - entry->hashValue) & mask) >= displ));
+            pos = (pos + 1) & mask;
+            cur = hashes[pos];
+        } while ((cur != 0) && (((pos - cur) & mask) >= displ));
     }
 
     *pfound = found;
-    return(entry);
+    return(pos);
+}
+
+/**
+ * Find the position where a new entry should be inserted. The key
+ * must not be in the table.
+ *
+ * @param hashes  hash values of the table
+ * @param mask  size of the table minus one
+ * @param hashValue  hash value of the new entry
+ * @returns the position
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static unsigned
+xmlHashFindSlot(const unsigned *hashes, unsigned mask, unsigned hashValue) {
+    unsigned pos, displ;
+
+    displ = 0;
+    pos = hashValue & mask;
+
+    if (hashes[pos] != 0) {
+        do {
+            displ++;
+            pos = (pos + 1) & mask;
+        } while ((hashes[pos] != 0) &&
+                 ((pos - hashes[pos]) & mask) >= displ);
+    }
+
+    return(pos);
+}
+
+/**
+ * Store an entry at `pos`, shifting the remainder of the probe
+ * sequence to the right.
+ *
+ * @param table  entries of the table
+ * @param hashes  hash values of the table
+ * @param mask  size of the table minus one
+ * @param pos  position returned by #xmlHashFindSlot
+ * @param entry  the new entry
+ * @param hashValue  hash value of the new entry
+ */
+static void
+xmlHashInsertAt(xmlHashEntry *table, unsigned *hashes, unsigned mask,
+                unsigned pos, const xmlHashEntry *entry, unsigned hashValue) {
+    if (hashes[pos] != 0) {
+        unsigned last = pos;
+
+        do {
+            last = (last + 1) & mask;
+        } while (hashes[last] != 0);
+
+        if (last < pos) {
+            /*
+             * If we traversed the end of the buffer, handle the part
+             * at the start of the buffer.
+             */
+            memmove(&table[1], table, last * sizeof(table[0]));
+            memmove(&hashes[1], hashes, last * sizeof(hashes[0]));
+            last = mask;
+            table[0] = table[last];
+            hashes[0] = hashes[last];
+        }
+
+        memmove(&table[pos + 1], &table[pos],
+                (last - pos) * sizeof(table[0]));
+        memmove(&hashes[pos + 1], &hashes[pos],
+                (last - pos) * sizeof(hashes[0]));
+    }
+
+    table[pos] = *entry;
+    /* OR with MAX_HASH_SIZE to make sure that the value is non-zero */
+    hashes[pos] = hashValue | MAX_HASH_SIZE;
+}
+
+/**
+ * Remove the entry at `pos`, shifting the remainder of the probe
+ * sequence to the left.
+ *
+ * @param table  entries of the table
+ * @param hashes  hash values of the table
+ * @param mask  size of the table minus one
+ * @param pos  position of the entry
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static void
+xmlHashRemoveAt(xmlHashEntry *table, unsigned *hashes, unsigned mask,
+                unsigned pos) {
+    unsigned last, next;
+
+    /*
+     * Find end of probe sequence. Entries at their initial probe
+     * position start a new sequence.
+     */
+    last = pos;
+
+    while (1) {
+        next = (last + 1) & mask;
+
+        if ((hashes[next] == 0) ||
+            (((hashes[next] - next) & mask) == 0))
+            break;
+
+        last = next;
+    }
+
+    /*
+     * Backward shift
+     */
+    if (last < pos) {
+        memmove(&table[pos], &table[pos + 1],
+                (mask - pos) * sizeof(table[0]));
+        memmove(&hashes[pos], &hashes[pos + 1],
+                (mask - pos) * sizeof(hashes[0]));
+        table[mask] = table[0];
+        hashes[mask] = hashes[0];
+        pos = 0;
+    }
+
+    memmove(&table[pos], &table[pos + 1], (last - pos) * sizeof(table[0]));
+    memmove(&hashes[pos], &hashes[pos + 1],
+            (last - pos) * sizeof(hashes[0]));
+
+    hashes[last] = 0;
 }
 
 /**
  * Resize the hash table.
  *
+ * Large tables are resized incrementally: the old table is kept and
+ * its entries are moved by #xmlHashMigrate.
+ *
  * @param hash  hash table
  * @param size  new size of the hash table
  * @returns 0 in case of success, -1 if a memory allocation failed.
  */
+ATTRIBUTE_NO_SANITIZE_INTEGER
 static int
 xmlHashGrow(xmlHashTablePtr hash, unsigned size) {
-    const xmlHashEntry *oldentry, *oldend, *end;
+    const xmlHashEntry *oldtable;
+    const unsigned *oldhashes;
     xmlHashEntry *table;
-    unsigned oldsize, i;
+    unsigned *hashes;
+    unsigned oldsize, mask, oldmask, pos, i;
+
+    /* Finish a pending resize */
+    if (hash->oldTable != NULL)
+        xmlHashMigrate(hash, hash->oldSize);
 
     /* Add 0 to avoid spurious -Wtype-limits warning on 64-bit GCC */
-    if ((size_t) size + 0 > SIZE_MAX / sizeof(table[0]))
+    if ((size_t) size + 0 > SIZE_MAX / (sizeof(table[0]) + sizeof(hashes[0])))
         return(-1);
-    table = xmlMalloc(size * sizeof(table[0]));
+    table = xmlMalloc(size * (sizeof(table[0]) + sizeof(hashes[0])));
     if (table == NULL)
         return(-1);
-    memset(table, 0, size * sizeof(table[0]));
+    hashes = (unsigned *) &table[size];
+    memset(hashes, 0, size * sizeof(hashes[0]));
 
     oldsize = hash->size;
     if (oldsize == 0)
         goto done;
 
-    oldend = &hash->table[oldsize];
-    end = &table[size];
+    oldtable = hash->table;
+    oldhashes = hash->hashes;
+    oldmask = oldsize - 1;
+    mask = size - 1;
 
     /*
      * Robin Hood sorting order is maintained if we
@@ -369,36 +626,135 @@ xmlHashGrow(xmlHashTablePtr hash, unsigned size) {
      * - resize by an integer factor
      * - start to copy from the beginning of a probe sequence
      */
-    oldentry = hash->table;
-    while (oldentry->hashValue != 0) {
-        if (++oldentry >= oldend)
-            oldentry = hash->table;
+    pos = 0;
+    while (oldhashes[pos] != 0)
+        pos = (pos + 1) & oldmask;
+
+    hash->nbGrows++;
+
+    if (oldsize >= INCREMENTAL_MIN_SIZE) {
+        hash->oldTable = hash->table;
+        hash->oldHashes = hash->hashes;
+        hash->oldSize = oldsize;
+        hash->migrateStart = pos;
+        hash->migrated = 0;
+        goto done;
     }
 
     for (i = 0; i < oldsize; i++) {
-        if (oldentry->hashValue != 0) {
-            xmlHashEntry *entry = &table[oldentry->hashValue & (size - 1)];
+        unsigned hashValue = oldhashes[pos];
 
-            while (entry->hashValue != 0) {
-                if (++entry >= end)
-                    entry = table;
-            }
-            *entry = *oldentry;
+        if (hashValue != 0) {
+            unsigned newpos = hashValue & mask;
+
+            while (hashes[newpos] != 0)
+                newpos = (newpos + 1) & mask;
+            hashes[newpos] = hashValue;
+            table[newpos] = oldtable[pos];
         }
 
-        if (++oldentry >= oldend)
-            oldentry = hash->table;
+        pos = (pos + 1) & oldmask;
     }
 
     xmlFree(hash->table);
 
 done:
     hash->table = table;
+    hash->hashes = hashes;
     hash->size = size;
 
     return(0);
 }
 
+/**
+ * Move entries from the old table to the new one during an
+ * incremental resize. At least `count` buckets are processed, then
+ * migration continues to the end of the current probe sequence, so
+ * entries left in the old table can still be found. The old table is
+ * freed once it's empty.
+ *
+ * Entries are inserted with the usual Robin Hood rules since the new
+ * table already receives new entries.
+ *
+ * @param hash  hash table
+ * @param count  minimum number of buckets to process
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static void
+xmlHashMigrate(xmlHashTablePtr hash, unsigned count) {
+    unsigned mask = hash->size - 1;
+    unsigned oldmask = hash->oldSize - 1;
+
+    while (hash->migrated < hash->oldSize) {
+        unsigned pos = (hash->migrateStart + hash->migrated) & oldmask;
+        unsigned hashValue = hash->oldHashes[pos];
+
+        if (hashValue == 0) {
+            if (count == 0)
+                break;
+        } else {
+            xmlHashInsertAt(hash->table, hash->hashes, mask,
+                            xmlHashFindSlot(hash->hashes, mask, hashValue),
+                            &hash->oldTable[pos], hashValue);
+            hash->oldHashes[pos] = 0;
+        }
+
+        hash->migrated++;
+        if (count > 0)
+            count--;
+    }
+
+    if (hash->migrated >= hash->oldSize) {
+        xmlFree(hash->oldTable);
+        hash->oldTable = NULL;
+        hash->oldHashes = NULL;
+        hash->oldSize = 0;
+        hash->migrateStart = 0;
+        hash->migrated = 0;
+    }
+}
+
+/**
+ * Turn a frozen table back into a regular one with room for at least
+ * one more entry.
+ *
+ * @param hash  frozen hash table
+ * @returns 0 in case of success, -1 if a memory allocation failed.
+ */
+static int
+xmlHashThaw(xmlHashTablePtr hash) {
+    xmlHashEntry *frozen = hash->table;
+    unsigned *frozenHashes = hash->hashes;
+    unsigned frozenSize = hash->size;
+    unsigned size, mask, i;
+
+    size = MIN_HASH_SIZE;
+    while (hash->nbElems + 1 > size / MAX_FILL_DENOM * MAX_FILL_NUM)
+        size *= 2;
+
+    /* Make xmlHashGrow allocate an empty table */
+    hash->size = 0;
+    if (xmlHashGrow(hash, size) != 0) {
+        hash->size = frozenSize;
+        return(-1);
+    }
+    hash->bucketDispl = NULL;
+    hash->nbBuckets = 0;
+
+    mask = size - 1;
+    for (i = 0; i < frozenSize; i++) {
+        unsigned hashValue = frozenHashes[i];
+
+        if (hashValue != 0)
+            xmlHashInsertAt(hash->table, hash->hashes, mask,
+                            xmlHashFindSlot(hash->hashes, mask, hashValue),
+                            &frozen[i], hashValue);
+    }
+
+    xmlFree(frozen);
+    return(0);
+}
+
 /**
  * Internal function to add or update hash entries.
  *
@@ -416,9 +772,9 @@ xmlHashUpdateInternal(xmlHashTable *hash, const xmlChar *key,
                       const xmlChar *key2, const xmlChar *key3,
                       void *payload, xmlHashDeallocator dealloc, int update) {
     xmlChar *copy, *copy2, *copy3;
-    xmlHashEntry *entry = NULL;
+    xmlHashEntry entry;
     size_t lengths[3] = {0, 0, 0};
-    unsigned hashValue, newSize;
+    unsigned hashValue, newSize, pos = 0;
 
     if ((hash == NULL) || (key == NULL))
         return(-1);
@@ -431,20 +787,37 @@ xmlHashUpdateInternal(xmlHashTable *hash, const xmlChar *key,
     if (hash->size == 0) {
         newSize = MIN_HASH_SIZE;
     } else {
+        xmlHashEntry *old = NULL;
         int found = 0;
 
-        entry = xmlHashFindEntry(hash, key, key2, key3, hashValue, &found);
-
+        pos = xmlHashFindEntry(hash, 0, key, key2, key3, hashValue, &found);
         if (found) {
+            old = &hash->table[pos];
+        } else if (hash->oldTable != NULL) {
+            unsigned oldpos;
+
+            oldpos = xmlHashFindEntry(hash, 1, key, key2, key3, hashValue,
+                                      &found);
+            if (found)
+                old = &hash->oldTable[oldpos];
+        }
+
+        if (old != NULL) {
             if (update) {
                 if (dealloc)
-                    dealloc(entry->payload, entry->key);
-                entry->payload = payload;
+                    dealloc(old->payload, old->key);
+                old->payload = payload;
             }
 
             return(0);
         }
 
+        if (hash->bucketDispl != NULL) {
+            if (xmlHashThaw(hash) != 0)
+                return(-1);
+            pos = xmlHashFindSlot(hash->hashes, hash->size - 1, hashValue);
+        }
+
         if (hash->nbElems + 1 > hash->size / MAX_FILL_DENOM * MAX_FILL_NUM) {
             /* This guarantees that nbElems < INT_MAX */
             if (hash->size >= MAX_HASH_SIZE)
@@ -456,32 +829,20 @@ xmlHashUpdateInternal(xmlHashTable *hash, const xmlChar *key,
     }
 
     /*
-     * Grow the hash table if needed
+     * Grow the hash table if needed and continue an incremental resize
      */
-    if (newSize > 0) {
-        unsigned mask, displ, pos;
-
-        if (xmlHashGrow(hash, newSize) != 0)
-            return(-1);
+    if ((newSize > 0) || (hash->oldTable != NULL)) {
+        if (newSize > 0) {
+            if (xmlHashGrow(hash, newSize) != 0)
+                return(-1);
+        }
+        if (hash->oldTable != NULL)
+            xmlHashMigrate(hash, INCREMENTAL_STEP);
 
         /*
          * Find new entry
          */
-        mask = hash->size - 1;
-        displ = 0;
-        pos = hashValue & mask;
-        entry = &hash->table[pos];
-
-        if (entry->hashValue != 0) {
-            do {
-                displ++;
-                pos++;
-                entry++;
-                if ((pos & mask) == 0)
-                    entry = hash->table;
-            } while ((entry->hashValue != 0) &&
-                     ((pos - entry->hashValue) & mask) >= displ);
-        }
+        pos = xmlHashFindSlot(hash->hashes, hash->size - 1, hashValue);
     }
 
     /*
@@ -540,42 +901,15 @@ xmlHashUpdateInternal(xmlHashTable *hash, const xmlChar *key,
         }
     }
 
-    /*
-     * Shift the remainder of the probe sequence to the right
-     */
-    if (entry->hashValue != 0) {
-        const xmlHashEntry *end = &hash->table[hash->size];
-        const xmlHashEntry *cur = entry;
-
-        do {
-            cur++;
-            if (cur >= end)
-                cur = hash->table;
-        } while (cur->hashValue != 0);
-
-        if (cur < entry) {
-            /*
-             * If we traversed the end of the buffer, handle the part
-             * at the start of the buffer.
-             */
-            memmove(&hash->table[1], hash->table,
-                    (char *) cur - (char *) hash->table);
-            cur = end - 1;
-            hash->table[0] = *cur;
-        }
-
-        memmove(&entry[1], entry, (char *) cur - (char *) entry);
-    }
-
     /*
      * Populate entry
      */
-    entry->key = copy;
-    entry->key2 = copy2;
-    entry->key3 = copy3;
-    entry->payload = payload;
-    /* OR with MAX_HASH_SIZE to make sure that the value is non-zero */
-    entry->hashValue = hashValue | MAX_HASH_SIZE;
+    entry.key = copy;
+    entry.key2 = copy2;
+    entry.key3 = copy3;
+    entry.payload = payload;
+    xmlHashInsertAt(hash->table, hash->hashes, hash->size - 1, pos, &entry,
+                    hashValue);
 
     hash->nbElems++;
 
@@ -869,16 +1203,20 @@ xmlHashQLookup2(xmlHashTable *hash, const xmlChar *prefix,
 void *
 xmlHashLookup3(xmlHashTable *hash, const xmlChar *key,
                const xmlChar *key2, const xmlChar *key3) {
-    const xmlHashEntry *entry;
-    unsigned hashValue;
+    unsigned hashValue, pos;
     int found;
 
     if ((hash == NULL) || (hash->size == 0) || (key == NULL))
         return(NULL);
     hashValue = xmlHashValue(hash->randomSeed, key, key2, key3, NULL);
-    entry = xmlHashFindEntry(hash, key, key2, key3, hashValue, &found);
+    pos = xmlHashFindEntry(hash, 0, key, key2, key3, hashValue, &found);
     if (found)
-        return(entry->payload);
+        return(hash->table[pos].payload);
+    if (hash->oldTable != NULL) {
+        pos = xmlHashFindEntry(hash, 1, key, key2, key3, hashValue, &found);
+        if (found)
+            return(hash->oldTable[pos].payload);
+    }
     return(NULL);
 }
 
@@ -900,36 +1238,62 @@ xmlHashQLookup3(xmlHashTable *hash,
                 const xmlChar *prefix, const xmlChar *name,
                 const xmlChar *prefix2, const xmlChar *name2,
                 const xmlChar *prefix3, const xmlChar *name3) {
-    const xmlHashEntry *entry;
-    unsigned hashValue, mask, pos, displ;
+    const xmlHashEntry *table;
+    const unsigned *hashes;
+    unsigned hashValue, mask, pos, displ, cur;
+    int old;
 
     if ((hash == NULL) || (hash->size == 0) || (name == NULL))
         return(NULL);
 
     hashValue = xmlHashQNameValue(hash->randomSeed, prefix, name, prefix2,
                                   name2, prefix3, name3);
-    mask = hash->size - 1;
-    pos = hashValue & mask;
-    entry = &hash->table[pos];
+    hashValue |= MAX_HASH_SIZE;
+
+    if (hash->bucketDispl != NULL) {
+        const xmlHashEntry *entry;
+
+        pos = xmlHashFrozenPos(hashValue,
+                hash->bucketDispl[hashValue & (hash->nbBuckets - 1)],
+                hash->size);
+        entry = &hash->table[pos];
+
+        if ((hash->hashes[pos] == hashValue) &&
+            (xmlStrQEqual(prefix, name, entry->key)) &&
+            (xmlStrQEqual(prefix2, name2, entry->key2)) &&
+            (xmlStrQEqual(prefix3, name3, entry->key3)))
+            return(entry->payload);
+
+        return(NULL);
+    }
+
+    /* Search the old table of an incremental resize as well */
+    for (old = 0; old <= (hash->oldTable != NULL); old++) {
+        table = old ? hash->oldTable : hash->table;
+        hashes = old ? hash->oldHashes : hash->hashes;
+        mask = (old ? hash->oldSize : hash->size) - 1;
+        pos = hashValue & mask;
+        cur = hashes[pos];
+
+        if (cur == 0)
+            continue;
 
-    if (entry->hashValue != 0) {
         displ = 0;
-        hashValue |= MAX_HASH_SIZE;
 
         do {
-            if ((hashValue == entry->hashValue) &&
-                (xmlStrQEqual(prefix, name, entry->key)) &&
-                (xmlStrQEqual(prefix2, name2, entry->key2)) &&
-                (xmlStrQEqual(prefix3, name3, entry->key3)))
-                return(entry->payload);
+            if (hashValue == cur) {
+                const xmlHashEntry *entry = &table[pos];
+
+                if ((xmlStrQEqual(prefix, name, entry->key)) &&
+                    (xmlStrQEqual(prefix2, name2, entry->key2)) &&
+                    (xmlStrQEqual(prefix3, name3, entry->key3)))
+                    return(entry->payload);
+            }
 
             displ++;
-            pos++;
-            entry++;
-            if ((pos & mask) == 0)
-                entry = hash->table;
-        } while ((entry->hashValue != 0) &&
-                 (((pos - entry->hashValue) & mask) >= displ));
+            pos = (pos + 1) & mask;
+            cur = hashes[pos];
+        } while ((cur != 0) && (((pos - cur) & mask) >= displ));
     }
 
     return(NULL);
@@ -948,6 +1312,54 @@ stubHashScannerFull(void *payload, void *data, const xmlChar *key,
     sdata->scan(payload, sdata->data, key);
 }
 
+static void
+xmlHashScanTable(const xmlHashEntry *table, const unsigned *hashes,
+                 unsigned size, int frozen, const xmlChar *key,
+                 const xmlChar *key2, const xmlChar *key3,
+                 xmlHashScannerFull scan, void *data) {
+    const xmlHashEntry *entry;
+    xmlHashEntry old;
+    unsigned i, mask, pos;
+
+    /*
+     * We must handle the case that a scanned entry is removed when executing
+     * the callback (xmlCleanSpecialAttr and possibly other places).
+     *
+     * Find the start of a probe sequence to avoid scanning entries twice if
+     * a deletion happens. Deletions in frozen tables don't move entries.
+     */
+    mask = size - 1;
+    pos = 0;
+    if (!frozen) {
+        while (hashes[pos] != 0)
+            pos = (pos + 1) & mask;
+    }
+
+    for (i = 0; i < size; i++) {
+        entry = &table[pos];
+
+        if ((hashes[pos] != 0) && (entry->payload != NULL)) {
+            /*
+             * Make sure to rescan after a possible deletion.
+             */
+            do {
+                if (((key != NULL) && (strcmp((const char *) key,
+                                              (const char *) entry->key) != 0)) ||
+                    ((key2 != NULL) && (!xmlFastStrEqual(key2, entry->key2))) ||
+                    ((key3 != NULL) && (!xmlFastStrEqual(key3, entry->key3))))
+                    break;
+                old = *entry;
+                scan(entry->payload, data, entry->key, entry->key2, entry->key3);
+            } while ((hashes[pos] != 0) &&
+                     (entry->payload != NULL) &&
+                     ((entry->key != old.key) ||
+                      (entry->key2 != old.key2) ||
+                      (entry->key3 != old.key3)));
+        }
+        pos = frozen ? pos + 1 : (pos + 1) & mask;
+    }
+}
+
 /**
  * Scan the hash `table` and apply `scan` to each value.
  *
@@ -972,44 +1384,7 @@ xmlHashScan(xmlHashTable *hash, xmlHashScanner scan, void *data) {
  */
 void
 xmlHashScanFull(xmlHashTable *hash, xmlHashScannerFull scan, void *data) {
-    const xmlHashEntry *entry, *end;
-    xmlHashEntry old;
-    unsigned i;
-
-    if ((hash == NULL) || (hash->size == 0) || (scan == NULL))
-        return;
-
-    /*
-     * We must handle the case that a scanned entry is removed when executing
-     * the callback (xmlCleanSpecialAttr and possibly other places).
-     *
-     * Find the start of a probe sequence to avoid scanning entries twice if
-     * a deletion happens.
-     */
-    entry = hash->table;
-    end = &hash->table[hash->size];
-    while (entry->hashValue != 0) {
-        if (++entry >= end)
-            entry = hash->table;
-    }
-
-    for (i = 0; i < hash->size; i++) {
-        if ((entry->hashValue != 0) && (entry->payload != NULL)) {
-            /*
-             * Make sure to rescan after a possible deletion.
-             */
-            do {
-                old = *entry;
-                scan(entry->payload, data, entry->key, entry->key2, entry->key3);
-            } while ((entry->hashValue != 0) &&
-                     (entry->payload != NULL) &&
-                     ((entry->key != old.key) ||
-                      (entry->key2 != old.key2) ||
-                      (entry->key3 != old.key3)));
-        }
-        if (++entry >= end)
-            entry = hash->table;
-    }
+    xmlHashScanFull3(hash, NULL, NULL, NULL, scan, data);
 }
 
 /**
@@ -1050,49 +1425,15 @@ void
 xmlHashScanFull3(xmlHashTable *hash, const xmlChar *key,
                  const xmlChar *key2, const xmlChar *key3,
                  xmlHashScannerFull scan, void *data) {
-    const xmlHashEntry *entry, *end;
-    xmlHashEntry old;
-    unsigned i;
-
     if ((hash == NULL) || (hash->size == 0) || (scan == NULL))
         return;
 
-    /*
-     * We must handle the case that a scanned entry is removed when executing
-     * the callback (xmlCleanSpecialAttr and possibly other places).
-     *
-     * Find the start of a probe sequence to avoid scanning entries twice if
-     * a deletion happens.
-     */
-    entry = hash->table;
-    end = &hash->table[hash->size];
-    while (entry->hashValue != 0) {
-        if (++entry >= end)
-            entry = hash->table;
-    }
-
-    for (i = 0; i < hash->size; i++) {
-        if ((entry->hashValue != 0) && (entry->payload != NULL)) {
-            /*
-             * Make sure to rescan after a possible deletion.
-             */
-            do {
-                if (((key != NULL) && (strcmp((const char *) key,
-                                              (const char *) entry->key) != 0)) ||
-                    ((key2 != NULL) && (!xmlFastStrEqual(key2, entry->key2))) ||
-                    ((key3 != NULL) && (!xmlFastStrEqual(key3, entry->key3))))
-                    break;
-                old = *entry;
-                scan(entry->payload, data, entry->key, entry->key2, entry->key3);
-            } while ((entry->hashValue != 0) &&
-                     (entry->payload != NULL) &&
-                     ((entry->key != old.key) ||
-                      (entry->key2 != old.key2) ||
-                      (entry->key3 != old.key3)));
-        }
-        if (++entry >= end)
-            entry = hash->table;
-    }
+    /* Removals don't migrate entries, so nothing is scanned twice */
+    if (hash->oldTable != NULL)
+        xmlHashScanTable(hash->oldTable, hash->oldHashes, hash->oldSize, 0,
+                         key, key2, key3, scan, data);
+    xmlHashScanTable(hash->table, hash->hashes, hash->size,
+                     hash->bucketDispl != NULL, key, key2, key3, scan, data);
 }
 
 /**
@@ -1109,8 +1450,9 @@ xmlHashScanFull3(xmlHashTable *hash, const xmlChar *key,
 xmlHashTable *
 xmlHashCopySafe(xmlHashTable *hash, xmlHashCopier copyFunc,
                 xmlHashDeallocator deallocFunc) {
-    const xmlHashEntry *entry, *end;
     xmlHashTablePtr ret;
+    unsigned i, size;
+    int old;
 
     if ((hash == NULL) || (copyFunc == NULL))
         return(NULL);
@@ -1119,15 +1461,19 @@ xmlHashCopySafe(xmlHashTable *hash, xmlHashCopier copyFunc,
     if (ret == NULL)
         return(NULL);
 
-    if (hash->size == 0)
-        return(ret);
+    for (old = 0; old <= (hash->oldTable != NULL); old++) {
+        const xmlHashEntry *table = old ? hash->oldTable : hash->table;
+        const unsigned *hashes = old ? hash->oldHashes : hash->hashes;
 
-    end = &hash->table[hash->size];
+        size = old ? hash->oldSize : hash->size;
 
-    for (entry = hash->table; entry < end; entry++) {
-        if (entry->hashValue != 0) {
+        for (i = 0; i < size; i++) {
+            const xmlHashEntry *entry = &table[i];
             void *copy;
 
+            if (hashes[i] == 0)
+                continue;
+
             copy = copyFunc(entry->payload, entry->key);
             if (copy == NULL)
                 goto error;
@@ -1176,6 +1522,72 @@ xmlHashSize(xmlHashTable *hash) {
     return(hash->nbElems);
 }
 
+/**
+ * Compute statistics of a hash table. Keys are only counted in
+ * `memory` if the table has no dictionary. Payloads are never
+ * counted.
+ *
+ * The table is scanned on every call, so this is meant for
+ * diagnostics, not for hot paths.
+ *
+ * @since 2.15.0
+ *
+ * @param hash  hash table
+ * @param stats  result
+ * @returns 0 in case of success or -1 in case of error
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+int
+xmlHashGetStats(xmlHashTable *hash, xmlHashStats *stats) {
+    unsigned i, size;
+    int old;
+
+    if ((hash == NULL) || (stats == NULL))
+        return(-1);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->size = hash->size;
+    stats->nbGrows = hash->nbGrows;
+    stats->memory = (size_t) hash->nbBuckets * sizeof(hash->bucketDispl[0]);
+
+    /* Include the old table of an incremental resize */
+    for (old = 0; old <= (hash->oldTable != NULL); old++) {
+        const xmlHashEntry *table = old ? hash->oldTable : hash->table;
+        const unsigned *hashes = old ? hash->oldHashes : hash->hashes;
+
+        size = old ? hash->oldSize : hash->size;
+        stats->memory += (size_t) size *
+                         (sizeof(table[0]) + sizeof(hashes[0]));
+
+        for (i = 0; i < size; i++) {
+            const xmlHashEntry *entry = &table[i];
+            size_t probe;
+
+            if (hashes[i] == 0)
+                continue;
+
+            if (hash->bucketDispl != NULL)
+                probe = 1;
+            else
+                probe = ((i - hashes[i]) & (size - 1)) + 1;
+            stats->nbElems++;
+            stats->totalProbe += probe;
+            if (probe > stats->maxProbe)
+                stats->maxProbe = probe;
+
+            if (hash->dict == NULL) {
+                stats->memory += strlen((const char *) entry->key) + 1;
+                if (entry->key2 != NULL)
+                    stats->memory += strlen((const char *) entry->key2) + 1;
+                if (entry->key3 != NULL)
+                    stats->memory += strlen((const char *) entry->key3) + 1;
+            }
+        }
+    }
+
+    return(0);
+}
+
 /**
  * Find the entry specified by the `key` and remove it from the hash table.
  * Payload will be freed with `dealloc`.
@@ -1219,22 +1631,36 @@ xmlHashRemoveEntry2(xmlHashTable *hash, const xmlChar *key,
  * @param dealloc  deallocator function for removed item or NULL
  * @returns 0 on success and -1 in case of error.
  */
-ATTRIBUTE_NO_SANITIZE_INTEGER
 int
 xmlHashRemoveEntry3(xmlHashTable *hash, const xmlChar *key,
                     const xmlChar *key2, const xmlChar *key3,
                     xmlHashDeallocator dealloc) {
-    xmlHashEntry *entry, *cur, *next;
-    unsigned hashValue, mask, pos, nextpos;
+    xmlHashEntry *table, *entry;
+    unsigned *hashes;
+    unsigned hashValue, size, pos;
     int found;
 
     if ((hash == NULL) || (hash->size == 0) || (key == NULL))
         return(-1);
 
     hashValue = xmlHashValue(hash->randomSeed, key, key2, key3, NULL);
-    entry = xmlHashFindEntry(hash, key, key2, key3, hashValue, &found);
-    if (!found)
-        return(-1);
+    pos = xmlHashFindEntry(hash, 0, key, key2, key3, hashValue, &found);
+    if (found) {
+        table = hash->table;
+        hashes = hash->hashes;
+        size = hash->size;
+    } else {
+        if (hash->oldTable == NULL)
+            return(-1);
+        pos = xmlHashFindEntry(hash, 1, key, key2, key3, hashValue, &found);
+        if (!found)
+            return(-1);
+        table = hash->oldTable;
+        hashes = hash->oldHashes;
+        size = hash->oldSize;
+    }
+
+    entry = &table[pos];
 
     if ((dealloc != NULL) && (entry->payload != NULL))
         dealloc(entry->payload, entry->key);
@@ -1247,51 +1673,215 @@ xmlHashRemoveEntry3(xmlHashTable *hash, const xmlChar *key,
             xmlFree(entry->key3);
     }
 
+    if (hash->bucketDispl != NULL)
+        hashes[pos] = 0;
+    else
+        xmlHashRemoveAt(table, hashes, size - 1, pos);
+
+    hash->nbElems--;
+
+    return(0);
+}
+
+
+/**
+ * Assign a displacement to each bucket so that all keys get distinct
+ * slots, starting with the largest buckets.
+ *
+ * @param n  number of keys
+ * @param nbBuckets  number of buckets, a power of two
+ * @param hashValues  hash values of the keys
+ * @param order  scratch space for n indices
+ * @param counts  scratch space for nbBuckets + 1 counters
+ * @param hashes  result: hash value of the key at each slot
+ * @param displs  result: displacement of each bucket
+ * @returns 0 in case of success, -1 if no displacements were found.
+ */
+static int
+xmlHashBuildFrozen(unsigned n, unsigned nbBuckets, const unsigned *hashValues,
+                   unsigned *order, unsigned *counts, unsigned *hashes,
+                   unsigned *displs) {
+    unsigned mask = nbBuckets - 1;
+    unsigned maxBucket = 0;
+    unsigned i, j, b, sz;
+
+    memset(hashes, 0, n * sizeof(hashes[0]));
+    memset(displs, 0, nbBuckets * sizeof(displs[0]));
+
     /*
-     * Find end of probe sequence. Entries at their initial probe
-     * position start a new sequence.
+     * Sort keys by bucket. Afterwards, bucket b holds the keys
+     * order[start] to order[counts[b] - 1] with start = counts[b - 1].
      */
-    mask = hash->size - 1;
-    pos = entry - hash->table;
-    cur = entry;
+    memset(counts, 0, (nbBuckets + 1) * sizeof(counts[0]));
+    for (i = 0; i < n; i++)
+        counts[(hashValues[i] & mask) + 1]++;
+    for (b = 0; b < nbBuckets; b++) {
+        if (counts[b + 1] > maxBucket)
+            maxBucket = counts[b + 1];
+        counts[b + 1] += counts[b];
+    }
+    if (maxBucket > FROZEN_MAX_BUCKET)
+        return(-1);
+    for (i = 0; i < n; i++)
+        order[counts[hashValues[i] & mask]++] = i;
 
-    while (1) {
-        nextpos = pos + 1;
-        next = cur + 1;
-        if ((nextpos & mask) == 0)
-            next = hash->table;
+    for (sz = maxBucket; sz > 0; sz--) {
+        for (b = 0; b < nbBuckets; b++) {
+            const unsigned *keys;
+            unsigned start = b ? counts[b - 1] : 0;
+            unsigned displ;
 
-        if ((next->hashValue == 0) ||
-            (((next->hashValue - nextpos) & mask) == 0))
-            break;
+            if (counts[b] - start != sz)
+                continue;
+            keys = &order[start];
 
-        cur = next;
-        pos = nextpos;
+            /* Keys with the same hash value can't be separated */
+            for (i = 1; i < sz; i++) {
+                for (j = 0; j < i; j++) {
+                    if (hashValues[keys[i]] == hashValues[keys[j]])
+                        return(-1);
+                }
+            }
+
+            for (displ = 0; displ < FROZEN_MAX_DISPL; displ++) {
+                for (i = 0; i < sz; i++) {
+                    unsigned hashValue = hashValues[keys[i]];
+                    unsigned pos = xmlHashFrozenPos(hashValue, displ, n);
+
+                    if (hashes[pos] != 0)
+                        break;
+                    hashes[pos] = hashValue;
+                }
+                if (i == sz)
+                    break;
+
+                /* Undo */
+                while (i > 0) {
+                    i--;
+                    hashes[xmlHashFrozenPos(hashValues[keys[i]], displ, n)] = 0;
+                }
+            }
+            if (displ >= FROZEN_MAX_DISPL)
+                return(-1);
+
+            displs[b] = displ;
+        }
     }
 
-    /*
-     * Backward shift
-     */
-    next = entry + 1;
+    return(0);
+}
+
+/**
+ * Rebuild a hash table for lookups only. Frozen tables use a minimal
+ * perfect hash function: every key is found by probing a single slot
+ * and there's no unused slot, so lookups are faster and the table is
+ * smaller. This is meant for tables which are filled once and then
+ * used for many lookups, like the components of a compiled schema.
+ *
+ * Frozen tables can still be modified. Updating or removing entries
+ * works in place, adding an entry turns the table back into a regular
+ * one.
+ *
+ * Tables with more than 65536 entries and tables where no perfect hash
+ * function was found are left unchanged, this is not an error.
+ *
+ * @since 2.15.0
+ *
+ * @param hash  hash table
+ * @returns 1 if the table is frozen, 0 if it was left unchanged and
+ * -1 in case of error.
+ */
+int
+xmlHashFreeze(xmlHashTable *hash) {
+    xmlHashEntry *table, *entries;
+    unsigned *hashes, *displs, *hashValues, *order, *counts;
+    unsigned n, nbBuckets, seed, attempt, i, j;
+    size_t tableSize;
 
-    if (cur < entry) {
-        xmlHashEntry *end = &hash->table[hash->size];
+    if (hash == NULL)
+        return(-1);
+    if (hash->bucketDispl != NULL)
+        return(1);
+    n = hash->nbElems;
+    if ((n == 0) || (n > FROZEN_MAX_ELEMS))
+        return(0);
+
+    if (hash->oldTable != NULL)
+        xmlHashMigrate(hash, hash->oldSize);
+
+    nbBuckets = 1;
+    while (nbBuckets * FROZEN_BUCKET_LOAD < n)
+        nbBuckets *= 2;
+
+    tableSize = (size_t) n * (sizeof(table[0]) + sizeof(hashes[0])) +
+                (size_t) nbBuckets * sizeof(displs[0]);
+    table = xmlMalloc(tableSize);
+    if (table == NULL)
+        return(-1);
+    hashes = (unsigned *) &table[n];
+    displs = &hashes[n];
 
-        memmove(entry, next, (char *) end - (char *) next);
-        entry = hash->table;
-        end[-1] = *entry;
-        next = entry + 1;
+    entries = xmlMalloc((size_t) n * sizeof(entries[0]) +
+                        ((size_t) n * 2 + nbBuckets + 1) * sizeof(unsigned));
+    if (entries == NULL) {
+        xmlFree(table);
+        return(-1);
     }
+    hashValues = (unsigned *) &entries[n];
+    order = &hashValues[n];
+    counts = &order[n];
 
-    memmove(entry, next, (char *) cur - (char *) entry);
+    j = 0;
+    for (i = 0; i < hash->size; i++) {
+        if (hash->hashes[i] != 0) {
+            entries[j] = hash->table[i];
+            hashValues[j] = hash->hashes[i];
+            j++;
+        }
+    }
 
     /*
-     * Update entry
+     * Retry with a new seed if keys collide. Equal hash values become
+     * likely with tens of thousands of keys.
      */
-    cur->hashValue = 0;
+    seed = hash->randomSeed;
+    for (attempt = 0; attempt < FROZEN_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            seed = xmlRandom();
+            for (j = 0; j < n; j++)
+                hashValues[j] = xmlHashValue(seed, entries[j].key,
+                                             entries[j].key2,
+                                             entries[j].key3, NULL) |
+                                MAX_HASH_SIZE;
+        }
 
-    hash->nbElems--;
+        if (xmlHashBuildFrozen(n, nbBuckets, hashValues, order, counts,
+                               hashes, displs) == 0)
+            break;
+    }
 
-    return(0);
-}
+    if (attempt >= FROZEN_ATTEMPTS) {
+        xmlFree(entries);
+        xmlFree(table);
+        return(0);
+    }
+
+    for (j = 0; j < n; j++) {
+        unsigned pos = xmlHashFrozenPos(hashValues[j],
+                displs[hashValues[j] & (nbBuckets - 1)], n);
+
+        table[pos] = entries[j];
+    }
 
+    xmlFree(entries);
+    xmlFree(hash->table);
+
+    hash->table = table;
+    hash->hashes = hashes;
+    hash->size = n;
+    hash->randomSeed = seed;
+    hash->bucketDispl = displs;
+    hash->nbBuckets = nbBuckets;
+
+    return(1);
+}
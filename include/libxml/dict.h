@@ -28,6 +28,30 @@ extern "C" {
 typedef struct _xmlDict xmlDict;
 typedef xmlDict *xmlDictPtr;
 
+typedef struct _xmlHashStats xmlHashStats;
+/**
+ * Statistics of a dictionary or hash table, filled by
+ * #xmlDictGetStats and #xmlHashGetStats.
+ *
+ * The probe length of an entry is the number of buckets inspected
+ * to find it, 1 if it's stored in its home bucket. Long probes
+ * indicate clustering or hash flooding.
+ */
+struct _xmlHashStats {
+    /** Number of buckets. */
+    size_t size;
+    /** Number of entries. */
+    size_t nbElems;
+    /** Sum of the probe lengths of all entries. */
+    size_t totalProbe;
+    /** Longest probe length. */
+    size_t maxProbe;
+    /** Number of times the table was resized. */
+    size_t nbGrows;
+    /** Bytes allocated for the table, strings or keys. */
+    size_t memory;
+};
+
 /*
  * Initializer
  */
@@ -46,6 +70,13 @@ XMLPUBFUN size_t
 			xmlDictGetUsage (xmlDict *dict);
 XMLPUBFUN xmlDict *
 			xmlDictCreateSub(xmlDict *sub);
+XMLPUBFUN int
+			xmlDictFreeze	(xmlDict *dict);
+XMLPUBFUN int
+			xmlDictSaveFile	(xmlDict *dict,
+					 const char *filename);
+XMLPUBFUN xmlDict *
+			xmlDictLoadFile	(const char *filename);
 XMLPUBFUN int
 			xmlDictReference(xmlDict *dict);
 XMLPUBFUN void
@@ -71,6 +102,9 @@ XMLPUBFUN int
 					 const xmlChar *str);
 XMLPUBFUN int
 			xmlDictSize	(xmlDict *dict);
+XMLPUBFUN int
+			xmlDictGetStats	(xmlDict *dict,
+					 xmlHashStats *stats);
 
 /*
  * Cleanup function
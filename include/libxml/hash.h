@@ -218,6 +218,11 @@ XMLPUBFUN xmlHashTable *
 					 xmlHashCopier copy);
 XMLPUBFUN int
 		xmlHashSize		(xmlHashTable *hash);
+XMLPUBFUN int
+		xmlHashGetStats		(xmlHashTable *hash,
+					 xmlHashStats *stats);
+XMLPUBFUN int
+		xmlHashFreeze		(xmlHashTable *hash);
 XMLPUBFUN void
 		xmlHashScan		(xmlHashTable *hash,
 					 xmlHashScanner scan,
@@ -89,7 +89,9 @@ typedef enum {
     /** Allow network access. Unused internally. */
     XML_INPUT_NETWORK               = (1 << 4),
     /** Allow system catalog to resolve URIs. */
-    XML_INPUT_USE_SYS_CATALOG       = (1 << 5)
+    XML_INPUT_USE_SYS_CATALOG       = (1 << 5),
+    /** Map regular files into memory instead of reading them */
+    XML_INPUT_MMAP                  = (1 << 6)
 } xmlParserInputFlags;
 
 /* Deprecated */
@@ -213,6 +215,13 @@ typedef struct _xmlAttrHashBucket xmlAttrHashBucket;
 
 /** @endcond */
 
+/**
+ * A thread-safe pool of reusable parser contexts.
+ *
+ * @since 2.15.0
+ */
+typedef struct _xmlParserCtxtPool xmlParserCtxtPool;
+
 /**
  * Callback for custom resource loaders.
  *
@@ -632,6 +641,14 @@ struct _xmlParserCtxt {
 
     xmlCharEncConvImpl convImpl XML_DEPRECATED_MEMBER;
     void *convCtxt XML_DEPRECATED_MEMBER;
+
+    /* maximum number of threads for parallel parsing */
+    int maxThreads XML_DEPRECATED_MEMBER;
+
+    /* newline index if XML_PARSE_OFFSETS is set */
+    void *lineIndex XML_DEPRECATED_MEMBER;
+    /* offset of the construct being parsed if XML_PARSE_OFFSETS is set */
+    unsigned long nodeOffset XML_DEPRECATED_MEMBER;
 };
 
 /**
@@ -1861,7 +1878,63 @@ typedef enum {
      *
      * @since 2.14.0
      */
-    XML_PARSE_CATALOG_PI = 1<<26
+    XML_PARSE_CATALOG_PI = 1<<26,
+    /**
+     * Parse documents with the indexed engine. The whole input is
+     * loaded into memory and scanned once to build an index of
+     * markup, then the tree is built from the index.
+     *
+     * Only used when building a tree with the default SAX2 handler
+     * and no DTD. Documents the engine doesn't handle, for example
+     * documents with a document type declaration, non-predefined
+     * entity references, encodings other than UTF-8 or errors, are
+     * parsed with the regular parser. The result is the same either
+     * way.
+     *
+     * @since 2.15.0
+     */
+    XML_PARSE_INDEXED = 1<<27,
+    /**
+     * Map uncompressed files into memory and parse directly from the
+     * mapping instead of reading them into a buffer. Files which
+     * can't be mapped are read as usual.
+     *
+     * The files must not be truncated while the parser uses them.
+     * On most systems, this would crash the process.
+     *
+     * @since 2.15.0
+     */
+    XML_PARSE_MMAP = 1<<28,
+    /**
+     * Allocate nodes, attributes and text content of the document
+     * from an arena owned by the document. This makes building the
+     * tree and freeing the document faster, but memory of nodes
+     * removed from the document is only reclaimed when the whole
+     * document is freed.
+     *
+     * Nodes can be moved to other documents, but they must not be
+     * detached from any document with xmlSetTreeDoc and a NULL
+     * document. Strings assigned directly to node fields instead of
+     * using the tree API may not be freed. Not supported by xmlreader.
+     *
+     * @since 2.15.0
+     */
+    XML_PARSE_ARENA = 1<<29,
+    /**
+     * Record the byte offset at which elements, text, comments and
+     * processing instructions start in the input, see
+     * xmlGetNodeOffset. Offsets are stored in the psvi field. The
+     * document keeps an index of newlines from which xmlGetLineNo
+     * derives exact line numbers of nodes past line 65535. The index
+     * is only built incrementally from input which was already
+     * consumed and takes a few bytes per line.
+     *
+     * Don't use this option if the psvi field of nodes is used for
+     * other purposes.
+     *
+     * @since 2.15.0
+     */
+    XML_PARSE_OFFSETS = 1<<30
 } xmlParserOption;
 
 XMLPUBFUN void
@@ -1933,6 +2006,19 @@ XMLPUBFUN void
 XMLPUBFUN void
 		xmlCtxtSetMaxAmplification(xmlParserCtxt *ctxt,
 					 unsigned maxAmpl);
+XMLPUBFUN void
+		xmlCtxtSetMaxThreads	(xmlParserCtxt *ctxt,
+					 int maxThreads);
+XMLPUBFUN xmlParserCtxtPool *
+		xmlNewParserCtxtPool	(int maxContexts,
+					 int maxItems);
+XMLPUBFUN void
+		xmlFreeParserCtxtPool	(xmlParserCtxtPool *pool);
+XMLPUBFUN xmlParserCtxt *
+		xmlParserCtxtPoolAcquire(xmlParserCtxtPool *pool);
+XMLPUBFUN void
+		xmlParserCtxtPoolRelease(xmlParserCtxtPool *pool,
+					 xmlParserCtxt *ctxt);
 XMLPUBFUN xmlDoc *
 		xmlReadDoc		(const xmlChar *cur,
 					 const char *URL,
@@ -1963,6 +2049,9 @@ XMLPUBFUN xmlDoc *
 XMLPUBFUN xmlDoc *
 		xmlCtxtParseDocument	(xmlParserCtxt *ctxt,
 					 xmlParserInput *input);
+XMLPUBFUN int
+		xmlCtxtCheckWellFormed	(xmlParserCtxt *ctxt,
+					 xmlParserInput *input);
 XMLPUBFUN xmlNode *
 		xmlCtxtParseContent	(xmlParserCtxt *ctxt,
 					 xmlParserInput *input,
@@ -2024,6 +2113,95 @@ XMLPUBFUN xmlParserErrors
 xmlInputSetEncodingHandler(xmlParserInput *input,
                            xmlCharEncodingHandler *handler);
 
+/*
+ * Lexer API
+ */
+
+/**
+ * A pull lexer which splits an in-memory document into tokens.
+ *
+ * @since 2.15.0
+ */
+typedef struct _xmlLexer xmlLexer;
+
+/**
+ * Token types returned by #xmlLexerNext. The span of a token is
+ * described for each type.
+ *
+ * @since 2.15.0
+ */
+typedef enum {
+    XML_TOKEN_NONE = 0,
+    /** character data up to the next markup or reference */
+    XML_TOKEN_TEXT,
+    /** entity or character reference including '&' and ';' */
+    XML_TOKEN_REFERENCE,
+    /** name of a start tag */
+    XML_TOKEN_START_TAG,
+    /** name of an attribute */
+    XML_TOKEN_ATTR_NAME,
+    /** value of an attribute without quotes, not normalized */
+    XML_TOKEN_ATTR_VALUE,
+    /** '>' closing a start tag */
+    XML_TOKEN_TAG_END,
+    /** '/>' closing an empty element tag */
+    XML_TOKEN_EMPTY_TAG_END,
+    /** name of an end tag */
+    XML_TOKEN_END_TAG,
+    /** content of a comment */
+    XML_TOKEN_COMMENT,
+    /** target and data of a processing instruction or XML declaration */
+    XML_TOKEN_PI,
+    /** content of a CDATA section */
+    XML_TOKEN_CDATA,
+    /** the whole document type declaration */
+    XML_TOKEN_DOCTYPE
+} xmlTokenType;
+
+/**
+ * A token as a span of the input.
+ *
+ * @since 2.15.0
+ */
+typedef struct {
+    /** type of the token */
+    xmlTokenType type;
+    /** offset in bytes from the start of the input */
+    size_t offset;
+    /** length in bytes */
+    size_t length;
+} xmlToken;
+
+/**
+ * Options for #xmlNewLexer.
+ *
+ * @since 2.15.0
+ */
+typedef enum {
+    /**
+     * Check that the document is well-formed: characters, names,
+     * nesting of elements, unique attributes, references, comments,
+     * processing instructions and content outside of the root
+     * element. Without this option, only errors which make it
+     * impossible to find the next token are reported.
+     */
+    XML_LEXER_WELL_FORMED = 1<<0,
+    /**
+     * The buffer is followed by a NUL byte which the lexer can use
+     * as sentinel. Otherwise, the buffer is copied.
+     */
+    XML_LEXER_ZERO_TERMINATED = 1<<1
+} xmlLexerOption;
+
+XMLPUBFUN xmlLexer *
+xmlNewLexer(const char *buffer, size_t size, int options);
+XMLPUBFUN void
+xmlFreeLexer(xmlLexer *lexer);
+XMLPUBFUN int
+xmlLexerNext(xmlLexer *lexer, xmlToken *token);
+XMLPUBFUN xmlParserErrors
+xmlLexerGetError(xmlLexer *lexer, size_t *offset);
+
 /*
  * Library wide options
  */
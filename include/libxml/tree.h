@@ -693,6 +693,10 @@ struct _xmlDoc {
     int             parseFlags;
     /** xmlDocProperties of the document */
     int             properties;
+    /** node allocator if parsed with XML_PARSE_ARENA (private) */
+    void           *arena;
+    /** newline index if parsed with XML_PARSE_OFFSETS (private) */
+    void           *lineIndex;
 };
 
 
@@ -963,6 +967,8 @@ XMLPUBFUN xmlNode *
  */
 XMLPUBFUN long
 		xmlGetLineNo		(const xmlNode *node);
+XMLPUBFUN long
+		xmlGetNodeOffset	(const xmlNode *node);
 XMLPUBFUN xmlChar *
 		xmlGetNodePath		(const xmlNode *node);
 XMLPUBFUN xmlNode *
@@ -1168,6 +1174,21 @@ XMLPUBFUN int
 		xmlReconciliateNs	(xmlDoc *doc,
 					 xmlNode *tree);
 
+/*
+ * Binary snapshots.
+ */
+XMLPUBFUN int
+		xmlDocSnapshotMemory	(xmlDoc *doc,
+					 xmlChar **mem,
+					 size_t *size);
+XMLPUBFUN xmlDoc *
+		xmlReadSnapshotMemory	(const void *buffer,
+					 size_t size,
+					 int options);
+XMLPUBFUN xmlDoc *
+		xmlReadSnapshotFile	(const char *filename,
+					 int options);
+
 #ifdef LIBXML_OUTPUT_ENABLED
 /*
  * Saving.
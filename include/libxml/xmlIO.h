@@ -153,6 +153,11 @@ struct _xmlOutputBuffer {
     xmlBuf *conv;      /* if encoder != NULL buffer for output */
     int written;            /* total number of byte written */
     int error;
+
+    xmlBuf **chunks;   /* full chunks preceding buffer if segmented */
+    int nbChunks;      /* number of pending chunks */
+    int maxChunks;     /* size of the chunks array */
+    size_t chunkSize;  /* chunk size, 0 if not segmented */
 };
 #endif /* LIBXML_OUTPUT_ENABLED */
 
@@ -561,6 +561,49 @@ XMLPUBFUN int
 XMLPUBFUN int
 		xmlXPathIsInf	(double val);
 
+/*
+ * The structure of a compact document is not public.
+ */
+typedef struct _xmlXPathCompactDoc xmlXPathCompactDoc;
+typedef xmlXPathCompactDoc *xmlXPathCompactDocPtr;
+
+/**
+ * Compact read-only documents.
+ */
+XMLPUBFUN xmlXPathCompactDoc *
+		    xmlXPathCompactDocNew	(xmlDoc *doc);
+XMLPUBFUN void
+		    xmlXPathCompactDocFree	(xmlXPathCompactDoc *cdoc);
+XMLPUBFUN int
+		    xmlXPathCompactDocSize	(const xmlXPathCompactDoc *cdoc);
+XMLPUBFUN xmlElementType
+		    xmlXPathCompactNodeType	(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN const xmlChar *
+		    xmlXPathCompactNodeName	(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN const xmlChar *
+		    xmlXPathCompactNodeNsURI	(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN const xmlChar *
+		    xmlXPathCompactNodeContent	(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN int
+		    xmlXPathCompactNodeParent	(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN int
+		    xmlXPathCompactNodeFirstChild(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN int
+		    xmlXPathCompactNodeNextSibling(const xmlXPathCompactDoc *cdoc,
+						 int node);
+XMLPUBFUN int
+		    xmlXPathCompactEval		(xmlXPathContext *ctxt,
+						 xmlXPathCompExpr *comp,
+						 const xmlXPathCompactDoc *cdoc,
+						 int node,
+						 int **nodes);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,8 @@
 XML_HIDDEN xmlBuf *
 xmlBufCreate(size_t size);
 XML_HIDDEN xmlBuf *
+xmlBufCreateRing(size_t size);
+XML_HIDDEN xmlBuf *
 xmlBufCreateMem(const xmlChar *mem, size_t size, int isStatic);
 XML_HIDDEN void
 xmlBufFree(xmlBuf *buf);
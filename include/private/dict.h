@@ -61,6 +61,12 @@ XML_HIDDEN unsigned
 xmlDictCombineHash(unsigned v1, unsigned v2);
 XML_HIDDEN xmlHashedString
 xmlDictLookupHashed(xmlDict *dict, const xmlChar *name, int len);
+XML_HIDDEN int
+xmlDictIsFrozen(const xmlDict *dict);
+XML_HIDDEN int
+xmlDictIsShared(xmlDict *dict);
+XML_HIDDEN int
+xmlDictMergeSub(xmlDict *dict, xmlDict *sub);
 
 XML_HIDDEN void
 xmlInitRandom(void);
@@ -49,13 +49,28 @@ XML_HIDDEN xmlParserInputBuffer *
 xmlNewInputBufferMemory(const void *mem, size_t size,
                         xmlParserInputFlags flags, xmlCharEncoding enc);
 
+XML_HIDDEN int
+xmlParserInputBufferRemaining(xmlParserInputBuffer *in, size_t *size);
+
 XML_HIDDEN xmlParserErrors
 xmlInputFromFd(xmlParserInputBuffer *buf, int fd, xmlParserInputFlags flags);
 
 #ifdef LIBXML_OUTPUT_ENABLED
+/*
+ * Segmented output buffers move full chunks of this size out of the
+ * main buffer instead of growing it, and write up to
+ * XML_OUTPUT_MAX_CHUNKS of them with a single system call.
+ */
+#define XML_OUTPUT_CHUNK_SIZE (16 * 1024)
+#define XML_OUTPUT_MAX_CHUNKS 16
+
 XML_HIDDEN void
 xmlOutputBufferWriteQuotedString(xmlOutputBuffer *buf,
                                  const xmlChar *string);
+XML_HIDDEN void
+xmlOutputBufferSetSegmented(xmlOutputBuffer *out, size_t chunkSize);
+XML_HIDDEN xmlChar *
+xmlOutputBufferDetach(xmlOutputBuffer *out, size_t *size);
 #endif
 
 #endif /* XML_IO_H_PRIVATE__ */
@@ -48,6 +48,21 @@ struct _xmlRMutex {
 #endif
 };
 
+typedef void (*xmlThreadFunc)(void *arg);
+
+/*
+ * Worker threads for internal use
+ */
+typedef struct {
+#ifdef HAVE_POSIX_THREADS
+    pthread_t thread;
+#elif defined HAVE_WIN32_THREADS
+    HANDLE thread;
+#endif
+    xmlThreadFunc func;
+    void *arg;
+} xmlThread;
+
 XML_HIDDEN void
 xmlInitMutex(xmlMutex *mutex);
 XML_HIDDEN void
@@ -58,4 +73,9 @@ xmlInitRMutex(xmlRMutex *mutex);
 XML_HIDDEN void
 xmlCleanupRMutex(xmlRMutex *mutex);
 
+XML_HIDDEN int
+xmlThreadCreate(xmlThread *thread, xmlThreadFunc func, void *arg);
+XML_HIDDEN void
+xmlThreadJoin(xmlThread *thread);
+
 #endif /* XML_THREADS_H_PRIVATE__ */
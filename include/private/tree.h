@@ -22,4 +22,38 @@ xmlSplitQName4(const xmlChar *name, xmlChar **prefixPtr);
 XML_HIDDEN xmlChar *
 xmlNodeListGetStringInternal(const xmlNode *node, int escape, int flags);
 
+typedef struct _xmlArena xmlArena;
+
+XML_HIDDEN int
+xmlDocEnableArena(xmlDoc *doc);
+XML_HIDDEN void *
+xmlDocMalloc(xmlDoc *doc, size_t size);
+XML_HIDDEN xmlArena *
+xmlDocTakeArena(xmlDoc *doc);
+XML_HIDDEN void
+xmlDocMergeArena(xmlDoc *doc, xmlArena *arena);
+XML_HIDDEN xmlChar *
+xmlDocStrndup(xmlDoc *doc, const xmlChar *str, int len);
+XML_HIDDEN xmlChar *
+xmlDocStrdup(xmlDoc *doc, const xmlChar *str);
+XML_HIDDEN int
+xmlDocOwnsMem(const xmlDoc *doc, const void *mem);
+XML_HIDDEN void
+xmlDocFreeMem(xmlDoc *doc, void *mem);
+XML_HIDDEN xmlNs *
+xmlDocNewNs(xmlDoc *doc, xmlNode *node, const xmlChar *href,
+            const xmlChar *prefix);
+
+typedef struct _xmlLineIndex xmlLineIndex;
+
+XML_HIDDEN xmlLineIndex *
+xmlLineIndexCreate(void);
+XML_HIDDEN void
+xmlLineIndexFree(xmlLineIndex *index);
+XML_HIDDEN int
+xmlLineIndexAdd(xmlLineIndex *index, size_t offset, const xmlChar *data,
+                size_t len);
+XML_HIDDEN long
+xmlLineIndexLookup(const xmlLineIndex *index, size_t offset);
+
 #endif /* XML_TREE_H_PRIVATE__ */
@@ -75,6 +75,7 @@
 #include "private/io.h"
 #include "private/memory.h"
 #include "private/parser.h"
+#include "private/threads.h"
 #include "private/tree.h"
 
 #define NS_INDEX_EMPTY  INT_MAX
@@ -142,6 +143,9 @@ xmlLookupGeneralEntity(xmlParserCtxtPtr ctxt, const xmlChar *name, int inAttr);
 static const xmlChar *
 xmlParseEntityRefInternal(xmlParserCtxtPtr ctxt);
 
+static int
+xmlParseContentParallel(xmlParserCtxtPtr ctxt);
+
 /************************************************************************
  *									*
  *	Arbitrary limits set in the parser. See XML_PARSE_HUGE		*
@@ -3194,6 +3198,101 @@ xmlParseName(xmlParserCtxt *ctxt) {
     return(xmlParseNameComplex(ctxt));
 }
 
+/*
+ * Word at a time scanning. Words are read with memcpy, so they have
+ * native byte order and no alignment requirements.
+ */
+#define XML_WORD_ONES (~(size_t) 0 / 0xFF)
+#define XML_WORD_HIGHS (XML_WORD_ONES * 0x80)
+
+/* Non-zero if a byte of word w is less than n, n <= 0x80 */
+#define XML_WORD_HAS_LESS(w, n) \
+    (((w) - XML_WORD_ONES * (n)) & ~(w) & XML_WORD_HIGHS)
+/* Non-zero if a byte of word w equals c */
+#define XML_WORD_HAS_BYTE(w, c) \
+    XML_WORD_HAS_LESS((w) ^ (XML_WORD_ONES * (c)), 1)
+
+/*
+ * High bit of each byte of word w set if the byte is in [lo, hi].
+ * Only valid if no byte of w has its high bit set.
+ */
+#define XML_WORD_IN_RANGE(w, lo, hi) \
+    (((w) + XML_WORD_ONES * (0x80 - (lo))) & \
+     ~((w) + XML_WORD_ONES * (0x7F - (hi))) & XML_WORD_HIGHS)
+
+/**
+ * Skip ASCII NCName characters [A-Za-z0-9_.-], a word at a time.
+ *
+ * @param cur  start of the data
+ * @param end  end of the input buffer which must be NUL-terminated
+ * @returns a pointer to the first other byte
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static const xmlChar *
+xmlSkipNCNameChars(const xmlChar *cur, const xmlChar *end) {
+    while ((size_t) (end - cur) >= sizeof(size_t)) {
+        size_t w, name;
+
+        memcpy(&w, cur, sizeof(w));
+        if (w & XML_WORD_HIGHS)
+            break;
+        /* Letters are folded to lower case */
+        name = XML_WORD_IN_RANGE(w | XML_WORD_ONES * 0x20, 'a', 'z') |
+               XML_WORD_IN_RANGE(w, '0', '9') |
+               XML_WORD_IN_RANGE(w, '-', '.') |
+               XML_WORD_IN_RANGE(w, '_', '_');
+        if (name != XML_WORD_HIGHS)
+            break;
+        cur += sizeof(w);
+    }
+
+    while (((*cur >= 0x61) && (*cur <= 0x7A)) ||
+           ((*cur >= 0x41) && (*cur <= 0x5A)) ||
+           ((*cur >= 0x30) && (*cur <= 0x39)) ||
+           (*cur == '_') || (*cur == '-') ||
+           (*cur == '.'))
+        cur++;
+
+    return(cur);
+}
+
+/**
+ * Skip bytes of an attribute value which are copied as is: ASCII
+ * characters except '&', '<', the quote and, unless `spaces` is set,
+ * space. Scans a word at a time like #xmlSkipNCNameChars.
+ *
+ * @param cur  start of the data
+ * @param end  end of the input buffer which must be NUL-terminated
+ * @param quote  the quote character
+ * @param spaces  whether to skip spaces
+ * @returns a pointer to the first other byte
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static const xmlChar *
+xmlSkipAttValueChars(const xmlChar *cur, const xmlChar *end, int quote,
+                     int spaces) {
+    int min = spaces ? 0x20 : 0x21;
+
+    while ((size_t) (end - cur) >= sizeof(size_t)) {
+        size_t w;
+
+        memcpy(&w, cur, sizeof(w));
+        if ((w & XML_WORD_HIGHS) ||
+            (XML_WORD_HAS_LESS(w, min)) ||
+            (XML_WORD_HAS_BYTE(w, '&')) ||
+            (XML_WORD_HAS_BYTE(w, '<')) ||
+            (XML_WORD_HAS_BYTE(w, quote)))
+            break;
+        cur += sizeof(w);
+    }
+
+    while ((*cur >= min) && (*cur < 0x80) &&
+           (*cur != '&') && (*cur != '<') && (*cur != quote))
+        cur++;
+
+    return(cur);
+}
+
 static xmlHashedString
 xmlParseNCNameComplex(xmlParserCtxtPtr ctxt) {
     xmlHashedString ret;
@@ -3266,13 +3365,7 @@ xmlParseNCName(xmlParserCtxtPtr ctxt) {
     if ((((*in >= 0x61) && (*in <= 0x7A)) ||
 	 ((*in >= 0x41) && (*in <= 0x5A)) ||
 	 (*in == '_')) && (in < e)) {
-	in++;
-	while ((((*in >= 0x61) && (*in <= 0x7A)) ||
-	        ((*in >= 0x41) && (*in <= 0x5A)) ||
-	        ((*in >= 0x30) && (*in <= 0x39)) ||
-	        (*in == '_') || (*in == '-') ||
-	        (*in == '.')) && (in < e))
-	    in++;
+	in = xmlSkipNCNameChars(in + 1, e);
 	if (in >= e)
 	    goto complex;
 	if ((*in > 0) && (*in < 0x80)) {
@@ -4030,6 +4123,7 @@ xmlParseAttValueInternal(xmlParserCtxtPtr ctxt, int *attlen, int *outFlags,
                          XML_MAX_TEXT_LENGTH;
     xmlSBuf buf;
     xmlChar *ret;
+    const xmlChar *next;
     int c, l, quote, entFlags, chunkSize;
     int inSpace = 1;
     int replaceEntities;
@@ -4062,18 +4156,21 @@ xmlParseAttValueInternal(xmlParserCtxtPtr ctxt, int *attlen, int *outFlags,
         if (PARSER_STOPPED(ctxt))
             goto error;
 
-        if (CUR_PTR >= ctxt->input->end) {
-            xmlFatalErrMsg(ctxt, XML_ERR_ATTRIBUTE_NOT_FINISHED,
-                           "AttValue: ' expected\n");
-            goto error;
-        }
-
         /*
          * TODO: Check growth threshold
+         *
+         * Runs of characters are skipped up to the end of the buffer,
+         * so grow before checking for the end.
          */
         if (ctxt->input->end - CUR_PTR < 10)
             GROW;
 
+        if (CUR_PTR >= ctxt->input->end) {
+            xmlFatalErrMsg(ctxt, XML_ERR_ATTRIBUTE_NOT_FINISHED,
+                           "AttValue: ' expected\n");
+            goto error;
+        }
+
         c = CUR;
 
         if (c >= 0x80) {
@@ -4100,8 +4197,17 @@ xmlParseAttValueInternal(xmlParserCtxtPtr ctxt, int *attlen, int *outFlags,
                 if (c == '<')
                     xmlFatalErr(ctxt, XML_ERR_LT_IN_ATTRIBUTE, NULL);
 
-                chunkSize += 1;
-                inSpace = 0;
+                /*
+                 * Skip a run of characters which are copied as is.
+                 * Spaces only need handling if values are normalized.
+                 */
+                next = xmlSkipAttValueChars(CUR_PTR + 1, ctxt->input->end,
+                                            quote, !normalize);
+                chunkSize += next - CUR_PTR;
+                ctxt->input->col += next - CUR_PTR;
+                CUR_PTR = next;
+                inSpace = (next[-1] == 0x20);
+                continue;
             } else if (!IS_BYTE_CHAR(c)) {
                 xmlFatalErrMsg(ctxt, XML_ERR_INVALID_CHAR,
                         "invalid character in attribute value\n");
@@ -4490,6 +4596,47 @@ static const unsigned char test_char_data[256] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 
+/**
+ * Skip character data which can be passed to the SAX handler as is,
+ * that is bytes set in test_char_data.
+ *
+ * Runs of such bytes are scanned a word at a time. Words containing
+ * a byte which isn't plain ASCII text, a control character like
+ * tab and newline or one of '<', '&' and ']' are checked with the
+ * table.
+ *
+ * @param cur  start of the data
+ * @param end  end of the input buffer which must be NUL-terminated
+ * @returns a pointer to the first byte not set in test_char_data
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static const xmlChar *
+xmlSkipCharData(const xmlChar *cur, const xmlChar *end) {
+    while (1) {
+        size_t i;
+
+        while ((size_t) (end - cur) >= sizeof(size_t)) {
+            size_t w;
+
+            memcpy(&w, cur, sizeof(w));
+            if ((w & XML_WORD_HIGHS) ||
+                (XML_WORD_HAS_LESS(w, 0x20)) ||
+                (XML_WORD_HAS_BYTE(w, '<')) ||
+                (XML_WORD_HAS_BYTE(w, '&')) ||
+                (XML_WORD_HAS_BYTE(w, ']')))
+                break;
+            cur += sizeof(w);
+        }
+
+        /* The terminating NUL stops this loop */
+        for (i = 0; i < sizeof(size_t); i++) {
+            if (!test_char_data[cur[i]])
+                return(cur + i);
+        }
+        cur += sizeof(size_t);
+    }
+}
+
 static void
 xmlCharacters(xmlParserCtxtPtr ctxt, const xmlChar *buf, int size,
               int isBlank) {
@@ -4524,6 +4671,21 @@ xmlCharacters(xmlParserCtxtPtr ctxt, const xmlChar *buf, int size,
     }
 }
 
+/*
+ * With XML_PARSE_OFFSETS, remember the offset of the construct starting
+ * at the current position of the main input. The SAX2 handlers store it
+ * in the nodes they create.
+ */
+static void
+xmlMarkNodeOffset(xmlParserCtxtPtr ctxt) {
+    xmlParserInputPtr input = ctxt->input;
+
+    if ((ctxt->lineIndex == NULL) || (input != ctxt->inputTab[0]))
+        return;
+
+    ctxt->nodeOffset = input->consumed + (input->cur - input->base);
+}
+
 /**
  * Parse character data. Always makes progress if the first char isn't
  * '<' or '&'.
@@ -4539,12 +4701,12 @@ xmlCharacters(xmlParserCtxtPtr ctxt, const xmlChar *buf, int size,
  */
 static void
 xmlParseCharDataInternal(xmlParserCtxtPtr ctxt, int partial) {
-    const xmlChar *in;
+    const xmlChar *in, *next;
     int line = ctxt->input->line;
     int col = ctxt->input->col;
-    int ccol;
 
     GROW;
+    xmlMarkNodeOffset(ctxt);
     /*
      * Accelerated common case where input don't need to be
      * modified before passing it to the handler.
@@ -4575,12 +4737,9 @@ get_more_space:
         }
 
 get_more:
-        ccol = ctxt->input->col;
-        while (test_char_data[*in]) {
-            in++;
-            ccol++;
-        }
-        ctxt->input->col = ccol;
+        next = xmlSkipCharData(in, ctxt->input->end);
+        ctxt->input->col += next - in;
+        in = next;
         if (*in == 0xA) {
             do {
                 ctxt->input->line++; ctxt->input->col = 1;
@@ -4934,6 +5093,7 @@ xmlParseComment(xmlParserCtxt *ctxt) {
      */
     if ((RAW != '<') || (NXT(1) != '!'))
         return;
+    xmlMarkNodeOffset(ctxt);
     SKIP(2);
     if ((RAW != '-') || (NXT(1) != '-'))
         return;
@@ -5198,6 +5358,7 @@ xmlParsePI(xmlParserCtxt *ctxt) {
 	/*
 	 * this is a Processing Instruction.
 	 */
+        xmlMarkNodeOffset(ctxt);
 	SKIP(2);
 
 	/*
@@ -7090,6 +7251,7 @@ xmlParseReference(xmlParserCtxt *ctxt) {
 
     if (RAW != '&')
         return;
+    xmlMarkNodeOffset(ctxt);
 
     /*
      * Simple case of a CharRef
@@ -8173,6 +8335,7 @@ xmlParseStartTag(xmlParserCtxt *ctxt) {
     int i;
 
     if (RAW != '<') return(NULL);
+    xmlMarkNodeOffset(ctxt);
     NEXT1;
 
     name = xmlParseName(ctxt);
@@ -8758,6 +8921,7 @@ xmlParseStartTag2(xmlParserCtxtPtr ctxt, const xmlChar **pref,
     int numDupErr = 0;
 
     if (RAW != '<') return(NULL);
+    xmlMarkNodeOffset(ctxt);
     NEXT1;
 
     nbatts = 0;
@@ -9442,6 +9606,7 @@ xmlParseCDSect(xmlParserCtxt *ctxt) {
 
     if ((CUR != '<') || (NXT(1) != '!') || (NXT(2) != '['))
         return;
+    xmlMarkNodeOffset(ctxt);
     SKIP(3);
 
     if (!CMP6(CUR_PTR, 'C', 'D', 'A', 'T', 'A', '['))
@@ -9661,7 +9826,8 @@ xmlParseElement(xmlParserCtxt *ctxt) {
     if (xmlParseElementStart(ctxt) != 0)
         return;
 
-    xmlParseContentInternal(ctxt);
+    if ((ctxt->maxThreads < 2) || (xmlParseContentParallel(ctxt) < 0))
+        xmlParseContentInternal(ctxt);
 
     if (ctxt->input->cur >= ctxt->input->end) {
         if (ctxt->wellFormed) {
@@ -10338,6 +10504,51 @@ xmlParseMisc(xmlParserCtxt *ctxt) {
     }
 }
 
+/*
+ * Start the newline index if XML_PARSE_OFFSETS is set. Must be called
+ * before any input is discarded.
+ */
+static void
+xmlCtxtInitLineIndex(xmlParserCtxtPtr ctxt) {
+    if (((ctxt->options & XML_PARSE_OFFSETS) == 0) ||
+        (ctxt->lineIndex != NULL))
+        return;
+
+    ctxt->lineIndex = xmlLineIndexCreate();
+    if (ctxt->lineIndex == NULL)
+        xmlCtxtErrMemory(ctxt);
+}
+
+/*
+ * Index the rest of the main input and hand the newline index over
+ * to the document.
+ */
+static void
+xmlCtxtFinishLineIndex(xmlParserCtxtPtr ctxt) {
+    xmlLineIndex *index = ctxt->lineIndex;
+    xmlParserInputPtr input;
+
+    if (index == NULL)
+        return;
+    ctxt->lineIndex = NULL;
+
+    input = (ctxt->inputNr > 0) ? ctxt->inputTab[0] : NULL;
+    if ((ctxt->myDoc == NULL) || (ctxt->myDoc->lineIndex != NULL) ||
+        (input == NULL) || (input->base == NULL)) {
+        xmlLineIndexFree(index);
+        return;
+    }
+
+    if (xmlLineIndexAdd(index, input->consumed, input->base,
+                        input->end - input->base) < 0) {
+        xmlCtxtErrMemory(ctxt);
+        xmlLineIndexFree(index);
+        return;
+    }
+
+    ctxt->myDoc->lineIndex = index;
+}
+
 static void
 xmlFinishDocument(xmlParserCtxtPtr ctxt) {
     xmlDocPtr doc;
@@ -10357,6 +10568,8 @@ xmlFinishDocument(xmlParserCtxtPtr ctxt) {
         xmlFreeDoc(doc);
         ctxt->myDoc = NULL;
     }
+
+    xmlCtxtFinishLineIndex(ctxt);
 }
 
 /**
@@ -10379,6 +10592,7 @@ xmlParseDocument(xmlParserCtxt *ctxt) {
      * SAX: detecting the level.
      */
     xmlCtxtInitializeLate(ctxt);
+    xmlCtxtInitLineIndex(ctxt);
 
     if ((ctxt->sax) && (ctxt->sax->setDocumentLocator)) {
         ctxt->sax->setDocumentLocator(ctxt->userData,
@@ -10479,127 +10693,2703 @@ xmlParseDocument(xmlParserCtxt *ctxt) {
     return(0);
 }
 
-/**
- * parse a general parsed entity
- * An external general parsed entity is well-formed if it matches the
- * production labeled extParsedEnt.
- *
- * @deprecated Internal function, don't use.
- *
- *     [78] extParsedEnt ::= TextDecl? content
- *
- * @param ctxt  an XML parser context
- * @returns 0, -1 in case of error. the parser context is augmented
- *                as a result of the parsing.
+/************************************************************************
+ *									*
+ *		Indexed parsing of in-memory documents			*
+ *									*
+ ************************************************************************/
+
+/*
+ * With XML_PARSE_INDEXED, documents are parsed in two stages when the
+ * default SAX2 tree builder is used. The first stage loads the whole
+ * input, validates it as UTF-8 without forbidden control characters
+ * and records the offset and line of each '<' and '&', a word at a
+ * time. The second stage walks this index. Character data between
+ * two entries is passed to the SAX handler without looking at it
+ * again, markup is parsed straight from the buffer which doesn't move
+ * or shrink anymore.
+ *
+ * The engine only handles the common subset of XML. If it finds
+ * anything else, for example a document type declaration, a reference
+ * to an entity which isn't predefined, or anything the regular parser
+ * would report as an error or warning, the partial result is discarded
+ * and the document is parsed again with the regular parser.
  */
 
-int
-xmlParseExtParsedEnt(xmlParserCtxt *ctxt) {
-    if ((ctxt == NULL) || (ctxt->input == NULL))
-        return(-1);
+#define XML_INDEX_MAX_ATTRS 32
 
-    xmlCtxtInitializeLate(ctxt);
+typedef struct {
+    unsigned offset;
+    int line;
+} xmlIndexEntry;
 
-    if ((ctxt->sax) && (ctxt->sax->setDocumentLocator)) {
-        ctxt->sax->setDocumentLocator(ctxt->userData,
-                (xmlSAXLocator *) &xmlDefaultSAXLocator);
-    }
+typedef struct {
+    const xmlChar *qname;
+    size_t qnameLen;
+    const xmlChar *localname;
+    const xmlChar *prefix;
+    const xmlChar *URI;
+    int nbNs;
+} xmlIndexElem;
 
-    xmlDetectEncoding(ctxt);
+typedef struct {
+    xmlParserCtxtPtr ctxt;
 
-    if (CUR == 0) {
-	xmlFatalErr(ctxt, XML_ERR_DOCUMENT_EMPTY, NULL);
-    }
+    const xmlChar *base;
+    const xmlChar *end;
+    const xmlChar *cur;
+    int line;
 
-    /*
-     * Check for the XMLDecl in the Prolog.
-     */
-    GROW;
-    if ((CMP5(CUR_PTR, '<', '?', 'x', 'm', 'l')) && (IS_BLANK_CH(NXT(5)))) {
+    /* Offsets of '<' and '&' */
+    xmlIndexEntry *index;
+    int nbIndex;
+    int maxIndex;
+    int next;
+    /* Whether "]]>" was found anywhere */
+    int cdataEnd;
 
-	/*
-	 * Note that we will switch encoding on the fly.
-	 */
-	xmlParseXMLDecl(ctxt);
-	SKIP_BLANKS;
-    } else {
-	ctxt->version = xmlCharStrdup(XML_DEFAULT_VERSION);
-    }
-    if ((ctxt->sax) && (ctxt->sax->startDocument) && (!ctxt->disableSAX))
-        ctxt->sax->startDocument(ctxt->userData);
+    xmlIndexElem *elems;
+    int nbElems;
+    int maxElems;
 
-    /*
-     * Doing validity checking on chunk doesn't make sense
-     */
-    ctxt->options &= ~XML_PARSE_DTDVALID;
-    ctxt->validate = 0;
-    ctxt->depth = 0;
+    /* Scratch buffer for normalized strings */
+    xmlChar *buf;
+    size_t bufSize;
+    size_t bufMax;
 
-    xmlParseContentInternal(ctxt);
+    const xmlChar *encoding;
+    int standalone;
 
-    if (ctxt->input->cur < ctxt->input->end)
-	xmlFatalErr(ctxt, XML_ERR_NOT_WELL_BALANCED, NULL);
+    size_t maxLength;
+    size_t maxNameLength;
+    int maxDepth;
+    int old10;
+} xmlIndexParser;
 
-    /*
-     * SAX: end of the document processing.
-     */
-    if ((ctxt->sax) && (ctxt->sax->endDocument != NULL))
-        ctxt->sax->endDocument(ctxt->userData);
+/*
+ * Check a multi-byte UTF-8 sequence. Returns its length or 0 if it's
+ * malformed or doesn't encode a Char.
+ */
+static int
+xmlIndexCheckUTF8(const xmlChar *cur) {
+    int c = cur[0];
+    int val;
+
+    if ((c < 0xC2) || (c > 0xF4))
+        return(0);
+    if ((cur[1] & 0xC0) != 0x80)
+        return(0);
+    if (c < 0xE0)
+        return(2);
+    if ((cur[2] & 0xC0) != 0x80)
+        return(0);
+    if (c < 0xF0) {
+        val = ((c & 0x0F) << 12) | ((cur[1] & 0x3F) << 6) | (cur[2] & 0x3F);
+        if ((val < 0x800) ||
+            ((val >= 0xD800) && (val < 0xE000)) ||
+            (val >= 0xFFFE))
+            return(0);
+        return(3);
+    }
+    if ((cur[3] & 0xC0) != 0x80)
+        return(0);
+    val = ((c & 0x07) << 18) | ((cur[1] & 0x3F) << 12) |
+          ((cur[2] & 0x3F) << 6) | (cur[3] & 0x3F);
+    if ((val < 0x10000) || (val >= 0x110000))
+        return(0);
+    return(4);
+}
+
+static int
+xmlIndexGrow(xmlIndexParser *ip) {
+    xmlIndexEntry *tmp;
+    int newSize;
+
+    newSize = xmlGrowCapacity(ip->maxIndex, sizeof(tmp[0]), 64,
+                              XML_MAX_ITEMS);
+    if (newSize < 0)
+        return(-1);
+    tmp = xmlRealloc(ip->index, newSize * sizeof(tmp[0]));
+    if (tmp == NULL) {
+        xmlErrMemory(ip->ctxt);
+        return(-1);
+    }
+    ip->index = tmp;
+    ip->maxIndex = newSize;
 
-    if (! ctxt->wellFormed) return(-1);
     return(0);
 }
 
-#ifdef LIBXML_PUSH_ENABLED
-/************************************************************************
- *									*
- *		Progressive parsing interfaces				*
- *									*
- ************************************************************************/
+/*
+ * Byte classes for the first stage: plain characters, markup ('<' and
+ * '&'), newline, ']', lead bytes of multi-byte sequences and bytes
+ * which are never allowed, including NUL and carriage return.
+ */
+#define XML_INDEX_PLAIN     0
+#define XML_INDEX_MARKUP    1
+#define XML_INDEX_NEWLINE   2
+#define XML_INDEX_BRACKET   3
+#define XML_INDEX_LEAD      4
+
+static const unsigned char xmlIndexClass[256] = {
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 0, 2, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5
+};
 
-/**
- * Check whether the input buffer contains a character.
- *
- * @param ctxt  an XML parser context
- * @param c  character
+/*
+ * First stage: validate the input and build the index.
  */
+ATTRIBUTE_NO_SANITIZE_INTEGER
 static int
-xmlParseLookupChar(xmlParserCtxtPtr ctxt, int c) {
-    const xmlChar *cur;
+xmlIndexScan(xmlIndexParser *ip) {
+    const xmlChar *cur = ip->base;
+    const xmlChar *end = ip->end;
+    int line = 1;
 
-    if (ctxt->checkIndex == 0) {
-        cur = ctxt->input->cur + 1;
-    } else {
-        cur = ctxt->input->cur + ctxt->checkIndex;
-    }
+    while (1) {
+        int len;
 
-    if (memchr(cur, c, ctxt->input->end - cur) == NULL) {
-        size_t index = ctxt->input->end - ctxt->input->cur;
+        while ((size_t) (end - cur) >= sizeof(size_t)) {
+            size_t w;
 
-        if (index > LONG_MAX) {
-            ctxt->checkIndex = 0;
-            return(1);
+            memcpy(&w, cur, sizeof(w));
+            if ((w & XML_WORD_HIGHS) ||
+                (XML_WORD_HAS_LESS(w, 0x20)) ||
+                (XML_WORD_HAS_BYTE(w, '<')) ||
+                (XML_WORD_HAS_BYTE(w, '&')) ||
+                (XML_WORD_HAS_BYTE(w, ']')))
+                break;
+            cur += sizeof(w);
+        }
+
+        while (xmlIndexClass[*cur] == XML_INDEX_PLAIN)
+            cur++;
+
+        switch (xmlIndexClass[*cur]) {
+            case XML_INDEX_MARKUP:
+                if ((ip->nbIndex >= ip->maxIndex) && (xmlIndexGrow(ip) < 0))
+                    return(-1);
+                ip->index[ip->nbIndex].offset = cur - ip->base;
+                ip->index[ip->nbIndex].line = line;
+                ip->nbIndex++;
+                cur++;
+                break;
+            case XML_INDEX_NEWLINE:
+                line++;
+                cur++;
+                break;
+            case XML_INDEX_BRACKET:
+                if ((cur[1] == ']') && (cur[2] == '>'))
+                    ip->cdataEnd = 1;
+                cur++;
+                break;
+            case XML_INDEX_LEAD:
+                len = xmlIndexCheckUTF8(cur);
+                if (len == 0)
+                    return(-1);
+                cur += len;
+                break;
+            default:
+                /* NUL, carriage return or another control character */
+                return((cur >= end) ? 0 : -1);
         }
-        ctxt->checkIndex = index;
-        return(0);
-    } else {
-        ctxt->checkIndex = 0;
-        return(1);
     }
 }
 
-/**
- * Check whether the input buffer contains a string.
- *
- * @param ctxt  an XML parser context
- * @param startDelta  delta to apply at the start
- * @param str  string
- * @param strLen  length of string
- */
 static const xmlChar *
-xmlParseLookupString(xmlParserCtxtPtr ctxt, size_t startDelta,
-                     const char *str, size_t strLen) {
-    const xmlChar *cur, *term;
+xmlIndexSkipBlanks(xmlIndexParser *ip, const xmlChar *cur) {
+    while (IS_BLANK_CH(*cur)) {
+        if (*cur == 0xA)
+            ip->line++;
+        cur++;
+    }
+
+    return(cur);
+}
+
+static void
+xmlIndexCountLines(xmlIndexParser *ip, const xmlChar *cur,
+                   const xmlChar *end) {
+    while (cur < end) {
+        cur = memchr(cur, 0xA, end - cur);
+        if (cur == NULL)
+            break;
+        ip->line++;
+        cur++;
+    }
+}
+
+/*
+ * Find the first occurrence of the `len` bytes at `str`. Returns NULL
+ * if there's none.
+ */
+static const xmlChar *
+xmlIndexFind(const xmlChar *cur, const xmlChar *end, const char *str,
+             size_t len) {
+    while ((size_t) (end - cur) >= len) {
+        cur = memchr(cur, str[0], end - cur - (len - 1));
+        if (cur == NULL)
+            break;
+        if (memcmp(cur + 1, str + 1, len - 1) == 0)
+            return(cur);
+        cur++;
+    }
+
+    return(NULL);
+}
+
+/*
+ * Append to the scratch buffer. Space for a terminator is always
+ * reserved.
+ */
+static int
+xmlIndexBufAdd(xmlIndexParser *ip, const xmlChar *str, size_t len) {
+    if (ip->bufMax - ip->bufSize <= len) {
+        xmlChar *tmp;
+        size_t newSize = ip->bufMax ? ip->bufMax * 2 : 256;
+
+        while (newSize - ip->bufSize <= len)
+            newSize *= 2;
+        tmp = xmlRealloc(ip->buf, newSize);
+        if (tmp == NULL) {
+            xmlErrMemory(ip->ctxt);
+            return(-1);
+        }
+        ip->buf = tmp;
+        ip->bufMax = newSize;
+    }
+
+    memcpy(ip->buf + ip->bufSize, str, len);
+    ip->bufSize += len;
+    ip->buf[ip->bufSize] = 0;
+    return(0);
+}
+
+static const xmlChar *
+xmlIndexScanNCName(xmlIndexParser *ip, const xmlChar *cur) {
+    const xmlChar *end;
+    int c = *cur | 0x20;
+
+    if (((c >= 'a') && (c <= 'z')) || (*cur == '_')) {
+        end = xmlSkipNCNameChars(cur + 1, ip->end);
+        if (*end < 0x80) {
+            if ((size_t) (end - cur) > ip->maxNameLength)
+                return(NULL);
+            return(end);
+        }
+    }
+
+    end = xmlScanName(cur, ip->maxNameLength,
+                      XML_SCAN_NC | (ip->old10 ? XML_SCAN_OLD10 : 0));
+    if (end == cur)
+        return(NULL);
+    return(end);
+}
+
+static int
+xmlIndexParseQName(xmlIndexParser *ip, xmlHashedString *localname,
+                   xmlHashedString *prefix) {
+    xmlDictPtr dict = ip->ctxt->dict;
+    const xmlChar *start = ip->cur;
+    const xmlChar *local, *end;
+
+    end = xmlIndexScanNCName(ip, start);
+    if (end == NULL)
+        return(-1);
+
+    if (*end == ':') {
+        local = end + 1;
+        end = xmlIndexScanNCName(ip, local);
+        if ((end == NULL) || (*end == ':'))
+            return(-1);
+        *prefix = xmlDictLookupHashed(dict, start, local - 1 - start);
+        if (prefix->name == NULL)
+            goto mem_error;
+    } else {
+        local = start;
+        prefix->name = NULL;
+        prefix->hashValue = 0;
+    }
+
+    *localname = xmlDictLookupHashed(dict, local, end - local);
+    if (localname->name == NULL)
+        goto mem_error;
+
+    ip->cur = end;
+    return(0);
+
+mem_error:
+    xmlErrMemory(ip->ctxt);
+    return(-1);
+}
+
+/*
+ * Parse a character reference or a reference to a predefined entity.
+ * Returns the character or 0 if the reference must be handled by the
+ * regular parser.
+ */
+static int
+xmlIndexParseRef(xmlIndexParser *ip) {
+    const xmlChar *cur = ip->cur + 1;
+    int val = 0;
+
+    if (*cur == '#') {
+        int i;
+
+        cur++;
+        if (*cur == 'x') {
+            cur++;
+            for (i = 0; i < 7; i++) {
+                int c = *cur;
+
+                if ((c >= '0') && (c <= '9'))
+                    val = val * 16 + (c - '0');
+                else if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+                    val = val * 16 + ((c | 0x20) - 'a' + 10);
+                else
+                    break;
+                cur++;
+            }
+        } else {
+            for (i = 0; i < 8; i++) {
+                int c = *cur;
+
+                if ((c < '0') || (c > '9'))
+                    break;
+                val = val * 10 + (c - '0');
+                cur++;
+            }
+        }
+        if ((i == 0) || (*cur != ';') || (!IS_CHAR(val)))
+            return(0);
+        cur++;
+    } else if (CMP4(cur, 'a', 'm', 'p', ';')) {
+        val = '&';
+        cur += 4;
+    } else if ((cur[0] == 'l') && (cur[1] == 't') && (cur[2] == ';')) {
+        val = '<';
+        cur += 3;
+    } else if ((cur[0] == 'g') && (cur[1] == 't') && (cur[2] == ';')) {
+        val = '>';
+        cur += 3;
+    } else if (CMP5(cur, 'q', 'u', 'o', 't', ';')) {
+        val = '"';
+        cur += 5;
+    } else if (CMP5(cur, 'a', 'p', 'o', 's', ';')) {
+        val = '\'';
+        cur += 5;
+    } else {
+        return(0);
+    }
+
+    ip->cur = cur;
+    return(val);
+}
+
+/*
+ * Parse an attribute value. Returns 0 if the value is used as is and
+ * points into the input, 1 if it was normalized into the scratch
+ * buffer at `*offset` like the regular parser does, -1 otherwise.
+ */
+static int
+xmlIndexParseAttValue(xmlIndexParser *ip, int replaceEntities,
+                      const xmlChar **value, size_t *len, size_t *offset) {
+    const xmlChar *cur = ip->cur;
+    const xmlChar *start;
+    int quote = *cur;
+
+    if ((quote != '"') && (quote != '\''))
+        return(-1);
+    start = ++cur;
+
+    while (1) {
+        cur = xmlSkipAttValueChars(cur, ip->end, quote, 1);
+        if (*cur < 0x80)
+            break;
+        do {
+            cur++;
+        } while (*cur >= 0x80);
+    }
+    if (*cur == quote) {
+        if ((size_t) (cur - start) > ip->maxLength)
+            return(-1);
+        *value = start;
+        *len = cur - start;
+        ip->cur = cur + 1;
+        return(0);
+    }
+
+    *offset = ip->bufSize;
+
+    while (1) {
+        int c;
+
+        cur = xmlSkipAttValueChars(cur, ip->end, quote, 1);
+        c = *cur;
+        if (c >= 0x80) {
+            do {
+                cur++;
+            } while (*cur >= 0x80);
+            continue;
+        }
+        if (c == quote)
+            break;
+        if ((c == '<') || (c == 0))
+            return(-1);
+
+        if (xmlIndexBufAdd(ip, start, cur - start) < 0)
+            return(-1);
+
+        if (c == '&') {
+            xmlChar out[16];
+            int i = 0;
+
+            ip->cur = cur;
+            c = xmlIndexParseRef(ip);
+            if (c == 0)
+                return(-1);
+            cur = ip->cur;
+
+            if ((c == '&') && (!replaceEntities)) {
+                /* Reparsed in xmlNodeParseContent */
+                if (xmlIndexBufAdd(ip, BAD_CAST "&#38;", 5) < 0)
+                    return(-1);
+            } else {
+                COPY_BUF(out, i, c);
+                if (xmlIndexBufAdd(ip, out, i) < 0)
+                    return(-1);
+            }
+        } else {
+            /* Tab or newline */
+            if (c == 0xA)
+                ip->line++;
+            if (xmlIndexBufAdd(ip, BAD_CAST " ", 1) < 0)
+                return(-1);
+            cur++;
+        }
+
+        if (ip->bufSize - *offset > ip->maxLength)
+            return(-1);
+        start = cur;
+    }
+
+    if (xmlIndexBufAdd(ip, start, cur - start) < 0)
+        return(-1);
+    *len = ip->bufSize - *offset;
+    if (*len > ip->maxLength)
+        return(-1);
+    /* Keep the terminator */
+    ip->bufSize++;
+    ip->cur = cur + 1;
+    return(1);
+}
+
+/*
+ * Handle a namespace declaration. Returns 1 if the namespace was
+ * pushed, 0 if it was ignored, -1 if the declaration must be handled
+ * by the regular parser.
+ */
+static int
+xmlIndexPushNs(xmlIndexParser *ip, const xmlHashedString *prefix,
+               const xmlChar *value, size_t len) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    xmlHashedString huri;
+    int nsIndex;
+
+    huri = xmlDictLookupHashed(ctxt->dict, value, len);
+    if (huri.name == NULL) {
+        xmlErrMemory(ctxt);
+        return(-1);
+    }
+
+    if (prefix == NULL) {
+        nsIndex = ctxt->nsdb->defaultNsIndex;
+    } else {
+        if (prefix->name == ctxt->str_xml)
+            return((huri.name == ctxt->str_xml_ns) ? 0 : -1);
+        if ((prefix->name == ctxt->str_xmlns) || (len == 0))
+            return(-1);
+        nsIndex = xmlParserNsLookup(ctxt, prefix, NULL);
+    }
+
+    /* Duplicate declaration */
+    if ((nsIndex != INT_MAX) &&
+        (ctxt->nsdb->extra[nsIndex].elementId == ctxt->nsdb->elementId))
+        return(-1);
+
+    if (len > 0) {
+        xmlURIPtr uri;
+        int absolute;
+
+        if ((huri.name == ctxt->str_xml_ns) ||
+            ((len == 29) &&
+             (xmlStrEqual(huri.name,
+                          BAD_CAST "http://www.w3.org/2000/xmlns/"))))
+            return(-1);
+
+        if (xmlParseURISafe((const char *) huri.name, &uri) < 0) {
+            xmlErrMemory(ctxt);
+            return(-1);
+        }
+        if (uri == NULL)
+            return(-1);
+        absolute = (uri->scheme != NULL);
+        xmlFreeURI(uri);
+        /* Relative default namespace URIs raise a warning */
+        if ((prefix == NULL) && (!absolute))
+            return(-1);
+    }
+
+    return(xmlParserNsPush(ctxt, prefix, &huri, NULL, 0));
+}
+
+static int
+xmlIndexGrowElems(xmlIndexParser *ip) {
+    xmlIndexElem *tmp;
+    int newSize;
+
+    newSize = xmlGrowCapacity(ip->maxElems, sizeof(tmp[0]), 16,
+                              XML_MAX_ITEMS);
+    if (newSize < 0)
+        return(-1);
+    tmp = xmlRealloc(ip->elems, newSize * sizeof(tmp[0]));
+    if (tmp == NULL) {
+        xmlErrMemory(ip->ctxt);
+        return(-1);
+    }
+    ip->elems = tmp;
+    ip->maxElems = newSize;
+
+    return(0);
+}
+
+static void
+xmlIndexEndElement(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    xmlIndexElem *elem = &ip->elems[ip->nbElems - 1];
+
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX)
+        ctxt->sax->endElementNs(ctxt->userData, elem->localname,
+                                elem->prefix, elem->URI);
+    if (elem->nbNs > 0)
+        xmlParserNsPop(ctxt, elem->nbNs);
+    ip->nbElems--;
+}
+
+static int
+xmlIndexParseStartTag(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    xmlHashedString hlocalname, hprefix;
+    xmlIndexElem *elem;
+    const xmlChar **atts;
+    const xmlChar *qname;
+    const xmlChar *uri;
+    size_t qnameLen;
+    unsigned inBuf = 0;
+    int nbatts = 0;
+    int nbNs = 0;
+    int i, j;
+
+    if (ip->nbElems >= ip->maxDepth)
+        return(-1);
+    if ((ip->nbElems >= ip->maxElems) && (xmlIndexGrowElems(ip) < 0))
+        return(-1);
+    if (xmlParserNsStartElement(ctxt->nsdb) < 0) {
+        xmlErrMemory(ctxt);
+        return(-1);
+    }
+
+    ip->cur++;
+    qname = ip->cur;
+    if (xmlIndexParseQName(ip, &hlocalname, &hprefix) < 0)
+        return(-1);
+    qnameLen = ip->cur - qname;
+
+    ip->bufSize = 0;
+
+    while (1) {
+        xmlHashedString hattname, haprefix;
+        const xmlChar *cur;
+        const xmlChar *value = NULL;
+        size_t len, offset = 0;
+        int res;
+
+        cur = xmlIndexSkipBlanks(ip, ip->cur);
+        if ((*cur == '>') || ((*cur == '/') && (cur[1] == '>'))) {
+            ip->cur = cur;
+            break;
+        }
+        if (cur == ip->cur)
+            return(-1);
+        ip->cur = cur;
+
+        if (xmlIndexParseQName(ip, &hattname, &haprefix) < 0)
+            return(-1);
+        ip->cur = xmlIndexSkipBlanks(ip, ip->cur);
+        if (*ip->cur != '=')
+            return(-1);
+        ip->cur = xmlIndexSkipBlanks(ip, ip->cur + 1);
+
+        if (((haprefix.name == NULL) && (hattname.name == ctxt->str_xmlns)) ||
+            (haprefix.name == ctxt->str_xmlns)) {
+            /* Namespace URIs are always expanded */
+            res = xmlIndexParseAttValue(ip, 1, &value, &len, &offset);
+            if (res < 0)
+                return(-1);
+            if (res > 0)
+                value = ip->buf + offset;
+            res = xmlIndexPushNs(ip,
+                    (haprefix.name == NULL) ? NULL : &hattname, value, len);
+            if (res < 0)
+                return(-1);
+            nbNs += res;
+            continue;
+        }
+
+        if (nbatts / 5 >= XML_INDEX_MAX_ATTRS)
+            return(-1);
+
+        res = xmlIndexParseAttValue(ip, ctxt->replaceEntities, &value,
+                                    &len, &offset);
+        if (res < 0)
+            return(-1);
+
+        if (haprefix.name == ctxt->str_xml) {
+            const xmlChar *v = (res > 0) ? ip->buf + offset : value;
+
+            /* xml:id is checked and registered by the SAX handler */
+            if (xmlStrEqual(hattname.name, BAD_CAST "id"))
+                return(-1);
+            if ((xmlStrEqual(hattname.name, BAD_CAST "space")) &&
+                (!((len == 7) && (memcmp(v, "default", 7) == 0))) &&
+                (!((len == 8) && (memcmp(v, "preserve", 8) == 0))))
+                return(-1);
+        }
+
+        if ((ctxt->atts == NULL) || (nbatts + 5 > ctxt->maxatts)) {
+            if (xmlCtxtGrowAttrs(ctxt) < 0)
+                return(-1);
+        }
+        atts = ctxt->atts;
+
+        atts[nbatts++] = hattname.name;
+        atts[nbatts++] = haprefix.name;
+        atts[nbatts++] = (const xmlChar *) (size_t) haprefix.hashValue;
+        if (res > 0) {
+            /* The scratch buffer can move, store offsets */
+            inBuf |= 1u << (nbatts / 5);
+            atts[nbatts++] = (const xmlChar *) offset;
+            atts[nbatts++] = (const xmlChar *) (offset + len);
+        } else {
+            atts[nbatts++] = value;
+            atts[nbatts++] = value + len;
+        }
+    }
+
+    /*
+     * Resolve attribute namespaces and check that attributes are unique.
+     */
+    atts = ctxt->atts;
+    for (i = 0; i < nbatts; i += 5) {
+        const xmlChar *aprefix = atts[i+1];
+        const xmlChar *nsuri;
+
+        if (aprefix == NULL) {
+            nsuri = NULL;
+        } else if (aprefix == ctxt->str_xml) {
+            nsuri = ctxt->str_xml_ns;
+        } else {
+            xmlHashedString haprefix;
+            int nsIndex;
+
+            haprefix.name = aprefix;
+            haprefix.hashValue = (size_t) atts[i+2];
+            nsIndex = xmlParserNsLookup(ctxt, &haprefix, NULL);
+            if (nsIndex == INT_MAX)
+                return(-1);
+            nsuri = ctxt->nsTab[nsIndex * 2 + 1];
+        }
+        atts[i+2] = nsuri;
+
+        for (j = 0; j < i; j += 5) {
+            if ((atts[j] == atts[i]) && (atts[j+2] == nsuri))
+                return(-1);
+        }
+
+        if (inBuf & (1u << (i / 5))) {
+            atts[i+3] = ip->buf + (size_t) atts[i+3];
+            atts[i+4] = ip->buf + (size_t) atts[i+4];
+        }
+    }
+
+    uri = xmlParserNsLookupUri(ctxt, &hprefix);
+    if ((hprefix.name != NULL) && (uri == NULL))
+        return(-1);
+
+    elem = &ip->elems[ip->nbElems++];
+    elem->qname = qname;
+    elem->qnameLen = qnameLen;
+    elem->localname = hlocalname.name;
+    elem->prefix = hprefix.name;
+    elem->URI = uri;
+    elem->nbNs = nbNs;
+
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX)
+        ctxt->sax->startElementNs(ctxt->userData, hlocalname.name,
+                hprefix.name, uri, nbNs,
+                (nbNs > 0) ? ctxt->nsTab + 2 * (ctxt->nsNr - nbNs) : NULL,
+                nbatts / 5, 0, atts);
+
+    if (*ip->cur == '/') {
+        ip->cur += 2;
+        xmlIndexEndElement(ip);
+    } else {
+        ip->cur++;
+    }
+
+    return(0);
+}
+
+static int
+xmlIndexParseEndTag(xmlIndexParser *ip) {
+    xmlIndexElem *elem = &ip->elems[ip->nbElems - 1];
+    const xmlChar *cur = ip->cur + 2;
+
+    if (((size_t) (ip->end - cur) < elem->qnameLen) ||
+        (memcmp(cur, elem->qname, elem->qnameLen) != 0))
+        return(-1);
+    cur += elem->qnameLen;
+    if ((*cur != '>') && (!IS_BLANK_CH(*cur)))
+        return(-1);
+    cur = xmlIndexSkipBlanks(ip, cur);
+    if (*cur != '>')
+        return(-1);
+
+    ip->cur = cur + 1;
+    xmlIndexEndElement(ip);
+    return(0);
+}
+
+static int
+xmlIndexParseComment(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    const xmlChar *start = ip->cur + 4;
+    const xmlChar *end;
+
+    end = xmlIndexFind(start, ip->end, "--", 2);
+    if ((end == NULL) || (end[2] != '>') ||
+        ((size_t) (end - start) > ip->maxLength))
+        return(-1);
+
+    ip->bufSize = 0;
+    if (xmlIndexBufAdd(ip, start, end - start) < 0)
+        return(-1);
+    xmlIndexCountLines(ip, start, end);
+    ip->cur = end + 3;
+
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX)
+        ctxt->sax->comment(ctxt->userData, ip->buf);
+    return(0);
+}
+
+static int
+xmlIndexParsePI(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    const xmlChar *start = ip->cur + 2;
+    const xmlChar *cur, *target;
+    const xmlChar *data = NULL;
+    size_t len;
+
+    cur = xmlScanName(start, ip->maxNameLength,
+                      ip->old10 ? XML_SCAN_OLD10 : 0);
+    if ((cur == NULL) || (cur == start))
+        return(-1);
+    len = cur - start;
+
+    /* Reserved names and colons are reported by the regular parser */
+    if ((len >= 3) &&
+        ((start[0] | 0x20) == 'x') &&
+        ((start[1] | 0x20) == 'm') &&
+        ((start[2] | 0x20) == 'l')) {
+        int i;
+
+        for (i = 0; xmlW3CPIs[i] != NULL; i++) {
+            if ((strlen(xmlW3CPIs[i]) == len) &&
+                (memcmp(start, xmlW3CPIs[i], len) == 0))
+                break;
+        }
+        if (xmlW3CPIs[i] == NULL)
+            return(-1);
+    }
+    if (memchr(start, ':', len) != NULL)
+        return(-1);
+    /* Catalog PIs need special handling */
+    if ((len == 17) && (memcmp(start, "oasis-xml-catalog", 17) == 0))
+        return(-1);
+
+    target = xmlDictLookup(ctxt->dict, start, len);
+    if (target == NULL) {
+        xmlErrMemory(ctxt);
+        return(-1);
+    }
+
+    if ((cur[0] == '?') && (cur[1] == '>')) {
+        cur += 2;
+    } else {
+        const xmlChar *end;
+
+        if (!IS_BLANK_CH(*cur))
+            return(-1);
+        cur = xmlIndexSkipBlanks(ip, cur);
+        end = xmlIndexFind(cur, ip->end, "?>", 2);
+        if ((end == NULL) || ((size_t) (end - cur) > ip->maxLength))
+            return(-1);
+
+        ip->bufSize = 0;
+        if (xmlIndexBufAdd(ip, cur, end - cur) < 0)
+            return(-1);
+        data = ip->buf;
+        xmlIndexCountLines(ip, cur, end);
+        cur = end + 2;
+    }
+
+    ip->cur = cur;
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX)
+        ctxt->sax->processingInstruction(ctxt->userData, target, data);
+    return(0);
+}
+
+static int
+xmlIndexParseCDSect(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    const xmlChar *start = ip->cur + 9;
+    const xmlChar *end;
+
+    end = xmlIndexFind(start, ip->end, "]]>", 3);
+    if ((end == NULL) || ((size_t) (end - start) > ip->maxLength))
+        return(-1);
+
+    xmlIndexCountLines(ip, start, end);
+    ip->cur = end + 3;
+
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX) {
+        if (ctxt->options & XML_PARSE_NOCDATA)
+            ctxt->sax->characters(ctxt->userData, start, end - start);
+        else if (ctxt->sax->cdataBlock != NULL)
+            ctxt->sax->cdataBlock(ctxt->userData, start, end - start);
+    }
+    return(0);
+}
+
+/*
+ * Second stage: parse content starting with the root element.
+ */
+static int
+xmlIndexParseContent(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+
+    if (xmlIndexParseStartTag(ip) < 0)
+        return(-1);
+
+    while (ip->nbElems > 0) {
+        const xmlChar *cur = ip->cur;
+        const xmlChar *next;
+        size_t offset = cur - ip->base;
+        int res;
+
+        if (PARSER_STOPPED(ctxt))
+            return(-1);
+
+        /* Skip entries inside markup */
+        while ((ip->next < ip->nbIndex) &&
+               (ip->index[ip->next].offset < offset))
+            ip->next++;
+        if (ip->next >= ip->nbIndex)
+            return(-1);
+        next = ip->base + ip->index[ip->next].offset;
+
+        if (next > cur) {
+            size_t len = next - cur;
+
+            if ((len > ip->maxLength) ||
+                ((ip->cdataEnd) &&
+                 (xmlIndexFind(cur, next, "]]>", 3) != NULL)))
+                return(-1);
+
+            ip->cur = next;
+            ip->line = ip->index[ip->next].line;
+            ctxt->input->cur = next;
+            ctxt->input->line = ip->line;
+            if (!ctxt->disableSAX)
+                ctxt->sax->characters(ctxt->userData, cur, len);
+            cur = next;
+        }
+
+        if (*cur == '&') {
+            xmlChar out[16];
+            int charRef = (cur[1] == '#');
+            int i = 0;
+            int val;
+
+            val = xmlIndexParseRef(ip);
+            if (val == 0)
+                return(-1);
+            COPY_BUF(out, i, val);
+            ctxt->input->cur = ip->cur;
+            ctxt->input->line = ip->line;
+            /* Like xmlParseReference */
+            if ((!ctxt->disableSAX) && ((charRef) || (ctxt->wellFormed)))
+                ctxt->sax->characters(ctxt->userData, out, i);
+            continue;
+        }
+
+        if (cur[1] == '/')
+            res = xmlIndexParseEndTag(ip);
+        else if (cur[1] == '?')
+            res = xmlIndexParsePI(ip);
+        else if (CMP4(cur, '<', '!', '-', '-'))
+            res = xmlIndexParseComment(ip);
+        else if (CMP9(cur, '<', '!', '[', 'C', 'D', 'A', 'T', 'A', '['))
+            res = xmlIndexParseCDSect(ip);
+        else if (cur[1] == '!')
+            res = -1;
+        else
+            res = xmlIndexParseStartTag(ip);
+        if (res < 0)
+            return(-1);
+    }
+
+    return(0);
+}
+
+static int
+xmlIndexParseMisc(xmlIndexParser *ip) {
+    while (!PARSER_STOPPED(ip->ctxt)) {
+        ip->cur = xmlIndexSkipBlanks(ip, ip->cur);
+
+        if ((ip->cur[0] == '<') && (ip->cur[1] == '?')) {
+            if (xmlIndexParsePI(ip) < 0)
+                return(-1);
+        } else if (CMP4(ip->cur, '<', '!', '-', '-')) {
+            if (xmlIndexParseComment(ip) < 0)
+                return(-1);
+        } else {
+            return(0);
+        }
+    }
+
+    return(-1);
+}
+
+static const xmlChar *
+xmlIndexParseEq(xmlIndexParser *ip, const xmlChar *cur) {
+    cur = xmlIndexSkipBlanks(ip, cur);
+    if (*cur != '=')
+        return(NULL);
+    return(xmlIndexSkipBlanks(ip, cur + 1));
+}
+
+/*
+ * Only the plain form of the XML declaration is handled.
+ */
+static int
+xmlIndexParseXMLDecl(xmlIndexParser *ip) {
+    const xmlChar *cur;
+    int quote, blank;
+
+    ip->standalone = -2;
+
+    cur = xmlIndexSkipBlanks(ip, ip->cur + 5);
+    if (!CMP7(cur, 'v', 'e', 'r', 's', 'i', 'o', 'n'))
+        return(-1);
+    cur = xmlIndexParseEq(ip, cur + 7);
+    if (cur == NULL)
+        return(-1);
+    quote = *cur;
+    if (((quote != '"') && (quote != '\'')) ||
+        (cur[1] != '1') || (cur[2] != '.') || (cur[3] != '0') ||
+        (cur[4] != quote))
+        return(-1);
+    cur += 5;
+
+    blank = IS_BLANK_CH(*cur);
+    cur = xmlIndexSkipBlanks(ip, cur);
+    if ((blank) && (CMP8(cur, 'e', 'n', 'c', 'o', 'd', 'i', 'n', 'g'))) {
+        cur = xmlIndexParseEq(ip, cur + 8);
+        if (cur == NULL)
+            return(-1);
+        quote = *cur;
+        if (((quote != '"') && (quote != '\'')) ||
+            (xmlStrncasecmp(cur + 1, BAD_CAST "UTF-8", 5) != 0) ||
+            (cur[6] != quote))
+            return(-1);
+        ip->encoding = cur + 1;
+        cur += 7;
+
+        blank = IS_BLANK_CH(*cur);
+        cur = xmlIndexSkipBlanks(ip, cur);
+    }
+    if ((blank) &&
+        (CMP10(cur, 's', 't', 'a', 'n', 'd', 'a', 'l', 'o', 'n', 'e'))) {
+        cur = xmlIndexParseEq(ip, cur + 10);
+        if (cur == NULL)
+            return(-1);
+        quote = *cur;
+        if ((quote != '"') && (quote != '\''))
+            return(-1);
+        if ((cur[1] == 'y') && (cur[2] == 'e') && (cur[3] == 's') &&
+            (cur[4] == quote)) {
+            ip->standalone = 1;
+            cur += 5;
+        } else if ((cur[1] == 'n') && (cur[2] == 'o') &&
+                   (cur[3] == quote)) {
+            ip->standalone = 0;
+            cur += 4;
+        } else {
+            return(-1);
+        }
+        cur = xmlIndexSkipBlanks(ip, cur);
+    }
+    if ((cur[0] != '?') || (cur[1] != '>'))
+        return(-1);
+
+    ip->cur = cur + 2;
+    return(0);
+}
+
+static int
+xmlIndexParseDocument(xmlIndexParser *ip) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+    xmlSAXHandlerPtr sax = ctxt->sax;
+
+    ip->standalone = ctxt->standalone;
+    if ((CMP5(ip->cur, '<', '?', 'x', 'm', 'l')) &&
+        (IS_BLANK_CH(ip->cur[5]))) {
+        if (xmlIndexParseXMLDecl(ip) < 0)
+            return(-1);
+        ip->cur = xmlIndexSkipBlanks(ip, ip->cur);
+    }
+
+    if (sax->setDocumentLocator != NULL)
+        sax->setDocumentLocator(ctxt->userData,
+                                (xmlSAXLocator *) &xmlDefaultSAXLocator);
+
+    ctxt->version = xmlCharStrdup(XML_DEFAULT_VERSION);
+    if (ctxt->version == NULL) {
+        xmlErrMemory(ctxt);
+        return(-1);
+    }
+    ctxt->standalone = ip->standalone;
+
+    ctxt->input->cur = ip->cur;
+    ctxt->input->line = ip->line;
+    if (!ctxt->disableSAX)
+        sax->startDocument(ctxt->userData);
+    if ((ctxt->myDoc != NULL) && (ctxt->input->buf->compressed >= 0))
+        ctxt->myDoc->compression = ctxt->input->buf->compressed;
+
+    if (xmlIndexParseMisc(ip) < 0)
+        return(-1);
+    if ((ip->cur[0] != '<') || (ip->cur[1] == '!') || (ip->cur[1] == '/'))
+        return(-1);
+    if (xmlIndexParseContent(ip) < 0)
+        return(-1);
+    if (xmlIndexParseMisc(ip) < 0)
+        return(-1);
+    if (ip->cur != ip->end)
+        return(-1);
+
+    return(0);
+}
+
+/*
+ * Check whether the SAX handler builds a tree with the default
+ * SAX2 callbacks.
+ */
+static int
+xmlIsDefaultSAX2(xmlSAXHandlerPtr sax) {
+    if ((sax == NULL) ||
+        (sax->initialized != XML_SAX2_MAGIC) ||
+        (sax->startDocument != xmlSAX2StartDocument) ||
+        (sax->endDocument != xmlSAX2EndDocument) ||
+        (sax->startElementNs != xmlSAX2StartElementNs) ||
+        (sax->endElementNs != xmlSAX2EndElementNs) ||
+        (sax->characters != xmlSAX2Characters) ||
+        (sax->ignorableWhitespace != xmlSAX2Characters) ||
+        (sax->comment != xmlSAX2Comment) ||
+        (sax->processingInstruction != xmlSAX2ProcessingInstruction) ||
+        ((sax->cdataBlock != NULL) &&
+         (sax->cdataBlock != xmlSAX2CDataBlock)) ||
+        ((sax->setDocumentLocator != NULL) &&
+         (sax->setDocumentLocator != xmlSAX2SetDocumentLocator)))
+        return(0);
+
+    return(1);
+}
+
+/*
+ * Check whether the indexed engine produces the same result as the
+ * regular parser.
+ */
+static int
+xmlIndexUsable(xmlParserCtxtPtr ctxt) {
+    xmlParserInputPtr input = ctxt->input;
+
+    if ((ctxt->inputNr != 1) || (ctxt->nodeNr != 0) ||
+        (ctxt->nameNr != 0) || (ctxt->nsNr != 0) ||
+        (ctxt->myDoc != NULL) || (ctxt->version != NULL) ||
+        (ctxt->nsdb == NULL) || (ctxt->dict == NULL) ||
+        (ctxt->userData != ctxt))
+        return(0);
+    if ((ctxt->html) || (ctxt->validate) || (ctxt->pedantic) ||
+        (ctxt->record_info) || (!ctxt->keepBlanks) ||
+        (ctxt->options & (XML_PARSE_SAX1 | XML_PARSE_OLDSAX |
+                          XML_PARSE_OFFSETS)))
+        return(0);
+    /* Nodes of a discarded partial result must not be seen */
+    if (xmlRegisterCallbacks)
+        return(0);
+    if ((input->buf == NULL) || (input->buf->encoder != NULL) ||
+        (input->cur != input->base) || (input->entity != NULL) ||
+        (input->flags & XML_INPUT_HAS_ENCODING))
+        return(0);
+
+    return(xmlIsDefaultSAX2(ctxt->sax));
+}
+
+/*
+ * Read the whole input into the buffer, up to `limit` bytes.
+ */
+static int
+xmlLoadWholeInput(xmlParserCtxtPtr ctxt, size_t limit) {
+    xmlParserInputPtr in = ctxt->input;
+    xmlParserInputBufferPtr buf = in->buf;
+    size_t pos = in->cur - in->base;
+
+    if (buf->error)
+        return(-1);
+
+    while (1) {
+        size_t size = in->end - in->base;
+        size_t remaining;
+        int res;
+
+        if (size > limit)
+            return(-1);
+
+        if (xmlParserInputBufferRemaining(buf, &remaining) == 0) {
+            /* Read the rest of in-memory input at once */
+            if (remaining == 0)
+                break;
+            if (remaining > limit - size)
+                return(-1);
+            size = remaining;
+        } else if (size < 4000) {
+            /* Read chunks of growing size */
+            size = 4000;
+        } else if (size > 64000000) {
+            size = 64000000;
+        }
+        if (size > XML_MAX_HUGE_LENGTH)
+            size = XML_MAX_HUGE_LENGTH;
+        res = xmlParserInputBufferGrow(buf, size);
+        xmlBufUpdateInput(buf->buffer, in, pos);
+        if (res < 0) {
+            xmlCtxtErrIO(ctxt, buf->error, NULL);
+            return(-1);
+        }
+        if (res == 0)
+            break;
+    }
+
+    return(0);
+}
+
+static void
+xmlIndexCleanup(xmlIndexParser *ip) {
+    xmlFree(ip->index);
+    xmlFree(ip->elems);
+    xmlFree(ip->buf);
+}
+
+/*
+ * Undo everything to parse the document again.
+ */
+static void
+xmlIndexReset(xmlIndexParser *ip, int standalone) {
+    xmlParserCtxtPtr ctxt = ip->ctxt;
+
+    while (ctxt->nodeNr > 0)
+        nodePop(ctxt);
+    if (ctxt->nsNr > 0)
+        xmlParserNsPop(ctxt, ctxt->nsNr);
+    xmlFreeDoc(ctxt->myDoc);
+    ctxt->myDoc = NULL;
+    xmlFree((xmlChar *) ctxt->version);
+    ctxt->version = NULL;
+    ctxt->standalone = standalone;
+    ctxt->nodelen = 0;
+    ctxt->nodemem = 0;
+
+    ctxt->input->cur = ip->base;
+    ctxt->input->line = 1;
+    ctxt->input->col = 1;
+}
+
+/*
+ * Parse a document with the indexed engine. Returns 0 if the document
+ * was parsed, -1 if it must be parsed with the regular parser.
+ */
+static int
+xmlParseDocumentIndexed(xmlParserCtxtPtr ctxt) {
+    xmlParserInputPtr input = ctxt->input;
+    xmlIndexParser ip;
+    int standalone = ctxt->standalone;
+    int res;
+
+    if ((!xmlIndexUsable(ctxt)) ||
+        (xmlLoadWholeInput(ctxt, XML_MAX_HUGE_LENGTH) < 0))
+        return(-1);
+
+    memset(&ip, 0, sizeof(ip));
+    ip.ctxt = ctxt;
+    ip.base = input->cur;
+    ip.end = input->end;
+    ip.cur = ip.base;
+    ip.line = 1;
+    if (ctxt->options & XML_PARSE_HUGE) {
+        ip.maxLength = XML_MAX_HUGE_LENGTH;
+        ip.maxNameLength = XML_MAX_TEXT_LENGTH;
+        ip.maxDepth = 2048;
+    } else {
+        ip.maxLength = XML_MAX_TEXT_LENGTH;
+        ip.maxNameLength = XML_MAX_NAME_LENGTH;
+        ip.maxDepth = 256;
+    }
+    /* Stay clear of the limits of the regular parser */
+    ip.maxLength -= 100;
+    ip.old10 = (ctxt->options & XML_PARSE_OLD10) ? 1 : 0;
+
+    /*
+     * Documents without a BOM starting with '<' or whitespace don't
+     * need encoding detection.
+     */
+    if ((ip.end - ip.base < 4) || (*ip.end != 0) ||
+        (((ip.base[0] != '<') || (ip.base[1] == 0)) &&
+         (!IS_BLANK_CH(ip.base[0]))))
+        return(-1);
+
+    xmlCtxtInitializeLate(ctxt);
+    if ((!ctxt->sax2) || (PARSER_STOPPED(ctxt)))
+        return(-1);
+
+    res = xmlIndexScan(&ip);
+    if (res == 0)
+        res = xmlIndexParseDocument(&ip);
+
+    if ((res < 0) && (!PARSER_STOPPED(ctxt))) {
+        xmlIndexReset(&ip, standalone);
+        xmlIndexCleanup(&ip);
+        return(-1);
+    }
+
+    while (ctxt->nodeNr > 0)
+        nodePop(ctxt);
+    if (ctxt->nsNr > 0)
+        xmlParserNsPop(ctxt, ctxt->nsNr);
+
+    if ((res == 0) && (ip.encoding != NULL)) {
+        xmlChar *encoding = xmlStrndup(ip.encoding, 5);
+
+        if (encoding == NULL)
+            xmlErrMemory(ctxt);
+        else
+            xmlSetDeclaredEncoding(ctxt, encoding);
+    }
+
+    input->cur = ip.cur;
+    input->line = ip.line;
+    ctxt->instate = XML_PARSER_EOF;
+    xmlFinishDocument(ctxt);
+
+    if (!ctxt->wellFormed)
+        ctxt->valid = 0;
+
+    xmlIndexCleanup(&ip);
+    return(0);
+}
+
+/************************************************************************
+ *									*
+ *		Pull lexer						*
+ *									*
+ ************************************************************************/
+
+/*
+ * The lexer splits a document in memory into tokens which point into
+ * the input. It uses the scanners of the parser but doesn't intern
+ * names, copy or normalize values, or call SAX handlers. For the
+ * well-formedness checks, the names of open elements and the
+ * attribute names of the current start tag are kept as spans of the
+ * input.
+ */
+
+#define XML_LEX_CONTENT 0
+#define XML_LEX_TAG     1
+#define XML_LEX_VALUE   2
+#define XML_LEX_DONE    3
+
+/* Attributes of a start tag are hashed beyond this number */
+#define XML_LEX_LINEAR_ATTS 8
+
+typedef struct {
+    size_t offset;
+    size_t length;
+    unsigned hashValue;
+} xmlLexerSpan;
+
+struct _xmlLexer {
+    /* input followed by a NUL byte */
+    const xmlChar *base;
+    const xmlChar *end;
+    const xmlChar *cur;
+    /* start of the document after a byte order mark */
+    const xmlChar *start;
+    xmlChar *copy;
+    int options;
+    int state;
+
+    /* attribute value returned after the attribute name */
+    xmlToken value;
+
+    /* names of open elements */
+    xmlLexerSpan *names;
+    int nbNames;
+    int maxNames;
+
+    /* attribute names of the current start tag */
+    xmlLexerSpan *atts;
+    int nbAtts;
+    int maxAtts;
+    int *attHash;
+    unsigned attHashSize;
+
+    /* maximum number of open elements, 0 for no limit */
+    int maxDepth;
+    int seenRoot;
+    int seenDoctype;
+
+    xmlParserErrors error;
+    size_t errorOffset;
+};
+
+static void
+xmlLexerErr(xmlLexer *lexer, xmlParserErrors code, const xmlChar *ptr) {
+    lexer->error = code;
+    lexer->errorOffset = ptr - lexer->base;
+    lexer->state = XML_LEX_DONE;
+}
+
+static int
+xmlLexerToken(xmlLexer *lexer, xmlToken *token, xmlTokenType type,
+              const xmlChar *start, const xmlChar *end) {
+    token->type = type;
+    token->offset = start - lexer->base;
+    token->length = end - start;
+    return(1);
+}
+
+/*
+ * Report content outside of the root element.
+ */
+static int
+xmlLexerErrOutside(xmlLexer *lexer, const xmlChar *ptr) {
+    xmlLexerErr(lexer,
+                lexer->seenRoot ? XML_ERR_DOCUMENT_END : XML_ERR_DOCUMENT_EMPTY,
+                ptr);
+    return(-1);
+}
+
+/*
+ * Check that the bytes between `cur` and `end` encode Chars in UTF-8.
+ * Returns NULL on success or a pointer to the first invalid byte.
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static const xmlChar *
+xmlLexerCheckChars(const xmlChar *cur, const xmlChar *end) {
+    while (cur < end) {
+        int c;
+
+        while ((size_t) (end - cur) >= sizeof(size_t)) {
+            size_t w;
+
+            memcpy(&w, cur, sizeof(w));
+            if ((w & XML_WORD_HIGHS) || (XML_WORD_HAS_LESS(w, 0x20)))
+                break;
+            cur += sizeof(w);
+        }
+        if (cur >= end)
+            break;
+
+        c = *cur;
+        if (c >= 0x80) {
+            int len = xmlIndexCheckUTF8(cur);
+
+            if ((len == 0) || (len > end - cur))
+                return(cur);
+            cur += len;
+        } else if ((c >= 0x20) || (c == 0x9) || (c == 0xA) || (c == 0xD)) {
+            cur++;
+        } else {
+            return(cur);
+        }
+    }
+
+    return(NULL);
+}
+
+static int
+xmlLexerCheckSpan(xmlLexer *lexer, const xmlChar *start,
+                  const xmlChar *end) {
+    const xmlChar *err;
+
+    if ((lexer->options & XML_LEXER_WELL_FORMED) == 0)
+        return(0);
+
+    err = xmlLexerCheckChars(start, end);
+    if (err != NULL) {
+        xmlLexerErr(lexer, XML_ERR_INVALID_CHAR, err);
+        return(-1);
+    }
+
+    return(0);
+}
+
+static const xmlChar *
+xmlLexerSkipBlanks(const xmlChar *cur) {
+    while (IS_BLANK_CH(*cur))
+        cur++;
+    return(cur);
+}
+
+/*
+ * Scan a Name. Returns a pointer to its end or NULL.
+ */
+static const xmlChar *
+xmlLexerScanName(xmlLexer *lexer, const xmlChar *cur) {
+    const xmlChar *end;
+    int c = *cur | 0x20;
+
+    if (((c >= 'a') && (c <= 'z')) || (*cur == '_') || (*cur == ':')) {
+        end = cur + 1;
+        while (1) {
+            end = xmlSkipNCNameChars(end, lexer->end);
+            if (*end != ':')
+                break;
+            end++;
+        }
+        if (*end < 0x80) {
+            if ((size_t) (end - cur) > XML_MAX_NAME_LENGTH) {
+                xmlLexerErr(lexer, XML_ERR_NAME_TOO_LONG, cur);
+                return(NULL);
+            }
+            return(end);
+        }
+    }
+
+    end = xmlScanName(cur, XML_MAX_NAME_LENGTH, 0);
+    if (end == NULL) {
+        xmlLexerErr(lexer, XML_ERR_NAME_TOO_LONG, cur);
+        return(NULL);
+    }
+    if (end == cur) {
+        xmlLexerErr(lexer, XML_ERR_NAME_REQUIRED, cur);
+        return(NULL);
+    }
+
+    return(end);
+}
+
+/*
+ * Scan a reference starting with '&'. Returns a pointer after the
+ * semicolon or NULL.
+ */
+static const xmlChar *
+xmlLexerScanRef(xmlLexer *lexer, const xmlChar *start) {
+    const xmlChar *cur = start + 1;
+    const xmlChar *end;
+    size_t len;
+
+    if (*cur == '#') {
+        const xmlChar *digits;
+        int val = 0;
+
+        cur++;
+        if (*cur == 'x') {
+            cur++;
+            digits = cur;
+            while (1) {
+                int c = *cur;
+
+                if ((c >= '0') && (c <= '9'))
+                    c -= '0';
+                else if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+                    c = (c | 0x20) - 'a' + 10;
+                else
+                    break;
+                if (val < 0x110000)
+                    val = val * 16 + c;
+                cur++;
+            }
+        } else {
+            digits = cur;
+            while ((*cur >= '0') && (*cur <= '9')) {
+                if (val < 0x110000)
+                    val = val * 10 + (*cur - '0');
+                cur++;
+            }
+        }
+
+        if ((cur == digits) || (*cur != ';')) {
+            xmlLexerErr(lexer, XML_ERR_INVALID_CHARREF, start);
+            return(NULL);
+        }
+        if ((lexer->options & XML_LEXER_WELL_FORMED) && (!IS_CHAR(val))) {
+            xmlLexerErr(lexer, XML_ERR_INVALID_CHAR, start);
+            return(NULL);
+        }
+
+        return(cur + 1);
+    }
+
+    end = xmlLexerScanName(lexer, cur);
+    if (end == NULL)
+        return(NULL);
+    if (*end != ';') {
+        xmlLexerErr(lexer, XML_ERR_ENTITYREF_SEMICOL_MISSING, end);
+        return(NULL);
+    }
+
+    /* Without a DTD, only the predefined entities are declared */
+    len = end - cur;
+    if ((lexer->options & XML_LEXER_WELL_FORMED) &&
+        (!lexer->seenDoctype) &&
+        (!((len == 2) && (cur[1] == 't') &&
+           ((cur[0] == 'l') || (cur[0] == 'g')))) &&
+        (!((len == 3) && (memcmp(cur, "amp", 3) == 0))) &&
+        (!((len == 4) && ((memcmp(cur, "quot", 4) == 0) ||
+                          (memcmp(cur, "apos", 4) == 0))))) {
+        xmlLexerErr(lexer, XML_ERR_UNDECLARED_ENTITY, start);
+        return(NULL);
+    }
+
+    return(end + 1);
+}
+
+/*
+ * Scan character data up to the next '<' or '&'.
+ */
+ATTRIBUTE_NO_SANITIZE_INTEGER
+static const xmlChar *
+xmlLexerScanText(xmlLexer *lexer, const xmlChar *cur) {
+    const xmlChar *end = lexer->end;
+
+    if ((lexer->options & XML_LEXER_WELL_FORMED) == 0) {
+        while ((size_t) (end - cur) >= sizeof(size_t)) {
+            size_t w;
+
+            memcpy(&w, cur, sizeof(w));
+            if ((XML_WORD_HAS_BYTE(w, '<')) || (XML_WORD_HAS_BYTE(w, '&')))
+                break;
+            cur += sizeof(w);
+        }
+        while ((cur < end) && (*cur != '<') && (*cur != '&'))
+            cur++;
+        return(cur);
+    }
+
+    while (1) {
+        int c, len;
+
+        cur = xmlSkipCharData(cur, end);
+        c = *cur;
+        if ((cur >= end) || (c == '<') || (c == '&'))
+            return(cur);
+
+        if (c == ']') {
+            if ((cur[1] == ']') && (cur[2] == '>')) {
+                xmlLexerErr(lexer, XML_ERR_MISPLACED_CDATA_END, cur);
+                return(NULL);
+            }
+            cur++;
+        } else if ((c == 0xA) || (c == 0xD)) {
+            cur++;
+        } else if ((c >= 0x80) && ((len = xmlIndexCheckUTF8(cur)) > 0)) {
+            cur += len;
+        } else {
+            xmlLexerErr(lexer, XML_ERR_INVALID_CHAR, cur);
+            return(NULL);
+        }
+    }
+}
+
+/*
+ * Scan an attribute value after the opening quote. Returns a pointer
+ * to the closing quote or NULL.
+ */
+static const xmlChar *
+xmlLexerScanAttValue(xmlLexer *lexer, const xmlChar *start, int quote) {
+    const xmlChar *cur = start;
+
+    if ((lexer->options & XML_LEXER_WELL_FORMED) == 0) {
+        cur = memchr(cur, quote, lexer->end - cur);
+        if (cur == NULL)
+            xmlLexerErr(lexer, XML_ERR_ATTRIBUTE_NOT_FINISHED, lexer->end);
+        return(cur);
+    }
+
+    while (1) {
+        int c, len;
+
+        cur = xmlSkipAttValueChars(cur, lexer->end, quote, 1);
+        c = *cur;
+        if (cur >= lexer->end) {
+            xmlLexerErr(lexer, XML_ERR_ATTRIBUTE_NOT_FINISHED, lexer->end);
+            return(NULL);
+        }
+
+        if (c == quote) {
+            return(cur);
+        } else if (c == '&') {
+            cur = xmlLexerScanRef(lexer, cur);
+            if (cur == NULL)
+                return(NULL);
+        } else if (c == '<') {
+            xmlLexerErr(lexer, XML_ERR_LT_IN_ATTRIBUTE, cur);
+            return(NULL);
+        } else if ((c == 0x9) || (c == 0xA) || (c == 0xD)) {
+            cur++;
+        } else if ((c >= 0x80) && ((len = xmlIndexCheckUTF8(cur)) > 0)) {
+            cur += len;
+        } else {
+            xmlLexerErr(lexer, XML_ERR_INVALID_CHAR, cur);
+            return(NULL);
+        }
+    }
+}
+
+static unsigned
+xmlLexerHashSpan(xmlLexer *lexer, const xmlLexerSpan *span) {
+    const xmlChar *str = lexer->base + span->offset;
+    unsigned h1, h2;
+    size_t i;
+
+    HASH_INIT(h1, h2, 0);
+    for (i = 0; i < span->length; i++)
+        HASH_UPDATE(h1, h2, str[i]);
+    HASH_FINISH(h1, h2);
+
+    return(h2);
+}
+
+static int
+xmlLexerSpanEqual(xmlLexer *lexer, const xmlLexerSpan *a,
+                  const xmlLexerSpan *b) {
+    return((a->length == b->length) &&
+           (memcmp(lexer->base + a->offset, lexer->base + b->offset,
+                   a->length) == 0));
+}
+
+/*
+ * Insert attribute `index` into the hash table. Returns 1 if an
+ * attribute with the same name exists, 0 otherwise.
+ */
+static int
+xmlLexerHashAttr(xmlLexer *lexer, int index) {
+    xmlLexerSpan *span = &lexer->atts[index];
+    unsigned mask = lexer->attHashSize - 1;
+    unsigned i = span->hashValue & mask;
+
+    while (lexer->attHash[i] >= 0) {
+        xmlLexerSpan *other = &lexer->atts[lexer->attHash[i]];
+
+        if ((other->hashValue == span->hashValue) &&
+            (xmlLexerSpanEqual(lexer, other, span)))
+            return(1);
+        i = (i + 1) & mask;
+    }
+
+    lexer->attHash[i] = index;
+    return(0);
+}
+
+/*
+ * Add an attribute name of the current start tag. Returns 1 if the
+ * attribute is a duplicate, 0 on success, -1 if a memory allocation
+ * failed.
+ */
+static int
+xmlLexerAddAttr(xmlLexer *lexer, const xmlChar *name, size_t len) {
+    xmlLexerSpan *span;
+    int i;
+
+    if (lexer->nbAtts >= lexer->maxAtts) {
+        xmlLexerSpan *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(lexer->maxAtts, sizeof(tmp[0]),
+                                  XML_LEX_LINEAR_ATTS, XML_MAX_ATTRS);
+        if (newSize < 0)
+            return(-1);
+        tmp = xmlRealloc(lexer->atts, newSize * sizeof(tmp[0]));
+        if (tmp == NULL)
+            return(-1);
+        lexer->atts = tmp;
+        lexer->maxAtts = newSize;
+    }
+
+    span = &lexer->atts[lexer->nbAtts];
+    span->offset = name - lexer->base;
+    span->length = len;
+
+    if (lexer->nbAtts < XML_LEX_LINEAR_ATTS) {
+        for (i = 0; i < lexer->nbAtts; i++) {
+            if (xmlLexerSpanEqual(lexer, &lexer->atts[i], span))
+                return(1);
+        }
+        lexer->nbAtts++;
+        return(0);
+    }
+
+    span->hashValue = xmlLexerHashSpan(lexer, span);
+
+    /* Rebuild the table for a new tag or when it's half full */
+    if ((lexer->nbAtts == XML_LEX_LINEAR_ATTS) ||
+        (lexer->attHashSize / 2 <= (unsigned) lexer->nbAtts)) {
+        unsigned size = 32;
+
+        while (size / 2 <= (unsigned) lexer->nbAtts)
+            size *= 2;
+        if (size > lexer->attHashSize) {
+            int *tmp;
+
+            tmp = xmlRealloc(lexer->attHash, size * sizeof(tmp[0]));
+            if (tmp == NULL)
+                return(-1);
+            lexer->attHash = tmp;
+            lexer->attHashSize = size;
+        }
+        memset(lexer->attHash, -1, lexer->attHashSize * sizeof(int));
+
+        for (i = 0; i < lexer->nbAtts; i++) {
+            if (i < XML_LEX_LINEAR_ATTS)
+                lexer->atts[i].hashValue =
+                    xmlLexerHashSpan(lexer, &lexer->atts[i]);
+            xmlLexerHashAttr(lexer, i);
+        }
+    }
+
+    if (xmlLexerHashAttr(lexer, lexer->nbAtts))
+        return(1);
+    lexer->nbAtts++;
+    return(0);
+}
+
+static int
+xmlLexerStartTag(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur + 1;
+    const xmlChar *end;
+
+    end = xmlLexerScanName(lexer, start);
+    if (end == NULL)
+        return(-1);
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        xmlLexerSpan *span;
+
+        if ((lexer->nbNames == 0) && (lexer->seenRoot))
+            return(xmlLexerErrOutside(lexer, lexer->cur));
+        if ((lexer->maxDepth > 0) && (lexer->nbNames >= lexer->maxDepth)) {
+            xmlLexerErr(lexer, XML_ERR_RESOURCE_LIMIT, lexer->cur);
+            return(-1);
+        }
+
+        if (lexer->nbNames >= lexer->maxNames) {
+            xmlLexerSpan *tmp;
+            int newSize;
+
+            newSize = xmlGrowCapacity(lexer->maxNames, sizeof(tmp[0]),
+                                      16, XML_MAX_ITEMS);
+            if (newSize < 0) {
+                xmlLexerErr(lexer, XML_ERR_RESOURCE_LIMIT, lexer->cur);
+                return(-1);
+            }
+            tmp = xmlRealloc(lexer->names, newSize * sizeof(tmp[0]));
+            if (tmp == NULL) {
+                xmlLexerErr(lexer, XML_ERR_NO_MEMORY, lexer->cur);
+                return(-1);
+            }
+            lexer->names = tmp;
+            lexer->maxNames = newSize;
+        }
+
+        span = &lexer->names[lexer->nbNames++];
+        span->offset = start - lexer->base;
+        span->length = end - start;
+    }
+
+    lexer->seenRoot = 1;
+    lexer->nbAtts = 0;
+    lexer->cur = end;
+    lexer->state = XML_LEX_TAG;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_START_TAG, start, end));
+}
+
+/*
+ * Return the next attribute name or the end of the start tag.
+ */
+static int
+xmlLexerAttribute(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *cur, *name, *nameEnd, *value;
+    int quote;
+
+    cur = xmlLexerSkipBlanks(lexer->cur);
+
+    if (*cur == '>') {
+        lexer->cur = cur + 1;
+        lexer->state = XML_LEX_CONTENT;
+        return(xmlLexerToken(lexer, token, XML_TOKEN_TAG_END, cur, cur + 1));
+    }
+    if ((cur[0] == '/') && (cur[1] == '>')) {
+        if (lexer->options & XML_LEXER_WELL_FORMED)
+            lexer->nbNames--;
+        lexer->cur = cur + 2;
+        lexer->state = XML_LEX_CONTENT;
+        return(xmlLexerToken(lexer, token, XML_TOKEN_EMPTY_TAG_END,
+                             cur, cur + 2));
+    }
+    if (cur >= lexer->end) {
+        xmlLexerErr(lexer, XML_ERR_GT_REQUIRED, cur);
+        return(-1);
+    }
+    if ((cur == lexer->cur) && (lexer->options & XML_LEXER_WELL_FORMED)) {
+        xmlLexerErr(lexer, XML_ERR_SPACE_REQUIRED, cur);
+        return(-1);
+    }
+
+    name = cur;
+    nameEnd = xmlLexerScanName(lexer, name);
+    if (nameEnd == NULL)
+        return(-1);
+
+    cur = xmlLexerSkipBlanks(nameEnd);
+    if (*cur != '=') {
+        xmlLexerErr(lexer, XML_ERR_ATTRIBUTE_WITHOUT_VALUE, cur);
+        return(-1);
+    }
+    cur = xmlLexerSkipBlanks(cur + 1);
+    quote = *cur;
+    if ((quote != '"') && (quote != '\'')) {
+        xmlLexerErr(lexer, XML_ERR_ATTRIBUTE_NOT_STARTED, cur);
+        return(-1);
+    }
+    value = cur + 1;
+    cur = xmlLexerScanAttValue(lexer, value, quote);
+    if (cur == NULL)
+        return(-1);
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        int res = xmlLexerAddAttr(lexer, name, nameEnd - name);
+
+        if (res != 0) {
+            xmlLexerErr(lexer,
+                        res > 0 ? XML_ERR_ATTRIBUTE_REDEFINED :
+                                  XML_ERR_NO_MEMORY,
+                        name);
+            return(-1);
+        }
+    }
+
+    xmlLexerToken(lexer, &lexer->value, XML_TOKEN_ATTR_VALUE, value, cur);
+    lexer->cur = cur + 1;
+    lexer->state = XML_LEX_VALUE;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_ATTR_NAME, name, nameEnd));
+}
+
+static int
+xmlLexerEndTag(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur + 2;
+    const xmlChar *end, *cur;
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        if (lexer->nbNames == 0)
+            return(xmlLexerErrOutside(lexer, lexer->cur));
+        /* Like the parser, treat a missing name as a mismatch */
+        if (xmlScanName(start, XML_MAX_NAME_LENGTH, 0) == start) {
+            cur = xmlLexerSkipBlanks(start);
+            if (*cur == '>')
+                xmlLexerErr(lexer, XML_ERR_TAG_NAME_MISMATCH, cur + 1);
+            else
+                xmlLexerErr(lexer, XML_ERR_GT_REQUIRED, cur);
+            return(-1);
+        }
+    }
+
+    end = xmlLexerScanName(lexer, start);
+    if (end == NULL)
+        return(-1);
+    cur = xmlLexerSkipBlanks(end);
+    if (*cur != '>') {
+        xmlLexerErr(lexer, XML_ERR_GT_REQUIRED, cur);
+        return(-1);
+    }
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        xmlLexerSpan *span;
+
+        span = &lexer->names[lexer->nbNames - 1];
+        if ((span->length != (size_t) (end - start)) ||
+            (memcmp(lexer->base + span->offset, start, span->length) != 0)) {
+            xmlLexerErr(lexer, XML_ERR_TAG_NAME_MISMATCH, cur + 1);
+            return(-1);
+        }
+        lexer->nbNames--;
+    }
+
+    lexer->cur = cur + 1;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_END_TAG, start, end));
+}
+
+static int
+xmlLexerComment(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur + 4;
+    const xmlChar *end;
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        /* "--" must not occur in comments */
+        end = xmlIndexFind(start, lexer->end, "--", 2);
+    } else {
+        end = xmlIndexFind(start, lexer->end, "-->", 3);
+    }
+    /* Report errors in the order the parser finds them */
+    if (xmlLexerCheckSpan(lexer, start,
+                          (end != NULL) ? end : lexer->end) < 0)
+        return(-1);
+    if (end == NULL) {
+        xmlLexerErr(lexer, XML_ERR_COMMENT_NOT_FINISHED, lexer->end);
+        return(-1);
+    }
+    if (end[2] != '>') {
+        xmlLexerErr(lexer, XML_ERR_HYPHEN_IN_COMMENT, end);
+        return(-1);
+    }
+
+    lexer->cur = end + 3;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_COMMENT, start, end));
+}
+
+static int
+xmlLexerPI(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur + 2;
+    const xmlChar *target, *end;
+
+    target = xmlLexerScanName(lexer, start);
+    if (target == NULL)
+        return(-1);
+
+    if ((lexer->options & XML_LEXER_WELL_FORMED) &&
+        (target - start == 3) &&
+        ((start[0] | 0x20) == 'x') &&
+        ((start[1] | 0x20) == 'm') &&
+        ((start[2] | 0x20) == 'l') &&
+        ((memcmp(start, "xml", 3) != 0) ||
+         (lexer->cur != lexer->start))) {
+        xmlLexerErr(lexer, XML_ERR_RESERVED_XML_NAME, start);
+        return(-1);
+    }
+
+    if ((target[0] == '?') && (target[1] == '>')) {
+        end = target;
+    } else {
+        if (!IS_BLANK_CH(*target)) {
+            xmlLexerErr(lexer, XML_ERR_SPACE_REQUIRED, target);
+            return(-1);
+        }
+        end = xmlIndexFind(target, lexer->end, "?>", 2);
+        if (xmlLexerCheckSpan(lexer, target,
+                              (end != NULL) ? end : lexer->end) < 0)
+            return(-1);
+        if (end == NULL) {
+            xmlLexerErr(lexer, XML_ERR_PI_NOT_FINISHED, lexer->end);
+            return(-1);
+        }
+    }
+
+    lexer->cur = end + 2;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_PI, start, end));
+}
+
+static int
+xmlLexerCDSect(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur + 9;
+    const xmlChar *end;
+
+    if ((lexer->options & XML_LEXER_WELL_FORMED) && (lexer->nbNames == 0))
+        return(xmlLexerErrOutside(lexer, lexer->cur));
+
+    end = xmlIndexFind(start, lexer->end, "]]>", 3);
+    if (xmlLexerCheckSpan(lexer, start,
+                          (end != NULL) ? end : lexer->end) < 0)
+        return(-1);
+    if (end == NULL) {
+        xmlLexerErr(lexer, XML_ERR_CDATA_NOT_FINISHED, lexer->end);
+        return(-1);
+    }
+
+    lexer->cur = end + 3;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_CDATA, start, end));
+}
+
+/*
+ * Only quotes, comments, PIs and the brackets of the internal subset
+ * are recognized to find the end of the declaration.
+ */
+static int
+xmlLexerDoctype(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur;
+    const xmlChar *cur = start + 9;
+    int inSubset = 0;
+
+    if (lexer->options & XML_LEXER_WELL_FORMED) {
+        if ((lexer->seenRoot) || (lexer->nbNames > 0))
+            return(xmlLexerErrOutside(lexer, start));
+        if (lexer->seenDoctype) {
+            xmlLexerErr(lexer, XML_ERR_EXTRA_CONTENT, start);
+            return(-1);
+        }
+    }
+    lexer->seenDoctype = 1;
+
+    while (1) {
+        const xmlChar *next = NULL;
+        int c = *cur;
+
+        if (cur >= lexer->end) {
+            xmlLexerErr(lexer, XML_ERR_DOCTYPE_NOT_FINISHED, start);
+            return(-1);
+        }
+
+        if ((c == '"') || (c == '\'')) {
+            next = memchr(cur + 1, c, lexer->end - (cur + 1));
+            if (next != NULL)
+                next += 1;
+        } else if ((inSubset) && (CMP4(cur, '<', '!', '-', '-'))) {
+            next = xmlIndexFind(cur + 4, lexer->end, "-->", 3);
+            if (next != NULL)
+                next += 3;
+        } else if ((inSubset) && (cur[0] == '<') && (cur[1] == '?')) {
+            next = xmlIndexFind(cur + 2, lexer->end, "?>", 2);
+            if (next != NULL)
+                next += 2;
+        } else {
+            if (c == '[')
+                inSubset = 1;
+            else if (c == ']')
+                inSubset = 0;
+            else if ((c == '>') && (!inSubset))
+                break;
+            next = cur + 1;
+        }
+
+        if (next == NULL) {
+            xmlLexerErr(lexer, XML_ERR_DOCTYPE_NOT_FINISHED, start);
+            return(-1);
+        }
+        cur = next;
+    }
+    cur++;
+
+    if (xmlLexerCheckSpan(lexer, start, cur) < 0)
+        return(-1);
+
+    lexer->cur = cur;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_DOCTYPE, start, cur));
+}
+
+static int
+xmlLexerText(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *start = lexer->cur;
+    const xmlChar *end;
+
+    end = xmlLexerScanText(lexer, start);
+    if (end == NULL)
+        return(-1);
+
+    /* Only whitespace is allowed outside of the root element */
+    if ((lexer->options & XML_LEXER_WELL_FORMED) && (lexer->nbNames == 0)) {
+        const xmlChar *cur = xmlLexerSkipBlanks(start);
+
+        if (cur < end)
+            return(xmlLexerErrOutside(lexer, cur));
+    }
+
+    lexer->cur = end;
+    return(xmlLexerToken(lexer, token, XML_TOKEN_TEXT, start, end));
+}
+
+static void
+xmlLexerInit(xmlLexer *lexer, const xmlChar *base, size_t size,
+             int options) {
+    memset(lexer, 0, sizeof(*lexer));
+    lexer->base = base;
+    lexer->end = base + size;
+    lexer->cur = base;
+    lexer->options = options;
+    lexer->state = XML_LEX_CONTENT;
+    lexer->error = XML_ERR_OK;
+
+    /* Skip a UTF-8 byte order mark, reject other encodings */
+    if ((size >= 3) &&
+        (base[0] == 0xEF) && (base[1] == 0xBB) && (base[2] == 0xBF)) {
+        lexer->cur += 3;
+    } else if ((size >= 2) &&
+               (((base[0] == 0xFE) && (base[1] == 0xFF)) ||
+                ((base[0] == 0xFF) && (base[1] == 0xFE)) ||
+                (base[0] == 0) || (base[1] == 0))) {
+        xmlLexerErr(lexer, XML_ERR_UNSUPPORTED_ENCODING, base);
+    }
+    lexer->start = lexer->cur;
+}
+
+static void
+xmlLexerCleanup(xmlLexer *lexer) {
+    xmlFree(lexer->names);
+    xmlFree(lexer->atts);
+    xmlFree(lexer->attHash);
+    xmlFree(lexer->copy);
+}
+
+/**
+ * Create a lexer for a document in memory. The document must be
+ * encoded in UTF-8. Tokens are spans of the buffer, so the buffer
+ * must stay valid while the lexer is used.
+ *
+ * Entity declarations in the DTD aren't parsed. Once a document type
+ * declaration was seen, references to any entity are accepted.
+ * Namespaces aren't checked.
+ *
+ * @since 2.15.0
+ *
+ * @param buffer  the document
+ * @param size  size of the document in bytes
+ * @param options  a combination of xmlLexerOption values
+ * @returns the lexer or NULL if arguments are invalid or a memory
+ * allocation failed
+ */
+xmlLexer *
+xmlNewLexer(const char *buffer, size_t size, int options) {
+    xmlLexer *lexer;
+    const xmlChar *base;
+    xmlChar *copy = NULL;
+
+    if ((buffer == NULL) || (size == SIZE_MAX))
+        return(NULL);
+
+    lexer = xmlMalloc(sizeof(*lexer));
+    if (lexer == NULL)
+        return(NULL);
+
+    if (options & XML_LEXER_ZERO_TERMINATED) {
+        base = (const xmlChar *) buffer;
+    } else {
+        copy = xmlMalloc(size + 1);
+        if (copy == NULL) {
+            xmlFree(lexer);
+            return(NULL);
+        }
+        memcpy(copy, buffer, size);
+        copy[size] = 0;
+        base = copy;
+    }
+
+    xmlLexerInit(lexer, base, size, options);
+    lexer->copy = copy;
+
+    return(lexer);
+}
+
+/**
+ * Free a lexer.
+ *
+ * @since 2.15.0
+ *
+ * @param lexer  the lexer
+ */
+void
+xmlFreeLexer(xmlLexer *lexer) {
+    if (lexer == NULL)
+        return;
+
+    xmlLexerCleanup(lexer);
+    xmlFree(lexer);
+}
+
+/**
+ * Return the next token.
+ *
+ * Attribute names are always followed by their value. With
+ * XML_LEXER_WELL_FORMED, the end of the input is only reported after
+ * the root element was closed.
+ *
+ * @since 2.15.0
+ *
+ * @param lexer  the lexer
+ * @param token  the token (output)
+ * @returns 1 if a token was returned, 0 at the end of the input, -1
+ * if an error was found. See #xmlLexerGetError.
+ */
+int
+xmlLexerNext(xmlLexer *lexer, xmlToken *token) {
+    const xmlChar *cur;
+
+    if ((lexer == NULL) || (token == NULL))
+        return(-1);
+    if (lexer->error != XML_ERR_OK)
+        return(-1);
+
+    switch (lexer->state) {
+        case XML_LEX_DONE:
+            return(0);
+        case XML_LEX_VALUE:
+            *token = lexer->value;
+            lexer->state = XML_LEX_TAG;
+            return(1);
+        case XML_LEX_TAG:
+            return(xmlLexerAttribute(lexer, token));
+        default:
+            break;
+    }
+
+    cur = lexer->cur;
+
+    if (cur >= lexer->end) {
+        if (lexer->options & XML_LEXER_WELL_FORMED) {
+            if (lexer->nbNames > 0) {
+                xmlLexerErr(lexer, XML_ERR_TAG_NOT_FINISHED, cur);
+                return(-1);
+            }
+            if (!lexer->seenRoot) {
+                xmlLexerErr(lexer, XML_ERR_DOCUMENT_EMPTY, cur);
+                return(-1);
+            }
+        }
+        lexer->state = XML_LEX_DONE;
+        return(0);
+    }
+
+    if (*cur == '&') {
+        const xmlChar *end;
+
+        if ((lexer->options & XML_LEXER_WELL_FORMED) &&
+            (lexer->nbNames == 0))
+            return(xmlLexerErrOutside(lexer, cur));
+        end = xmlLexerScanRef(lexer, cur);
+        if (end == NULL)
+            return(-1);
+        lexer->cur = end;
+        return(xmlLexerToken(lexer, token, XML_TOKEN_REFERENCE, cur, end));
+    }
+
+    if (*cur != '<')
+        return(xmlLexerText(lexer, token));
+
+    if (cur[1] == '/')
+        return(xmlLexerEndTag(lexer, token));
+    if (cur[1] == '?')
+        return(xmlLexerPI(lexer, token));
+    if (cur[1] == '!') {
+        if (CMP4(cur, '<', '!', '-', '-'))
+            return(xmlLexerComment(lexer, token));
+        if (CMP9(cur, '<', '!', '[', 'C', 'D', 'A', 'T', 'A', '['))
+            return(xmlLexerCDSect(lexer, token));
+        if (CMP9(cur, '<', '!', 'D', 'O', 'C', 'T', 'Y', 'P', 'E'))
+            return(xmlLexerDoctype(lexer, token));
+        xmlLexerErr(lexer, XML_ERR_NAME_REQUIRED, cur + 1);
+        return(-1);
+    }
+
+    return(xmlLexerStartTag(lexer, token));
+}
+
+/**
+ * Return the error which stopped the lexer.
+ *
+ * @since 2.15.0
+ *
+ * @param lexer  the lexer
+ * @param offset  offset in bytes where the error was found (output,
+ * optional)
+ * @returns an xmlParserErrors code or XML_ERR_OK if there was no
+ * error
+ */
+xmlParserErrors
+xmlLexerGetError(xmlLexer *lexer, size_t *offset) {
+    if (lexer == NULL)
+        return(XML_ERR_ARGUMENT);
+
+    if (offset != NULL)
+        *offset = lexer->errorOffset;
+    return(lexer->error);
+}
+
+/************************************************************************
+ *									*
+ *		Well-formedness check					*
+ *									*
+ ************************************************************************/
+
+/*
+ * Report an error found by the lexer at `ptr` in the current input.
+ */
+static void
+xmlCheckErr(xmlParserCtxtPtr ctxt, xmlParserErrors code,
+            const xmlChar *ptr) {
+    xmlParserInputPtr input = ctxt->input;
+    const xmlChar *cur = input->cur;
+    const xmlChar *lineStart = cur;
+    int line = input->line;
+    int col = 1;
+
+    while (cur < ptr) {
+        cur = memchr(cur, 0xA, ptr - cur);
+        if (cur == NULL)
+            break;
+        line++;
+        lineStart = ++cur;
+    }
+    for (cur = lineStart; cur < ptr; cur++) {
+        if ((*cur & 0xC0) != 0x80)
+            col++;
+    }
+
+    input->cur = ptr;
+    input->line = line;
+    input->col = col;
+    xmlFatalErr(ctxt, code, NULL);
+}
+
+/*
+ * Check a document with the lexer. Returns 0 if the document was
+ * checked, -1 if it must be parsed with the regular parser.
+ */
+static int
+xmlCheckWellFormedLexer(xmlParserCtxtPtr ctxt) {
+    xmlParserInputPtr input = ctxt->input;
+    xmlLexer lexer;
+    xmlToken token;
+    size_t maxLength;
+    int huge = (ctxt->options & XML_PARSE_HUGE) ? 1 : 0;
+    int res;
+
+    if ((ctxt->html) || (ctxt->options & XML_PARSE_OLD10) ||
+        (input->buf == NULL) || (input->buf->encoder != NULL) ||
+        (input->flags & XML_INPUT_HAS_ENCODING) ||
+        (xmlLoadWholeInput(ctxt, XML_MAX_HUGE_LENGTH) < 0) ||
+        (*input->end != 0))
+        return(-1);
+
+    xmlLexerInit(&lexer, input->cur, input->end - input->cur,
+                 XML_LEXER_WELL_FORMED | XML_LEXER_ZERO_TERMINATED);
+    lexer.maxDepth = huge ? 2048 : 256;
+    maxLength = huge ? XML_MAX_HUGE_LENGTH : XML_MAX_TEXT_LENGTH;
+
+    /* Leave encoding detection to the regular parser */
+    if ((lexer.error != XML_ERR_OK) ||
+        ((*lexer.cur != '<') && (!IS_BLANK_CH(*lexer.cur))))
+        return(-1);
+
+    /* Only the plain form of the XML declaration is handled */
+    if ((CMP5(lexer.cur, '<', '?', 'x', 'm', 'l')) &&
+        (IS_BLANK_CH(lexer.cur[5]))) {
+        xmlIndexParser ip;
+
+        memset(&ip, 0, sizeof(ip));
+        ip.cur = lexer.cur;
+        if (xmlIndexParseXMLDecl(&ip) < 0)
+            return(-1);
+        lexer.cur = ip.cur;
+    }
+
+    /*
+     * Documents with a DTD and tokens exceeding the limits of the
+     * regular parser are passed on.
+     */
+    while ((res = xmlLexerNext(&lexer, &token)) > 0) {
+        if ((token.type == XML_TOKEN_DOCTYPE) ||
+            ((token.type != XML_TOKEN_TEXT) && (token.length > maxLength)))
+            break;
+    }
+
+    if (res < 0) {
+        if ((lexer.seenDoctype) ||
+            (lexer.error == XML_ERR_UNSUPPORTED_ENCODING) ||
+            ((lexer.error == XML_ERR_NAME_TOO_LONG) && (huge)))
+            res = 1;
+        else if (lexer.error == XML_ERR_NO_MEMORY)
+            xmlCtxtErrMemory(ctxt);
+        else
+            xmlCheckErr(ctxt, lexer.error, lexer.base + lexer.errorOffset);
+    }
+
+    xmlLexerCleanup(&lexer);
+    return(res > 0 ? -1 : 0);
+}
+
+/*
+ * Set up a SAX handler which only keeps the DTD and entity declarations
+ * needed to check entity references and reports errors like `sax`.
+ */
+static void
+xmlCheckWellFormedSAX(xmlSAXHandler *hdlr, const xmlSAXHandler *sax) {
+    memset(hdlr, 0, sizeof(*hdlr));
+    hdlr->initialized = XML_SAX2_MAGIC;
+
+    hdlr->internalSubset = xmlSAX2InternalSubset;
+    hdlr->externalSubset = xmlSAX2ExternalSubset;
+    hdlr->isStandalone = xmlSAX2IsStandalone;
+    hdlr->hasInternalSubset = xmlSAX2HasInternalSubset;
+    hdlr->hasExternalSubset = xmlSAX2HasExternalSubset;
+    hdlr->resolveEntity = xmlSAX2ResolveEntity;
+    hdlr->getEntity = xmlSAX2GetEntity;
+    hdlr->getParameterEntity = xmlSAX2GetParameterEntity;
+    hdlr->entityDecl = xmlSAX2EntityDecl;
+    hdlr->unparsedEntityDecl = xmlSAX2UnparsedEntityDecl;
+    hdlr->startDocument = xmlSAX2StartDocument;
+    hdlr->endDocument = xmlSAX2EndDocument;
+
+    if (sax != NULL) {
+        hdlr->warning = sax->warning;
+        hdlr->error = sax->error;
+        hdlr->fatalError = sax->fatalError;
+        if (sax->initialized == XML_SAX2_MAGIC)
+            hdlr->serror = sax->serror;
+    }
+}
+
+/**
+ * Check whether a document is well-formed without building a tree
+ * or calling SAX handlers. Takes ownership of the input object.
+ *
+ * Documents in UTF-8 without a document type declaration are checked
+ * with the lexer (see #xmlNewLexer) which doesn't intern names or
+ * copy strings. Other documents are parsed with the regular parser
+ * using SAX callbacks which only record DTD and entity declarations.
+ * Errors are reported like parser errors. Namespace errors don't make
+ * a document malformed.
+ *
+ * The lexer only reports the first error. It is found at the same
+ * position as the first fatal error of the regular parser in most
+ * cases, but its error code can differ, for example for invalid
+ * characters in CDATA sections. Unterminated comments, CDATA sections
+ * and processing instructions are reported at the end of the input.
+ *
+ * Options must be set with #xmlCtxtUseOptions.
+ *
+ * @since 2.15.0
+ *
+ * @param ctxt  an XML parser context
+ * @param input  parser input
+ * @returns 1 if the document is well-formed, 0 if it isn't or if an
+ * error occurred. See #xmlCtxtGetLastError.
+ */
+int
+xmlCtxtCheckWellFormed(xmlParserCtxt *ctxt, xmlParserInput *input) {
+    int ret;
+
+    if ((ctxt == NULL) || (input == NULL)) {
+        xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
+        xmlFreeInputStream(input);
+        return(0);
+    }
+
+    xmlCtxtReset(ctxt);
+
+    if (xmlCtxtPushInput(ctxt, input) < 0) {
+        xmlFreeInputStream(input);
+        return(0);
+    }
+
+    if (xmlCheckWellFormedLexer(ctxt) < 0) {
+        xmlSAXHandler hdlr;
+        xmlSAXHandler *sax = ctxt->sax;
+
+        xmlCheckWellFormedSAX(&hdlr, sax);
+        ctxt->sax = &hdlr;
+        xmlParseDocument(ctxt);
+        ctxt->sax = sax;
+
+        /* Only holds the DTD */
+        if (ctxt->myDoc != NULL) {
+            xmlFreeDoc(ctxt->myDoc);
+            ctxt->myDoc = NULL;
+        }
+    }
+
+    ret = ctxt->wellFormed ? 1 : 0;
+
+    while (ctxt->inputNr > 0)
+        xmlFreeInputStream(xmlCtxtPopInput(ctxt));
+
+    return(ret);
+}
+
+/**
+ * parse a general parsed entity
+ * An external general parsed entity is well-formed if it matches the
+ * production labeled extParsedEnt.
+ *
+ * @deprecated Internal function, don't use.
+ *
+ *     [78] extParsedEnt ::= TextDecl? content
+ *
+ * @param ctxt  an XML parser context
+ * @returns 0, -1 in case of error. the parser context is augmented
+ *                as a result of the parsing.
+ */
+
+int
+xmlParseExtParsedEnt(xmlParserCtxt *ctxt) {
+    if ((ctxt == NULL) || (ctxt->input == NULL))
+        return(-1);
+
+    xmlCtxtInitializeLate(ctxt);
+
+    if ((ctxt->sax) && (ctxt->sax->setDocumentLocator)) {
+        ctxt->sax->setDocumentLocator(ctxt->userData,
+                (xmlSAXLocator *) &xmlDefaultSAXLocator);
+    }
+
+    xmlDetectEncoding(ctxt);
+
+    if (CUR == 0) {
+	xmlFatalErr(ctxt, XML_ERR_DOCUMENT_EMPTY, NULL);
+    }
+
+    /*
+     * Check for the XMLDecl in the Prolog.
+     */
+    GROW;
+    if ((CMP5(CUR_PTR, '<', '?', 'x', 'm', 'l')) && (IS_BLANK_CH(NXT(5)))) {
+
+	/*
+	 * Note that we will switch encoding on the fly.
+	 */
+	xmlParseXMLDecl(ctxt);
+	SKIP_BLANKS;
+    } else {
+	ctxt->version = xmlCharStrdup(XML_DEFAULT_VERSION);
+    }
+    if ((ctxt->sax) && (ctxt->sax->startDocument) && (!ctxt->disableSAX))
+        ctxt->sax->startDocument(ctxt->userData);
+
+    /*
+     * Doing validity checking on chunk doesn't make sense
+     */
+    ctxt->options &= ~XML_PARSE_DTDVALID;
+    ctxt->validate = 0;
+    ctxt->depth = 0;
+
+    xmlParseContentInternal(ctxt);
+
+    if (ctxt->input->cur < ctxt->input->end)
+	xmlFatalErr(ctxt, XML_ERR_NOT_WELL_BALANCED, NULL);
+
+    /*
+     * SAX: end of the document processing.
+     */
+    if ((ctxt->sax) && (ctxt->sax->endDocument != NULL))
+        ctxt->sax->endDocument(ctxt->userData);
+
+    if (! ctxt->wellFormed) return(-1);
+    return(0);
+}
+
+#ifdef LIBXML_PUSH_ENABLED
+/************************************************************************
+ *									*
+ *		Progressive parsing interfaces				*
+ *									*
+ ************************************************************************/
+
+/**
+ * Check whether the input buffer contains a character.
+ *
+ * @param ctxt  an XML parser context
+ * @param c  character
+ */
+static int
+xmlParseLookupChar(xmlParserCtxtPtr ctxt, int c) {
+    const xmlChar *cur;
+
+    if (ctxt->checkIndex == 0) {
+        cur = ctxt->input->cur + 1;
+    } else {
+        cur = ctxt->input->cur + ctxt->checkIndex;
+    }
+
+    if (memchr(cur, c, ctxt->input->end - cur) == NULL) {
+        size_t index = ctxt->input->end - ctxt->input->cur;
+
+        if (index > LONG_MAX) {
+            ctxt->checkIndex = 0;
+            return(1);
+        }
+        ctxt->checkIndex = index;
+        return(0);
+    } else {
+        ctxt->checkIndex = 0;
+        return(1);
+    }
+}
+
+/**
+ * Check whether the input buffer contains a string.
+ *
+ * @param ctxt  an XML parser context
+ * @param startDelta  delta to apply at the start
+ * @param str  string
+ * @param strLen  length of string
+ */
+static const xmlChar *
+xmlParseLookupString(xmlParserCtxtPtr ctxt, size_t startDelta,
+                     const char *str, size_t strLen) {
+    const xmlChar *cur, *term;
+    const xmlChar *end = ctxt->input->end;
+    size_t index;
 
     if (ctxt->checkIndex == 0) {
         cur = ctxt->input->cur + startDelta;
@@ -10607,27 +13397,36 @@ xmlParseLookupString(xmlParserCtxtPtr ctxt, size_t startDelta,
         cur = ctxt->input->cur + ctxt->checkIndex;
     }
 
-    term = BAD_CAST strstr((const char *) cur, str);
-    if (term == NULL) {
-        const xmlChar *end = ctxt->input->end;
-        size_t index;
-
-        /* Rescan (strLen - 1) characters. */
-        if ((size_t) (end - cur) < strLen)
-            end = cur;
-        else
-            end -= strLen - 1;
-        index = end - ctxt->input->cur;
-        if (index > LONG_MAX) {
+    /*
+     * Only stop at candidates for the first character, so every byte
+     * is examined once. A candidate too close to the end is where the
+     * next lookup resumes.
+     */
+    while (cur < end) {
+        term = memchr(cur, str[0], end - cur);
+        if (term == NULL) {
+            cur = end;
+            break;
+        }
+        if ((size_t) (end - term) < strLen) {
+            cur = term;
+            break;
+        }
+        if (memcmp(term, str, strLen) == 0) {
             ctxt->checkIndex = 0;
-            return(ctxt->input->end - strLen);
+            return(term);
         }
-        ctxt->checkIndex = index;
-    } else {
+        cur = term + 1;
+    }
+
+    index = cur - ctxt->input->cur;
+    if (index > LONG_MAX) {
         ctxt->checkIndex = 0;
+        return(ctxt->input->end - strLen);
     }
+    ctxt->checkIndex = index;
 
-    return(term);
+    return(NULL);
 }
 
 /**
@@ -11243,8 +14042,10 @@ xmlParseChunk(xmlParserCtxt *ctxt, const char *chunk, int size,
         return(ctxt->errNo);
 
     ctxt->input->flags |= XML_INPUT_PROGRESSIVE;
-    if (ctxt->instate == XML_PARSER_START)
+    if (ctxt->instate == XML_PARSER_START) {
         xmlCtxtInitializeLate(ctxt);
+        xmlCtxtInitLineIndex(ctxt);
+    }
     if ((size > 0) && (chunk != NULL) && (!terminate) &&
         (chunk[size - 1] == '\r')) {
 	end_in_lf = 1;
@@ -11989,121 +14790,608 @@ xmlCtxtParseContent(xmlParserCtxt *ctxt, xmlParserInput *input,
     xmlDictPtr oldDict;
     int oldOptions, oldDictNames, oldLoadSubset;
 
-    if ((ctxt == NULL) || (input == NULL) || (node == NULL)) {
-        xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
-        goto exit;
+    if ((ctxt == NULL) || (input == NULL) || (node == NULL)) {
+        xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
+        goto exit;
+    }
+
+    doc = node->doc;
+    if (doc == NULL) {
+        xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
+        goto exit;
+    }
+
+    switch (node->type) {
+        case XML_ELEMENT_NODE:
+        case XML_DOCUMENT_NODE:
+        case XML_HTML_DOCUMENT_NODE:
+            break;
+
+        case XML_ATTRIBUTE_NODE:
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+        case XML_ENTITY_REF_NODE:
+        case XML_PI_NODE:
+        case XML_COMMENT_NODE:
+            for (cur = node->parent; cur != NULL; cur = node->parent) {
+                if ((cur->type == XML_ELEMENT_NODE) ||
+                    (cur->type == XML_DOCUMENT_NODE) ||
+                    (cur->type == XML_HTML_DOCUMENT_NODE)) {
+                    node = cur;
+                    break;
+                }
+            }
+            break;
+
+        default:
+            xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
+            goto exit;
+    }
+
+#ifdef LIBXML_HTML_ENABLED
+    if (ctxt->html)
+        htmlCtxtReset(ctxt);
+    else
+#endif
+        xmlCtxtReset(ctxt);
+
+    oldDict = ctxt->dict;
+    oldOptions = ctxt->options;
+    oldDictNames = ctxt->dictNames;
+    oldLoadSubset = ctxt->loadsubset;
+
+    /*
+     * Use input doc's dict if present, else assure XML_PARSE_NODICT is set.
+     */
+    if (doc->dict != NULL) {
+        ctxt->dict = doc->dict;
+    } else {
+        ctxt->options |= XML_PARSE_NODICT;
+        ctxt->dictNames = 0;
+    }
+
+    /*
+     * Disable IDs
+     */
+    ctxt->loadsubset |= XML_SKIP_IDS;
+
+    ctxt->myDoc = doc;
+
+#ifdef LIBXML_HTML_ENABLED
+    if (ctxt->html) {
+        /*
+         * When parsing in context, it makes no sense to add implied
+         * elements like html/body/etc...
+         */
+        ctxt->options |= HTML_PARSE_NOIMPLIED;
+
+        list = htmlCtxtParseContentInternal(ctxt, input);
+    } else
+#endif
+    {
+        xmlCtxtInitializeLate(ctxt);
+
+        /*
+         * initialize the SAX2 namespaces stack
+         */
+        cur = node;
+        while ((cur != NULL) && (cur->type == XML_ELEMENT_NODE)) {
+            xmlNsPtr ns = cur->nsDef;
+            xmlHashedString hprefix, huri;
+
+            while (ns != NULL) {
+                hprefix = xmlDictLookupHashed(ctxt->dict, ns->prefix, -1);
+                huri = xmlDictLookupHashed(ctxt->dict, ns->href, -1);
+                if (xmlParserNsPush(ctxt, &hprefix, &huri, ns, 1) > 0)
+                    nsnr++;
+                ns = ns->next;
+            }
+            cur = cur->parent;
+        }
+
+        list = xmlCtxtParseContentInternal(ctxt, input, hasTextDecl, 1);
+
+        if (nsnr > 0)
+            xmlParserNsPop(ctxt, nsnr);
+    }
+
+    ctxt->dict = oldDict;
+    ctxt->options = oldOptions;
+    ctxt->dictNames = oldDictNames;
+    ctxt->loadsubset = oldLoadSubset;
+    ctxt->myDoc = NULL;
+    ctxt->node = NULL;
+
+exit:
+    xmlFreeInputStream(input);
+    return(list);
+}
+
+/************************************************************************
+ *									*
+ *		Parallel parsing of the root element			*
+ *									*
+ ************************************************************************/
+
+/*
+ * The content of the root element is split speculatively at start tags
+ * which look like siblings of its first child element. The chunks are
+ * parsed by worker threads, each with its own parser context and a
+ * sub-dictionary of the document's dictionary. If every chunk turned
+ * out to be well-balanced and free of errors and warnings, the result
+ * is the same as that of a sequential parse and the node lists are
+ * stitched under the root element. Otherwise, the results are
+ * discarded and the content is parsed sequentially, reporting errors
+ * in the usual way.
+ */
+
+#define XML_PARALLEL_MIN_CHUNK (256 * 1024)
+
+typedef struct {
+    xmlParserCtxtPtr ctxt;
+    const xmlChar *start;
+    const xmlChar *end;
+    int line;
+    xmlDictPtr dict;
+    xmlArena *arena;
+    xmlNodePtr list;
+    /* XML namespace of the scratch document used by the list */
+    xmlNsPtr oldNs;
+    int failed;
+    int started;
+    xmlThread thread;
+} xmlParallelChunk;
+
+/*
+ * Check whether the content of the root element can be parsed in
+ * parallel with the same result as the regular parser.
+ */
+static int
+xmlParallelUsable(xmlParserCtxtPtr ctxt) {
+#ifdef LIBXML_THREAD_ENABLED
+    xmlParserInputPtr input = ctxt->input;
+    xmlDocPtr doc = ctxt->myDoc;
+
+    if ((ctxt->maxThreads < 2) || (ctxt->inputNr != 1) ||
+        (ctxt->nameNr != 1) || (ctxt->nodeNr != 1) ||
+        (ctxt->node == NULL) || (ctxt->dict == NULL) ||
+        (ctxt->userData != ctxt) || (!ctxt->wellFormed) ||
+        (PARSER_STOPPED(ctxt)) || (PARSER_PROGRESSIVE(ctxt)))
+        return(0);
+    /* Without a DTD, there are no entities, default attributes or IDs */
+    if ((doc == NULL) || (doc->intSubset != NULL) ||
+        (doc->extSubset != NULL) || (ctxt->inSubset != 0))
+        return(0);
+    if ((ctxt->html) || (ctxt->validate) || (ctxt->record_info) ||
+        (!ctxt->keepBlanks) ||
+        (ctxt->options & (XML_PARSE_SAX1 | XML_PARSE_OLDSAX |
+                          XML_PARSE_OFFSETS)))
+        return(0);
+    /* Nodes of a discarded partial result must not be seen */
+    if (xmlRegisterCallbacks)
+        return(0);
+    if ((input->buf == NULL) || (input->buf->encoder != NULL) ||
+        (input->entity != NULL))
+        return(0);
+
+    return(xmlIsDefaultSAX2(ctxt->sax));
+#else
+    (void) ctxt;
+    return(0);
+#endif
+}
+
+/*
+ * Find the start of the next sibling `name` element at or after `cur`.
+ */
+static const xmlChar *
+xmlParallelFindSplit(const xmlChar *cur, const xmlChar *end,
+                     const xmlChar *name, size_t len) {
+    while ((size_t) (end - cur) > len + 1) {
+        const xmlChar *p = memchr(cur, '<', end - cur - len - 1);
+        xmlChar c;
+
+        if (p == NULL)
+            break;
+        c = p[len + 1];
+        if ((memcmp(p + 1, name, len) == 0) &&
+            ((IS_BLANK_CH(c)) || (c == '>') || (c == '/')))
+            return(p);
+        cur = p + 1;
+    }
+
+    return(NULL);
+}
+
+/*
+ * Count line breaks. Single CRs are only counted as line break in some
+ * places by the parser, so chunks containing them can't be parsed in
+ * parallel.
+ */
+static void
+xmlParallelCountLines(void *arg) {
+    xmlParallelChunk *chunk = arg;
+    const xmlChar *cur = chunk->start;
+    const xmlChar *end = chunk->end;
+    int line = 0;
+
+    while ((cur = memchr(cur, '\n', end - cur)) != NULL) {
+        line++;
+        cur++;
+    }
+
+    cur = chunk->start;
+    while ((cur = memchr(cur, '\r', end - cur)) != NULL) {
+        cur++;
+        if ((cur >= end) || (*cur != '\n')) {
+            chunk->failed = 1;
+            break;
+        }
+    }
+
+    chunk->line = line;
+}
+
+static void
+xmlParallelSetDoc(xmlNodePtr list, xmlDocPtr doc) {
+    xmlNodePtr cur = list;
+
+    while (cur != NULL) {
+        cur->doc = doc;
+
+        if (cur->type == XML_ELEMENT_NODE) {
+            xmlAttrPtr attr;
+            xmlNodePtr text;
+
+            for (attr = cur->properties; attr != NULL; attr = attr->next) {
+                attr->doc = doc;
+                for (text = attr->children; text != NULL; text = text->next)
+                    text->doc = doc;
+            }
+
+            if (cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+        }
+
+        while (cur->next == NULL) {
+            cur = cur->parent;
+            if (cur == NULL)
+                return;
+        }
+        cur = cur->next;
+    }
+}
+
+/*
+ * Make the nodes of `list` use the XML namespace declaration of the
+ * document of `root` instead of `oldNs`.
+ */
+static int
+xmlParallelFixXmlNs(xmlNodePtr list, xmlNsPtr oldNs, xmlNodePtr root) {
+    xmlNodePtr cur = list;
+    xmlNsPtr ns;
+
+    if (xmlSearchNsSafe(root, BAD_CAST "xml", &ns) < 0)
+        return(-1);
+
+    while (cur != NULL) {
+        if (cur->type == XML_ELEMENT_NODE) {
+            xmlAttrPtr attr;
+
+            if (cur->ns == oldNs)
+                cur->ns = ns;
+            for (attr = cur->properties; attr != NULL; attr = attr->next) {
+                if (attr->ns == oldNs)
+                    attr->ns = ns;
+            }
+
+            if (cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+        }
+
+        while (cur->next == NULL) {
+            cur = cur->parent;
+            if (cur == NULL)
+                return(0);
+        }
+        cur = cur->next;
+    }
+
+    return(0);
+}
+
+/*
+ * Parse a chunk in a worker thread. The tree is built in a scratch
+ * document using the chunk's dictionary, so that nothing shared is
+ * modified.
+ */
+static void
+xmlParallelParseChunk(void *arg) {
+    xmlParallelChunk *chunk = arg;
+    xmlParserCtxtPtr ctxt = chunk->ctxt;
+    xmlParserCtxtPtr wctxt;
+    xmlParserInputPtr input;
+    xmlDocPtr doc = NULL;
+    xmlNsPtr ns;
+    xmlNodePtr list = NULL;
+    int nsnr = 0;
+
+    chunk->failed = 1;
+
+    wctxt = xmlNewParserCtxt();
+    if (wctxt == NULL)
+        return;
+    xmlCtxtSetDict(wctxt, chunk->dict);
+    /* Errors are reported by the sequential parse */
+    xmlCtxtSetOptions(wctxt, ctxt->options | XML_PARSE_NOERROR |
+                             XML_PARSE_NOWARNING);
+    wctxt->maxAmpl = ctxt->maxAmpl;
+
+    doc = xmlNewDoc(NULL);
+    if (doc == NULL)
+        goto done;
+    if (ctxt->myDoc->dict != NULL) {
+        doc->dict = chunk->dict;
+        xmlDictReference(doc->dict);
+    }
+    if ((ctxt->myDoc->arena != NULL) && (xmlDocEnableArena(doc) < 0))
+        goto done;
+    wctxt->myDoc = doc;
+
+    xmlCtxtInitializeLate(wctxt);
+
+    for (ns = ctxt->node->nsDef; ns != NULL; ns = ns->next) {
+        xmlHashedString hprefix, huri;
+
+        hprefix = xmlDictLookupHashed(wctxt->dict, ns->prefix, -1);
+        huri = xmlDictLookupHashed(wctxt->dict, ns->href, -1);
+        if (xmlParserNsPush(wctxt, &hprefix, &huri, ns, 1) > 0)
+            nsnr++;
     }
 
-    doc = node->doc;
-    if (doc == NULL) {
-        xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
-        goto exit;
+    input = xmlCtxtNewInputFromMemory(wctxt, NULL, chunk->start,
+                                      chunk->end - chunk->start, NULL,
+                                      XML_INPUT_BUF_STATIC);
+    if (input == NULL)
+        goto done;
+    input->line = chunk->line;
+
+    list = xmlCtxtParseContentInternal(wctxt, input, 0, 1);
+    xmlFreeInputStream(input);
+
+    if (nsnr > 0)
+        xmlParserNsPop(wctxt, nsnr);
+
+    /* IDs would have to be moved to the document */
+    if ((!wctxt->wellFormed) || (wctxt->nbErrors != 0) ||
+        (wctxt->nbWarnings != 0) || (doc->ids != NULL) ||
+        (doc->refs != NULL)) {
+        xmlFreeNodeList(list);
+        list = NULL;
     }
 
-    switch (node->type) {
-        case XML_ELEMENT_NODE:
-        case XML_DOCUMENT_NODE:
-        case XML_HTML_DOCUMENT_NODE:
-            break;
+    if (list != NULL) {
+        xmlParallelSetDoc(list, ctxt->myDoc);
+        /* xml: attributes reference it, replaced when stitching */
+        chunk->oldNs = doc->oldNs;
+        doc->oldNs = NULL;
+        chunk->list = list;
+        chunk->failed = 0;
+    }
 
-        case XML_ATTRIBUTE_NODE:
-        case XML_TEXT_NODE:
-        case XML_CDATA_SECTION_NODE:
-        case XML_ENTITY_REF_NODE:
-        case XML_PI_NODE:
-        case XML_COMMENT_NODE:
-            for (cur = node->parent; cur != NULL; cur = node->parent) {
-                if ((cur->type == XML_ELEMENT_NODE) ||
-                    (cur->type == XML_DOCUMENT_NODE) ||
-                    (cur->type == XML_HTML_DOCUMENT_NODE)) {
-                    node = cur;
-                    break;
-                }
-            }
-            break;
+done:
+    wctxt->myDoc = NULL;
+    xmlFreeParserCtxt(wctxt);
+    /* The nodes are allocated from the arena of the scratch document */
+    if (doc != NULL)
+        chunk->arena = xmlDocTakeArena(doc);
+    xmlFreeDoc(doc);
+}
 
-        default:
-            xmlFatalErr(ctxt, XML_ERR_ARGUMENT, NULL);
-            goto exit;
+/*
+ * Run `func` for all chunks, each in its own thread if possible.
+ */
+static void
+xmlParallelRun(xmlParallelChunk *chunks, int nbChunks, xmlThreadFunc func) {
+    int i;
+
+    for (i = 0; i < nbChunks; i++)
+        chunks[i].started =
+            (xmlThreadCreate(&chunks[i].thread, func, &chunks[i]) == 0);
+
+    for (i = 0; i < nbChunks; i++) {
+        if (chunks[i].started)
+            xmlThreadJoin(&chunks[i].thread);
+        else
+            func(&chunks[i]);
     }
+}
 
-#ifdef LIBXML_HTML_ENABLED
-    if (ctxt->html)
-        htmlCtxtReset(ctxt);
-    else
-#endif
-        xmlCtxtReset(ctxt);
+/*
+ * Parse the content of the root element in parallel. On success, the
+ * input is positioned at the end tag of the root element. Returns 0 if
+ * the content was parsed, -1 if it must be parsed sequentially.
+ */
+static int
+xmlParseContentParallel(xmlParserCtxtPtr ctxt) {
+    xmlParserInputPtr input = ctxt->input;
+    xmlNodePtr root = ctxt->node;
+    xmlParallelChunk *chunks = NULL;
+    const xmlChar *begin, *end, *cur, *name;
+    size_t size, nameLen, limit;
+    int nbChunks, n, i, line, col;
+    int ret = -1;
 
-    oldDict = ctxt->dict;
-    oldOptions = ctxt->options;
-    oldDictNames = ctxt->dictNames;
-    oldLoadSubset = ctxt->loadsubset;
+    if (!xmlParallelUsable(ctxt))
+        return(-1);
+
+    limit = (ctxt->options & XML_PARSE_HUGE) ?
+            SIZE_MAX :
+            XML_MAX_HUGE_LENGTH;
+    if (xmlLoadWholeInput(ctxt, limit) < 0)
+        return(-1);
+
+    begin = input->cur;
+    end = input->end;
+    if (*end != 0)
+        return(-1);
 
     /*
-     * Use input doc's dict if present, else assure XML_PARSE_NODICT is set.
+     * Assume that the last end tag closes the root element. If it
+     * doesn't, the last chunk contains an unmatched end tag.
      */
-    if (doc->dict != NULL) {
-        ctxt->dict = doc->dict;
-    } else {
-        ctxt->options |= XML_PARSE_NODICT;
-        ctxt->dictNames = 0;
+    do {
+        if (end - begin < 2)
+            return(-1);
+        end--;
+    } while ((end[0] != '<') || (end[1] != '/'));
+
+    size = end - begin;
+    if (size / XML_PARALLEL_MIN_CHUNK < (size_t) ctxt->maxThreads)
+        nbChunks = size / XML_PARALLEL_MIN_CHUNK;
+    else
+        nbChunks = ctxt->maxThreads;
+    if (nbChunks < 2)
+        return(-1);
+
+    /* Records usually share the name of the first child element */
+    cur = memchr(begin, '<', size);
+    while ((cur != NULL) && ((cur[1] == '!') || (cur[1] == '?')))
+        cur = memchr(cur + 1, '<', end - cur - 1);
+    if ((cur == NULL) || (cur[1] == '/'))
+        return(-1);
+    name = ++cur;
+    while ((cur < end) && (!IS_BLANK_CH(*cur)) && (*cur != '>') &&
+           (*cur != '/'))
+        cur++;
+    nameLen = cur - name;
+    if ((nameLen == 0) || (nameLen > XML_MAX_NAME_LENGTH))
+        return(-1);
+
+    chunks = xmlMalloc(nbChunks * sizeof(chunks[0]));
+    if (chunks == NULL) {
+        xmlCtxtErrMemory(ctxt);
+        return(-1);
     }
+    memset(chunks, 0, nbChunks * sizeof(chunks[0]));
 
-    /*
-     * Disable IDs
-     */
-    ctxt->loadsubset |= XML_SKIP_IDS;
+    chunks[0].start = begin;
+    n = 1;
+    for (i = 1; i < nbChunks; i++) {
+        const xmlChar *split;
 
-    ctxt->myDoc = doc;
+        split = xmlParallelFindSplit(begin + size / nbChunks * i, end,
+                                     name, nameLen);
+        if (split == NULL)
+            break;
+        if (split > chunks[n - 1].start)
+            chunks[n++].start = split;
+    }
+    if (n < 2)
+        goto done;
 
-#ifdef LIBXML_HTML_ENABLED
-    if (ctxt->html) {
-        /*
-         * When parsing in context, it makes no sense to add implied
-         * elements like html/body/etc...
-         */
-        ctxt->options |= HTML_PARSE_NOIMPLIED;
+    for (i = 0; i < n; i++) {
+        chunks[i].ctxt = ctxt;
+        chunks[i].end = (i + 1 < n) ? chunks[i + 1].start : end;
+    }
 
-        list = htmlCtxtParseContentInternal(ctxt, input);
-    } else
-#endif
-    {
-        xmlCtxtInitializeLate(ctxt);
+    xmlParallelRun(chunks, n, xmlParallelCountLines);
 
-        /*
-         * initialize the SAX2 namespaces stack
-         */
-        cur = node;
-        while ((cur != NULL) && (cur->type == XML_ELEMENT_NODE)) {
-            xmlNsPtr ns = cur->nsDef;
-            xmlHashedString hprefix, huri;
+    line = input->line;
+    for (i = 0; i < n; i++) {
+        int count = chunks[i].line;
 
-            while (ns != NULL) {
-                hprefix = xmlDictLookupHashed(ctxt->dict, ns->prefix, -1);
-                huri = xmlDictLookupHashed(ctxt->dict, ns->href, -1);
-                if (xmlParserNsPush(ctxt, &hprefix, &huri, ns, 1) > 0)
-                    nsnr++;
-                ns = ns->next;
-            }
-            cur = cur->parent;
+        if (chunks[i].failed)
+            goto done;
+
+        chunks[i].line = line;
+        line += count;
+    }
+
+    for (i = 0; i < n; i++) {
+        chunks[i].dict = xmlDictCreateSub(ctxt->dict);
+        if (chunks[i].dict == NULL) {
+            xmlCtxtErrMemory(ctxt);
+            goto done;
+        }
+    }
+
+    xmlParallelRun(chunks, n, xmlParallelParseChunk);
+
+    ret = 0;
+    for (i = 0; i < n; i++) {
+        if (chunks[i].failed)
+            ret = -1;
+        /* The nodes reference strings of the chunk dictionaries */
+        if (xmlDictMergeSub(ctxt->dict, chunks[i].dict) < 0)
+            xmlCtxtErrMemory(ctxt);
+        chunks[i].dict = NULL;
+        if (chunks[i].arena != NULL) {
+            xmlDocMergeArena(ctxt->myDoc, chunks[i].arena);
+            chunks[i].arena = NULL;
         }
+    }
 
-        list = xmlCtxtParseContentInternal(ctxt, input, hasTextDecl, 1);
+    for (i = 0; (ret == 0) && (i < n); i++) {
+        if ((chunks[i].oldNs != NULL) &&
+            (xmlParallelFixXmlNs(chunks[i].list, chunks[i].oldNs,
+                                 root) < 0)) {
+            xmlCtxtErrMemory(ctxt);
+            ret = -1;
+        }
+    }
 
-        if (nsnr > 0)
-            xmlParserNsPop(ctxt, nsnr);
+    if (ret < 0) {
+        for (i = 0; i < n; i++)
+            xmlFreeNodeList(chunks[i].list);
+        goto done;
     }
 
-    ctxt->dict = oldDict;
-    ctxt->options = oldOptions;
-    ctxt->dictNames = oldDictNames;
-    ctxt->loadsubset = oldLoadSubset;
-    ctxt->myDoc = NULL;
-    ctxt->node = NULL;
+    for (i = 0; i < n; i++) {
+        xmlNodePtr list = chunks[i].list;
 
-exit:
-    xmlFreeInputStream(input);
-    return(list);
+        if (root->last == NULL) {
+            root->children = list;
+        } else {
+            root->last->next = list;
+            list->prev = root->last;
+        }
+        for (; list != NULL; list = list->next) {
+            list->parent = root;
+            root->last = list;
+        }
+    }
+
+    /* Position after the last line break, counting characters */
+    col = 1;
+    cur = end;
+    while ((cur > begin) && (cur[-1] != '\n'))
+        cur--;
+    if (cur == begin)
+        col = input->col;
+    for (; cur < end; cur++) {
+        if ((*cur & 0xC0) != 0x80)
+            col++;
+    }
+
+    input->cur = end;
+    input->line = line;
+    input->col = col;
+    SHRINK;
+
+done:
+    for (i = 0; i < nbChunks; i++) {
+        if (chunks[i].dict != NULL)
+            xmlDictFree(chunks[i].dict);
+        if (chunks[i].oldNs != NULL)
+            xmlFreeNs(chunks[i].oldNs);
+    }
+    xmlFree(chunks);
+    return(ret);
 }
 
 /**
@@ -12991,6 +16279,9 @@ xmlCtxtReset(xmlParserCtxt *ctxt)
     if (ctxt->myDoc != NULL)
         xmlFreeDoc(ctxt->myDoc);
     ctxt->myDoc = NULL;
+    xmlLineIndexFree(ctxt->lineIndex);
+    ctxt->lineIndex = NULL;
+    ctxt->nodeOffset = 0;
 
     ctxt->standalone = -1;
     ctxt->hasExternalSubset = 0;
@@ -13008,7 +16299,6 @@ xmlCtxtReset(xmlParserCtxt *ctxt)
     ctxt->inSubset = 0;
     ctxt->errNo = XML_ERR_OK;
     ctxt->depth = 0;
-    ctxt->catalogs = NULL;
     ctxt->sizeentities = 0;
     ctxt->sizeentcopy = 0;
     xmlInitNodeInfoSeq(&ctxt->node_seq);
@@ -13026,6 +16316,7 @@ xmlCtxtReset(xmlParserCtxt *ctxt)
     if (ctxt->catalogs != NULL)
 	xmlCatalogFreeLocal(ctxt->catalogs);
 #endif
+    ctxt->catalogs = NULL;
     ctxt->nbErrors = 0;
     ctxt->nbWarnings = 0;
     if (ctxt->lastError.code != XML_ERR_OK)
@@ -13108,7 +16399,11 @@ xmlCtxtSetOptionsInternal(xmlParserCtxtPtr ctxt, int options, int keepMask)
               XML_PARSE_NO_XXE |
               XML_PARSE_UNZIP |
               XML_PARSE_NO_SYS_CATALOG |
-              XML_PARSE_CATALOG_PI;
+              XML_PARSE_CATALOG_PI |
+              XML_PARSE_INDEXED |
+              XML_PARSE_MMAP |
+              XML_PARSE_ARENA |
+              XML_PARSE_OFFSETS;
 
     ctxt->options = (ctxt->options & keepMask) | (options & allMask);
 
@@ -13255,6 +16550,238 @@ xmlCtxtSetMaxAmplification(xmlParserCtxt *ctxt, unsigned maxAmpl)
     ctxt->maxAmpl = maxAmpl;
 }
 
+/**
+ * Set the maximum number of threads used to parse a document.
+ *
+ * With more than one thread, the content of the root element of
+ * large documents is split and parsed in parallel. This requires the
+ * whole document to be loaded into memory and only applies to
+ * documents without a DTD parsed into a tree with the default SAX2
+ * handlers. If a chunk can't be parsed without errors, the content is
+ * parsed again sequentially, so the result and errors are the same as
+ * without threads.
+ *
+ * @since 2.15.0
+ *
+ * @param ctxt  an XML parser context
+ * @param maxThreads  maximum number of threads, 0 or 1 to disable
+ */
+void
+xmlCtxtSetMaxThreads(xmlParserCtxt *ctxt, int maxThreads)
+{
+    if (ctxt == NULL)
+        return;
+    ctxt->maxThreads = maxThreads;
+}
+
+/************************************************************************
+ *									*
+ *			Parser context pools				*
+ *									*
+ ************************************************************************/
+
+struct _xmlParserCtxtPool {
+    xmlMutex lock;
+    xmlParserCtxtPtr *ctxts;
+    int nbCtxts;
+    int maxCtxts;
+    int maxItems;
+};
+
+/**
+ * Create a pool of reusable parser contexts.
+ *
+ * Creating a parser context and growing its stacks while parsing
+ * costs a few dozen allocations, which dominates the time needed
+ * to parse small documents. A pool keeps released contexts together
+ * with their node, name, namespace and attribute arrays, so that
+ * parsing a stream of small messages allocates little beyond the
+ * document itself.
+ *
+ * Contexts can be acquired and released from multiple threads,
+ * but a context must only be used by one thread at a time.
+ *
+ * @since 2.15.0
+ *
+ * @param maxContexts  maximum number of idle contexts kept
+ * @param maxItems  contexts whose arrays grew beyond this number of
+ * items are freed instead of being kept, dictionaries holding more
+ * names are replaced with a new one. 0 for no limit, in which case
+ * the dictionary of a pooled context grows with every new name.
+ * @returns the new pool or NULL in case of error
+ */
+xmlParserCtxtPool *
+xmlNewParserCtxtPool(int maxContexts, int maxItems) {
+    xmlParserCtxtPool *pool;
+
+    if ((maxContexts <= 0) || (maxContexts > XML_MAX_ITEMS) ||
+        (maxItems < 0))
+        return(NULL);
+
+    pool = xmlMalloc(sizeof(*pool));
+    if (pool == NULL)
+        return(NULL);
+    memset(pool, 0, sizeof(*pool));
+
+    pool->ctxts = xmlMalloc(maxContexts * sizeof(pool->ctxts[0]));
+    if (pool->ctxts == NULL) {
+        xmlFree(pool);
+        return(NULL);
+    }
+    pool->maxCtxts = maxContexts;
+    pool->maxItems = maxItems;
+    xmlInitMutex(&pool->lock);
+
+    return(pool);
+}
+
+/**
+ * Free a parser context pool and all idle contexts. Contexts which
+ * are still in use must be freed with #xmlFreeParserCtxt.
+ *
+ * @since 2.15.0
+ *
+ * @param pool  a parser context pool
+ */
+void
+xmlFreeParserCtxtPool(xmlParserCtxtPool *pool) {
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < pool->nbCtxts; i++)
+        xmlFreeParserCtxt(pool->ctxts[i]);
+    xmlCleanupMutex(&pool->lock);
+    xmlFree(pool->ctxts);
+    xmlFree(pool);
+}
+
+/**
+ * Get a parser context from a pool. If no idle context is
+ * available, a new one is created.
+ *
+ * The context is in the same state as one returned by
+ * #xmlNewParserCtxt and can be used with the xmlCtxtRead functions
+ * or #xmlCtxtResetPush. It should be returned to the pool with
+ * #xmlParserCtxtPoolRelease.
+ *
+ * @since 2.15.0
+ *
+ * @param pool  a parser context pool
+ * @returns a parser context or NULL if a memory allocation failed
+ */
+xmlParserCtxt *
+xmlParserCtxtPoolAcquire(xmlParserCtxtPool *pool) {
+    xmlParserCtxtPtr ctxt = NULL;
+
+    if (pool == NULL)
+        return(NULL);
+
+    xmlMutexLock(&pool->lock);
+    if (pool->nbCtxts > 0)
+        ctxt = pool->ctxts[--pool->nbCtxts];
+    xmlMutexUnlock(&pool->lock);
+
+    if (ctxt == NULL)
+        ctxt = xmlNewParserCtxt();
+
+    return(ctxt);
+}
+
+/**
+ * @param ctxt  a reset parser context
+ * @param maxItems  maximum number of items
+ * @returns 1 if one of the arrays of the context grew beyond
+ * `maxItems`, 0 otherwise. The dictionary is checked separately.
+ */
+static int
+xmlCtxtExceedsItems(xmlParserCtxtPtr ctxt, int maxItems) {
+    unsigned max = maxItems;
+
+    if ((ctxt->inputMax > maxItems) ||
+        (ctxt->nodeMax > maxItems) ||
+        (ctxt->nameMax > maxItems) ||
+        (ctxt->spaceMax > maxItems) ||
+        (ctxt->nsMax > maxItems) ||
+        (ctxt->maxatts > maxItems) ||
+        (ctxt->nodeInfoMax > maxItems) ||
+        (ctxt->attrHashMax > max) ||
+        (ctxt->vctxt.nodeMax > maxItems) ||
+        (ctxt->vctxt.vstateMax > maxItems))
+        return(1);
+
+    if ((ctxt->nsdb != NULL) && (ctxt->nsdb->hashSize > max))
+        return(1);
+
+    return(0);
+}
+
+/**
+ * Return a parser context to a pool.
+ *
+ * The context is reset and its error handler, resource loader,
+ * encoding converter, SAX handler, private data and options are
+ * restored to their defaults. Its stacks keep their allocated size
+ * unless they grew beyond the item limit of the pool, in which case
+ * the context is freed. The document of a context is freed if it
+ * wasn't taken by the caller.
+ *
+ * If the dictionary of the context is still referenced by a parsed
+ * document, the context gets a new dictionary, so documents can
+ * be used and freed in other threads. A new dictionary is also
+ * used if the old one holds more names than the item limit.
+ *
+ * @since 2.15.0
+ *
+ * @param pool  a parser context pool
+ * @param ctxt  a parser context
+ */
+void
+xmlParserCtxtPoolRelease(xmlParserCtxtPool *pool, xmlParserCtxt *ctxt) {
+    if (ctxt == NULL)
+        return;
+    if (pool == NULL) {
+        xmlFreeParserCtxt(ctxt);
+        return;
+    }
+
+    xmlClearNodeInfoSeq(&ctxt->node_seq);
+    xmlCtxtReset(ctxt);
+
+    if ((pool->maxItems > 0) && (xmlCtxtExceedsItems(ctxt, pool->maxItems)))
+        goto drop;
+
+    if ((xmlDictIsShared(ctxt->dict)) ||
+        ((pool->maxItems > 0) &&
+         (xmlDictSize(ctxt->dict) > pool->maxItems))) {
+        xmlDictPtr dict = xmlDictCreate();
+
+        if (dict == NULL)
+            goto drop;
+        xmlCtxtSetDict(ctxt, dict);
+        xmlDictFree(dict);
+    }
+
+    xmlCtxtSetErrorHandler(ctxt, NULL, NULL);
+    xmlCtxtSetResourceLoader(ctxt, NULL, NULL);
+    xmlCtxtSetCharEncConvImpl(ctxt, NULL, NULL);
+    ctxt->_private = NULL;
+    ctxt->maxThreads = 0;
+    if (xmlInitParserCtxt(ctxt) < 0)
+        goto drop;
+
+    xmlMutexLock(&pool->lock);
+    if (pool->nbCtxts < pool->maxCtxts) {
+        pool->ctxts[pool->nbCtxts++] = ctxt;
+        ctxt = NULL;
+    }
+    xmlMutexUnlock(&pool->lock);
+
+drop:
+    xmlFreeParserCtxt(ctxt);
+}
+
 /**
  * Parse an XML document and return the resulting document tree.
  * Takes ownership of the input object.
@@ -13285,7 +16812,9 @@ xmlCtxtParseDocument(xmlParserCtxt *ctxt, xmlParserInput *input)
         return(NULL);
     }
 
-    xmlParseDocument(ctxt);
+    if (((ctxt->options & XML_PARSE_INDEXED) == 0) ||
+        (xmlParseDocumentIndexed(ctxt) < 0))
+        xmlParseDocument(ctxt);
 
     ret = xmlCtxtGetDocument(ctxt);
 
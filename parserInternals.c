@@ -40,12 +40,14 @@
 #define END(ctxt) ctxt->input->end
 
 #include "private/buf.h"
+#include "private/dict.h"
 #include "private/enc.h"
 #include "private/error.h"
 #include "private/globals.h"
 #include "private/io.h"
 #include "private/memory.h"
 #include "private/parser.h"
+#include "private/tree.h"
 
 #ifndef SIZE_MAX
   #define SIZE_MAX ((size_t) -1)
@@ -685,6 +687,14 @@ xmlParserShrink(xmlParserCtxt *ctxt) {
     used = in->cur - in->base;
 
     if (used > LINE_LEN) {
+        /* Index newlines before the input is discarded */
+        if ((ctxt->lineIndex != NULL) && (in == ctxt->inputTab[0]) &&
+            (xmlLineIndexAdd(ctxt->lineIndex, in->consumed, in->base,
+                             used - LINE_LEN) < 0)) {
+            xmlCtxtErrMemory(ctxt);
+            return;
+        }
+
         res = xmlBufShrink(buf->buffer, used - LINE_LEN);
 
         if (res > 0) {
@@ -1326,7 +1336,7 @@ xmlInputSetEncodingHandler(xmlParserInput *input,
         return(XML_ERR_OK);
     }
 
-    buf = xmlBufCreate(XML_IO_BUFFER_SIZE);
+    buf = xmlBufCreateRing(XML_IO_BUFFER_SIZE);
     if (buf == NULL) {
         xmlCharEncCloseFunc(handler);
         return(XML_ERR_NO_MEMORY);
@@ -2358,6 +2368,8 @@ xmlCheckHTTPInput(xmlParserCtxt *ctxt ATTRIBUTE_UNUSED,
  *
  * The flag XML_INPUT_UNZIP allows decompression.
  *
+ * The flag XML_INPUT_MMAP maps uncompressed files into memory.
+ *
  * The flag XML_INPUT_NETWORK allows network access.
  *
  * The following resource loaders will be called if they were
@@ -2448,6 +2460,8 @@ xmlNewInputFromFile(xmlParserCtxt *ctxt, const char *filename) {
 
     if (ctxt->options & XML_PARSE_UNZIP)
         flags |= XML_INPUT_UNZIP;
+    if (ctxt->options & XML_PARSE_MMAP)
+        flags |= XML_INPUT_MMAP;
     if ((ctxt->options & XML_PARSE_NONET) == 0)
         flags |= XML_INPUT_NETWORK;
 
@@ -2616,6 +2630,8 @@ xmlLoadResource(xmlParserCtxt *ctxt, const char *url, const char *publicId,
 
         if (ctxt->options & XML_PARSE_UNZIP)
             flags |= XML_INPUT_UNZIP;
+        if (ctxt->options & XML_PARSE_MMAP)
+            flags |= XML_INPUT_MMAP;
         if ((ctxt->options & XML_PARSE_NONET) == 0)
             flags |= XML_INPUT_NETWORK;
 
@@ -2733,8 +2749,6 @@ xmlInitSAXParserCtxt(xmlParserCtxtPtr ctxt, const xmlSAXHandler *sax,
         ctxt->userData = userData ? userData : ctxt;
     }
 
-    ctxt->maxatts = 0;
-    ctxt->atts = NULL;
     /* Allocate the Input stack */
     if (ctxt->inputTab == NULL) {
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
@@ -2893,6 +2907,7 @@ xmlFreeParserCtxt(xmlParserCtxt *ctxt)
     if (ctxt->nodeTab != NULL) xmlFree(ctxt->nodeTab);
     if (ctxt->nodeInfoTab != NULL) xmlFree(ctxt->nodeInfoTab);
     if (ctxt->inputTab != NULL) xmlFree(ctxt->inputTab);
+    xmlLineIndexFree(ctxt->lineIndex);
     if (ctxt->version != NULL) xmlFree((char *) ctxt->version);
     if (ctxt->encoding != NULL) xmlFree((char *) ctxt->encoding);
     if (ctxt->extSubURI != NULL) xmlFree((char *) ctxt->extSubURI);
@@ -3081,6 +3096,10 @@ xmlCtxtGetDict(xmlParserCtxt *ctxt) {
  * Set the dictionary. This should only be done immediately after
  * creating a parser context.
  *
+ * If `dict` was frozen with #xmlDictFreeze, the parser uses a new
+ * sub-dictionary of `dict`, so a frozen dictionary can be shared by
+ * parsers running in several threads.
+ *
  * @since 2.14.0
  *
  * @param ctxt  parser context
@@ -3088,14 +3107,28 @@ xmlCtxtGetDict(xmlParserCtxt *ctxt) {
  */
 void
 xmlCtxtSetDict(xmlParserCtxt *ctxt, xmlDict *dict) {
+    xmlDictPtr sub = NULL;
+
     if (ctxt == NULL)
         return;
 
+    if (xmlDictIsFrozen(dict)) {
+        sub = xmlDictCreateSub(dict);
+        if (sub == NULL) {
+            xmlCtxtErrMemory(ctxt);
+            return;
+        }
+    }
+
     if (ctxt->dict != NULL)
         xmlDictFree(ctxt->dict);
 
-    xmlDictReference(dict);
-    ctxt->dict = dict;
+    if (sub != NULL) {
+        ctxt->dict = sub;
+    } else {
+        xmlDictReference(dict);
+        ctxt->dict = dict;
+    }
 }
 
 /**
@@ -90,7 +90,7 @@
 /*
  * pseudo flag for the unification of HTML and XML tests
  */
-#define XML_PARSE_HTML 1 << 30
+#define XML_PARSE_HTML ((int) (1u << 31))
 
 /*
  * O_BINARY is just for Windows compatibility - if it isn't defined
@@ -2220,6 +2220,116 @@ static int memParseTest(const char *filename, const char *result,
   return (ret);
 }
 
+/**
+ * Parse a file, store the document in a snapshot, load it back and
+ * check the serialization of the loaded document.
+ *
+ * @param filename  the file to parse
+ * @param result  the file with expected result
+ * @param err  the file with error messages: unused
+ * @returns 0 in case of success, an error code otherwise
+ */
+static int snapshotParseTest(const char *filename, const char *result,
+                             const char *err ATTRIBUTE_UNUSED,
+                             int options) {
+  xmlParserCtxtPtr ctxt;
+  xmlDocPtr doc;
+  xmlChar *base = NULL;
+  int size = 0;
+  int res;
+
+  nb_tests++;
+  ctxt = xmlNewParserCtxt();
+  xmlCtxtSetErrorHandler(ctxt, testStructuredErrorHandler, NULL);
+  doc = xmlCtxtReadFile(ctxt, filename, NULL, options);
+  xmlFreeParserCtxt(ctxt);
+
+  if (doc != NULL) {
+    xmlChar *snapshot;
+    size_t snapshotSize;
+
+    res = xmlDocSnapshotMemory(doc, &snapshot, &snapshotSize);
+    xmlFreeDoc(doc);
+    if (res != 0) {
+      fprintf(stderr, "Failed to create snapshot of %s\n", filename);
+      return (-1);
+    }
+    doc = xmlReadSnapshotMemory(snapshot, snapshotSize, options);
+    xmlFree(snapshot);
+    if (doc == NULL) {
+      fprintf(stderr, "Failed to load snapshot of %s\n", filename);
+      return (-1);
+    }
+    xmlDocDumpMemory(doc, &base, &size);
+    xmlFreeDoc(doc);
+  }
+
+  res = compareFileMem(result, (char *) base, size);
+  xmlFree(base);
+  if (res != 0) {
+    fprintf(stderr, "Result for %s failed in %s\n", filename, result);
+    return (-1);
+  }
+  return (0);
+}
+
+static void
+firstFatalErrorHandler(void *ctx, const xmlError *error) {
+  int *line = ctx;
+
+  if ((*line == 0) && (error->level == XML_ERR_FATAL))
+    *line = error->line;
+}
+
+/**
+ * Check whether a file is well-formed with #xmlCtxtCheckWellFormed
+ * and compare the result and the line of the first fatal error with
+ * the regular parser.
+ *
+ * @param filename  the file to parse
+ * @param result  unused
+ * @param err  unused
+ * @returns 0 in case of success, an error code otherwise
+ */
+static int wfCheckTest(const char *filename,
+                       const char *result ATTRIBUTE_UNUSED,
+                       const char *err ATTRIBUTE_UNUSED, int options) {
+  xmlParserCtxtPtr ctxt;
+  xmlParserInputPtr input;
+  const char *base;
+  int size, wellFormed, res;
+  int line = 0, checkLine = 0;
+  int ret = 0;
+
+  nb_tests++;
+  if (loadMem(filename, &base, &size) != 0) {
+    fprintf(stderr, "Failed to load %s\n", filename);
+    return (-1);
+  }
+
+  ctxt = xmlNewParserCtxt();
+  xmlCtxtSetErrorHandler(ctxt, firstFatalErrorHandler, &line);
+  xmlFreeDoc(xmlCtxtReadMemory(ctxt, base, size, filename, NULL, options));
+  wellFormed = ctxt->wellFormed;
+
+  xmlCtxtSetErrorHandler(ctxt, firstFatalErrorHandler, &checkLine);
+  input = xmlNewInputFromMemory(filename, base, size, XML_INPUT_BUF_STATIC);
+  res = xmlCtxtCheckWellFormed(ctxt, input);
+  if (res != wellFormed) {
+    fprintf(stderr, "Well-formedness check for %s returned %d\n",
+            filename, res);
+    ret = -1;
+  } else if (checkLine != line) {
+    fprintf(stderr, "Well-formedness check for %s reported line %d, "
+            "expected %d\n", filename, checkLine, line);
+    ret = -1;
+  }
+
+  xmlFreeParserCtxt(ctxt);
+  unloadMem(base);
+  return (ret);
+}
+
 /**
  * Parse a file with entity resolution, then serialize back
  * reparse the result and serialize again, then check for deviation
@@ -2619,6 +2729,54 @@ static int streamMemParseTest(const char *filename, const char *result,
 
 static FILE *xpathOutput;
 static xmlDocPtr xpathDocument;
+static xmlXPathCompactDocPtr xpathCompactDocument;
+
+/*
+ * Check that evaluating a compiled expression over the compact copy of
+ * the document selects the same nodes as the tree evaluation.
+ */
+static void testXPathCompact(xmlXPathContextPtr ctxt,
+                             xmlXPathCompExprPtr comp,
+                             xmlXPathObjectPtr res) {
+  const xmlXPathCompactDoc *cdoc = xpathCompactDocument;
+  int *nodes;
+  int node, nbNodes, i, ok;
+
+  if (cdoc == NULL)
+    return;
+  node = xmlXPathCompactNodeFirstChild(cdoc, 0);
+  while ((node >= 0) &&
+         (xmlXPathCompactNodeType(cdoc, node) != XML_ELEMENT_NODE))
+    node = xmlXPathCompactNodeNextSibling(cdoc, node);
+  if (node < 0)
+    return;
+
+  nbNodes = xmlXPathCompactEval(ctxt, comp, cdoc, node, &nodes);
+  if (nbNodes == -2)
+    return;
+  ok = ((nbNodes >= 0) && (res != NULL) && (res->type == XPATH_NODESET) &&
+        (nbNodes == xmlXPathNodeSetGetLength(res->nodesetval)));
+  for (i = 0; (ok) && (i < nbNodes); i++) {
+    xmlNodePtr cur = res->nodesetval->nodeTab[i];
+    int type = xmlXPathCompactNodeType(cdoc, nodes[i]);
+
+    if ((int) cur->type != type) {
+      ok = 0;
+    } else if ((type == XML_ELEMENT_NODE) || (type == XML_ATTRIBUTE_NODE) ||
+               (type == XML_PI_NODE)) {
+      ok = xmlStrEqual(cur->name, xmlXPathCompactNodeName(cdoc, nodes[i]));
+    }
+    if ((ok) && (type != XML_ELEMENT_NODE) && (type != XML_DOCUMENT_NODE)) {
+      xmlChar *content = xmlNodeGetContent(cur);
+
+      ok = xmlStrEqual(content, xmlXPathCompactNodeContent(cdoc, nodes[i]));
+      xmlFree(content);
+    }
+  }
+  if (!ok)
+    fprintf(xpathOutput, "compact document mismatch\n");
+  xmlFree(nodes);
+}
 
 static void testXPath(const char *str, int xptr, int expr) {
   xmlXPathObjectPtr res;
@@ -2644,6 +2802,7 @@ static void testXPath(const char *str, int xptr, int expr) {
       comp = xmlXPathCompile(BAD_CAST str);
       if (comp != NULL) {
         res = xmlXPathCompiledEval(comp, ctxt);
+        testXPathCompact(ctxt, comp, res);
         xmlXPathFreeCompExpr(comp);
       } else
         res = NULL;
@@ -2758,6 +2917,12 @@ static int xpathDocTest(const char *filename,
     fprintf(stderr, "Failed to load %s\n", filename);
     return (-1);
   }
+  xpathCompactDocument = xmlXPathCompactDocNew(xpathDocument);
+  if (xpathCompactDocument == NULL) {
+    fprintf(stderr, "Failed to build compact document for %s\n", filename);
+    xmlFreeDoc(xpathDocument);
+    return (-1);
+  }
 
   res =
       snprintf(pattern, 499, "./test/XPath/tests/%s*", baseFilename(filename));
@@ -2773,6 +2938,8 @@ static int xpathDocTest(const char *filename,
   }
   globfree(&globbuf);
 
+  xmlXPathCompactDocFree(xpathCompactDocument);
+  xpathCompactDocument = NULL;
   xmlFreeDoc(xpathDocument);
   return (ret);
 }
@@ -4668,13 +4835,42 @@ static testDesc testDescriptions[] = {
     {"XML regression tests", oldParseTest, "./test/*", "result/", "", NULL, 0},
     {"XML regression tests on memory", memParseTest, "./test/*", "result/", "",
      NULL, 0},
+    {"XML regression tests with indexed parsing", memParseTest, "./test/*",
+     "result/", "", NULL, XML_PARSE_INDEXED},
+    {"XML regression tests with mapped files", errParseTest, "./test/*",
+     "result/", "", NULL, XML_PARSE_MMAP},
+    {"XML regression tests with arena allocation", errParseTest, "./test/*",
+     "result/", "", NULL, XML_PARSE_ARENA},
+    {"XML regression tests with node offsets", errParseTest, "./test/*",
+     "result/", "", NULL, XML_PARSE_OFFSETS},
+    {"XML well-formedness check regression tests", wfCheckTest, "./test/*",
+     NULL, NULL, NULL, 0},
     {"XML entity subst regression tests", noentParseTest, "./test/*",
      "result/noent/", "", NULL, XML_PARSE_NOENT},
+    {"XML regression tests from snapshots", snapshotParseTest, "./test/*",
+     "result/", "", NULL, 0},
+    {"XML regression tests from snapshots with arena allocation",
+     snapshotParseTest, "./test/*", "result/", "", NULL, XML_PARSE_ARENA},
+    {"XML entity subst regression tests from snapshots", snapshotParseTest,
+     "./test/*", "result/noent/", "", NULL, XML_PARSE_NOENT},
     {"XML Namespaces regression tests", errParseTest, "./test/namespaces/*",
      "result/namespaces/", "", ".err", 0},
+    {"XML Namespaces regression tests with indexed parsing", errParseTest,
+     "./test/namespaces/*", "result/namespaces/", "", ".err",
+     XML_PARSE_INDEXED},
 #ifdef LIBXML_VALID_ENABLED
     {"Error cases regression tests", errParseTest, "./test/errors/*.xml",
      "result/errors/", "", ".err", 0},
+    {"Error cases regression tests with indexed parsing", errParseTest,
+     "./test/errors/*.xml", "result/errors/", "", ".err", XML_PARSE_INDEXED},
+    {"Error cases regression tests with mapped files", errParseTest,
+     "./test/errors/*.xml", "result/errors/", "", ".err", XML_PARSE_MMAP},
+    {"Error cases regression tests with arena allocation", errParseTest,
+     "./test/errors/*.xml", "result/errors/", "", ".err", XML_PARSE_ARENA},
+    {"Error cases regression tests with node offsets", errParseTest,
+     "./test/errors/*.xml", "result/errors/", "", ".err", XML_PARSE_OFFSETS},
+    {"Error cases well-formedness check regression tests", wfCheckTest,
+     "./test/errors/*.xml", NULL, NULL, NULL, 0},
     {"Error cases regression tests from file descriptor", fdParseTest,
      "./test/errors/*.xml", "result/errors/", "", ".err", 0},
     {"Error cases regression tests with entity substitution", errParseTest,
@@ -4742,6 +4938,9 @@ static testDesc testDescriptions[] = {
 #endif
     {"General documents valid regression tests", errParseTest, "./test/valid/*",
      "result/valid/", "", ".err", XML_PARSE_DTDVALID},
+    {"General documents valid regression tests from snapshots",
+     snapshotParseTest, "./test/valid/*", "result/valid/", "", NULL,
+     XML_PARSE_DTDVALID},
 #endif
 #ifdef LIBXML_XINCLUDE_ENABLED
     {"XInclude regression tests", errParseTest, "./test/XInclude/docs/*",
@@ -1,9 +1,6 @@
-use std::collections::hash_map::DefaultHasher;
-use std::collections::HashMap;
+use std::cell::RefCell;
 use std::ffi::{c_char, c_int, c_uchar, c_void};
-use std::hash::BuildHasherDefault;
 use std::ptr;
-use std::sync::{Mutex, OnceLock};
 
 // Logging macro for debugging
 // disable for now
@@ -14,6 +11,69 @@ macro_rules! log_buf {
     };
 }
 
+// Operation trace recorder, enabled with the "trace" feature. Each FFI
+// call appends "<op> <id> <arg>" to the file named by $XML_BUF_TRACE,
+// with buffer handles renumbered in creation order. The output is the
+// input format of benchbuf.c.
+#[cfg(feature = "trace")]
+mod trace {
+    use std::collections::HashMap;
+    use std::io::Write;
+    use std::sync::Mutex;
+
+    struct Recorder {
+        out: Option<std::fs::File>,
+        ids: HashMap<usize, u32>,
+        next_id: u32,
+    }
+
+    static RECORDER: Mutex<Option<Recorder>> = Mutex::new(None);
+
+    pub fn record(op: char, handle: usize, arg: usize) {
+        if handle == 0 {
+            return;
+        }
+
+        let mut guard = RECORDER.lock().unwrap();
+        let rec = guard.get_or_insert_with(|| Recorder {
+            out: std::env::var_os("XML_BUF_TRACE").and_then(|path| std::fs::File::create(path).ok()),
+            ids: HashMap::new(),
+            next_id: 0,
+        });
+        if rec.out.is_none() {
+            return;
+        }
+
+        let id = match op {
+            'c' | 'm' | 'M' => {
+                let id = rec.next_id;
+                rec.next_id += 1;
+                rec.ids.insert(handle, id);
+                id
+            }
+            'f' => match rec.ids.remove(&handle) {
+                Some(id) => id,
+                None => return,
+            },
+            _ => match rec.ids.get(&handle) {
+                Some(&id) => id,
+                None => return,
+            },
+        };
+
+        if let Some(out) = rec.out.as_mut() {
+            let _ = writeln!(out, "{} {} {}", op, id, arg);
+        }
+    }
+}
+
+macro_rules! trace_buf {
+    ($op:expr, $buf:expr, $arg:expr) => {
+        #[cfg(feature = "trace")]
+        trace::record($op, $buf, $arg as usize);
+    };
+}
+
 // Type definitions matching libxml2
 pub type XmlChar = c_uchar;
 pub type XmlBufPtr = usize;
@@ -22,6 +82,12 @@ pub type XmlBufPtr = usize;
 const BUF_FLAG_OOM: u32 = 1 << 0;
 const BUF_FLAG_OVERFLOW: u32 = 1 << 1;
 const BUF_FLAG_STATIC: u32 = 1 << 2;
+const BUF_FLAG_RING: u32 = 1 << 3; // May switch to a ring mapping
+
+// Tag stored in every live buffer so handles can be validated without
+// a global lookup table. It is cleared when the buffer is freed.
+const BUF_MAGIC: u32 = 0x584d_4c42; // "XMLB"
+const BUF_MAGIC_FREED: u32 = 0xdead_b0f0;
 
 // reference xmlFree and xmlMalloc function pointers
 type XmlFreeFunc = unsafe extern "C" fn(*mut c_void);
@@ -67,41 +133,221 @@ pub struct XmlParserInput {
    pub entity: *mut c_void,
 }
 
+// Bytes of content (including the terminator) stored inside the XmlBuf
+// itself before switching to a heap Vec. Covers the many small buffers
+// created with an initial size of 50 by tree.c and xpath.c.
+const BUF_INLINE_SIZE: usize = 64;
+
+// Freed buffers are recycled through a per-thread pool, keyed by the
+// capacity class of their heap storage. Class 0 holds buffers with less
+// than BUF_INLINE_SIZE bytes of heap storage, class k holds capacities of
+// at least BUF_INLINE_SIZE << (k - 1).
+const BUF_POOL_CLASSES: usize = 8;
+const BUF_POOL_DEPTH: usize = 16;
+
+// Input buffers created with xmlBufCreateRing switch to a ring once
+// growing would move at least BUF_RING_THRESHOLD bytes of unconsumed
+// content. Rings are sized in powers of two from BUF_RING_MIN_SIZE.
+const BUF_RING_THRESHOLD: usize = 16 * 1024;
+const BUF_RING_MIN_SIZE: usize = 64 * 1024;
+
+// Double-mapped ring storage. The same `cap` bytes of a memfd are mapped
+// twice, back to back, so any `cap` bytes starting in the first half are
+// contiguous in memory. Consuming input only advances the content offset,
+// which wraps around at `cap`, and growing in place never moves data.
+#[derive(Debug)]
+struct Ring {
+    ptr: *mut u8,
+    cap: usize,
+}
+
+impl Ring {
+    #[cfg(target_os = "linux")]
+    fn new(cap: usize) -> Option<Ring> {
+        use libc::{MAP_ANONYMOUS, MAP_FAILED, MAP_FIXED, MAP_PRIVATE, MAP_SHARED};
+        use libc::{PROT_NONE, PROT_READ, PROT_WRITE};
+
+        let page = unsafe { libc::sysconf(libc::_SC_PAGESIZE) };
+        if page <= 0 || cap % page as usize != 0 || cap > usize::MAX / 2 {
+            return None;
+        }
+
+        unsafe {
+            let fd = libc::memfd_create(b"xmlbuf\0".as_ptr() as *const c_char, libc::MFD_CLOEXEC);
+            if fd < 0 {
+                return None;
+            }
+            if libc::ftruncate(fd, cap as libc::off_t) != 0 {
+                libc::close(fd);
+                return None;
+            }
+
+            // Reserve both halves first so the second mapping can't clash
+            let base = libc::mmap(ptr::null_mut(), 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if base == MAP_FAILED {
+                libc::close(fd);
+                return None;
+            }
+            let first = libc::mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            let second = libc::mmap(
+                (base as *mut u8).add(cap) as *mut c_void,
+                cap,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED,
+                fd,
+                0,
+            );
+            libc::close(fd);
+            if first == MAP_FAILED || second == MAP_FAILED {
+                libc::munmap(base, 2 * cap);
+                return None;
+            }
+
+            Some(Ring { ptr: base as *mut u8, cap })
+        }
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    fn new(_cap: usize) -> Option<Ring> {
+        None
+    }
+
+    fn as_slice(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr, 2 * self.cap) }
+    }
+
+    fn as_mut_slice(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.ptr, 2 * self.cap) }
+    }
+}
+
+impl Drop for Ring {
+    fn drop(&mut self) {
+        #[cfg(target_os = "linux")]
+        unsafe {
+            libc::munmap(self.ptr as *mut c_void, 2 * self.cap);
+        }
+    }
+}
+
 // Rust buffer structure
 // derive Debug
 #[derive(Debug)]
 pub struct XmlBuf {
+    magic: u32,
+    inline: [u8; BUF_INLINE_SIZE], // Used while content is empty
     content: Vec<u8>,
     use_: usize,
     size: usize,
     max_size: usize,
     flags: u32,
-    content_offset: usize,     // Offset from start of Vec to current content
+    content_offset: usize,     // Offset from start of storage to current content
     static_mem: Option<usize>, // For static buffers - store as usize for Send/Sync
+    ring: Option<Ring>,        // Replaces content and inline if set
+}
+
+thread_local! {
+    static BUF_POOL: RefCell<[Vec<Box<XmlBuf>>; BUF_POOL_CLASSES]> =
+        RefCell::new(Default::default());
+}
+
+fn pool_class(capacity: usize) -> usize {
+    (usize::BITS - (capacity / BUF_INLINE_SIZE).leading_zeros()) as usize
+}
+
+// Smallest class whose buffers can hold `len` bytes of storage
+fn pool_class_for(len: usize) -> usize {
+    if len <= BUF_INLINE_SIZE {
+        0
+    } else {
+        pool_class(len - 1) + 1
+    }
+}
+
+fn pool_take(len: usize) -> Option<Box<XmlBuf>> {
+    let first = pool_class_for(len);
+    if first >= BUF_POOL_CLASSES {
+        return None;
+    }
+    // Requests that fit inline can use any pooled buffer; larger ones
+    // only take buffers from the next two classes up.
+    let last = if first == 0 {
+        BUF_POOL_CLASSES - 1
+    } else {
+        (first + 2).min(BUF_POOL_CLASSES - 1)
+    };
+
+    BUF_POOL
+        .try_with(|pool| {
+            let mut pool = pool.try_borrow_mut().ok()?;
+            (first..=last).find_map(|class| pool[class].pop())
+        })
+        .ok()
+        .flatten()
+}
+
+fn pool_put(mut buf: Box<XmlBuf>) {
+    let class = pool_class(buf.content.capacity());
+    if class >= BUF_POOL_CLASSES {
+        return;
+    }
+    buf.content.clear();
+    buf.static_mem = None;
+    buf.ring = None;
+
+    // Dropped if the pool is full or the thread is being torn down
+    let _ = BUF_POOL.try_with(|pool| {
+        if let Ok(mut pool) = pool.try_borrow_mut() {
+            if pool[class].len() < BUF_POOL_DEPTH {
+                pool[class].push(buf);
+            }
+        }
+    });
 }
 
 impl XmlBuf {
-    fn new(size: usize) -> Result<Self, ()> {
+    // Get a reset buffer with at least `len` bytes of storage, inline or
+    // on the heap, from the pool if possible.
+    fn alloc(len: usize) -> Box<Self> {
+        let mut buf = pool_take(len).unwrap_or_else(|| {
+            Box::new(XmlBuf {
+                magic: BUF_MAGIC,
+                inline: [0; BUF_INLINE_SIZE],
+                content: Vec::new(),
+                use_: 0,
+                size: 0,
+                max_size: usize::MAX - 1,
+                flags: 0,
+                content_offset: 0,
+                static_mem: None,
+                ring: None,
+            })
+        });
+
+        buf.magic = BUF_MAGIC;
+        buf.use_ = 0;
+        buf.size = 0;
+        buf.max_size = usize::MAX - 1;
+        buf.flags = 0;
+        buf.content_offset = 0;
+        if len > BUF_INLINE_SIZE {
+            buf.content.resize(len, 0);
+        }
+        buf.storage_mut()[0] = 0;
+        buf
+    }
+
+    fn new(size: usize) -> Result<Box<Self>, ()> {
         if size == usize::MAX {
             return Err(());
         }
 
-        let mut content = Vec::with_capacity(size + 1);
-        content.resize(size + 1, 0);
-        content[0] = 0; // Null terminate
-
-        Ok(XmlBuf {
-            content,
-            use_: 0,
-            size,
-            max_size: usize::MAX - 1,
-            flags: 0,
-            content_offset: 0,
-            static_mem: None,
-        })
+        let mut buf = XmlBuf::alloc(size + 1);
+        buf.size = size;
+        Ok(buf)
     }
 
-    fn new_from_mem(mem: *const XmlChar, size: usize, is_static: bool) -> Result<Self, ()> {
+    fn new_from_mem(mem: *const XmlChar, size: usize, is_static: bool) -> Result<Box<Self>, ()> {
         if mem.is_null() {
             return Err(());
         }
@@ -114,32 +360,50 @@ impl XmlBuf {
                 }
             }
 
-            Ok(XmlBuf {
-                content: Vec::new(), // Not used for static buffers
-                use_: size,
-                size,
-                max_size: usize::MAX - 1,
-                flags: BUF_FLAG_STATIC,
-                content_offset: 0,
-                static_mem: Some(mem as usize),
-            })
+            let mut buf = XmlBuf::alloc(0);
+            buf.use_ = size;
+            buf.size = size;
+            buf.flags = BUF_FLAG_STATIC;
+            buf.static_mem = Some(mem as usize);
+            Ok(buf)
         } else {
-            let mut content = Vec::with_capacity(size + 1);
+            if size == usize::MAX {
+                return Err(());
+            }
+
+            let mut buf = XmlBuf::alloc(size + 1);
             unsafe {
                 let slice = std::slice::from_raw_parts(mem, size);
-                content.extend_from_slice(slice);
+                buf.storage_mut()[..size].copy_from_slice(slice);
             }
-            content.push(0); // Null terminate
+            buf.storage_mut()[size] = 0; // Null terminate
+            buf.use_ = size;
+            buf.size = size;
+            Ok(buf)
+        }
+    }
 
-            Ok(XmlBuf {
-                content,
-                use_: size,
-                size,
-                max_size: usize::MAX - 1,
-                flags: 0,
-                content_offset: 0,
-                static_mem: None,
-            })
+    fn is_inline(&self) -> bool {
+        self.ring.is_none() && self.content.is_empty()
+    }
+
+    fn storage(&self) -> &[u8] {
+        if let Some(ring) = &self.ring {
+            ring.as_slice()
+        } else if self.is_inline() {
+            &self.inline
+        } else {
+            &self.content
+        }
+    }
+
+    fn storage_mut(&mut self) -> &mut [u8] {
+        if let Some(ring) = self.ring.as_mut() {
+            ring.as_mut_slice()
+        } else if self.content.is_empty() {
+            &mut self.inline
+        } else {
+            &mut self.content
         }
     }
 
@@ -163,11 +427,11 @@ impl XmlBuf {
         }
 
         self.use_ = 0;
-        self.size += self.content_offset;
-        self.content_offset = 0;
-        if !self.content.is_empty() {
-            self.content[0] = 0;
+        if self.ring.is_none() {
+            self.size += self.content_offset;
         }
+        self.content_offset = 0;
+        self.storage_mut()[0] = 0;
     }
 
     fn grow(&mut self, len: usize) -> Result<(), ()> {
@@ -179,11 +443,22 @@ impl XmlBuf {
             return Ok(());
         }
 
+        if (self.flags & BUF_FLAG_RING) != 0
+            && (self.ring.is_some() || self.use_ >= BUF_RING_THRESHOLD)
+            && len <= self.max_size - self.use_
+        {
+            if self.grow_ring(len).is_ok() {
+                return Ok(());
+            }
+            // Keep using the heap if mapping fails
+            self.flags &= !BUF_FLAG_RING;
+        }
+
         // Check if we can move content to beginning to make space
         if len <= self.content_offset + self.size - self.use_ {
             let content_start = self.content_offset;
             let content_end = content_start + self.use_ + 1;
-            self.content.copy_within(content_start..content_end, 0);
+            self.storage_mut().copy_within(content_start..content_end, 0);
             self.size += self.content_offset;
             self.content_offset = 0;
             return Ok(());
@@ -209,23 +484,51 @@ impl XmlBuf {
             }
         };
 
-        // Resize the Vec
-        self.content.resize(new_size + 1, 0);
+        let content_start = self.content_offset;
+        let content_end = content_start + self.use_ + 1;
 
-        // If we had offset content, move it to the beginning
-        if self.content_offset > 0 {
-            let content_start = self.content_offset;
-            let content_end = content_start + self.use_ + 1;
-            self.content.copy_within(content_start..content_end, 0);
-            self.content_offset = 0;
+        if !self.is_inline() {
+            // Resize the Vec
+            self.content.resize(new_size + 1, 0);
+
+            // If we had offset content, move it to the beginning
+            if content_start > 0 {
+                self.content.copy_within(content_start..content_end, 0);
+            }
+        } else if new_size + 1 <= BUF_INLINE_SIZE {
+            self.inline.copy_within(content_start..content_end, 0);
+        } else {
+            // Move inline content to the heap, reusing any retained capacity
+            self.content.resize(new_size + 1, 0);
+            self.content[..self.use_ + 1].copy_from_slice(&self.inline[content_start..content_end]);
         }
 
+        self.content_offset = 0;
         self.size = new_size;
         Ok(())
     }
 
+    // Copy the content into a new ring large enough for `len` more bytes.
+    // This only happens when switching to a ring or when the ring is full.
+    fn grow_ring(&mut self, len: usize) -> Result<(), ()> {
+        let needed = self.use_.checked_add(len).and_then(|n| n.checked_add(1)).ok_or(())?;
+        let cap = needed.max(BUF_RING_MIN_SIZE).checked_next_power_of_two().ok_or(())?;
+        let mut ring = Ring::new(cap).ok_or(())?;
+
+        let content_start = self.content_offset;
+        let content_end = content_start + self.use_ + 1;
+        ring.as_mut_slice()[..self.use_ + 1].copy_from_slice(&self.storage()[content_start..content_end]);
+
+        // Release heap storage, it won't be used again by this buffer
+        self.content = Vec::new();
+        self.ring = Some(ring);
+        self.content_offset = 0;
+        self.size = cap - 1;
+        Ok(())
+    }
+
     fn add(&mut self, str_ptr: *const XmlChar, len: usize) -> Result<(), ()> {
-        if self.is_error() || self.is_static() || str_ptr.is_null() {
+        if self.is_error() || self.is_static() {
             return Err(());
         }
 
@@ -233,18 +536,23 @@ impl XmlBuf {
             return Ok(());
         }
 
+        if str_ptr.is_null() {
+            return Err(());
+        }
+
         if len > self.size - self.use_ {
             self.grow(len)?;
         }
 
+        let start_pos = self.content_offset + self.use_;
         unsafe {
             let src_slice = std::slice::from_raw_parts(str_ptr, len);
-            let start_pos = self.content_offset + self.use_;
-            self.content[start_pos..start_pos + len].copy_from_slice(src_slice);
+            self.storage_mut()[start_pos..start_pos + len].copy_from_slice(src_slice);
         }
 
         self.use_ += len;
-        self.content[self.content_offset + self.use_] = 0; // Null terminate
+        let end_pos = self.content_offset + self.use_;
+        self.storage_mut()[end_pos] = 0; // Null terminate
 
         Ok(())
     }
@@ -280,7 +588,8 @@ impl XmlBuf {
         }
 
         self.use_ += len;
-        self.content[self.content_offset + self.use_] = 0;
+        let end_pos = self.content_offset + self.use_;
+        self.storage_mut()[end_pos] = 0;
         Ok(())
     }
 
@@ -297,14 +606,16 @@ impl XmlBuf {
             }
             libc::memcpy(
                 ptr as *mut c_void,
-                self.content.as_ptr().add(self.content_offset) as *const c_void,
+                self.storage().as_ptr().add(self.content_offset) as *const c_void,
                 self.use_ + 1,
             );
             ptr
         };
 
-        // Clear buffer
+        // Clear buffer, keeping the heap capacity for reuse
+        self.ring = None;
         self.content.clear();
+        self.inline[0] = 0;
         self.use_ = 0;
         self.size = 0;
         self.content_offset = 0;
@@ -318,28 +629,55 @@ impl XmlBuf {
         }
 
         if self.is_static() {
+            // Shrinking a static buffer only advances the content offset
             self.static_mem
-                .map(|addr| addr as *const XmlChar)
+                .map(|addr| (addr as *const XmlChar).wrapping_add(self.content_offset))
                 .unwrap_or(ptr::null())
         } else {
-            self.content.as_ptr().wrapping_add(self.content_offset)
+            self.storage().as_ptr().wrapping_add(self.content_offset)
         }
     }
 }
 
-// Global storage for buffer handles
-static BUFFERS: OnceLock<
-    Mutex<HashMap<XmlBufPtr, Box<XmlBuf>, BuildHasherDefault<DefaultHasher>>>,
-> = OnceLock::new();
+// Buffer handles
+//
+// A handle is the address of the boxed XmlBuf itself, so resolving it is a
+// pointer check plus a tag comparison and never takes a lock. As with the C
+// implementation, a single buffer must not be used from several threads at
+// once without external synchronization; distinct buffers are independent.
+
+fn new_handle(buf: Box<XmlBuf>) -> XmlBufPtr {
+    Box::into_raw(buf) as XmlBufPtr
+}
+
+fn handle_is_valid(handle: XmlBufPtr) -> bool {
+    if handle == 0 || handle % std::mem::align_of::<XmlBuf>() != 0 {
+        return false;
+    }
+    unsafe { (*(handle as *const XmlBuf)).magic == BUF_MAGIC }
+}
+
+fn get_buf<'a>(handle: XmlBufPtr) -> Option<&'a XmlBuf> {
+    if !handle_is_valid(handle) {
+        return None;
+    }
+    Some(unsafe { &*(handle as *const XmlBuf) })
+}
 
-fn get_buffers(
-) -> &'static Mutex<HashMap<XmlBufPtr, Box<XmlBuf>, BuildHasherDefault<DefaultHasher>>> {
-    BUFFERS.get_or_init(|| Mutex::new(HashMap::with_hasher(BuildHasherDefault::new())))
+fn get_buf_mut<'a>(handle: XmlBufPtr) -> Option<&'a mut XmlBuf> {
+    if !handle_is_valid(handle) {
+        return None;
+    }
+    Some(unsafe { &mut *(handle as *mut XmlBuf) })
 }
 
-fn next_handle() -> XmlBufPtr {
-    static COUNTER: std::sync::atomic::AtomicUsize = std::sync::atomic::AtomicUsize::new(5);
-    COUNTER.fetch_add(1, std::sync::atomic::Ordering::SeqCst)
+fn take_buf(handle: XmlBufPtr) -> Option<Box<XmlBuf>> {
+    if !handle_is_valid(handle) {
+        return None;
+    }
+    let mut buffer = unsafe { Box::from_raw(handle as *mut XmlBuf) };
+    buffer.magic = BUF_MAGIC_FREED;
+    Some(buffer)
 }
 
 // FFI functions matching the C API
@@ -356,15 +694,28 @@ pub extern "C" fn xmlBufCreate(size: usize) -> XmlBufPtr {
         }
     };
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    let handle = next_handle();
-    m.insert(handle, Box::new(buf));
+    let handle = new_handle(buf);
+    trace_buf!('c', handle, size);
 
     log_buf!("xmlBufCreate SUCCESS - handle={}", handle);
     handle
 }
 
+#[no_mangle]
+pub extern "C" fn xmlBufCreateRing(size: usize) -> XmlBufPtr {
+    log_buf!("xmlBufCreateRing(size={})", size);
+
+    let mut buf = match XmlBuf::new(size) {
+        Ok(buf) => buf,
+        Err(()) => return 0,
+    };
+    buf.flags |= BUF_FLAG_RING;
+
+    let handle = new_handle(buf);
+    trace_buf!('c', handle, size);
+    handle
+}
+
 #[no_mangle]
 pub extern "C" fn xmlBufCreateMem(mem: *const XmlChar, size: usize, is_static: c_int) -> XmlBufPtr {
     log_buf!(
@@ -382,10 +733,8 @@ pub extern "C" fn xmlBufCreateMem(mem: *const XmlChar, size: usize, is_static: c
         }
     };
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    let handle = next_handle();
-    m.insert(handle, Box::new(buf));
+    let handle = new_handle(buf);
+    trace_buf!(if is_static != 0 { 'M' } else { 'm' }, handle, size);
 
     log_buf!("xmlBufCreateMem SUCCESS - handle={}", handle);
     handle
@@ -398,21 +747,21 @@ pub extern "C" fn xmlBufFree(buf: XmlBufPtr) {
         return;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    m.remove(&buf);
+    trace_buf!('f', buf, 0);
+    if let Some(buffer) = take_buf(buf) {
+        pool_put(buffer);
+    }
 }
 
 #[no_mangle]
 pub extern "C" fn xmlBufEmpty(buf: XmlBufPtr) {
     log_buf!("xmlBufEmpty(buf={})", buf);
+    trace_buf!('e', buf, 0);
     if buf == 0 {
         return;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         buffer.empty();
     }
 }
@@ -420,13 +769,12 @@ pub extern "C" fn xmlBufEmpty(buf: XmlBufPtr) {
 #[no_mangle]
 pub extern "C" fn xmlBufGrow(buf: XmlBufPtr, len: usize) -> c_int {
     log_buf!("xmlBufGrow(buf={}, len={})", buf, len);
+    trace_buf!('g', buf, len);
     if buf == 0 {
         return -1;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         match buffer.grow(len) {
             Ok(()) => 0,
             Err(()) => -1,
@@ -439,15 +787,14 @@ pub extern "C" fn xmlBufGrow(buf: XmlBufPtr, len: usize) -> c_int {
 #[no_mangle]
 pub extern "C" fn xmlBufAdd(buf: XmlBufPtr, str_ptr: *const XmlChar, len: usize) -> c_int {
     log_buf!("xmlBufAdd(buf={}, str_ptr={:p}, len={})", buf, str_ptr, len);
+    trace_buf!('a', buf, len);
 
     if buf == 0 {
         log_buf!("xmlBufAdd FAILED - null handle");
         return -1;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         match buffer.add(str_ptr, len) {
             Ok(()) => {
                 log_buf!("xmlBufAdd SUCCESS - buffer now has {} bytes", buffer.use_);
@@ -467,14 +814,17 @@ pub extern "C" fn xmlBufAdd(buf: XmlBufPtr, str_ptr: *const XmlChar, len: usize)
 #[no_mangle]
 pub extern "C" fn xmlBufCat(buf: XmlBufPtr, str_ptr: *const XmlChar) -> c_int {
     log_buf!("xmlBufCat(buf={}, str_ptr={:p})", buf, str_ptr);
+    trace_buf!(
+        't',
+        buf,
+        if str_ptr.is_null() { 0 } else { unsafe { libc::strlen(str_ptr as *const c_char) } }
+    );
 
     if buf == 0 {
         return -1;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         match buffer.cat(str_ptr) {
             Ok(()) => 0,
             Err(()) => -1,
@@ -487,13 +837,12 @@ pub extern "C" fn xmlBufCat(buf: XmlBufPtr, str_ptr: *const XmlChar) -> c_int {
 #[no_mangle]
 pub extern "C" fn xmlBufAvail(buf: XmlBufPtr) -> usize {
     log_buf!("xmlBufAvail(buf={})", buf);
+    trace_buf!('q', buf, 0);
     if buf == 0 {
         return 0;
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         buffer.avail()
     } else {
         0
@@ -503,13 +852,12 @@ pub extern "C" fn xmlBufAvail(buf: XmlBufPtr) -> usize {
 #[no_mangle]
 pub extern "C" fn xmlBufIsEmpty(buf: XmlBufPtr) -> c_int {
     log_buf!("xmlBufIsEmpty(buf={})", buf);
+    trace_buf!('q', buf, 0);
     if buf == 0 {
         return -1;
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         if buffer.is_error() {
             -1
         } else if buffer.is_empty() {
@@ -525,13 +873,12 @@ pub extern "C" fn xmlBufIsEmpty(buf: XmlBufPtr) -> c_int {
 #[no_mangle]
 pub extern "C" fn xmlBufAddLen(buf: XmlBufPtr, len: usize) -> c_int {
     log_buf!("xmlBufAddLen(buf={}, len={})", buf, len);
+    trace_buf!('l', buf, len);
     if buf == 0 {
         return -1;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         match buffer.add_len(len) {
             Ok(()) => 0,
             Err(()) => -1,
@@ -544,13 +891,12 @@ pub extern "C" fn xmlBufAddLen(buf: XmlBufPtr, len: usize) -> c_int {
 #[no_mangle]
 pub extern "C" fn xmlBufDetach(buf: XmlBufPtr) -> *mut XmlChar {
     log_buf!("xmlBufDetach(buf={})", buf);
+    trace_buf!('d', buf, 0);
     if buf == 0 {
         return ptr::null_mut();
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         match buffer.detach() {
             Ok(ptr) => ptr,
             Err(()) => ptr::null_mut(),
@@ -565,15 +911,14 @@ pub extern "C" fn xmlBufDetach(buf: XmlBufPtr) -> *mut XmlChar {
 #[no_mangle]
 pub extern "C" fn xmlBufContent(buf: XmlBufPtr) -> *const XmlChar {
     log_buf!("xmlBufContent(buf={})", buf);
+    trace_buf!('q', buf, 0);
 
     if buf == 0 {
         log_buf!("xmlBufContent - NULL handle");
         return ptr::null();
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         let ptr = buffer.content_ptr();
         log_buf!("xmlBufContent SUCCESS - ptr={:p}, use={}", ptr, buffer.use_);
         ptr
@@ -585,13 +930,12 @@ pub extern "C" fn xmlBufContent(buf: XmlBufPtr) -> *const XmlChar {
 
 #[no_mangle]
 pub extern "C" fn xmlBufEnd(buf: XmlBufPtr) -> *mut XmlChar {
+    trace_buf!('q', buf, 0);
     if buf == 0 {
         return ptr::null_mut();
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         if buffer.is_error() {
             return ptr::null_mut();
         }
@@ -601,7 +945,7 @@ pub extern "C" fn xmlBufEnd(buf: XmlBufPtr) -> *mut XmlChar {
         }
 
         buffer
-            .content
+            .storage()
             .as_ptr()
             .wrapping_add(buffer.content_offset + buffer.use_) as *mut XmlChar
     } else {
@@ -611,13 +955,12 @@ pub extern "C" fn xmlBufEnd(buf: XmlBufPtr) -> *mut XmlChar {
 
 #[no_mangle]
 pub extern "C" fn xmlBufUse(buf: XmlBufPtr) -> usize {
+    trace_buf!('q', buf, 0);
     if buf == 0 {
         return 0;
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         if buffer.is_error() {
             return 0;
         }
@@ -629,13 +972,12 @@ pub extern "C" fn xmlBufUse(buf: XmlBufPtr) -> usize {
 
 #[no_mangle]
 pub extern "C" fn xmlBufShrink(buf: XmlBufPtr, len: usize) -> usize {
+    trace_buf!('s', buf, len);
     if buf == 0 {
         return 0;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get_mut(&buf) {
+    if let Some(buffer) = get_buf_mut(buf) {
         if buffer.is_error() || len == 0 {
             return 0;
         }
@@ -646,7 +988,14 @@ pub extern "C" fn xmlBufShrink(buf: XmlBufPtr, len: usize) -> usize {
 
         buffer.use_ -= len;
         buffer.content_offset += len;
-        buffer.size -= len;
+        if let Some(ring) = &buffer.ring {
+            // The consumed space becomes available at the end
+            if buffer.content_offset >= ring.cap {
+                buffer.content_offset -= ring.cap;
+            }
+        } else {
+            buffer.size -= len;
+        }
 
         len
     } else {
@@ -1114,21 +1463,14 @@ pub extern "C" fn xmlBufFromBuffer(buffer: *mut XmlBuffer) -> XmlBufPtr {
             }
             content.resize(size + 1, 0);
 
-            XmlBuf {
-                content,
-                use_,
-                size,
-                max_size: usize::MAX - 1,
-                flags: 0,
-                content_offset: 0,
-                static_mem: None,
-            }
+            let mut buf = XmlBuf::alloc(0);
+            buf.content = content;
+            buf.use_ = use_;
+            buf.size = size;
+            buf
         };
 
-        let mutex = get_buffers();
-        let mut m = mutex.lock().unwrap();
-        let handle = next_handle();
-        m.insert(handle, Box::new(xml_buf));
+        let handle = new_handle(xml_buf);
 
         log_buf!("xmlBufFromBuffer SUCCESS - handle={}", handle);
         handle
@@ -1138,15 +1480,13 @@ pub extern "C" fn xmlBufFromBuffer(buffer: *mut XmlBuffer) -> XmlBufPtr {
 #[no_mangle]
 pub extern "C" fn xmlBufBackToBuffer(buf: XmlBufPtr, ret: *mut XmlBuffer) -> c_int {
     log_buf!("xmlBufBackToBuffer(buf={}, ret={:p})", buf, ret);
+    trace_buf!('f', buf, 0);
 
     if buf == 0 || ret.is_null() {
         return -1;
     }
 
-    let mutex = get_buffers();
-    let mut m = mutex.lock().unwrap();
-
-    if let Some(mut buffer) = m.remove(&buf) {
+    if let Some(mut buffer) = take_buf(buf) {
         if buffer.is_error() || buffer.is_static() || buffer.use_ >= i32::MAX as usize {
             unsafe {
                 let ret_struct = &mut *ret;
@@ -1172,19 +1512,20 @@ pub extern "C" fn xmlBufBackToBuffer(buf: XmlBufPtr, ret: *mut XmlBuffer) -> c_i
             
             // Transfer ownership of the buffer content like the C version does
             // First, ensure the content is at the beginning of the allocation
-            if buffer.content_offset > 0 {
-                // Need to move content to start of buffer
+            if buffer.content_offset > 0 || buffer.is_inline() || buffer.ring.is_some() {
+                // Need to move content to start of a heap allocation
                 let content_ptr = xmlMalloc(buffer.use_ + 1) as *mut XmlChar;
                 if content_ptr.is_null() {
                     return -1;
                 }
                 libc::memcpy(
                     content_ptr as *mut c_void,
-                    buffer.content.as_ptr().add(buffer.content_offset) as *const c_void,
+                    buffer.storage().as_ptr().add(buffer.content_offset) as *const c_void,
                     buffer.use_ + 1,
                 );
                 ret_struct.content = content_ptr;
                 ret_struct.content_io = content_ptr;
+                ret_struct.size = buffer.use_ as c_int + 1;
             } else {
                 // Extract the Vec's pointer and prevent deallocation
                 let vec_ptr = buffer.content.as_mut_ptr();
@@ -1222,15 +1563,14 @@ pub extern "C" fn xmlBufUpdateInput(
         input,
         pos
     );
+    trace_buf!('q', buf, pos);
 
     if buf == 0 || input.is_null() {
         log_buf!("xmlBufUpdateInput FAILED - invalid args");
         return -1;
     }
 
-    let mutex = get_buffers();
-    let m = mutex.lock().unwrap();
-    if let Some(buffer) = m.get(&buf) {
+    if let Some(buffer) = get_buf(buf) {
         if buffer.is_error() {
             log_buf!("xmlBufUpdateInput FAILED - buffer in error state");
             return -1;
@@ -1300,6 +1640,19 @@ mod tests {
         xmlBufFree(buf);
     }
 
+    #[test]
+    fn test_buf_add_empty() {
+        let buf = xmlBufCreate(100);
+        assert_ne!(buf, 0);
+
+        // Like the C implementation, accept NULL with a length of 0
+        assert_eq!(xmlBufAdd(buf, ptr::null(), 0), 0);
+        assert_eq!(xmlBufAdd(buf, ptr::null(), 1), -1);
+        assert_eq!(xmlBufIsEmpty(buf), 1);
+
+        xmlBufFree(buf);
+    }
+
     #[test]
     fn test_buf_empty() {
         let buf = xmlBufCreate(100);
@@ -1357,6 +1710,19 @@ mod tests {
         xmlBufFree(buf);
     }
 
+    #[test]
+    fn test_buf_static_shrink() {
+        let test_str = b"Static content\0";
+        let buf = xmlBufCreateMem(test_str.as_ptr(), test_str.len() - 1, 1);
+        assert_ne!(buf, 0);
+
+        assert_eq!(xmlBufShrink(buf, 7), 7);
+        assert_eq!(xmlBufUse(buf), 7);
+        assert_eq!(xmlBufContent(buf), test_str[7..].as_ptr());
+
+        xmlBufFree(buf);
+    }
+
     #[test]
     fn test_buf_detach() {
         let buf = xmlBufCreate(100);
@@ -1379,6 +1745,130 @@ mod tests {
         xmlBufFree(buf);
     }
 
+    #[test]
+    fn test_buf_invalid_handle() {
+        assert_eq!(xmlBufAdd(0, b"x\0".as_ptr(), 1), -1);
+        assert_eq!(xmlBufUse(1), 0);
+        assert!(xmlBufContent(3).is_null());
+
+        let buf = xmlBufCreate(10);
+        assert_ne!(buf, 0);
+        assert_eq!(xmlBufIsEmpty(buf + 1), -1);
+        xmlBufFree(buf);
+    }
+
+    #[test]
+    fn test_buf_inline_to_heap() {
+        let buf = xmlBufCreate(10);
+        assert_ne!(buf, 0);
+
+        let chunk = b"0123456789";
+        let mut expected = Vec::new();
+        for _ in 0..20 {
+            assert_eq!(xmlBufAdd(buf, chunk.as_ptr(), chunk.len()), 0);
+            assert_eq!(xmlBufShrink(buf, 3), 3);
+            expected.extend_from_slice(chunk);
+            expected.drain(..3);
+        }
+        let used = xmlBufUse(buf);
+        assert_eq!(used, expected.len());
+
+        let content = unsafe { std::slice::from_raw_parts(xmlBufContent(buf), used + 1) };
+        assert_eq!(&content[..used], &expected[..]);
+        assert_eq!(content[used], 0);
+
+        xmlBufFree(buf);
+    }
+
+    #[test]
+    fn test_buf_ring() {
+        let buf = xmlBufCreateRing(4000);
+        assert_ne!(buf, 0);
+
+        // Stream through several times the ring size with a large
+        // amount of unconsumed lookahead, like the parser does.
+        let chunk: Vec<u8> = (0..4000u32).map(|i| b'a' + (i % 26) as u8).collect();
+        let mut expected = Vec::new();
+        let mut ring_base = ptr::null();
+        for i in 0..200 {
+            assert_eq!(xmlBufAdd(buf, chunk.as_ptr(), chunk.len()), 0);
+            expected.extend_from_slice(&chunk);
+            if xmlBufUse(buf) > 40000 {
+                let len = 4000 + i % 7;
+                assert_eq!(xmlBufShrink(buf, len), len);
+                expected.drain(..len);
+            }
+
+            let used = xmlBufUse(buf);
+            let content = unsafe { std::slice::from_raw_parts(xmlBufContent(buf), used + 1) };
+            assert_eq!(&content[..used], &expected[..]);
+            assert_eq!(content[used], 0);
+
+            // Once the content is large, the ring is set up and never
+            // reallocated since the content size stays bounded.
+            if i == 20 {
+                ring_base = get_buf(buf).unwrap().storage().as_ptr();
+            } else if i > 20 {
+                assert_eq!(get_buf(buf).unwrap().storage().as_ptr(), ring_base);
+            }
+        }
+        assert!(get_buf(buf).unwrap().ring.is_some());
+
+        let detached = xmlBufDetach(buf);
+        assert!(!detached.is_null());
+        unsafe {
+            assert_eq!(std::slice::from_raw_parts(detached, expected.len()), &expected[..]);
+            xmlFree(detached as *mut c_void);
+        }
+
+        xmlBufFree(buf);
+    }
+
+    #[test]
+    fn test_buf_pool_reuse() {
+        let buf = xmlBufCreate(50);
+        assert_ne!(buf, 0);
+        assert_eq!(xmlBufCat(buf, [b'x'; 200].iter().chain(b"\0").copied().collect::<Vec<u8>>().as_ptr()), 0);
+        let detached = xmlBufDetach(buf);
+        assert!(!detached.is_null());
+        unsafe { xmlFree(detached as *mut c_void) };
+        xmlBufFree(buf);
+
+        // The recycled buffer must come back empty
+        let buf2 = xmlBufCreate(50);
+        assert_eq!(buf2, buf);
+        assert_eq!(xmlBufIsEmpty(buf2), 1);
+        assert_eq!(xmlBufAvail(buf2), 50);
+        assert_eq!(unsafe { *xmlBufContent(buf2) }, 0);
+        xmlBufFree(buf2);
+    }
+
+    #[test]
+    fn test_buf_threads() {
+        let threads: Vec<_> = (0..8)
+            .map(|_| {
+                std::thread::spawn(|| {
+                    for i in 0..1000 {
+                        let buf = xmlBufCreate(16);
+                        assert_ne!(buf, 0);
+                        for _ in 0..(i % 17) {
+                            assert_eq!(xmlBufAdd(buf, b"abcd".as_ptr(), 4), 0);
+                        }
+                        assert_eq!(xmlBufUse(buf), 4 * (i % 17));
+                        assert_eq!(xmlBufShrink(buf, 0), 0);
+                        let content = xmlBufContent(buf);
+                        assert!(!content.is_null());
+                        assert_eq!(unsafe { *content.add(xmlBufUse(buf)) }, 0);
+                        xmlBufFree(buf);
+                    }
+                })
+            })
+            .collect();
+        for t in threads {
+            t.join().unwrap();
+        }
+    }
+
     #[test]
     fn test_xml_buf_update_input() {
         let buf = xmlBufCreate(100);
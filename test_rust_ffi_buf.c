@@ -9,6 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 // Type definitions matching the Rust FFI
 typedef unsigned char xmlChar;
@@ -26,6 +29,9 @@ extern size_t xmlBufAvail(xmlBufPtr buf);
 extern int xmlBufIsEmpty(xmlBufPtr buf);
 extern int xmlBufAddLen(xmlBufPtr buf, size_t len);
 extern xmlChar *xmlBufDetach(xmlBufPtr buf);
+extern xmlChar *xmlBufContent(xmlBufPtr buf);
+extern size_t xmlBufUse(xmlBufPtr buf);
+extern size_t xmlBufShrink(xmlBufPtr buf, size_t len);
 
 // Test results tracking
 static int tests_run = 0;
@@ -215,7 +221,113 @@ void test_error_conditions() {
     TEST_ASSERT(1, "xmlBufFree on invalid handle should not crash");
 }
 
-int main() {
+// Per-thread workload mimicking the parser: small appends, periodic
+// shrinks of consumed data and content lookups.
+#define WORKER_BUFFERS 64
+#define WORKER_APPENDS 256
+
+typedef struct {
+    long iterations;
+    int failed;
+} worker_arg;
+
+static void *buf_worker(void *data) {
+    worker_arg *arg = (worker_arg *)data;
+    const xmlChar *chunk = (const xmlChar *)"<elem attr=\"value\">text</elem>";
+    size_t chunk_len = strlen((const char *)chunk);
+    long it;
+
+    for (it = 0; it < arg->iterations; it++) {
+        xmlBufPtr buf = xmlBufCreate(64);
+        int i;
+
+        if (buf == 0) {
+            arg->failed = 1;
+            return NULL;
+        }
+        for (i = 0; i < WORKER_APPENDS; i++) {
+            if (xmlBufAdd(buf, chunk, chunk_len) != 0) {
+                arg->failed = 1;
+                break;
+            }
+            if ((i & 7) == 7)
+                xmlBufShrink(buf, chunk_len * 4);
+        }
+        if ((xmlBufContent(buf) == NULL) ||
+            (xmlBufUse(buf) != chunk_len * (WORKER_APPENDS / 2)))
+            arg->failed = 1;
+        xmlBufFree(buf);
+    }
+
+    return NULL;
+}
+
+static double run_workers(int nthreads, long iterations, int *failed) {
+    pthread_t *tids = calloc(nthreads, sizeof(tids[0]));
+    worker_arg *args = calloc(nthreads, sizeof(args[0]));
+    struct timespec start, end;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nthreads; i++) {
+        args[i].iterations = iterations;
+        pthread_create(&tids[i], NULL, buf_worker, &args[i]);
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(tids[i], NULL);
+        if (args[i].failed)
+            *failed = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    free(tids);
+    free(args);
+    return (end.tv_sec - start.tv_sec) +
+           (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+void test_buf_threads() {
+    printf("\n=== Testing concurrent buffer use ===\n");
+
+    int failed = 0;
+    run_workers(8, WORKER_BUFFERS, &failed);
+    TEST_ASSERT(!failed, "Buffers used from 8 threads should stay consistent");
+}
+
+// Throughput benchmark: each thread works on its own buffers, so with
+// lock-free handle resolution the aggregate rate should scale linearly
+// with the number of threads up to the number of cores.
+static int bench_buf_threads(void) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    long iterations = 20000;
+    double base_rate = 0;
+    int failed = 0;
+    int nthreads;
+
+    if (ncpu < 1)
+        ncpu = 1;
+
+    printf("threads  Mops/s  speedup  efficiency\n");
+    for (nthreads = 1; nthreads <= ncpu; nthreads *= 2) {
+        double secs = run_workers(nthreads, iterations, &failed);
+        double ops = (double) nthreads * iterations * (WORKER_APPENDS + 3);
+        double rate = ops / secs / 1e6;
+
+        if (nthreads == 1)
+            base_rate = rate;
+        printf("%7d  %6.1f  %7.2f  %9.0f%%\n", nthreads, rate,
+               rate / base_rate, rate / base_rate / nthreads * 100.0);
+        if (nthreads * 2 > ncpu && nthreads != ncpu)
+            nthreads = ncpu / 2;
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0))
+        return bench_buf_threads();
+
     printf("Starting Rust FFI buffer tests...\n");
     
     test_buf_create_free();
@@ -227,6 +339,7 @@ int main() {
     test_buf_add_len();
     test_buf_static_restrictions();
     test_error_conditions();
+    test_buf_threads();
     
     printf("\n=== Test Summary ===\n");
     printf("Tests run: %d\n", tests_run);
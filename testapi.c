@@ -140,6 +140,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFreeParserCtxt(xmlCreateMemoryParserCtxt(NULL, 0));
     xmlFreeURI(xmlCreateURI());
     xmlFreeParserCtxt(xmlCreateURLParserCtxt(NULL, 0));
+    xmlCtxtCheckWellFormed(NULL, NULL);
     xmlCtxtErrMemory(NULL);
     xmlCtxtGetCatalogs(NULL);
     xmlCtxtGetDeclaredEncoding(NULL);
@@ -171,6 +172,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlCtxtSetDict(NULL, NULL);
     xmlCtxtSetErrorHandler(NULL, 0, NULL);
     xmlCtxtSetMaxAmplification(NULL, 0);
+    xmlCtxtSetMaxThreads(NULL, 0);
     xmlCtxtSetOptions(NULL, 0);
     xmlCtxtSetPrivate(NULL, NULL);
     xmlCtxtSetResourceLoader(NULL, 0, NULL);
@@ -192,17 +194,22 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlDictFree(xmlDictCreateSub(NULL));
     xmlDictExists(NULL, NULL, 0);
     xmlDictFree(NULL);
+    xmlDictFreeze(NULL);
+    xmlDictGetStats(NULL, NULL);
     xmlDictGetUsage(NULL);
+    xmlDictFree(xmlDictLoadFile(NULL));
     xmlDictLookup(NULL, NULL, 0);
     xmlDictOwns(NULL, NULL);
     xmlDictQLookup(NULL, NULL, NULL);
     xmlDictReference(NULL);
+    xmlDictSaveFile(NULL, NULL);
     xmlDictSetLimit(NULL, 0);
     xmlDictSize(NULL);
     xmlFreeNode(xmlDocCopyNode(NULL, NULL, 0));
     xmlFreeNode(xmlDocCopyNodeList(NULL, NULL));
     xmlFreeNode(xmlDocGetRootElement(NULL));
     xmlFreeNode(xmlDocSetRootElement(NULL, NULL));
+    xmlDocSnapshotMemory(NULL, NULL, NULL);
     xmlFree(xmlEncodeEntitiesReentrant(NULL, NULL));
     xmlFree(xmlEncodeSpecialChars(NULL, NULL));
     xmlFileClose(NULL);
@@ -223,6 +230,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFreeEnumeration(NULL);
     xmlFreeIDTable(NULL);
     xmlFreeInputStream(NULL);
+    xmlFreeLexer(NULL);
     xmlFreeMutex(NULL);
     xmlFreeNode(NULL);
     xmlFreeNodeList(NULL);
@@ -230,6 +238,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFreeNs(NULL);
     xmlFreeNsList(NULL);
     xmlFreeParserCtxt(NULL);
+    xmlFreeParserCtxtPool(NULL);
     xmlFreeParserInputBuffer(NULL);
     xmlFreeProp(NULL);
     xmlFreePropList(NULL);
@@ -258,6 +267,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlGetLastError();
     xmlGetLineNo(NULL);
     xmlFree(xmlGetNoNsProp(NULL, NULL));
+    xmlGetNodeOffset(NULL);
     xmlFree(xmlGetNodePath(NULL));
     xmlGetNsList(NULL, NULL);
     xmlGetNsListSafe(NULL, NULL, NULL);
@@ -282,6 +292,8 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlHashFree(xmlHashCreateDict(0, NULL), NULL);
     xmlHashDefaultDeallocator(NULL, NULL);
     xmlHashFree(NULL, 0);
+    xmlHashFreeze(NULL);
+    xmlHashGetStats(NULL, NULL);
     xmlHashLookup(NULL, NULL);
     xmlHashLookup2(NULL, NULL, NULL);
     xmlHashLookup3(NULL, NULL, NULL, NULL);
@@ -324,6 +336,8 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlIsolat1ToUTF8(NULL, NULL, NULL, NULL);
     xmlKeepBlanksDefault(0);
     xmlFreeNode(xmlLastElementChild(NULL));
+    xmlLexerGetError(NULL, NULL);
+    xmlLexerNext(NULL, NULL);
     xmlLineNumbersDefault(0);
     xmlLinkGetData(NULL);
     xmlListAppend(NULL, NULL);
@@ -394,6 +408,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFreeInputStream(xmlNewInputFromString(NULL, NULL, 0));
     xmlNewInputFromUrl(NULL, 0, NULL);
     xmlFreeInputStream(xmlNewInputStream(NULL));
+    xmlFreeLexer(xmlNewLexer(NULL, 0, 0));
     xmlFreeMutex(xmlNewMutex());
     xmlFreeNode(xmlNewNode(NULL, NULL));
     xmlFreeNode(xmlNewNodeEatName(NULL, NULL));
@@ -402,6 +417,7 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlNewNsPropEatName(NULL, NULL, NULL, NULL);
     xmlFreeNode(xmlNewPI(NULL, NULL));
     xmlFreeParserCtxt(xmlNewParserCtxt());
+    xmlFreeParserCtxtPool(xmlNewParserCtxtPool(0, 0));
     xmlNewProp(NULL, NULL, NULL);
     xmlFreeRMutex(xmlNewRMutex());
     xmlFreeNode(xmlNewReference(NULL, NULL));
@@ -448,6 +464,8 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlParseURIReference(NULL, NULL);
     xmlParseURISafe(NULL, NULL);
     xmlParserAddNodeInfo(NULL, NULL);
+    xmlFreeParserCtxt(xmlParserCtxtPoolAcquire(NULL));
+    xmlParserCtxtPoolRelease(NULL, NULL);
     xmlParserFindNodeInfo(NULL, NULL);
     xmlParserFindNodeInfoIndex(NULL, NULL);
     xmlParserGetDirectory(NULL);
@@ -479,6 +497,8 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFreeDoc(xmlReadFile(NULL, NULL, 0));
     xmlFreeDoc(xmlReadIO(0, 0, NULL, NULL, NULL, 0));
     xmlFreeDoc(xmlReadMemory(NULL, 0, NULL, NULL, 0));
+    xmlFreeDoc(xmlReadSnapshotFile(NULL, 0));
+    xmlFreeDoc(xmlReadSnapshotMemory(NULL, 0, 0));
     xmlReconciliateNs(NULL, NULL);
     xmlRegisterCharEncodingHandler(NULL);
     xmlRegisterDefaultInputCallbacks();
@@ -1248,6 +1268,17 @@ main(int argc ATTRIBUTE_UNUSED, char **argv ATTRIBUTE_UNUSED) {
     xmlFree(xmlXPathCastToString(NULL));
     xmlXPathCeilingFunction(NULL, 0);
     xmlXPathCmpNodes(NULL, NULL);
+    xmlXPathCompactDocFree(NULL);
+    xmlXPathCompactDocNew(NULL);
+    xmlXPathCompactDocSize(NULL);
+    xmlXPathCompactEval(NULL, NULL, NULL, 0, NULL);
+    xmlXPathCompactNodeContent(NULL, 0);
+    xmlXPathCompactNodeFirstChild(NULL, 0);
+    xmlXPathCompactNodeName(NULL, 0);
+    xmlXPathCompactNodeNextSibling(NULL, 0);
+    xmlXPathCompactNodeNsURI(NULL, 0);
+    xmlXPathCompactNodeParent(NULL, 0);
+    xmlXPathCompactNodeType(NULL, 0);
     xmlXPathCompareValues(NULL, 0, 0);
     xmlXPathCompile(NULL);
     xmlXPathFreeObject(xmlXPathCompiledEval(NULL, NULL));
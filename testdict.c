@@ -2,9 +2,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <libxml/parser.h>
 #include <libxml/dict.h>
 
+#ifndef SIZE_MAX
+  #define SIZE_MAX ((size_t) -1)
+#endif
 
 /**** dictionary tests ****/
 
@@ -395,6 +399,161 @@ test_dict(xmlDict *dict) {
     return(ret);
 }
 
+/*
+ * Test a frozen dictionary and its use as parent
+ */
+static int
+test_frozen_dict(xmlDict *dict) {
+    int i, size;
+    int ret = 0;
+
+    size = xmlDictSize(dict);
+    if (xmlDictFreeze(dict) != 0) {
+        fprintf(stderr, "Failed to freeze dictionary\n");
+        nbErrors++;
+        return(1);
+    }
+
+    for (i = 0;i < NB_STRINGS_MAX;i++) {
+        if (xmlDictLookup(dict, strings1[i], -1) != test1[i]) {
+	    fprintf(stderr, "Failed frozen lookup check for %d, '%s'\n",
+	            i, strings1[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+        if (xmlDictLookup(dict, strings2[i], -1) != NULL) {
+	    fprintf(stderr, "Frozen dictionary added '%s'\n", strings2[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+    }
+    if (xmlDictSize(dict) != size) {
+        fprintf(stderr, "Frozen dictionary size changed\n");
+        ret = 1;
+        nbErrors++;
+    }
+
+    /* Strings of the first sub-dictionary are gone */
+    memset(test2, 0, NB_STRINGS_MAX * sizeof(test2[0]));
+    if (test_subdict(dict) != 0)
+        ret = 1;
+
+    return(ret);
+}
+
+/*
+ * Check the consistency of table statistics
+ */
+static int
+check_stats(const char *name, const xmlHashStats *stats, size_t nbElems) {
+    if ((stats->nbElems != nbElems) ||
+        ((stats->size & (stats->size - 1)) != 0) ||
+        (stats->nbElems > stats->size) ||
+        (stats->totalProbe < stats->nbElems) ||
+        (stats->maxProbe > stats->size) ||
+        (stats->totalProbe > stats->nbElems * stats->maxProbe) ||
+        ((stats->nbElems > 0) &&
+         ((stats->maxProbe == 0) || (stats->memory == 0)))) {
+        fprintf(stderr, "%s: inconsistent statistics\n", name);
+        nbErrors++;
+        return(1);
+    }
+    return(0);
+}
+
+/*
+ * Test saving a dictionary to a file and loading it back
+ */
+static int
+test_dict_file(xmlDict *dict) {
+    const char *filename = "testdict.tmp";
+    xmlDictPtr loaded, sub;
+    const xmlChar *str;
+    int i;
+    int ret = 0;
+
+    if (xmlDictSaveFile(dict, filename) != 0) {
+        fprintf(stderr, "Failed to save dictionary\n");
+        nbErrors++;
+        return(1);
+    }
+    loaded = xmlDictLoadFile(filename);
+    remove(filename);
+    if (loaded == NULL) {
+        fprintf(stderr, "Failed to load dictionary\n");
+        nbErrors++;
+        return(1);
+    }
+
+    if (xmlDictSize(loaded) != xmlDictSize(dict)) {
+        fprintf(stderr, "Loaded dictionary has wrong size\n");
+        ret = 1;
+        nbErrors++;
+    }
+    for (i = 0;i < NB_STRINGS_MAX;i++) {
+        str = xmlDictLookup(loaded, strings1[i], -1);
+        if ((str == NULL) || (!xmlStrEqual(str, strings1[i])) ||
+            (!xmlDictOwns(loaded, str))) {
+	    fprintf(stderr, "Failed loaded lookup check for %d, '%s'\n",
+	            i, strings1[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+        if (xmlDictLookup(loaded, strings2[i], -1) != NULL) {
+	    fprintf(stderr, "Loaded dictionary added '%s'\n", strings2[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+    }
+
+    sub = xmlDictCreateSub(loaded);
+    if (sub == NULL) {
+        fprintf(stderr, "Out of memory while creating sub-dictionary\n");
+        exit(1);
+    }
+    for (i = 0;i < NB_STRINGS_MAX;i++) {
+        if (xmlDictLookup(sub, strings1[i], -1) !=
+            xmlDictLookup(loaded, strings1[i], -1)) {
+	    fprintf(stderr, "Failed sub lookup check for %d, '%s'\n",
+	            i, strings1[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+        str = xmlDictLookup(sub, strings2[i], -1);
+        if ((str == NULL) || (!xmlStrEqual(str, strings2[i])) ||
+            (xmlDictOwns(loaded, str))) {
+	    fprintf(stderr, "Failed sub insert check for %d, '%s'\n",
+	            i, strings2[i]);
+	    ret = 1;
+	    nbErrors++;
+	}
+    }
+    xmlDictFree(sub);
+    xmlDictFree(loaded);
+
+    /* Truncated files must be rejected */
+    {
+        static const char junk[] = "XMLDICT\0\1\0\0\0junk";
+        FILE *f = fopen(filename, "wb");
+
+        if ((f == NULL) || (fwrite(junk, 1, sizeof(junk), f) != sizeof(junk))) {
+            fprintf(stderr, "Failed to write %s\n", filename);
+            exit(1);
+        }
+        fclose(f);
+        loaded = xmlDictLoadFile(filename);
+        remove(filename);
+        if (loaded != NULL) {
+            fprintf(stderr, "Loaded invalid dictionary file\n");
+            xmlDictFree(loaded);
+            ret = 1;
+            nbErrors++;
+        }
+    }
+
+    return(ret);
+}
+
 static int
 testall_dict(void) {
     xmlDictPtr dict;
@@ -426,6 +585,20 @@ testall_dict(void) {
     if (test_subdict(dict) != 0) {
         ret = 1;
     }
+    {
+        xmlHashStats stats;
+
+        if ((xmlDictGetStats(dict, &stats) != 0) ||
+            (check_stats("dict", &stats, xmlDictSize(dict)) != 0) ||
+            (stats.nbGrows == 0))
+            ret = 1;
+    }
+    if (test_frozen_dict(dict) != 0) {
+        ret = 1;
+    }
+    if (test_dict_file(dict) != 0) {
+        ret = 1;
+    }
     xmlDictFree(dict);
 
     clean_strings();
@@ -696,6 +869,73 @@ pool_bulk_remove(StringPool *pool, xmlHashTablePtr hash, size_t num) {
     return ret;
 }
 
+/*
+ * Freeze a table holding the entries of pool1 but none of pool2, then
+ * remove and re-add half of pool1.
+ */
+static int
+test_hash_freeze(xmlHashTablePtr hash, StringPool *pool1, StringPool *pool2) {
+    xmlHashStats stats;
+    size_t i, half;
+    int frozen, ret = 0;
+
+    frozen = xmlHashFreeze(hash);
+    if (frozen < 0) {
+        fprintf(stderr, "hash freeze failed\n");
+        return(1);
+    }
+
+    pool_reset(pool1);
+    if (pool_bulk_lookup(pool1, hash, pool1->num_entries, 1) != 0) {
+        fprintf(stderr, "pool1: frozen hash lookup failed\n");
+        ret = 1;
+    }
+    pool_reset(pool2);
+    if (pool_bulk_lookup(pool2, hash, pool2->num_entries, 0) != 0) {
+        fprintf(stderr, "pool2: frozen hash lookup succeeded unexpectedly\n");
+        ret = 1;
+    }
+    /* Frozen tables have no unused slots and no probe sequences */
+    if ((xmlHashGetStats(hash, &stats) != 0) ||
+        ((frozen) &&
+         ((stats.nbElems != pool1->num_entries) ||
+          (stats.size != stats.nbElems) ||
+          (stats.maxProbe != 1)))) {
+        fprintf(stderr, "frozen hash: inconsistent statistics\n");
+        ret = 1;
+    }
+
+    half = pool1->num_entries / 2;
+    pool_reset(pool1);
+    if (pool_bulk_remove(pool1, hash, half) != 0) {
+        fprintf(stderr, "pool1: frozen hash remove failed\n");
+        ret = 1;
+    }
+    if (pool_bulk_lookup(pool1, hash, pool1->num_entries - half, 1) != 0) {
+        fprintf(stderr, "pool1: lookup after frozen remove failed\n");
+        ret = 1;
+    }
+
+    /* Adding entries thaws the table */
+    for (i = 0; i < half * pool1->num_keys; i += pool1->num_keys) {
+        xmlChar **str = &pool1->strings[i];
+
+        if (xmlHashAdd3(hash, str[0],
+                        pool1->num_keys > 1 ? str[1] : NULL,
+                        pool1->num_keys > 2 ? str[2] : NULL, str[0]) != 1) {
+            fprintf(stderr, "pool1: frozen hash insert failed\n");
+            ret = 1;
+        }
+    }
+    pool_reset(pool1);
+    if (pool_bulk_lookup(pool1, hash, pool1->num_entries, 1) != 0) {
+        fprintf(stderr, "pool1: lookup after thawing failed\n");
+        ret = 1;
+    }
+
+    return(ret);
+}
+
 static int
 test_hash(size_t num_entries, size_t num_keys, int use_dict) {
     xmlDict *dict = NULL;
@@ -758,6 +998,17 @@ test_hash(size_t num_entries, size_t num_keys, int use_dict) {
         ret = 1;
     }
 
+    {
+        xmlHashStats stats;
+
+        if ((xmlHashGetStats(hash, &stats) != 0) ||
+            (check_stats("hash", &stats, xmlHashSize(hash)) != 0))
+            ret = 1;
+    }
+
+    if (test_hash_freeze(hash, pool1, pool2) != 0)
+        ret = 1;
+
     pool_free(pool1);
     pool_free(pool2);
     xmlHashFree(hash, NULL);
@@ -766,6 +1017,120 @@ test_hash(size_t num_entries, size_t num_keys, int use_dict) {
     return ret;
 }
 
+#define NB_RESIZE_KEYS 60000
+
+typedef struct {
+    xmlHashTablePtr hash;
+    size_t count;
+} ResizeScan;
+
+static void
+resize_scan_count(void *payload ATTRIBUTE_UNUSED, void *data,
+                  const xmlChar *name ATTRIBUTE_UNUSED) {
+    ((ResizeScan *) data)->count++;
+}
+
+static void
+resize_scan_remove(void *payload ATTRIBUTE_UNUSED, void *data,
+                   const xmlChar *name) {
+    ResizeScan *scan = data;
+
+    scan->count++;
+    xmlHashRemoveEntry(scan->hash, name, NULL);
+}
+
+static void *
+resize_copy(void *payload, const xmlChar *name ATTRIBUTE_UNUSED) {
+    return(payload);
+}
+
+/*
+ * Test a large table while it's resized incrementally. Crossing the
+ * fill limit of 65536 buckets starts migrating entries to the new
+ * table, which takes a few thousand more insertions.
+ */
+static int
+test_hash_resize(void) {
+    xmlHashTablePtr hash, copy;
+    xmlChar *keys;
+    ResizeScan scan;
+    size_t i;
+    int ret = 0;
+
+    keys = xmlMalloc(NB_RESIZE_KEYS * 16);
+    hash = xmlHashCreate(0);
+    if ((keys == NULL) || (hash == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < NB_RESIZE_KEYS; i++) {
+        xmlChar *key = keys + i * 16;
+
+        snprintf((char *) key, 16, "k%lu", (unsigned long) i);
+        if (xmlHashAdd(hash, key, key) != 1) {
+            fprintf(stderr, "resize: hash insert failed\n");
+            ret = 1;
+        }
+    }
+
+    for (i = 0; i < NB_RESIZE_KEYS; i++) {
+        xmlChar *key = keys + i * 16;
+
+        if ((xmlHashLookup(hash, key) != key) ||
+            (xmlHashAdd(hash, key, NULL) != 0)) {
+            fprintf(stderr, "resize: hash lookup failed\n");
+            ret = 1;
+        }
+    }
+
+    scan.hash = hash;
+    scan.count = 0;
+    xmlHashScan(hash, resize_scan_count, &scan);
+    if (scan.count != NB_RESIZE_KEYS) {
+        fprintf(stderr, "resize: scan found %lu entries\n",
+                (unsigned long) scan.count);
+        ret = 1;
+    }
+
+    copy = xmlHashCopySafe(hash, resize_copy, NULL);
+    if ((copy == NULL) || (xmlHashSize(copy) != NB_RESIZE_KEYS) ||
+        (xmlHashLookup(copy, keys) != keys)) {
+        fprintf(stderr, "resize: hash copy failed\n");
+        ret = 1;
+    }
+    xmlHashFree(copy, NULL);
+
+    for (i = 0; i < NB_RESIZE_KEYS; i += 2) {
+        if (xmlHashRemoveEntry(hash, keys + i * 16, NULL) != 0) {
+            fprintf(stderr, "resize: hash remove failed\n");
+            ret = 1;
+        }
+    }
+    for (i = 0; i < NB_RESIZE_KEYS; i++) {
+        xmlChar *key = keys + i * 16;
+
+        if (xmlHashLookup(hash, key) != ((i & 1) ? key : NULL)) {
+            fprintf(stderr, "resize: lookup after remove failed\n");
+            ret = 1;
+        }
+    }
+
+    /* Remove the remaining entries while scanning */
+    scan.count = 0;
+    xmlHashScan(hash, resize_scan_remove, &scan);
+    if ((scan.count != NB_RESIZE_KEYS / 2) || (xmlHashSize(hash) != 0)) {
+        fprintf(stderr, "resize: removing scan failed\n");
+        ret = 1;
+    }
+
+    if (ret)
+        nbErrors++;
+    xmlHashFree(hash, NULL);
+    xmlFree(keys);
+    return(ret);
+}
+
 static int
 testall_hash(void) {
     size_t num_keys;
@@ -791,18 +1156,262 @@ testall_hash(void) {
         }
     }
 
+    if (test_hash_resize() != 0)
+        return(1);
+
+    return(0);
+}
+
+
+/**** Lookup benchmark ****/
+
+/*
+ * Names as they show up in XHTML, XML Schema, SVG and OpenDocument
+ * files, including namespace URIs which are interned as well. The
+ * list is roughly ordered by frequency.
+ */
+static const char *const benchNames[] = {
+    "a", "p", "id", "li", "td", "tr", "div", "span", "class", "href",
+    "name", "type", "style", "value", "title", "item", "text", "ul",
+    "img", "src", "alt", "table", "body", "head", "html", "meta", "link",
+    "rect", "path", "fill", "stroke", "xmlns", "lang", "xml:lang",
+    "xs:element", "xs:sequence", "minOccurs", "maxOccurs", "xs:string",
+    "xs:attribute", "xs:complexType", "xs:annotation", "xs:documentation",
+    "text:p", "text:span", "style:name", "table:table-cell",
+    "table:table-row", "text:style-name", "style:family",
+    "xs:simpleContent", "xs:complexContent", "attributeFormDefault",
+    "elementFormDefault", "targetNamespace", "style:text-properties",
+    "style:paragraph-properties", "style:table-cell-properties",
+    "office:document-content", "table:number-columns-repeated",
+    "http://www.w3.org/1999/xhtml",
+    "http://www.w3.org/2000/svg",
+    "http://www.w3.org/2001/XMLSchema",
+    "http://www.w3.org/1999/xlink",
+    "http://www.w3.org/XML/1998/namespace",
+    "urn:oasis:names:tc:opendocument:xmlns:office:1.0",
+    "urn:oasis:names:tc:opendocument:xmlns:style:1.0",
+    "urn:oasis:names:tc:opendocument:xmlns:text:1.0"
+};
+
+#define NB_BENCH_NAMES (sizeof(benchNames) / sizeof(benchNames[0]))
+#define NB_BENCH_LOOKUPS 100000
+#define MIN_BENCH_TIME 0.25
+
+/*
+ * Time lookups of names with a length in [minLen, maxLen), drawn
+ * with a Zipf-like distribution from the list above.
+ */
+static int
+bench_dict_lookup(const char *label, size_t minLen, size_t maxLen,
+                  int knownLen) {
+    const xmlChar **names;
+    int *lens;
+    const char *candidates[NB_BENCH_NAMES];
+    size_t nbCandidates = 0, totalLen = 0, i;
+    xmlDictPtr dict;
+    unsigned long reps = 0;
+    double elapsed;
+    clock_t start;
+
+    for (i = 0; i < NB_BENCH_NAMES; i++) {
+        size_t len = strlen(benchNames[i]);
+
+        if ((len >= minLen) && (len < maxLen))
+            candidates[nbCandidates++] = benchNames[i];
+    }
+    if (nbCandidates == 0)
+        return(0);
+
+    names = xmlMalloc(NB_BENCH_LOOKUPS * sizeof(names[0]));
+    lens = xmlMalloc(NB_BENCH_LOOKUPS * sizeof(lens[0]));
+    dict = xmlDictCreate();
+    if ((names == NULL) || (lens == NULL) || (dict == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+
+    for (i = 0; i < NB_BENCH_LOOKUPS; i++) {
+        /* Rank r is picked with probability proportional to 1 / (r + 1) */
+        size_t r = my_rand(nbCandidates);
+
+        r = my_rand(r + 1);
+        names[i] = BAD_CAST candidates[r];
+        lens[i] = knownLen ? (int) strlen(candidates[r]) : -1;
+        totalLen += strlen(candidates[r]);
+    }
+
+    start = clock();
+    do {
+        for (i = 0; i < NB_BENCH_LOOKUPS; i++) {
+            if (xmlDictLookup(dict, names[i], lens[i]) == NULL) {
+                fprintf(stderr, "Lookup failed\n");
+                return(1);
+            }
+        }
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    printf("%-10s %-6s %6.1f %8.2f %8.1f\n", label,
+           knownLen ? "len" : "-1",
+           (double) totalLen / NB_BENCH_LOOKUPS,
+           elapsed * 1e9 / ((double) reps * NB_BENCH_LOOKUPS),
+           (double) reps * NB_BENCH_LOOKUPS / elapsed / 1e6);
+
+    xmlDictFree(dict);
+    xmlFree(names);
+    xmlFree(lens);
+    return(0);
+}
+
+/*
+ * Keys of the hash table benchmark look like generated IDs. Keys
+ * with prefix 'x' are never inserted and produce misses.
+ */
+static xmlChar **
+bench_hash_keys(size_t num, char prefix) {
+    xmlChar **keys;
+    xmlChar *mem;
+    size_t i;
+
+    keys = xmlMalloc(num * sizeof(keys[0]));
+    mem = xmlMalloc(num * 24);
+    if ((keys == NULL) || (mem == NULL)) {
+        xmlFree(keys);
+        xmlFree(mem);
+        return(NULL);
+    }
+
+    for (i = 0; i < num; i++) {
+        keys[i] = mem + i * 24;
+        snprintf((char *) keys[i], 24, "%c%lu", prefix, (unsigned long) i);
+    }
+
+    return(keys);
+}
+
+/*
+ * Time hits and misses in a hash table with num entries, using keys
+ * in random order. Also report the slowest insertion, which includes
+ * the resizes.
+ */
+static int
+bench_hash_lookup(size_t num) {
+    xmlHashTablePtr hash;
+    xmlChar **keys, **other;
+    size_t *order;
+    size_t i, numLookups;
+    double elapsed[4];
+    clock_t maxInsert = 0;
+    int frozen, miss;
+
+    keys = bench_hash_keys(num, 'i');
+    other = bench_hash_keys(num, 'x');
+    numLookups = num < NB_BENCH_LOOKUPS ? num : NB_BENCH_LOOKUPS;
+    order = xmlMalloc(numLookups * sizeof(order[0]));
+    hash = xmlHashCreate(0);
+    if ((keys == NULL) || (other == NULL) || (order == NULL) ||
+        (hash == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+
+    for (i = 0; i < num; i++) {
+        clock_t start = clock();
+
+        if (xmlHashAdd(hash, keys[i], keys[i]) != 1) {
+            fprintf(stderr, "Hash insert failed\n");
+            return(1);
+        }
+        start = clock() - start;
+        if (start > maxInsert)
+            maxInsert = start;
+    }
+    for (i = 0; i < numLookups; i++)
+        order[i] = ((size_t) my_rand(1u << 16) << 16 | my_rand(1u << 16)) %
+                   num;
+
+    /* Large tables can't be frozen */
+    for (frozen = 0; frozen <= 1; frozen++) {
+        if ((frozen) && (xmlHashFreeze(hash) != 1)) {
+            elapsed[2] = elapsed[3] = 0.0;
+            break;
+        }
+
+        for (miss = 0; miss <= 1; miss++) {
+            xmlChar **lookup = miss ? other : keys;
+            double *result = &elapsed[frozen * 2 + miss];
+            unsigned long reps = 0;
+            clock_t start;
+
+            start = clock();
+            do {
+                for (i = 0; i < numLookups; i++) {
+                    const xmlChar *key = lookup[order[i]];
+
+                    if ((xmlHashLookup(hash, key) != NULL) != !miss) {
+                        fprintf(stderr, "Hash lookup failed\n");
+                        return(1);
+                    }
+                }
+                reps++;
+                *result = (double) (clock() - start) / CLOCKS_PER_SEC;
+            } while (*result < MIN_BENCH_TIME);
+            *result = *result * 1e9 / ((double) reps * numLookups);
+        }
+    }
+
+    printf("%-10lu %8.2f %8.2f %10.3f %8.2f %8.2f\n", (unsigned long) num,
+           elapsed[0], elapsed[1], (double) maxInsert / CLOCKS_PER_SEC * 1e3,
+           elapsed[2], elapsed[3]);
+
+    xmlHashFree(hash, NULL);
+    xmlFree(keys[0]);
+    xmlFree(keys);
+    xmlFree(other[0]);
+    xmlFree(other);
+    xmlFree(order);
     return(0);
 }
 
+static int
+bench_dict(void) {
+    size_t num;
+    int ret = 0;
+    int knownLen;
+
+    printf("%-10s %-6s %6s %8s %8s\n",
+           "names", "length", "avg", "ns/op", "Mops/s");
+    for (knownLen = 1; knownLen >= 0; knownLen--) {
+        ret |= bench_dict_lookup("all", 0, SIZE_MAX, knownLen);
+        ret |= bench_dict_lookup("short", 0, 16, knownLen);
+        ret |= bench_dict_lookup("long", 16, SIZE_MAX, knownLen);
+    }
+
+    printf("\n%-10s %8s %8s %10s %8s %8s\n",
+           "entries", "hit ns", "miss ns", "max ins ms",
+           "frz hit", "frz miss");
+    for (num = 1000; num <= 10000000; num *= 10)
+        ret |= bench_hash_lookup(num);
+
+    return(ret);
+}
+
 
 /**** main ****/
 
 int
-main(void) {
+main(int argc, char **argv) {
     int ret = 0;
 
     LIBXML_TEST_VERSION
 
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) {
+        ret = bench_dict();
+        xmlCleanupParser();
+        return(ret);
+    }
+
     if (testall_dict() != 0) {
         fprintf(stderr, "dictionary tests failed\n");
         ret = 1;
@@ -16,7 +16,9 @@
 #include <libxml/HTMLparser.h>
 #include <libxml/HTMLtree.h>
 
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef LIBXML_SAX1_ENABLED
 static void
@@ -586,6 +588,54 @@ testPushCDataEnd(void) {
 
     return err;
 }
+
+/*
+ * Push documents with terminators and partial terminators split at
+ * every chunk boundary and compare with the pull parser.
+ */
+static int
+testPushChunkBoundaries(void) {
+    static const char doc[] =
+        "<doc a='x>y' b=\"'\">"
+        "<!-- a -b- c - --><?pi a ? b ?\?><![CDATA[ ] ]] ]]]>"
+        "<e>t&amp;t</e><!---->\n</doc>";
+    int size = sizeof(doc) - 1;
+    xmlDocPtr ref;
+    xmlChar *refOut;
+    int chunkSize, refSize;
+    int err = 0;
+
+    ref = xmlReadMemory(doc, size, NULL, NULL, 0);
+    xmlDocDumpMemory(ref, &refOut, &refSize);
+    xmlFreeDoc(ref);
+
+    for (chunkSize = 1; chunkSize <= size; chunkSize++) {
+        xmlParserCtxtPtr ctxt;
+        xmlChar *out = NULL;
+        int i, outSize;
+
+        ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+        for (i = 0; i < size; i += chunkSize)
+            xmlParseChunk(ctxt, doc + i,
+                          size - i < chunkSize ? size - i : chunkSize, 0);
+        xmlParseChunk(ctxt, NULL, 0, 1);
+
+        if (ctxt->myDoc != NULL)
+            xmlDocDumpMemory(ctxt->myDoc, &out, &outSize);
+        if ((!ctxt->wellFormed) || (!xmlStrEqual(out, refOut))) {
+            fprintf(stderr, "testPushChunkBoundaries failed with chunk "
+                    "size %d\n", chunkSize);
+            err = 1;
+        }
+
+        xmlFree(out);
+        xmlFreeDoc(ctxt->myDoc);
+        xmlFreeParserCtxt(ctxt);
+    }
+
+    xmlFree(refOut);
+    return(err);
+}
 #endif /* PUSH */
 
 #ifdef LIBXML_HTML_ENABLED
@@ -1388,16 +1438,1572 @@ testCharEncConvImpl(void) {
     return err;
 }
 
+/*
+ * Check line and column numbers after runs of character data which
+ * are skipped a word at a time.
+ */
+static int
+testCharDataPosition(void) {
+    xmlParserCtxtPtr ctxt;
+    char doc[200];
+    int err = 0;
+    int n, m, k;
+
+    ctxt = xmlNewParserCtxt();
+
+    for (n = 0; n < 20; n += 3) {
+        for (m = 0; m < 20; m++) {
+            for (k = 0; k < 20; k += 5) {
+                const xmlError *error;
+                int len;
+
+                len = snprintf(doc, sizeof(doc), "<d>%.*s\n%.*s\t%.*s]]></d>",
+                               n, "aaaaaaaaaaaaaaaaaaaa",
+                               m, "bbbbbbbbbbbbbbbbbbbb",
+                               k, "cccccccccccccccccccc");
+                xmlFreeDoc(xmlCtxtReadMemory(ctxt, doc, len, NULL, NULL,
+                                             XML_PARSE_NOERROR));
+                error = xmlCtxtGetLastError(ctxt);
+
+                if ((error == NULL) ||
+                    (error->code != XML_ERR_MISPLACED_CDATA_END) ||
+                    (error->line != 2) ||
+                    (error->int2 != m + k + 2)) {
+                    fprintf(stderr, "testCharDataPosition failed for "
+                            "%d %d %d\n", n, m, k);
+                    err = 1;
+                }
+            }
+        }
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    return err;
+}
+
+/*
+ * Compare documents parsed with and without XML_PARSE_INDEXED,
+ * including line numbers and documents which fall back to the
+ * regular parser.
+ */
+static int
+testIndexedNodeLines(xmlNodePtr a, xmlNodePtr b) {
+    while ((a != NULL) && (b != NULL)) {
+        if ((a->type != b->type) || (a->line != b->line))
+            return(-1);
+        if ((a->type == XML_ELEMENT_NODE) &&
+            (testIndexedNodeLines(a->children, b->children) < 0))
+            return(-1);
+        a = a->next;
+        b = b->next;
+    }
+
+    return((a == b) ? 0 : -1);
+}
+
+static int
+testIndexed(void) {
+    static const char *const docs[] = {
+        "<d/>",
+        "<?xml version='1.0'?>\n<d a='1' b=\"2\">text</d>\n",
+        "<?xml version=\"1.0\" encoding=\"utf-8\" standalone='yes'?><d/>",
+        "<!-- c -->\n<?pi data?>\n<d>\n<e>a&amp;b&#x20AC;&#65;</e>\n"
+            "<![CDATA[<x>]]>\n<?pi?><!--c--></d>\n<!-- end -->",
+        "<a:d xmlns:a='urn:a' xmlns='urn:b' a:x='1' x='2'>\n"
+            "<e xmlns=''><a:f/></e>\n</a:d>",
+        "<d a='\t&lt;x&gt;\n'\n   b = 'caf\xC3\xA9'>\xE2\x82\xAC</d>",
+        "<d xml:lang='en' xml:space='preserve'> <e/> </d>",
+        /* Documents handled by the regular parser */
+        "<!DOCTYPE d [<!ENTITY e 'x'>]><d>&e;</d>",
+        "<d a='1' a='2'/>",
+        "<d>\r\n</d>",
+        "<?xml version='1.0' encoding='ISO-8859-1'?><d>\xE9</d>",
+        "<d><e></d>",
+        "<a:d/>",
+        "<d xml:id='x'/>",
+        "<d>]]></d>",
+        "<d/><e/>",
+        "<d>\xC3</d>",
+        "<d>&#0;</d>",
+        "<d xmlns:a=''/>",
+    };
+    xmlParserCtxtPtr ctxt;
+    size_t i;
+    int err = 0;
+
+    ctxt = xmlNewParserCtxt();
+
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        xmlDocPtr doc, idoc;
+        xmlChar *out = NULL, *iout = NULL;
+        const xmlError *error;
+        int code, icode, wf, iwf, size;
+
+        doc = xmlCtxtReadMemory(ctxt, docs[i], strlen(docs[i]), NULL, NULL,
+                                XML_PARSE_NOERROR | XML_PARSE_RECOVER);
+        error = xmlCtxtGetLastError(ctxt);
+        code = error ? error->code : 0;
+        wf = ctxt->wellFormed;
+        idoc = xmlCtxtReadMemory(ctxt, docs[i], strlen(docs[i]), NULL, NULL,
+                                 XML_PARSE_NOERROR | XML_PARSE_RECOVER |
+                                 XML_PARSE_INDEXED);
+        error = xmlCtxtGetLastError(ctxt);
+        icode = error ? error->code : 0;
+        iwf = ctxt->wellFormed;
+
+        if (doc != NULL)
+            xmlDocDumpMemory(doc, &out, &size);
+        if (idoc != NULL)
+            xmlDocDumpMemory(idoc, &iout, &size);
+
+        if ((code != icode) || (wf != iwf) ||
+            ((doc == NULL) != (idoc == NULL)) ||
+            ((doc != NULL) &&
+             ((!xmlStrEqual(out, iout)) ||
+              (testIndexedNodeLines(doc->children, idoc->children) < 0)))) {
+            fprintf(stderr, "testIndexed failed for document %d\n", (int) i);
+            err = 1;
+        }
+
+        xmlFree(out);
+        xmlFree(iout);
+        xmlFreeDoc(doc);
+        xmlFreeDoc(idoc);
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    return err;
+}
+
+/*
+ * Compare documents parsed with and without threads, including line
+ * numbers and documents which have to be parsed sequentially.
+ */
+static char *
+testParallelDoc(const char *pre, const char *post, const char *tail,
+                size_t *sizeOut) {
+    static const char rec[] =
+        "  <rec n='%d' x:k='v&amp;%d'>\r\n"
+        "    <name>caf\xC3\xA9 &lt;%d&#x41;</name>\r\n"
+        "    <![CDATA[ <x> ]]><!-- c --><?pi %d?>\n"
+        "    <x:v xmlns:y='urn:y' y:z='%d'/>\n"
+        "  </rec>\n";
+    size_t max = 2000000;
+    size_t size = 0;
+    char *doc;
+    int i;
+
+    doc = malloc(max);
+    if (doc == NULL)
+        return(NULL);
+
+    size += snprintf(doc + size, max - size,
+                     "<?xml version='1.0'?>\n"
+                     "<db xmlns='urn:d' xmlns:x='urn:x'>\n");
+    for (i = 0; i < 9000; i++) {
+        if (i == 3000)
+            size += snprintf(doc + size, max - size, "%s", pre);
+        size += snprintf(doc + size, max - size, rec, i, i, i, i, i);
+        if (i == 5999)
+            size += snprintf(doc + size, max - size, "%s", post);
+    }
+    size += snprintf(doc + size, max - size, "</db>\n%s", tail);
+
+    *sizeOut = size;
+    return(doc);
+}
+
+/*
+ * Check that xml: attributes use the XML namespace of their document.
+ */
+static int
+testParallelXmlNs(xmlDocPtr doc) {
+    xmlNodePtr cur;
+
+    for (cur = xmlDocGetRootElement(doc)->children; cur != NULL;
+         cur = cur->next) {
+        xmlAttrPtr attr;
+
+        if (cur->type != XML_ELEMENT_NODE)
+            continue;
+        for (attr = cur->properties; attr != NULL; attr = attr->next) {
+            if ((attr->ns != NULL) &&
+                (xmlStrEqual(attr->ns->prefix, BAD_CAST "xml")) &&
+                (attr->ns != xmlSearchNs(doc, cur, BAD_CAST "xml")))
+                return(-1);
+        }
+    }
+
+    return(0);
+}
+
+static int
+testParallel(void) {
+    static const char *const cases[][3] = {
+        { "", "", "" },
+        { "", "", "<!-- end -->\n" },
+        { "<rec xml:lang='en' xml:space='preserve'/>",
+          "<rec xml:lang='de'/>", "" },
+        /* Documents which can't be split */
+        { "<!--", "-->", "" },
+        { "<![CDATA[", "]]>", "" },
+        { "<rec>", "</rec>", "" },
+        { "<rec xml:id='a'/>", "", "" },
+        { "<rec>&e;</rec>", "", "" },
+        { "<rec a='1' a='2'/>", "", "" },
+        { "<rec>", "", "" },
+        { "", "", "<!-- </rec> -->" },
+        { "<rec>\r</rec>", "", "" },
+    };
+    xmlParserCtxtPtr ctxt, pctxt;
+    size_t i;
+    int err = 0;
+
+    ctxt = xmlNewParserCtxt();
+    pctxt = xmlNewParserCtxt();
+    xmlCtxtSetMaxThreads(pctxt, 4);
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        xmlDocPtr doc, pdoc;
+        xmlChar *out = NULL, *pout = NULL;
+        const xmlError *error;
+        char *buf;
+        size_t bufSize;
+        int code, pcode, size;
+
+        buf = testParallelDoc(cases[i][0], cases[i][1], cases[i][2],
+                              &bufSize);
+        if (buf == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            err = 1;
+            break;
+        }
+
+        doc = xmlCtxtReadMemory(ctxt, buf, bufSize, NULL, NULL,
+                                XML_PARSE_NOERROR | XML_PARSE_RECOVER);
+        error = xmlCtxtGetLastError(ctxt);
+        code = error ? error->code : 0;
+        pdoc = xmlCtxtReadMemory(pctxt, buf, bufSize, NULL, NULL,
+                                 XML_PARSE_NOERROR | XML_PARSE_RECOVER);
+        error = xmlCtxtGetLastError(pctxt);
+        pcode = error ? error->code : 0;
+
+        if (doc != NULL)
+            xmlDocDumpMemory(doc, &out, &size);
+        if (pdoc != NULL)
+            xmlDocDumpMemory(pdoc, &pout, &size);
+
+        if ((code != pcode) || (ctxt->wellFormed != pctxt->wellFormed) ||
+            ((doc == NULL) != (pdoc == NULL)) ||
+            ((doc != NULL) &&
+             ((!xmlStrEqual(out, pout)) ||
+              (testIndexedNodeLines(doc->children, pdoc->children) < 0) ||
+              (testParallelXmlNs(pdoc) < 0) ||
+              ((xmlGetID(doc, BAD_CAST "a") == NULL) !=
+               (xmlGetID(pdoc, BAD_CAST "a") == NULL))))) {
+            fprintf(stderr, "testParallel failed for case %d\n", (int) i);
+            err = 1;
+        }
+
+        xmlFree(out);
+        xmlFree(pout);
+        xmlFreeDoc(doc);
+        xmlFreeDoc(pdoc);
+        free(buf);
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    xmlFreeParserCtxt(pctxt);
+    return err;
+}
+
+static int
+testArena(void) {
+    static const char xml[] =
+        "<doc xmlns:x='urn:x'>\n"
+        "  <a x:k='v&amp;1'>text &lt;one&gt;</a>\n"
+        "  <b><![CDATA[ cdata ]]><!-- c --><?pi data?></b>\n"
+        "  <c>long text which doesn't fit into the node</c>\n"
+        "</doc>\n";
+    static const char expected[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<doc xmlns:x=\"urn:x\">\n"
+        "  <a x:k=\"new\">text &lt;one&gt; and more</a>\n"
+        "  <renamed><![CDATA[ cdata ]]><!-- c --><?pi data?><c/></renamed>\n"
+        "  </doc>\n";
+    xmlParserCtxtPtr ctxt;
+    xmlDocPtr doc, ref, other;
+    xmlNodePtr root, a, b, c, last, moved;
+    xmlNsPtr ns;
+    xmlChar *out = NULL, *refOut = NULL;
+    char *buf;
+    size_t bufSize;
+    int size, err = 0;
+
+    doc = xmlReadMemory(xml, sizeof(xml) - 1, NULL, NULL, XML_PARSE_ARENA);
+    ref = xmlReadMemory(xml, sizeof(xml) - 1, NULL, NULL, 0);
+    if ((doc == NULL) || (ref == NULL)) {
+        fprintf(stderr, "testArena: parsing failed\n");
+        xmlFreeDoc(doc);
+        xmlFreeDoc(ref);
+        return(1);
+    }
+
+    xmlDocDumpMemory(doc, &out, &size);
+    xmlDocDumpMemory(ref, &refOut, &size);
+    if (!xmlStrEqual(out, refOut)) {
+        fprintf(stderr, "testArena: arena tree differs\n");
+        err = 1;
+    }
+    xmlFree(out);
+    xmlFree(refOut);
+    xmlFreeDoc(ref);
+
+    /* Mutate arena-owned nodes and strings */
+    root = xmlDocGetRootElement(doc);
+    a = xmlFirstElementChild(root);
+    b = xmlNextElementSibling(a);
+    c = xmlNextElementSibling(b);
+    xmlNodeAddContent(a->children, BAD_CAST " and more");
+    xmlSetNsProp(a, a->properties->ns, BAD_CAST "k", BAD_CAST "new");
+    xmlNodeSetName(b, BAD_CAST "renamed");
+    xmlNodeSetContent(c, NULL);
+    xmlUnlinkNode(c);
+    xmlAddChild(b, c);
+    last = root->last;
+    xmlUnlinkNode(last);
+    xmlFreeNode(last);
+
+    xmlDocDumpMemory(doc, &out, &size);
+    if (!xmlStrEqual(out, BAD_CAST expected)) {
+        fprintf(stderr, "testArena: unexpected result: %s\n", out);
+        err = 1;
+    }
+    xmlFree(out);
+
+    /* Namespaces from xmlNewNs can be freed with xmlFreeNs */
+    ns = xmlNewNs(b, BAD_CAST "urn:y", BAD_CAST "y");
+    if ((ns == NULL) || (b->nsDef != ns)) {
+        fprintf(stderr, "testArena: xmlNewNs failed\n");
+        err = 1;
+    } else {
+        b->nsDef = NULL;
+        xmlFreeNs(ns);
+    }
+
+    /* Nodes moved to another document must outlive the source */
+    other = xmlNewDoc(NULL);
+    moved = xmlNewDocNode(other, NULL, BAD_CAST "root", NULL);
+    xmlDocSetRootElement(other, moved);
+    xmlUnlinkNode(a);
+    xmlAddChild(moved, a);
+    xmlReconciliateNs(other, a);
+    xmlFreeDoc(doc);
+
+    xmlDocDumpMemory(other, &out, &size);
+    if (!xmlStrEqual(out, BAD_CAST
+            "<?xml version=\"1.0\"?>\n"
+            "<root><a xmlns:x=\"urn:x\" x:k=\"new\">"
+            "text &lt;one&gt; and more</a></root>\n")) {
+        fprintf(stderr, "testArena: unexpected moved tree: %s\n", out);
+        err = 1;
+    }
+    xmlFree(out);
+    xmlFreeDoc(other);
+
+    /* Worker threads allocate from their own arenas */
+    buf = testParallelDoc("", "", "", &bufSize);
+    if (buf == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+    ctxt = xmlNewParserCtxt();
+    xmlCtxtSetMaxThreads(ctxt, 4);
+    doc = xmlCtxtReadMemory(ctxt, buf, bufSize, NULL, NULL, XML_PARSE_ARENA);
+    ref = xmlReadMemory(buf, bufSize, NULL, NULL, 0);
+    if ((doc == NULL) || (ref == NULL)) {
+        fprintf(stderr, "testArena: parallel parsing failed\n");
+        err = 1;
+    } else {
+        xmlDocDumpMemory(doc, &out, &size);
+        xmlDocDumpMemory(ref, &refOut, &size);
+        if (!xmlStrEqual(out, refOut)) {
+            fprintf(stderr, "testArena: parallel arena tree differs\n");
+            err = 1;
+        }
+        xmlFree(out);
+        xmlFree(refOut);
+    }
+    xmlFreeDoc(doc);
+    xmlFreeDoc(ref);
+    xmlFreeParserCtxt(ctxt);
+    free(buf);
+
+    return(err);
+}
+
+static int
+testCtxtPool(void) {
+    char deep[1024];
+    xmlParserCtxtPool *pool;
+    xmlParserCtxtPtr ctxt, ctxt2, reused;
+    xmlDocPtr doc, doc2;
+    size_t size = 0;
+    int i;
+    int err = 0;
+
+    for (i = 0; i < 100; i++)
+        size += sprintf(deep + size, "<e>");
+    for (i = 0; i < 100; i++)
+        size += sprintf(deep + size, "</e>");
+
+    pool = xmlNewParserCtxtPool(1, 1000);
+    ctxt = xmlParserCtxtPoolAcquire(pool);
+    xmlCtxtSetPrivate(ctxt, ctxt);
+    doc = xmlCtxtReadMemory(ctxt, deep, size, NULL, NULL, XML_PARSE_NOBLANKS);
+    if (doc == NULL) {
+        fprintf(stderr, "testCtxtPool: parsing failed\n");
+        err = 1;
+    }
+
+    /* Pool is full after the first release */
+    ctxt2 = xmlParserCtxtPoolAcquire(pool);
+    xmlParserCtxtPoolRelease(pool, ctxt);
+    xmlParserCtxtPoolRelease(pool, ctxt2);
+
+    reused = xmlParserCtxtPoolAcquire(pool);
+    if (reused != ctxt) {
+        fprintf(stderr, "testCtxtPool: context not reused\n");
+        err = 1;
+    }
+    if ((xmlCtxtGetPrivate(reused) != NULL) ||
+        (xmlCtxtGetSaxHandler(reused)->ignorableWhitespace !=
+         xmlSAX2Characters) ||
+        ((doc != NULL) && (xmlCtxtGetDict(reused) == doc->dict))) {
+        fprintf(stderr, "testCtxtPool: context not restored\n");
+        err = 1;
+    }
+
+    doc2 = xmlCtxtReadMemory(reused, "<doc>  <a/></doc>", 17, NULL, NULL, 0);
+    if ((doc2 == NULL) ||
+        (doc2->children->children->type != XML_TEXT_NODE)) {
+        fprintf(stderr, "testCtxtPool: reused context failed\n");
+        err = 1;
+    }
+    xmlFreeDoc(doc2);
+    xmlParserCtxtPoolRelease(pool, reused);
+    xmlFreeParserCtxtPool(pool);
+
+    /* Contexts exceeding the item limit aren't kept */
+    pool = xmlNewParserCtxtPool(1, 50);
+    ctxt = xmlParserCtxtPoolAcquire(pool);
+    ctxt2 = xmlParserCtxtPoolAcquire(pool);
+    xmlFreeDoc(xmlCtxtReadMemory(ctxt, deep, size, NULL, NULL, 0));
+    xmlParserCtxtPoolRelease(pool, ctxt);
+    xmlParserCtxtPoolRelease(pool, ctxt2);
+    reused = xmlParserCtxtPoolAcquire(pool);
+    if (reused != ctxt2) {
+        fprintf(stderr, "testCtxtPool: large context kept\n");
+        err = 1;
+    }
+    xmlParserCtxtPoolRelease(pool, reused);
+    xmlFreeParserCtxtPool(pool);
+
+    /* Large dictionaries are replaced, the context is kept */
+    size = sprintf(deep, "<doc>");
+    for (i = 0; i < 100; i++)
+        size += sprintf(deep + size, "<e%d/>", i);
+    size += sprintf(deep + size, "</doc>");
+    pool = xmlNewParserCtxtPool(1, 50);
+    ctxt = xmlParserCtxtPoolAcquire(pool);
+    xmlFreeDoc(xmlCtxtReadMemory(ctxt, deep, size, NULL, NULL, 0));
+    if (xmlDictSize(xmlCtxtGetDict(ctxt)) <= 100) {
+        fprintf(stderr, "testCtxtPool: names not in dictionary\n");
+        err = 1;
+    }
+    xmlParserCtxtPoolRelease(pool, ctxt);
+    reused = xmlParserCtxtPoolAcquire(pool);
+    if (reused != ctxt) {
+        fprintf(stderr, "testCtxtPool: context with large dict dropped\n");
+        err = 1;
+    }
+    if (xmlDictSize(xmlCtxtGetDict(reused)) > 50) {
+        fprintf(stderr, "testCtxtPool: large dict kept\n");
+        err = 1;
+    }
+    xmlParserCtxtPoolRelease(pool, reused);
+    xmlFreeParserCtxtPool(pool);
+
+    /* Documents outlive the pool */
+    xmlFreeDoc(doc);
+
+    return(err);
+}
+
+/*
+ * Check that XML_PARSE_OFFSETS reports exact line numbers past line
+ * 65535, including CRLF line breaks split across push chunks.
+ */
+static int
+checkOffsetLines(xmlDocPtr doc, const char *name) {
+    xmlNodePtr cur;
+    long line, expected;
+    int err = 0, checked = 0;
+
+    if (doc == NULL) {
+        fprintf(stderr, "testOffsets: %s: parsing failed\n", name);
+        return(1);
+    }
+
+    cur = xmlDocGetRootElement(doc)->children;
+    for (; cur != NULL; cur = cur->next) {
+        xmlChar *num;
+
+        if (cur->type == XML_ELEMENT_NODE)
+            num = xmlGetProp(cur, BAD_CAST "n");
+        else if (cur->type == XML_COMMENT_NODE)
+            num = xmlNodeGetContent(cur);
+        else
+            continue;
+
+        expected = strtol((char *) num, NULL, 10);
+        xmlFree(num);
+        line = xmlGetLineNo(cur);
+        if (line != expected) {
+            fprintf(stderr, "testOffsets: %s: got line %ld, expected %ld\n",
+                    name, line, expected);
+            err = 1;
+            break;
+        }
+        checked++;
+    }
+
+    if ((!err) && (checked < 70000)) {
+        fprintf(stderr, "testOffsets: %s: only %d nodes\n", name, checked);
+        err = 1;
+    }
+
+    xmlFreeDoc(doc);
+    return(err);
+}
+
+/*
+ * Check that XML_PARSE_OFFSETS records where each node starts.
+ */
+static const char offsetDoc[] =
+    "<?xml version='1.0'?>\n"
+    "<doc>\n"
+    "<e a='1'\n"
+    "   b='2'>t1</e>&amp;t2<!--c--><?pi x?><![CDATA[cd]]><f/>t3\n"
+    "</doc>\n";
+
+static int
+checkNodeOffsets(xmlDocPtr doc, const char *name) {
+    static const char *const starts[] = {
+        "\n<e", "<e", "&amp;", "<!--", "<?pi", "<![CDATA[", "<f/>", "t3"
+    };
+    xmlNodePtr root, cur;
+    long offset, expected;
+    int i = 0, err = 0;
+
+    if (doc == NULL) {
+        fprintf(stderr, "testOffsets: %s: parsing failed\n", name);
+        return(1);
+    }
+
+    root = xmlDocGetRootElement(doc);
+    expected = strstr(offsetDoc, "<doc>") - offsetDoc;
+    offset = xmlGetNodeOffset(root);
+    if (offset != expected) {
+        fprintf(stderr, "testOffsets: %s: root at %ld, expected %ld\n",
+                name, offset, expected);
+        err = 1;
+    }
+
+    for (cur = root->children; cur != NULL; cur = cur->next, i++) {
+        if (i >= (int) (sizeof(starts) / sizeof(starts[0]))) {
+            fprintf(stderr, "testOffsets: %s: too many nodes\n", name);
+            err = 1;
+            break;
+        }
+        expected = strstr(offsetDoc, starts[i]) - offsetDoc;
+        offset = xmlGetNodeOffset(cur);
+        if (offset != expected) {
+            fprintf(stderr, "testOffsets: %s: node %d at %ld, "
+                    "expected %ld\n", name, i, offset, expected);
+            err = 1;
+        }
+    }
+
+    cur = root->children->next->children;
+    expected = strstr(offsetDoc, "t1") - offsetDoc;
+    if ((cur == NULL) || (xmlGetNodeOffset(cur) != expected)) {
+        fprintf(stderr, "testOffsets: %s: wrong text offset\n", name);
+        err = 1;
+    }
+
+    xmlFreeDoc(doc);
+    return(err);
+}
+
+static int
+testOffsets(void) {
+    static const char *const endings[] = { "\n", "\r\n" };
+    char *buf;
+    size_t size = 0;
+    int i, err = 0;
+
+    err |= checkNodeOffsets(xmlReadMemory(offsetDoc, strlen(offsetDoc),
+                                          NULL, NULL, XML_PARSE_OFFSETS),
+                            "pull");
+    if (xmlGetNodeOffset(NULL) != -1) {
+        fprintf(stderr, "testOffsets: offset of NULL\n");
+        err = 1;
+    }
+
+    buf = malloc(2000000);
+    if (buf == NULL)
+        return(1);
+
+    size += sprintf(buf, "<doc>\n");
+    for (i = 2; i <= 70002; i++) {
+        const char *fmt = (i % 10 == 0) ? "<!--%d-->%s" : "<e n='%d'/>%s";
+
+        size += sprintf(buf + size, fmt, i, endings[i % 2]);
+    }
+    size += sprintf(buf + size, "</doc>\n");
+
+    err |= checkOffsetLines(xmlReadMemory(buf, size, NULL, NULL,
+                                          XML_PARSE_OFFSETS), "pull");
+
+#ifdef LIBXML_PUSH_ENABLED
+    {
+        xmlParserCtxtPtr ctxt;
+        size_t pos;
+
+        ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+        xmlCtxtUseOptions(ctxt, XML_PARSE_OFFSETS);
+        /* Odd chunk size to split carriage return and newline */
+        for (pos = 0; pos < size; pos += 13) {
+            size_t len = (size - pos < 13) ? size - pos : 13;
+
+            xmlParseChunk(ctxt, buf + pos, len, 0);
+        }
+        xmlParseChunk(ctxt, NULL, 0, 1);
+        err |= checkOffsetLines(ctxt->myDoc, "push");
+        xmlFreeParserCtxt(ctxt);
+
+        ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+        xmlCtxtUseOptions(ctxt, XML_PARSE_OFFSETS);
+        for (pos = 0; offsetDoc[pos] != 0; pos++)
+            xmlParseChunk(ctxt, offsetDoc + pos, 1, 0);
+        xmlParseChunk(ctxt, NULL, 0, 1);
+        err |= checkNodeOffsets(ctxt->myDoc, "push");
+        xmlFreeParserCtxt(ctxt);
+    }
+#endif
+
+    free(buf);
+    return(err);
+}
+
+static const char *const lexerTokenNames[] = {
+    "none", "text", "ref", "start", "attr", "value", ">", "/>", "end",
+    "comment", "pi", "cdata", "doctype"
+};
+
+/*
+ * Lex a document and append the tokens to `out` as "type[text]".
+ * Returns the result of the last call to xmlLexerNext.
+ */
+static int
+lexTokens(const char *doc, int options, char *out, size_t outSize) {
+    xmlLexer *lexer;
+    xmlToken token;
+    size_t size = strlen(doc);
+    size_t used = 0;
+    int ret;
+
+    out[0] = 0;
+    lexer = xmlNewLexer(doc, size, options);
+    if (lexer == NULL)
+        return(-2);
+
+    while ((ret = xmlLexerNext(lexer, &token)) > 0) {
+        if ((token.offset > size) || (token.length > size - token.offset))
+            break;
+        used += snprintf(out + used, outSize - used, "%s[%.*s]",
+                         lexerTokenNames[token.type], (int) token.length,
+                         doc + token.offset);
+        if (used >= outSize)
+            break;
+    }
+
+    xmlFreeLexer(lexer);
+    return(ret);
+}
+
+static int
+testLexer(void) {
+    static const char doc[] =
+        "\xEF\xBB\xBF<?xml version='1.0'?>\n"
+        "<!DOCTYPE d [<!ENTITY e '>'><!-- ] -->]>\n"
+        "<d a='1' b=\"x&amp;y\"><!--c--><?p q?>t&e;&#x41;"
+        "<![CDATA[<>]]><f/></d >\n";
+    static const char tokens[] =
+        "pi[xml version='1.0']text[\n]"
+        "doctype[<!DOCTYPE d [<!ENTITY e '>'><!-- ] -->]>]text[\n]"
+        "start[d]attr[a]value[1]attr[b]value[x&amp;y]>[>]"
+        "comment[c]pi[p q]text[t]ref[&e;]ref[&#x41;]cdata[<>]"
+        "start[f]/>[/>]end[d]text[\n]";
+    static const struct {
+        const char *doc;
+        xmlParserErrors code;
+        size_t offset;
+    } errors[] = {
+        { "<d></e>", XML_ERR_TAG_NAME_MISMATCH, 7 },
+        { "<d a='1' b='2' a='3'/>", XML_ERR_ATTRIBUTE_REDEFINED, 15 },
+        { "<d a1='' a2='' a3='' a4='' a5='' a6='' a7='' a8='' a9=''"
+          " a10='' a11='' a2=''/>", XML_ERR_ATTRIBUTE_REDEFINED, 71 },
+        { "<d>&e;</d>", XML_ERR_UNDECLARED_ENTITY, 3 },
+        { "<d>&#0;</d>", XML_ERR_INVALID_CHAR, 3 },
+        { "<d a='<'/>", XML_ERR_LT_IN_ATTRIBUTE, 6 },
+        { "<d>]]></d>", XML_ERR_MISPLACED_CDATA_END, 3 },
+        { "<d><!-- - -- --></d>", XML_ERR_HYPHEN_IN_COMMENT, 10 },
+        { "<d/><e/>", XML_ERR_DOCUMENT_END, 4 },
+        { "<d/>t", XML_ERR_DOCUMENT_END, 4 },
+        { "<d>", XML_ERR_TAG_NOT_FINISHED, 3 },
+        { " ", XML_ERR_DOCUMENT_EMPTY, 1 },
+        { "<d a='1'b='2'/>", XML_ERR_SPACE_REQUIRED, 8 },
+        { "<d>\xC3\x28</d>", XML_ERR_INVALID_CHAR, 3 },
+        { "<d/><?XmL ?>", XML_ERR_RESERVED_XML_NAME, 6 }
+    };
+    char out[500];
+    int err = 0;
+    size_t i;
+
+    if ((lexTokens(doc, 0, out, sizeof(out)) != 0) ||
+        (strcmp(out, tokens) != 0)) {
+        fprintf(stderr, "testLexer: got %s\n", out);
+        err = 1;
+    }
+    if ((lexTokens(doc, XML_LEXER_WELL_FORMED | XML_LEXER_ZERO_TERMINATED,
+                   out, sizeof(out)) != 0) ||
+        (strcmp(out, tokens) != 0)) {
+        fprintf(stderr, "testLexer: well-formed: got %s\n", out);
+        err = 1;
+    }
+
+    for (i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
+        xmlLexer *lexer;
+        xmlToken token;
+        xmlParserErrors code;
+        size_t offset;
+
+        /* These errors are only found by the well-formedness check */
+        if (lexTokens(errors[i].doc, 0, out, sizeof(out)) != 0) {
+            fprintf(stderr, "testLexer: %s: unexpected error\n",
+                    errors[i].doc);
+            err = 1;
+        }
+
+        lexer = xmlNewLexer(errors[i].doc, strlen(errors[i].doc),
+                            XML_LEXER_WELL_FORMED);
+        while (xmlLexerNext(lexer, &token) > 0)
+            ;
+        code = xmlLexerGetError(lexer, &offset);
+        if ((code != errors[i].code) || (offset != errors[i].offset)) {
+            fprintf(stderr, "testLexer: %s: got error %d at %d\n",
+                    errors[i].doc, code, (int) offset);
+            err = 1;
+        }
+        xmlFreeLexer(lexer);
+    }
+
+    return(err);
+}
+
+static int checkStartElements;
+
+static void
+checkStartElementNs(void *ctx ATTRIBUTE_UNUSED,
+                    const xmlChar *localname ATTRIBUTE_UNUSED,
+                    const xmlChar *prefix ATTRIBUTE_UNUSED,
+                    const xmlChar *URI ATTRIBUTE_UNUSED,
+                    int nb_namespaces ATTRIBUTE_UNUSED,
+                    const xmlChar **namespaces ATTRIBUTE_UNUSED,
+                    int nb_attributes ATTRIBUTE_UNUSED,
+                    int nb_defaulted ATTRIBUTE_UNUSED,
+                    const xmlChar **attributes ATTRIBUTE_UNUSED) {
+    checkStartElements++;
+}
+
+static int
+testCheckWellFormed(void) {
+    static const struct {
+        const char *doc;
+        int options;
+        int wellFormed;
+        xmlParserErrors code;
+        int line;
+        int col;
+    } tests[] = {
+        { "<?xml version='1.0' encoding='utf-8' standalone='yes'?>\n"
+          "<d a='&lt;'>&#xE9;<![CDATA[]]]]><?p?><!----></d>\n",
+          0, 1, XML_ERR_OK, 0, 0 },
+        /* Parsed with the regular parser */
+        { "<?xml version='1.0' encoding='ISO-8859-1'?><d>\xE9</d>",
+          0, 1, XML_ERR_OK, 0, 0 },
+        { "<!DOCTYPE d [<!ENTITY e 'x'>]><d>&e;</d>",
+          0, 1, XML_ERR_OK, 0, 0 },
+        { "<!DOCTYPE d [<!ENTITY e '<'>]><d>&e;</d>",
+          0, 0, XML_ERR_NAME_REQUIRED, 1, 0 },
+        { "<!DOCTYPE d [<!ENTITY a '<x/>'><!ENTITY b '&a;&a;'>]>\n"
+          "<d>&b;&b;</d>",
+          0, 1, XML_ERR_OK, 0, 0 },
+        { "<!DOCTYPE d [<!NOTATION n SYSTEM 'n'>\n"
+          "<!ENTITY e SYSTEM 'e' NDATA n>]>\n<d>&e;</d>",
+          0, 0, XML_ERR_UNPARSED_ENTITY, 3, 0 },
+        { "<d>\n  <e></f></d>", 0, 0, XML_ERR_TAG_NAME_MISMATCH, 2, 10 },
+        { "<d>\n</\nd>", 0, 0, XML_ERR_GT_REQUIRED, 3, 1 },
+        /* Unterminated constructs are reported at the end */
+        { "<d><!--->\n</d>", 0, 0, XML_ERR_COMMENT_NOT_FINISHED, 2, 5 },
+        { "<d><![CDATA[ a\n\n", 0, 0, XML_ERR_CDATA_NOT_FINISHED, 3, 1 },
+        { "<d><?pi a\n\n", 0, 0, XML_ERR_PI_NOT_FINISHED, 3, 1 },
+        { "<d><!-- a\n-- -->\n</d>", 0, 0, XML_ERR_HYPHEN_IN_COMMENT, 2, 1 },
+        { "<d><!--\x01 -- -->\n</d>", 0, 0, XML_ERR_INVALID_CHAR, 1, 8 },
+        { "<d a='1' a='2'/>", 0, 0, XML_ERR_ATTRIBUTE_REDEFINED, 1, 10 },
+        { "<d>\n\xC3\xA9&x;</d>", 0, 0, XML_ERR_UNDECLARED_ENTITY, 2, 2 },
+        { "<?xml version='1.0'?><?xml version='1.0'?><d/>",
+          0, 0, XML_ERR_RESERVED_XML_NAME, 1, 24 },
+        { "<d/>\n<e/>", 0, 0, XML_ERR_DOCUMENT_END, 2, 1 }
+    };
+    xmlParserCtxtPtr ctxt;
+    char deep[3000];
+    size_t i;
+    int j, res, err = 0;
+
+    ctxt = xmlNewParserCtxt();
+    xmlCtxtSetOptions(ctxt, XML_PARSE_NOERROR);
+    /* Neither the lexer nor the regular parser may call it */
+    xmlCtxtGetSaxHandler(ctxt)->startElementNs = checkStartElementNs;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        const xmlError *error;
+
+        res = xmlCtxtCheckWellFormed(ctxt,
+                xmlNewInputFromString(NULL, tests[i].doc, 0));
+        error = xmlCtxtGetLastError(ctxt);
+        if (res != tests[i].wellFormed) {
+            fprintf(stderr, "testCheckWellFormed: test %d returned %d\n",
+                    (int) i, res);
+            err = 1;
+        } else if ((!res) &&
+                   ((error == NULL) ||
+                    (error->code != (int) tests[i].code) ||
+                    (error->line != tests[i].line) ||
+                    ((tests[i].col > 0) && (error->int2 != tests[i].col)))) {
+            fprintf(stderr, "testCheckWellFormed: test %d: wrong error %d\n",
+                    (int) i, error ? error->code : 0);
+            err = 1;
+        }
+    }
+
+    /* Nesting limit of the regular parser */
+    for (j = 0; j < 300; j++)
+        memcpy(deep + j * 3, "<d>", 3);
+    for (j = 0; j < 300; j++)
+        memcpy(deep + 900 + j * 4, "</d>", 4);
+    deep[2100] = 0;
+
+    res = xmlCtxtCheckWellFormed(ctxt, xmlNewInputFromString(NULL, deep, 0));
+    if ((res != 0) || (ctxt->errNo != XML_ERR_RESOURCE_LIMIT)) {
+        fprintf(stderr, "testCheckWellFormed: nesting limit not enforced\n");
+        err = 1;
+    }
+    xmlCtxtSetOptions(ctxt, XML_PARSE_NOERROR | XML_PARSE_HUGE);
+    res = xmlCtxtCheckWellFormed(ctxt, xmlNewInputFromString(NULL, deep, 0));
+    if (res != 1) {
+        fprintf(stderr, "testCheckWellFormed: huge document rejected\n");
+        err = 1;
+    }
+
+    if ((checkStartElements != 0) || (ctxt->myDoc != NULL) ||
+        (xmlCtxtGetSaxHandler(ctxt)->startElementNs != checkStartElementNs)) {
+        fprintf(stderr, "testCheckWellFormed: tree built\n");
+        err = 1;
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    return(err);
+}
+
+/**** Parser benchmark ****/
+
+#define BENCH_DOC_SIZE (8 * 1024 * 1024)
+#define MIN_BENCH_TIME 0.5
+
+static const char *const benchWords[] = {
+    "the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+    "with", "was", "on", "be", "by", "this", "are", "from", "at", "or",
+    "document", "element", "attribute", "character", "reference",
+    "processing", "instruction", "namespace", "declaration", "parser",
+    "entity", "validation", "specification", "information", "content"
+};
+
+#define NB_BENCH_WORDS (sizeof(benchWords) / sizeof(benchWords[0]))
+
+/*
+ * Generate a document: paragraphs of 32 lines, with a line break
+ * every 72 columns. If `markup` is non-zero, every `markup` words are
+ * replaced with `markupStr` which can use the word up to three times.
+ */
+static char *
+benchDoc(int markup, const char *markupStr, size_t *psize) {
+    char *doc;
+    size_t size = 0, lineStart = 0;
+    unsigned seed = 1;
+    int words = 0, lines = 0;
+
+    /* Leave room for the last word and the end tags */
+    doc = malloc(BENCH_DOC_SIZE + 1000);
+    if (doc == NULL)
+        return(NULL);
+
+    size += sprintf(doc, "<doc><p>");
+    while (size < BENCH_DOC_SIZE) {
+        const char *word;
+
+        seed = seed * 1103515245 + 12345;
+        word = benchWords[(seed >> 16) % NB_BENCH_WORDS];
+
+        if ((markup > 0) && (++words % markup == 0))
+            size += sprintf(doc + size, markupStr, word, word, word);
+        else
+            size += sprintf(doc + size, "%s", word);
+
+        if (size - lineStart > 72) {
+            if (++lines % 32 == 0) {
+                size += sprintf(doc + size, "</p>\n<p>");
+            } else {
+                doc[size++] = '\n';
+            }
+            lineStart = size;
+        } else {
+            doc[size++] = ' ';
+        }
+    }
+    size += sprintf(doc + size, "</p></doc>\n");
+
+    *psize = size;
+    return(doc);
+}
+
+static size_t benchChars;
+
+static void
+benchCharacters(void *ctx ATTRIBUTE_UNUSED, const xmlChar *ch ATTRIBUTE_UNUSED,
+                int len) {
+    benchChars += len;
+}
+
+/*
+ * Parse a document repeatedly for at least MIN_BENCH_TIME seconds and
+ * return the throughput in MB/s or a negative value on error.
+ */
+static double
+benchRun(xmlParserCtxtPtr ctxt, const char *doc, size_t size, int options) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlFreeDoc(xmlCtxtReadMemory(ctxt, doc, size, NULL, NULL, options));
+        if (!ctxt->wellFormed) {
+            fprintf(stderr, "Benchmark document not well-formed\n");
+            return(-1.0);
+        }
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps * size / 1e6 / elapsed);
+}
+
+static const struct {
+    const char *name;
+    int markup;
+    const char *markupStr;
+} corpora[] = {
+    { "text", 0, NULL },
+    { "text+entities", 12, "%s &amp;" },
+    { "text+inline", 6, "<i>%s</i>" },
+    { "short", 1, "<w>%s</w>" },
+    { "attributes", 1,
+      "<e id='%s-1842' href='http://example.org/feed/%s/entry.xml' "
+      "title=\"The %s of the item\" type='text/html' lang='en'/>" }
+};
+
+static int
+benchParser(void) {
+    xmlSAXHandler sax;
+    size_t i;
+    int err = 0;
+
+    /* Only report character data, don't build a tree */
+    memset(&sax, 0, sizeof(sax));
+    sax.initialized = XML_SAX2_MAGIC;
+    sax.characters = benchCharacters;
+    sax.ignorableWhitespace = benchCharacters;
+
+    printf("%-16s %8s %10s %10s %10s %10s\n", "corpus", "MB", "MB/s", "tree",
+           "indexed", "arena");
+
+    for (i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        xmlParserCtxtPtr saxCtxt, ctxt;
+        char *doc;
+        size_t size;
+        double mbps, tree, indexed, arena;
+
+        doc = benchDoc(corpora[i].markup, corpora[i].markupStr,
+                               &size);
+        saxCtxt = xmlNewSAXParserCtxt(&sax, NULL);
+        ctxt = xmlNewParserCtxt();
+        if ((doc == NULL) || (saxCtxt == NULL) || (ctxt == NULL)) {
+            fprintf(stderr, "Out of memory\n");
+            free(doc);
+            xmlFreeParserCtxt(saxCtxt);
+            xmlFreeParserCtxt(ctxt);
+            return(1);
+        }
+
+        mbps = benchRun(saxCtxt, doc, size, 0);
+        tree = benchRun(ctxt, doc, size, 0);
+        indexed = benchRun(ctxt, doc, size, XML_PARSE_INDEXED);
+        arena = benchRun(ctxt, doc, size, XML_PARSE_ARENA);
+        if ((mbps < 0) || (tree < 0) || (indexed < 0) || (arena < 0))
+            err = 1;
+
+        printf("%-16s %8.1f %10.1f %10.1f %10.1f %10.1f\n", corpora[i].name,
+               size / 1e6, mbps, tree, indexed, arena);
+
+        xmlFreeParserCtxt(saxCtxt);
+        xmlFreeParserCtxt(ctxt);
+        free(doc);
+    }
+
+    return(err);
+}
+
+#define BENCH_XML_FILE "testparser-bench.xml"
+#define BENCH_SNAPSHOT_FILE "testparser-bench.snapshot"
+
+/*
+ * Load a document from a file repeatedly, either by parsing it or
+ * from a snapshot, and return the throughput in MB/s of the XML
+ * document or a negative value on error.
+ */
+static double
+benchLoadRun(int snapshot, int options, size_t size) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlDocPtr doc;
+
+        if (snapshot)
+            doc = xmlReadSnapshotFile(BENCH_SNAPSHOT_FILE, options);
+        else
+            doc = xmlReadFile(BENCH_XML_FILE, NULL, options);
+        if (doc == NULL) {
+            fprintf(stderr, "Failed to load benchmark document\n");
+            return(-1.0);
+        }
+        xmlFreeDoc(doc);
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps * size / 1e6 / elapsed);
+}
+
+static int
+benchWriteFile(const char *filename, const void *data, size_t size) {
+    FILE *f;
+    int ret = 0;
+
+    f = fopen(filename, "wb");
+    if (f == NULL)
+        return(-1);
+    if (fwrite(data, 1, size, f) != size)
+        ret = -1;
+    if (fclose(f) != 0)
+        ret = -1;
+    return(ret);
+}
+
+/*
+ * Compare loading snapshots with parsing files, with and without
+ * arena allocation.
+ */
+static int
+benchSnapshot(void) {
+    size_t i;
+    int err = 0;
+
+    printf("\n%-16s %10s %10s %10s %10s\n", "load MB/s", "read",
+           "arena", "snapshot", "snap+arena");
+
+    for (i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        xmlDocPtr doc;
+        xmlChar *snapshot = NULL;
+        char *text;
+        size_t size, snapshotSize;
+        double read, arena, snap, snapArena;
+
+        text = benchDoc(corpora[i].markup, corpora[i].markupStr, &size);
+        if (text == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            err = 1;
+            break;
+        }
+        doc = xmlReadMemory(text, size, NULL, NULL, 0);
+        if ((doc == NULL) ||
+            (xmlDocSnapshotMemory(doc, &snapshot, &snapshotSize) < 0) ||
+            (benchWriteFile(BENCH_XML_FILE, text, size) < 0) ||
+            (benchWriteFile(BENCH_SNAPSHOT_FILE, snapshot,
+                            snapshotSize) < 0)) {
+            fprintf(stderr, "Failed to create benchmark files\n");
+            xmlFreeDoc(doc);
+            xmlFree(snapshot);
+            free(text);
+            err = 1;
+            break;
+        }
+        xmlFreeDoc(doc);
+        xmlFree(snapshot);
+        free(text);
+
+        read = benchLoadRun(0, 0, size);
+        arena = benchLoadRun(0, XML_PARSE_ARENA, size);
+        snap = benchLoadRun(1, 0, size);
+        snapArena = benchLoadRun(1, XML_PARSE_ARENA, size);
+        if ((read < 0) || (arena < 0) || (snap < 0) || (snapArena < 0))
+            err = 1;
+
+        printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", corpora[i].name,
+               read, arena, snap, snapArena);
+    }
+
+    remove(BENCH_XML_FILE);
+    remove(BENCH_SNAPSHOT_FILE);
+    return(err);
+}
+
+#ifdef LIBXML_PUSH_ENABLED
+/*
+ * Feed a document to the push parser in chunks of `chunkSize` bytes
+ * for at least MIN_BENCH_TIME seconds and return the throughput in
+ * MB/s or a negative value on error.
+ */
+static double
+benchPushRun(xmlSAXHandler *sax, const char *doc, size_t size,
+             size_t chunkSize) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlParserCtxtPtr ctxt;
+        size_t i;
+        int wellFormed;
+
+        ctxt = xmlCreatePushParserCtxt(sax, NULL, NULL, 0, NULL);
+        if (ctxt == NULL)
+            return(-1.0);
+        for (i = 0; i < size; i += chunkSize) {
+            size_t len = size - i < chunkSize ? size - i : chunkSize;
+
+            xmlParseChunk(ctxt, doc + i, len, 0);
+        }
+        xmlParseChunk(ctxt, NULL, 0, 1);
+        wellFormed = ctxt->wellFormed;
+        xmlFreeParserCtxt(ctxt);
+        if (!wellFormed) {
+            fprintf(stderr, "Benchmark document not well-formed\n");
+            return(-1.0);
+        }
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps * size / 1e6 / elapsed);
+}
+
+/*
+ * Push parse the corpora with chunk sizes from 1 byte to 64 KB. The
+ * lookahead state of the push parser is kept between chunks, so the
+ * throughput with tiny chunks should only suffer from the overhead
+ * per call, not from rescanning buffered data.
+ */
+static int
+benchPush(void) {
+    static const size_t chunkSizes[] = { 1, 16, 256, 4096, 65536 };
+    xmlSAXHandler sax;
+    size_t i, j;
+    int err = 0;
+
+    memset(&sax, 0, sizeof(sax));
+    sax.initialized = XML_SAX2_MAGIC;
+    sax.characters = benchCharacters;
+    sax.ignorableWhitespace = benchCharacters;
+
+    printf("\n%-16s %10s %10s %10s %10s %10s\n", "push MB/s", "1 B",
+           "16 B", "256 B", "4 KB", "64 KB");
+
+    for (i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        char *doc;
+        size_t size;
+
+        doc = benchDoc(corpora[i].markup, corpora[i].markupStr, &size);
+        if (doc == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return(1);
+        }
+
+        printf("%-16s", corpora[i].name);
+        for (j = 0; j < sizeof(chunkSizes) / sizeof(chunkSizes[0]); j++) {
+            double mbps = benchPushRun(&sax, doc, size, chunkSizes[j]);
+
+            if (mbps < 0)
+                err = 1;
+            printf(" %10.1f", mbps);
+        }
+        printf("\n");
+
+        free(doc);
+    }
+
+    return(err);
+}
+#endif /* LIBXML_PUSH_ENABLED */
+
+/*
+ * Parse small messages repeatedly with new contexts and with contexts
+ * from a pool and return the number of messages per second, or a
+ * negative value on error.
+ */
+static double
+benchMessages(xmlParserCtxtPool *pool, const char *doc, size_t size) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlParserCtxtPtr ctxt;
+        xmlDocPtr res;
+
+        ctxt = pool ? xmlParserCtxtPoolAcquire(pool) : xmlNewParserCtxt();
+        res = xmlCtxtReadMemory(ctxt, doc, size, NULL, NULL, 0);
+        if (res == NULL) {
+            fprintf(stderr, "Benchmark message not well-formed\n");
+            xmlFreeParserCtxt(ctxt);
+            return(-1.0);
+        }
+        xmlFreeDoc(res);
+        if (pool)
+            xmlParserCtxtPoolRelease(pool, ctxt);
+        else
+            xmlFreeParserCtxt(ctxt);
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps / elapsed);
+}
+
+static int
+benchSmallMessages(void) {
+    static const size_t sizes[] = { 2000, 8000, 20000 };
+    xmlParserCtxtPool *pool;
+    size_t i;
+    int err = 0;
+
+    pool = xmlNewParserCtxtPool(4, 10000);
+    if (pool == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+
+    printf("\n%-16s %10s %10s\n", "message size", "msgs/s", "pooled");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *doc;
+        size_t size = 0;
+        unsigned id = 0;
+        double plain, pooled;
+
+        doc = malloc(sizes[i] + 200);
+        if (doc == NULL) {
+            err = 1;
+            break;
+        }
+        size += sprintf(doc, "<msg xmlns='urn:msg'><head id='%u'/>", id);
+        while (size < sizes[i]) {
+            id++;
+            size += sprintf(doc + size,
+                            "<item id='%u' type='entry'><name>%s</name>"
+                            "<value>%u</value></item>\n",
+                            id, benchWords[id % NB_BENCH_WORDS], id * 7);
+        }
+        size += sprintf(doc + size, "</msg>\n");
+
+        plain = benchMessages(NULL, doc, size);
+        pooled = benchMessages(pool, doc, size);
+        if ((plain < 0) || (pooled < 0))
+            err = 1;
+
+        printf("%-16u %10.0f %10.0f\n", (unsigned) size, plain, pooled);
+
+        free(doc);
+    }
+
+    xmlFreeParserCtxtPool(pool);
+    return(err);
+}
+
+/*
+ * Lex a document repeatedly for at least MIN_BENCH_TIME seconds and
+ * return the throughput in MB/s or a negative value on error.
+ */
+static double
+benchLexerRun(const char *doc, size_t size, int options) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlLexer *lexer;
+        xmlToken token;
+        int ret;
+
+        lexer = xmlNewLexer(doc, size, options | XML_LEXER_ZERO_TERMINATED);
+        if (lexer == NULL)
+            return(-1.0);
+        while ((ret = xmlLexerNext(lexer, &token)) > 0)
+            ;
+        xmlFreeLexer(lexer);
+        if (ret < 0) {
+            fprintf(stderr, "Benchmark document not well-formed\n");
+            return(-1.0);
+        }
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps * size / 1e6 / elapsed);
+}
+
+/*
+ * Check a document with xmlCtxtCheckWellFormed repeatedly and return
+ * the throughput in MB/s or a negative value on error.
+ */
+static double
+benchCheckRun(xmlParserCtxtPtr ctxt, const char *doc, size_t size) {
+    unsigned long reps = 0;
+    clock_t start;
+    double elapsed = 0.0;
+
+    start = clock();
+    do {
+        xmlParserInputPtr input;
+
+        input = xmlNewInputFromMemory(NULL, doc, size,
+                                      XML_INPUT_BUF_STATIC |
+                                      XML_INPUT_BUF_ZERO_TERMINATED);
+        if (!xmlCtxtCheckWellFormed(ctxt, input)) {
+            fprintf(stderr, "Benchmark document not well-formed\n");
+            return(-1.0);
+        }
+        reps++;
+        elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_BENCH_TIME);
+
+    return((double) reps * size / 1e6 / elapsed);
+}
+
+static int
+benchLexer(void) {
+    xmlParserCtxtPtr ctxt;
+    size_t i;
+    int err = 0;
+
+    ctxt = xmlNewParserCtxt();
+    if (ctxt == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+
+    printf("\n%-16s %10s %10s %10s\n", "lexer MB/s", "tokens", "checked",
+           "wf-only");
+
+    for (i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+        char *doc;
+        size_t size;
+        double lax, checked, wfOnly;
+
+        doc = benchDoc(corpora[i].markup, corpora[i].markupStr, &size);
+        if (doc == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            err = 1;
+            break;
+        }
+
+        lax = benchLexerRun(doc, size, 0);
+        checked = benchLexerRun(doc, size, XML_LEXER_WELL_FORMED);
+        wfOnly = benchCheckRun(ctxt, doc, size);
+        if ((lax < 0) || (checked < 0) || (wfOnly < 0))
+            err = 1;
+
+        printf("%-16s %10.1f %10.1f %10.1f\n", corpora[i].name, lax,
+               checked, wfOnly);
+
+        free(doc);
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    return(err);
+}
+
+/*
+ * Check attribute values and names of varying length which are
+ * skipped a word at a time.
+ */
+static int
+testAttValueScan(void) {
+    static const char text[] = "ab cd-ef.gh_ij  kl mnop qrstuvwxyz0123456789";
+    xmlParserCtxtPtr ctxt;
+    char doc[400];
+    int err = 0;
+    int n;
+
+    ctxt = xmlNewParserCtxt();
+
+    for (n = 0; n < (int) sizeof(text); n++) {
+        const xmlError *error;
+        xmlDocPtr xml;
+        xmlNodePtr root;
+        xmlChar *value;
+        char name[50], norm[50];
+        int i, j, len;
+
+        /* An attribute name made of the first n name characters */
+        snprintf(name, sizeof(name), "n%.*s", n,
+                 "abcdefghijklmnopqrstuvwxyz-._ABCDEFGHIJ0123456789");
+
+        len = snprintf(doc, sizeof(doc),
+                       "<!DOCTYPE d [<!ATTLIST d t NMTOKENS #IMPLIED>]>\n"
+                       "<d %s='%.*s' q=\"%.*s&amp;'\" t=' %.*s '/>",
+                       name, n, text, n, text, n, text);
+        xml = xmlCtxtReadMemory(ctxt, doc, len, NULL, NULL, 0);
+        root = xmlDocGetRootElement(xml);
+        if (root == NULL) {
+            fprintf(stderr, "testAttValueScan: parse failed for %d\n", n);
+            err = 1;
+            continue;
+        }
+
+        value = xmlGetProp(root, BAD_CAST name);
+        if ((value == NULL) ||
+            (strncmp((char *) value, text, n) != 0) ||
+            (value[n] != 0)) {
+            fprintf(stderr, "testAttValueScan: wrong value for %d\n", n);
+            err = 1;
+        }
+        xmlFree(value);
+
+        value = xmlGetProp(root, BAD_CAST "q");
+        if ((value == NULL) ||
+            (strncmp((char *) value, text, n) != 0) ||
+            (strcmp((char *) value + n, "&'") != 0)) {
+            fprintf(stderr, "testAttValueScan: wrong value for %d\n", n);
+            err = 1;
+        }
+        xmlFree(value);
+
+        /* Normalized NMTOKENS value */
+        for (i = 0, j = 0; i < n; i++) {
+            if ((text[i] != ' ') ||
+                ((j > 0) && (norm[j - 1] != ' ')))
+                norm[j++] = text[i];
+        }
+        if ((j > 0) && (norm[j - 1] == ' '))
+            j--;
+        norm[j] = 0;
+        value = xmlGetProp(root, BAD_CAST "t");
+        if ((value == NULL) || (strcmp((char *) value, norm) != 0)) {
+            fprintf(stderr, "testAttValueScan: wrong value for %d\n", n);
+            err = 1;
+        }
+        xmlFree(value);
+
+        xmlFreeDoc(xml);
+
+        /* Column of a '<' in the value */
+        len = snprintf(doc, sizeof(doc), "<d\n a='%.*s<'/>", n, text);
+        xmlFreeDoc(xmlCtxtReadMemory(ctxt, doc, len, NULL, NULL,
+                                     XML_PARSE_NOERROR));
+        error = xmlCtxtGetLastError(ctxt);
+        if ((error == NULL) ||
+            (error->code != XML_ERR_LT_IN_ATTRIBUTE) ||
+            (error->line != 2) ||
+            (error->int2 != n + 5)) {
+            fprintf(stderr, "testAttValueScan: wrong error for %d\n", n);
+            err = 1;
+        }
+    }
+
+    xmlFreeParserCtxt(ctxt);
+    return err;
+}
+
 int
-main(void) {
+main(int argc, char **argv) {
     int err = 0;
 
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) {
+        err = benchParser();
+        err |= benchSmallMessages();
+        err |= benchSnapshot();
+        err |= benchLexer();
+#ifdef LIBXML_PUSH_ENABLED
+        err |= benchPush();
+#endif
+        xmlCleanupParser();
+        return(err);
+    }
+
     err |= testNewDocNode();
     err |= testStandaloneWithEncoding();
     err |= testUnsupportedEncoding();
     err |= testNodeGetContent();
     err |= testCFileIO();
     err |= testUndeclEntInContent();
+    err |= testCharDataPosition();
+    err |= testAttValueScan();
+    err |= testIndexed();
+    err |= testParallel();
+    err |= testArena();
+    err |= testCtxtPool();
+    err |= testOffsets();
+    err |= testLexer();
+    err |= testCheckWellFormed();
 #ifdef LIBXML_VALID_ENABLED
     err |= testSwitchDtd();
 #endif
@@ -1414,6 +3020,7 @@ main(void) {
     err |= testHugePush();
     err |= testHugeEncodedChunk();
     err |= testPushCDataEnd();
+    err |= testPushChunkBoundaries();
 #endif
 #ifdef LIBXML_HTML_ENABLED
     err |= testHtmlIds();
@@ -280,6 +280,76 @@ xmlRMutexUnlock(xmlRMutex *tok ATTRIBUTE_UNUSED)
 #endif
 }
 
+/************************************************************************
+ *									*
+ *			Worker threads					*
+ *									*
+ ************************************************************************/
+
+#ifdef HAVE_POSIX_THREADS
+static void *
+xmlThreadStart(void *arg) {
+    xmlThread *thread = arg;
+
+    thread->func(thread->arg);
+    return(NULL);
+}
+#elif defined HAVE_WIN32_THREADS
+static DWORD WINAPI
+xmlThreadStart(LPVOID arg) {
+    xmlThread *thread = arg;
+
+    thread->func(thread->arg);
+    return(0);
+}
+#endif
+
+/**
+ * Start a thread running `func` with argument `arg`. `thread` must
+ * stay valid until the thread was joined.
+ *
+ * @param thread  the thread
+ * @param func  the function to run
+ * @param arg  argument passed to `func`
+ * @returns 0 on success, -1 if threads aren't supported or the
+ * thread couldn't be created.
+ */
+int
+xmlThreadCreate(xmlThread *thread, xmlThreadFunc func, void *arg) {
+    thread->func = func;
+    thread->arg = arg;
+
+#ifdef HAVE_POSIX_THREADS
+    if (pthread_create(&thread->thread, NULL, xmlThreadStart, thread) != 0)
+        return(-1);
+    return(0);
+#elif defined HAVE_WIN32_THREADS
+    thread->thread = CreateThread(NULL, 0, xmlThreadStart, thread, 0, NULL);
+    if (thread->thread == NULL)
+        return(-1);
+    return(0);
+#else
+    return(-1);
+#endif
+}
+
+/**
+ * Wait for a thread started with #xmlThreadCreate to finish.
+ *
+ * @param thread  the thread
+ */
+void
+xmlThreadJoin(xmlThread *thread) {
+#ifdef HAVE_POSIX_THREADS
+    pthread_join(thread->thread, NULL);
+#elif defined HAVE_WIN32_THREADS
+    WaitForSingleObject(thread->thread, INFINITE);
+    CloseHandle(thread->thread);
+#else
+    (void) thread;
+#endif
+}
+
 /************************************************************************
  *									*
  *			Library wide thread interfaces			*
@@ -61,7 +61,13 @@ int xmlRegisterCallbacks = 0;
  ************************************************************************/
 
 static xmlNodePtr
-xmlNewEntityRef(xmlDocPtr doc, xmlChar *name);
+xmlNewEntityRef(xmlDocPtr doc, const xmlChar *name, int len);
+
+static void
+xmlDocFreeNsList(xmlDocPtr doc, xmlNsPtr cur);
+
+static void
+xmlDocFreeNs(xmlDocPtr doc, xmlNsPtr cur);
 
 static xmlNsPtr
 xmlNewReconciledNs(xmlNodePtr tree, xmlNsPtr ns);
@@ -493,6 +499,393 @@ xmlValidateNMToken(const xmlChar *value, int space) {
  *									*
  ************************************************************************/
 
+/*
+ * Document arenas
+ *
+ * Documents parsed with XML_PARSE_ARENA allocate nodes, namespaces
+ * and strings from a bump allocator owned by the document. Individual
+ * nodes can still be freed, but their memory is only reclaimed with
+ * the whole arena.
+ *
+ * As long as all memory reachable from the document is owned by the
+ * arena or the dictionary, xmlFreeDoc releases the arena without
+ * walking the tree. Once other memory is attached to the tree, for
+ * example nodes moved from another document, the arena is marked as
+ * mixed and xmlFreeDoc walks the tree, skipping arena memory.
+ *
+ * When nodes are moved to another document, the target document
+ * keeps a reference to the source arena, so both arenas stay alive
+ * until all documents referencing them are freed.
+ */
+
+#define XML_ARENA_ALIGN 8
+#define XML_ARENA_MIN_CHUNK 4000
+#define XML_ARENA_MAX_CHUNK (8 * 1024 * 1024)
+
+typedef struct _xmlArenaChunk xmlArenaChunk;
+struct _xmlArenaChunk {
+    xmlArenaChunk *next;
+    unsigned char *free;
+    unsigned char *end;
+    size_t size;
+    unsigned char array[1];
+};
+
+struct _xmlArena {
+    int ref;
+    /* whether the owner allocates from this arena */
+    int alloc;
+    /* whether the owner's tree contains memory not owned by arenas */
+    int mixed;
+    xmlArenaChunk *chunks;
+    /* arenas of nodes moved into the owner document */
+    xmlArena **deps;
+    int nbDeps;
+    int maxDeps;
+};
+
+static xmlArena *
+xmlArenaCreate(int alloc) {
+    xmlArena *arena;
+
+    arena = xmlMalloc(sizeof(*arena));
+    if (arena == NULL)
+        return(NULL);
+    memset(arena, 0, sizeof(*arena));
+    arena->ref = 1;
+    arena->alloc = alloc;
+
+    return(arena);
+}
+
+/*
+ * The owner drops its references to other arenas before its own, so
+ * there are none left when the last reference goes away.
+ */
+static void
+xmlArenaRelease(xmlArena *arena) {
+    xmlArenaChunk *chunk, *next;
+
+    if (--arena->ref > 0)
+        return;
+
+    chunk = arena->chunks;
+    while (chunk != NULL) {
+        next = chunk->next;
+        xmlFree(chunk);
+        chunk = next;
+    }
+    xmlFree(arena);
+}
+
+/*
+ * Drop the references to other arenas. Called when the owning
+ * document is freed and its nodes don't need them anymore. This also
+ * breaks reference cycles between documents that exchanged nodes.
+ */
+static void
+xmlArenaReleaseDeps(xmlArena *arena) {
+    int i;
+
+    for (i = 0; i < arena->nbDeps; i++)
+        xmlArenaRelease(arena->deps[i]);
+    xmlFree(arena->deps);
+    arena->deps = NULL;
+    arena->nbDeps = 0;
+    arena->maxDeps = 0;
+}
+
+static void *
+xmlArenaAlloc(xmlArena *arena, size_t size) {
+    xmlArenaChunk *chunk = arena->chunks;
+    void *ret;
+
+    if (size > SIZE_MAX - XML_ARENA_ALIGN - sizeof(xmlArenaChunk))
+        return(NULL);
+    size = (size + (XML_ARENA_ALIGN - 1)) & ~((size_t) XML_ARENA_ALIGN - 1);
+
+    if ((chunk == NULL) || ((size_t) (chunk->end - chunk->free) < size)) {
+        size_t chunkSize;
+
+        if (chunk == NULL)
+            chunkSize = XML_ARENA_MIN_CHUNK;
+        else if (chunk->size < XML_ARENA_MAX_CHUNK / 2)
+            chunkSize = chunk->size * 2;
+        else
+            chunkSize = XML_ARENA_MAX_CHUNK;
+        /* Large requests get a chunk of their own */
+        if (chunkSize < size)
+            chunkSize = size;
+
+        chunk = xmlMalloc(sizeof(xmlArenaChunk) + chunkSize);
+        if (chunk == NULL)
+            return(NULL);
+        chunk->size = chunkSize;
+        chunk->free = &chunk->array[0];
+        chunk->end = &chunk->array[chunkSize];
+
+        /*
+         * Keep the current chunk in front if it has more room left,
+         * so a single large request doesn't waste it.
+         */
+        if ((arena->chunks != NULL) &&
+            (chunkSize - size <
+             (size_t) (arena->chunks->end - arena->chunks->free))) {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    ret = chunk->free;
+    chunk->free += size;
+
+    return(ret);
+}
+
+static int
+xmlArenaOwnsLocal(const xmlArena *arena, const void *mem) {
+    const xmlArenaChunk *chunk;
+    const unsigned char *ptr = mem;
+
+    for (chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        if ((ptr >= chunk->array) && (ptr < chunk->free))
+            return(1);
+    }
+
+    return(0);
+}
+
+static int
+xmlArenaOwns(const xmlArena *arena, const void *mem) {
+    int i;
+
+    if (xmlArenaOwnsLocal(arena, mem))
+        return(1);
+    for (i = 0; i < arena->nbDeps; i++) {
+        if (xmlArenaOwnsLocal(arena->deps[i], mem))
+            return(1);
+    }
+
+    return(0);
+}
+
+static int
+xmlArenaAddDep(xmlArena *arena, xmlArena *dep) {
+    int i;
+
+    if (dep == arena)
+        return(0);
+    for (i = 0; i < arena->nbDeps; i++) {
+        if (arena->deps[i] == dep)
+            return(0);
+    }
+
+    if (arena->nbDeps >= arena->maxDeps) {
+        xmlArena **tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(arena->maxDeps, sizeof(tmp[0]),
+                                  4, XML_MAX_ITEMS);
+        if (newSize < 0)
+            return(-1);
+        tmp = xmlRealloc(arena->deps, newSize * sizeof(tmp[0]));
+        if (tmp == NULL)
+            return(-1);
+        arena->deps = tmp;
+        arena->maxDeps = newSize;
+    }
+
+    arena->deps[arena->nbDeps++] = dep;
+    dep->ref++;
+
+    return(0);
+}
+
+/*
+ * Mark the tree of `doc` as containing memory which isn't owned by
+ * its arenas.
+ */
+static void
+xmlDocSetMixed(xmlDocPtr doc) {
+    if ((doc != NULL) && (doc->arena != NULL))
+        ((xmlArena *) doc->arena)->mixed = 1;
+}
+
+/*
+ * Make `doc` reference the arenas holding nodes from `oldDoc`.
+ */
+static int
+xmlDocReferenceArena(xmlDocPtr doc, xmlDocPtr oldDoc) {
+    xmlArena *arena, *oldArena = oldDoc->arena;
+    int i;
+
+    if (doc->arena == NULL) {
+        doc->arena = xmlArenaCreate(0);
+        if (doc->arena == NULL)
+            return(-1);
+    }
+    arena = doc->arena;
+
+    if (xmlArenaAddDep(arena, oldArena) < 0)
+        return(-1);
+    for (i = 0; i < oldArena->nbDeps; i++) {
+        if (xmlArenaAddDep(arena, oldArena->deps[i]) < 0)
+            return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * Start allocating nodes of `doc` from an arena.
+ *
+ * @param doc  the document
+ * @returns 0 on success or -1 if a memory allocation failed.
+ */
+int
+xmlDocEnableArena(xmlDoc *doc) {
+    if (doc->arena == NULL) {
+        doc->arena = xmlArenaCreate(1);
+        if (doc->arena == NULL)
+            return(-1);
+    } else {
+        ((xmlArena *) doc->arena)->alloc = 1;
+    }
+
+    return(0);
+}
+
+/**
+ * Detach the arena from a document without nodes, so it can be
+ * merged into another document with #xmlDocMergeArena.
+ *
+ * @param doc  the document
+ * @returns the arena or NULL if the document has none.
+ */
+xmlArena *
+xmlDocTakeArena(xmlDoc *doc) {
+    xmlArena *arena = doc->arena;
+
+    doc->arena = NULL;
+    return(arena);
+}
+
+/**
+ * Move the memory of an arena without other users and without
+ * references to other arenas into the arena of `doc`. Can't fail.
+ *
+ * @param doc  a document with an arena
+ * @param arena  the arena to merge (optional)
+ */
+void
+xmlDocMergeArena(xmlDoc *doc, xmlArena *arena) {
+    xmlArena *dst = doc->arena;
+    xmlArenaChunk **last;
+
+    if (arena == NULL)
+        return;
+
+    /* Append, so the current chunk of `doc` stays in front */
+    last = &dst->chunks;
+    while (*last != NULL)
+        last = &(*last)->next;
+    *last = arena->chunks;
+    arena->chunks = NULL;
+    if (arena->mixed)
+        dst->mixed = 1;
+
+    xmlArenaRelease(arena);
+}
+
+/**
+ * Allocate memory for a node or string of `doc`.
+ *
+ * @param doc  the document (optional)
+ * @param size  the number of bytes
+ * @returns the memory or NULL if a memory allocation failed.
+ */
+void *
+xmlDocMalloc(xmlDoc *doc, size_t size) {
+    if ((doc != NULL) && (doc->arena != NULL) &&
+        (((xmlArena *) doc->arena)->alloc))
+        return(xmlArenaAlloc(doc->arena, size));
+
+    return(xmlMalloc(size));
+}
+
+/**
+ * Copy a string into memory of `doc`.
+ *
+ * @param doc  the document (optional)
+ * @param str  the string
+ * @param len  the length of the string
+ * @returns the copy or NULL if a memory allocation failed.
+ */
+xmlChar *
+xmlDocStrndup(xmlDoc *doc, const xmlChar *str, int len) {
+    xmlChar *ret;
+
+    if ((doc == NULL) || (doc->arena == NULL) ||
+        (!((xmlArena *) doc->arena)->alloc))
+        return(xmlStrndup(str, len));
+
+    if ((str == NULL) || (len < 0))
+        return(NULL);
+    ret = xmlArenaAlloc(doc->arena, (size_t) len + 1);
+    if (ret == NULL)
+        return(NULL);
+    memcpy(ret, str, len);
+    ret[len] = 0;
+
+    return(ret);
+}
+
+/**
+ * Copy a string into memory of `doc`.
+ *
+ * @param doc  the document (optional)
+ * @param str  the string
+ * @returns the copy or NULL if a memory allocation failed.
+ */
+xmlChar *
+xmlDocStrdup(xmlDoc *doc, const xmlChar *str) {
+    if (str == NULL)
+        return(NULL);
+    return(xmlDocStrndup(doc, str, xmlStrlen(str)));
+}
+
+/**
+ * @param doc  the document (optional)
+ * @param mem  a pointer
+ * @returns 1 if `mem` is owned by the arenas of `doc`, 0 otherwise.
+ */
+int
+xmlDocOwnsMem(const xmlDoc *doc, const void *mem) {
+    if ((doc == NULL) || (doc->arena == NULL))
+        return(0);
+
+    return(xmlArenaOwns(doc->arena, mem));
+}
+
+/**
+ * Free memory allocated with #xmlDocMalloc or #xmlMalloc. Arena
+ * memory is only reclaimed when the document is freed.
+ *
+ * @param doc  the document (optional)
+ * @param mem  the memory
+ */
+void
+xmlDocFreeMem(xmlDoc *doc, void *mem) {
+    if ((doc != NULL) && (doc->arena != NULL) &&
+        (xmlArenaOwns(doc->arena, mem)))
+        return;
+
+    xmlFree(mem);
+}
+
 /**
  * Create a new namespace. For a default namespace, `prefix` should be
  * NULL. The namespace URI in `href` is not checked. You should make sure
@@ -503,6 +896,9 @@ xmlValidateNMToken(const xmlChar *value, int space) {
  * the node already has a definition for the prefix or default
  * namespace.
  *
+ * The namespace is never allocated from the arena of the document, so
+ * it can be freed with #xmlFreeNs after unlinking.
+ *
  * @param node  the element carrying the namespace (optional)
  * @param href  the URI associated
  * @param prefix  the prefix for the namespace (optional)
@@ -511,27 +907,44 @@ xmlValidateNMToken(const xmlChar *value, int space) {
  */
 xmlNs *
 xmlNewNs(xmlNode *node, const xmlChar *href, const xmlChar *prefix) {
-    xmlNsPtr cur;
-
     if ((node != NULL) && (node->type != XML_ELEMENT_NODE))
 	return(NULL);
 
+    return(xmlDocNewNs(NULL, node, href, prefix));
+}
+
+/**
+ * Like #xmlNewNs, but allocates from the arena of `doc` if there
+ * is one. For the parser and internal callers which free namespaces
+ * through the document.
+ *
+ * @param doc  the document of `node` or the namespace (optional)
+ * @param node  the element carrying the namespace (optional)
+ * @param href  the URI associated
+ * @param prefix  the prefix for the namespace (optional)
+ * @returns a new namespace pointer or NULL on error.
+ */
+xmlNs *
+xmlDocNewNs(xmlDoc *doc, xmlNode *node, const xmlChar *href,
+            const xmlChar *prefix) {
+    xmlNsPtr cur;
+
     /*
      * Allocate a new Namespace and fill the fields.
      */
-    cur = (xmlNsPtr) xmlMalloc(sizeof(xmlNs));
+    cur = (xmlNsPtr) xmlDocMalloc(doc, sizeof(xmlNs));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNs));
     cur->type = XML_LOCAL_NAMESPACE;
 
     if (href != NULL) {
-	cur->href = xmlStrdup(href);
+	cur->href = xmlDocStrdup(doc, href);
         if (cur->href == NULL)
             goto error;
     }
     if (prefix != NULL) {
-	cur->prefix = xmlStrdup(prefix);
+	cur->prefix = xmlDocStrdup(doc, prefix);
         if (cur->prefix == NULL)
             goto error;
     }
@@ -561,7 +974,7 @@ xmlNewNs(xmlNode *node, const xmlChar *href, const xmlChar *prefix) {
     return(cur);
 
 error:
-    xmlFreeNs(cur);
+    xmlDocFreeNsList(doc, cur);
     return(NULL);
 }
 
@@ -615,6 +1028,44 @@ xmlFreeNsList(xmlNs *cur) {
     }
 }
 
+/**
+ * Free a list of namespaces which may be allocated from the arena
+ * of `doc`.
+ *
+ * @param doc  the document (optional)
+ * @param cur  the first namespace pointer
+ */
+static void
+xmlDocFreeNsList(xmlDocPtr doc, xmlNsPtr cur) {
+    xmlNsPtr next;
+
+    while (cur != NULL) {
+        next = cur->next;
+        xmlDocFreeNs(doc, cur);
+	cur = next;
+    }
+}
+
+/**
+ * Free a namespace which may be allocated from the arena of `doc`.
+ *
+ * @param doc  the document (optional)
+ * @param cur  the namespace
+ */
+static void
+xmlDocFreeNs(xmlDocPtr doc, xmlNsPtr cur) {
+    if ((doc == NULL) || (doc->arena == NULL)) {
+        xmlFreeNs(cur);
+        return;
+    }
+
+    if (cur == NULL)
+        return;
+    if (cur->href != NULL) xmlDocFreeMem(doc, (xmlChar *) cur->href);
+    if (cur->prefix != NULL) xmlDocFreeMem(doc, (xmlChar *) cur->prefix);
+    xmlDocFreeMem(doc, cur);
+}
+
 /**
  * Create a DTD node.
  *
@@ -807,6 +1258,17 @@ error:
 	    (xmlDictOwns(dict, (const xmlChar *)(str)) == 0)))	\
 	    xmlFree((char *)(str));
 
+/**
+ * Like DICT_FREE, but also skips memory owned by the arena of the
+ * "doc" in the current scope
+ *
+ * @param str  a string
+ */
+#define DOC_FREE(str)						\
+	if ((str) && ((!dict) ||				\
+	    (xmlDictOwns(dict, (const xmlChar *)(str)) == 0)))	\
+	    xmlDocFreeMem(doc, (char *)(str));
+
 /**
  * Free a DTD structure.
  *
@@ -914,12 +1376,14 @@ void
 xmlFreeDoc(xmlDoc *cur) {
     xmlDtdPtr extSubset, intSubset;
     xmlDictPtr dict = NULL;
+    xmlArena *arena;
 
     if (cur == NULL) {
 	return;
     }
 
     dict = cur->dict;
+    arena = cur->arena;
 
     if ((xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))
 	xmlDeregisterNodeDefaultValue((xmlNodePtr)cur);
@@ -946,17 +1410,46 @@ xmlFreeDoc(xmlDoc *cur) {
 	xmlFreeDtd(intSubset);
     }
 
-    if (cur->children != NULL) xmlFreeNodeList(cur->children);
+    /*
+     * If the tree only holds arena memory, it's released with the
+     * arena below.
+     */
+    if ((cur->children != NULL) &&
+        ((arena == NULL) || (!arena->alloc) || (arena->mixed) ||
+         ((xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))))
+        xmlFreeNodeList(cur->children);
     if (cur->oldNs != NULL) xmlFreeNsList(cur->oldNs);
 
     DICT_FREE(cur->version)
     DICT_FREE(cur->name)
     DICT_FREE(cur->encoding)
     DICT_FREE(cur->URL)
+    if (arena != NULL) {
+        xmlArenaReleaseDeps(arena);
+        xmlArenaRelease(arena);
+    }
+    xmlLineIndexFree(cur->lineIndex);
     xmlFree(cur);
     if (dict) xmlDictFree(dict);
 }
 
+
+/*
+ * Detach the content of a buffer as a string owned by the document's
+ * allocator.
+ */
+static xmlChar *
+xmlDocBufDetach(const xmlDoc *doc, xmlBufPtr buf) {
+    xmlChar *ret;
+
+    if ((doc == NULL) || (doc->arena == NULL))
+        return(xmlBufDetach(buf));
+
+    ret = xmlDocStrndup((xmlDocPtr) doc, xmlBufContent(buf), xmlBufUse(buf));
+    if (ret != NULL)
+        xmlBufEmpty(buf);
+    return(ret);
+}
 /**
  * See xmlNodeParseContent.
  *
@@ -1092,7 +1585,7 @@ xmlNodeParseContentInternal(const xmlDoc *doc, xmlNodePtr parent,
 			    node = xmlNewDocText(doc, NULL);
 			    if (node == NULL)
 				goto out;
-			    node->content = xmlBufDetach(buf);
+			    node->content = xmlDocBufDetach(doc, buf);
                             node->parent = parent;
 
 			    if (last == NULL) {
@@ -1122,8 +1615,7 @@ xmlNodeParseContentInternal(const xmlDoc *doc, xmlNodePtr parent,
 			/*
 			 * Create a new REFERENCE_REF node
 			 */
-			node = xmlNewEntityRef((xmlDocPtr) doc, val);
-                        val = NULL;
+			node = xmlNewEntityRef((xmlDocPtr) doc, val, -1);
 			if (node == NULL)
 			    goto out;
                         node->parent = parent;
@@ -1180,7 +1672,7 @@ xmlNodeParseContentInternal(const xmlDoc *doc, xmlNodePtr parent,
 	if (node == NULL)
             goto out;
         node->parent = parent;
-	node->content = xmlBufDetach(buf);
+	node->content = xmlDocBufDetach(doc, buf);
 
 	if (last == NULL) {
 	    head = node;
@@ -1445,7 +1937,8 @@ xmlNewPropInternal(xmlNodePtr node, xmlNsPtr ns,
     /*
      * Allocate a new property and fill the fields.
      */
-    cur = (xmlAttrPtr) xmlMalloc(sizeof(xmlAttr));
+    cur = (xmlAttrPtr) xmlDocMalloc(node ? node->doc : NULL,
+                                    sizeof(xmlAttr));
     if (cur == NULL) {
         if ((eatname == 1) &&
 	    ((node == NULL) || (node->doc == NULL) ||
@@ -1468,11 +1961,15 @@ xmlNewPropInternal(xmlNodePtr node, xmlNsPtr ns,
         if ((doc != NULL) && (doc->dict != NULL))
             cur->name = (xmlChar *) xmlDictLookup(doc->dict, name, -1);
         else
-            cur->name = xmlStrdup(name);
+            cur->name = xmlDocStrdup(doc, name);
         if (cur->name == NULL)
             goto error;
-    } else
+    } else {
         cur->name = name;
+        if ((doc == NULL) || (doc->dict == NULL) ||
+            (!xmlDictOwns(doc->dict, name)))
+            xmlDocSetMixed(doc);
+    }
 
     if (value != NULL) {
         xmlNodePtr tmp;
@@ -1626,19 +2123,19 @@ xmlNewDocProp(xmlDoc *doc, const xmlChar *name, const xmlChar *value) {
     /*
      * Allocate a new property and fill the fields.
      */
-    cur = (xmlAttrPtr) xmlMalloc(sizeof(xmlAttr));
+    cur = (xmlAttrPtr) xmlDocMalloc(doc, sizeof(xmlAttr));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlAttr));
     cur->type = XML_ATTRIBUTE_NODE;
+    cur->doc = doc;
 
     if ((doc != NULL) && (doc->dict != NULL))
 	cur->name = xmlDictLookup(doc->dict, name, -1);
     else
-	cur->name = xmlStrdup(name);
+	cur->name = xmlDocStrdup(doc, name);
     if (cur->name == NULL)
         goto error;
-    cur->doc = doc;
     if (value != NULL) {
 	if (xmlNodeParseContent((xmlNodePtr) cur, value, -1) < 0)
             goto error;
@@ -1676,10 +2173,12 @@ xmlFreePropList(xmlAttr *cur) {
  */
 void
 xmlFreeProp(xmlAttr *cur) {
+    xmlDocPtr doc;
     xmlDictPtr dict = NULL;
     if (cur == NULL) return;
 
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    doc = cur->doc;
+    if (doc != NULL) dict = doc->dict;
 
     if ((xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))
 	xmlDeregisterNodeDefaultValue((xmlNodePtr)cur);
@@ -1689,8 +2188,8 @@ xmlFreeProp(xmlAttr *cur) {
 	    xmlRemoveID(cur->doc, cur);
     }
     if (cur->children != NULL) xmlFreeNodeList(cur->children);
-    DICT_FREE(cur->name)
-    xmlFree(cur);
+    DOC_FREE(cur->name)
+    xmlDocFreeMem(doc, cur);
 }
 
 /**
@@ -1754,7 +2253,7 @@ xmlNewDocPI(xmlDoc *doc, const xmlChar *name, const xmlChar *content) {
     /*
      * Allocate a new node and fill the fields.
      */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    cur = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNode));
@@ -1764,11 +2263,11 @@ xmlNewDocPI(xmlDoc *doc, const xmlChar *name, const xmlChar *content) {
     if ((doc != NULL) && (doc->dict != NULL))
         cur->name = xmlDictLookup(doc->dict, name, -1);
     else
-	cur->name = xmlStrdup(name);
+	cur->name = xmlDocStrdup(doc, name);
     if (cur->name == NULL)
         goto error;
     if (content != NULL) {
-	cur->content = xmlStrdup(content);
+	cur->content = xmlDocStrdup(doc, content);
         if (cur->content == NULL)
             goto error;
     }
@@ -1836,7 +2335,7 @@ xmlNewElem(xmlDocPtr doc, xmlNsPtr ns, const xmlChar *name,
            const xmlChar *content) {
     xmlNodePtr cur;
 
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    cur = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNode));
@@ -1849,7 +2348,7 @@ xmlNewElem(xmlDocPtr doc, xmlNsPtr ns, const xmlChar *name,
     if (content != NULL) {
         if (xmlNodeParseContent(cur, content, -1) < 0) {
             /* Don't free name on error */
-            xmlFree(cur);
+            xmlDocFreeMem(doc, cur);
             return(NULL);
         }
     }
@@ -1901,13 +2400,13 @@ xmlNewDocNode(xmlDoc *doc, xmlNs *ns,
         return(xmlNewElem(doc, ns, dictName, content));
     }
 
-    copy = xmlStrdup(name);
+    copy = xmlDocStrdup(doc, name);
     if (copy == NULL)
         return(NULL);
 
     cur = xmlNewElem(doc, ns, copy, content);
     if (cur == NULL) {
-        xmlFree(copy);
+        xmlDocFreeMem(doc, copy);
         return(NULL);
     }
 
@@ -1945,6 +2444,9 @@ xmlNewDocNodeEatName(xmlDoc *doc, xmlNs *ns,
             xmlFree(name);
         return(NULL);
     }
+    if ((doc == NULL) || (doc->dict == NULL) ||
+        (!xmlDictOwns(doc->dict, name)))
+        xmlDocSetMixed(doc);
 
     return(cur);
 }
@@ -2000,7 +2502,7 @@ xmlNewDocFragment(xmlDoc *doc) {
     /*
      * Allocate a new DocumentFragment node and fill the fields.
      */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    cur = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNode));
@@ -2013,42 +2515,53 @@ xmlNewDocFragment(xmlDoc *doc) {
     return(cur);
 }
 
-/**
- * Create a text node.
- *
- * Use of this function is DISCOURAGED in favor of #xmlNewDocText.
- *
- * @param content  raw text content (optional)
- * @returns a pointer to the new node object or NULL if a memory
- * allocation failed.
+/*
+ * Create a text, comment or CDATA section node.
  */
-xmlNode *
-xmlNewText(const xmlChar *content) {
+static xmlNodePtr
+xmlNewCharData(xmlDocPtr doc, xmlElementType type, const xmlChar *name,
+               const xmlChar *content, int len) {
     xmlNodePtr cur;
 
     /*
      * Allocate a new node and fill the fields.
      */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    cur = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNode));
-    cur->type = XML_TEXT_NODE;
+    cur->type = type;
+    cur->doc = doc;
 
-    cur->name = xmlStringText;
+    cur->name = name;
     if (content != NULL) {
-	cur->content = xmlStrdup(content);
-        if (cur->content == NULL)
-            goto error;
+        if (len < 0)
+            cur->content = xmlDocStrdup(doc, content);
+        else
+            cur->content = xmlDocStrndup(doc, content, len);
+        if (cur->content == NULL) {
+            xmlDocFreeMem(doc, cur);
+            return(NULL);
+        }
     }
 
     if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
 	xmlRegisterNodeDefaultValue(cur);
     return(cur);
+}
 
-error:
-    xmlFreeNode(cur);
-    return(NULL);
+/**
+ * Create a text node.
+ *
+ * Use of this function is DISCOURAGED in favor of #xmlNewDocText.
+ *
+ * @param content  raw text content (optional)
+ * @returns a pointer to the new node object or NULL if a memory
+ * allocation failed.
+ */
+xmlNode *
+xmlNewText(const xmlChar *content) {
+    return(xmlNewCharData(NULL, XML_TEXT_NODE, xmlStringText, content, -1));
 }
 
 /**
@@ -2115,29 +2628,33 @@ xmlNewTextChild(xmlNode *parent, xmlNs *ns,
  * Create an empty entity reference node. This function doesn't attempt
  * to look up the entity in `doc`.
  *
- * `name` is consumed.
- *
  * @param doc  the target document (optional)
  * @param name  the entity name
+ * @param len  length of the name or -1 if zero-terminated
  * @returns a pointer to the new node object or NULL if arguments are
  * invalid or a memory allocation failed.
  */
 static xmlNodePtr
-xmlNewEntityRef(xmlDocPtr doc, xmlChar *name) {
+xmlNewEntityRef(xmlDocPtr doc, const xmlChar *name, int len) {
     xmlNodePtr cur;
 
     /*
      * Allocate a new node and fill the fields.
      */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
-    if (cur == NULL) {
-        xmlFree(name);
+    cur = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
+    if (cur == NULL)
 	return(NULL);
-    }
     memset(cur, 0, sizeof(xmlNode));
     cur->type = XML_ENTITY_REF_NODE;
     cur->doc = doc;
-    cur->name = name;
+    if (len < 0)
+        cur->name = xmlDocStrdup(doc, name);
+    else
+        cur->name = xmlDocStrndup(doc, name, len);
+    if (cur->name == NULL) {
+        xmlDocFreeMem(doc, cur);
+        return(NULL);
+    }
 
     if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
 	xmlRegisterNodeDefaultValue(cur);
@@ -2162,25 +2679,19 @@ xmlNewEntityRef(xmlDocPtr doc, xmlChar *name) {
  */
 xmlNode *
 xmlNewCharRef(xmlDoc *doc, const xmlChar *name) {
-    xmlChar *copy;
+    int len = -1;
 
     if (name == NULL)
         return(NULL);
 
     if (name[0] == '&') {
-        int len;
         name++;
 	len = xmlStrlen(name);
 	if (name[len - 1] == ';')
-	    copy = xmlStrndup(name, len - 1);
-	else
-	    copy = xmlStrndup(name, len);
-    } else
-	copy = xmlStrdup(name);
-    if (copy == NULL)
-        return(NULL);
+	    len--;
+    }
 
-    return(xmlNewEntityRef(doc, copy));
+    return(xmlNewEntityRef(doc, name, len));
 }
 
 /**
@@ -2205,7 +2716,7 @@ xmlNewReference(const xmlDoc *doc, const xmlChar *name) {
     /*
      * Allocate a new node and fill the fields.
      */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    cur = (xmlNodePtr) xmlDocMalloc((xmlDocPtr) doc, sizeof(xmlNode));
     if (cur == NULL)
 	return(NULL);
     memset(cur, 0, sizeof(xmlNode));
@@ -2217,11 +2728,11 @@ xmlNewReference(const xmlDoc *doc, const xmlChar *name) {
         name++;
 	len = xmlStrlen(name);
 	if (name[len - 1] == ';')
-	    cur->name = xmlStrndup(name, len - 1);
+	    cur->name = xmlDocStrndup(cur->doc, name, len - 1);
 	else
-	    cur->name = xmlStrndup(name, len);
+	    cur->name = xmlDocStrndup(cur->doc, name, len);
     } else
-	cur->name = xmlStrdup(name);
+	cur->name = xmlDocStrdup(cur->doc, name);
     if (cur->name == NULL)
         goto error;
 
@@ -2256,11 +2767,8 @@ error:
  */
 xmlNode *
 xmlNewDocText(const xmlDoc *doc, const xmlChar *content) {
-    xmlNodePtr cur;
-
-    cur = xmlNewText(content);
-    if (cur != NULL) cur->doc = (xmlDoc *)doc;
-    return(cur);
+    return(xmlNewCharData((xmlDocPtr) doc, XML_TEXT_NODE, xmlStringText,
+                          content, -1));
 }
 
 /**
@@ -2275,29 +2783,9 @@ xmlNewDocText(const xmlDoc *doc, const xmlChar *content) {
  */
 xmlNode *
 xmlNewTextLen(const xmlChar *content, int len) {
-    xmlNodePtr cur;
-
-    /*
-     * Allocate a new node and fill the fields.
-     */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
-    if (cur == NULL)
-	return(NULL);
-    memset(cur, 0, sizeof(xmlNode));
-    cur->type = XML_TEXT_NODE;
-
-    cur->name = xmlStringText;
-    if (content != NULL) {
-	cur->content = xmlStrndup(content, len);
-        if (cur->content == NULL) {
-            xmlFreeNode(cur);
-            return(NULL);
-        }
-    }
-
-    if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
-	xmlRegisterNodeDefaultValue(cur);
-    return(cur);
+    if ((content != NULL) && (len < 0))
+        return(NULL);
+    return(xmlNewCharData(NULL, XML_TEXT_NODE, xmlStringText, content, len));
 }
 
 /**
@@ -2311,11 +2799,9 @@ xmlNewTextLen(const xmlChar *content, int len) {
  */
 xmlNode *
 xmlNewDocTextLen(xmlDoc *doc, const xmlChar *content, int len) {
-    xmlNodePtr cur;
-
-    cur = xmlNewTextLen(content, len);
-    if (cur != NULL) cur->doc = doc;
-    return(cur);
+    if ((content != NULL) && (len < 0))
+        return(NULL);
+    return(xmlNewCharData(doc, XML_TEXT_NODE, xmlStringText, content, len));
 }
 
 /**
@@ -2329,31 +2815,8 @@ xmlNewDocTextLen(xmlDoc *doc, const xmlChar *content, int len) {
  */
 xmlNode *
 xmlNewComment(const xmlChar *content) {
-    xmlNodePtr cur;
-
-    /*
-     * Allocate a new node and fill the fields.
-     */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
-    if (cur == NULL)
-	return(NULL);
-    memset(cur, 0, sizeof(xmlNode));
-    cur->type = XML_COMMENT_NODE;
-
-    cur->name = xmlStringComment;
-    if (content != NULL) {
-	cur->content = xmlStrdup(content);
-        if (cur->content == NULL)
-            goto error;
-    }
-
-    if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
-	xmlRegisterNodeDefaultValue(cur);
-    return(cur);
-
-error:
-    xmlFreeNode(cur);
-    return(NULL);
+    return(xmlNewCharData(NULL, XML_COMMENT_NODE, xmlStringComment,
+                          content, -1));
 }
 
 /**
@@ -2367,29 +2830,9 @@ error:
  */
 xmlNode *
 xmlNewCDataBlock(xmlDoc *doc, const xmlChar *content, int len) {
-    xmlNodePtr cur;
-
-    /*
-     * Allocate a new node and fill the fields.
-     */
-    cur = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
-    if (cur == NULL)
-	return(NULL);
-    memset(cur, 0, sizeof(xmlNode));
-    cur->type = XML_CDATA_SECTION_NODE;
-    cur->doc = doc;
-
-    if (content != NULL) {
-	cur->content = xmlStrndup(content, len);
-        if (cur->content == NULL) {
-            xmlFree(cur);
-            return(NULL);
-        }
-    }
-
-    if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
-	xmlRegisterNodeDefaultValue(cur);
-    return(cur);
+    if ((content != NULL) && (len < 0))
+        return(NULL);
+    return(xmlNewCharData(doc, XML_CDATA_SECTION_NODE, NULL, content, len));
 }
 
 /**
@@ -2402,11 +2845,8 @@ xmlNewCDataBlock(xmlDoc *doc, const xmlChar *content, int len) {
  */
 xmlNode *
 xmlNewDocComment(xmlDoc *doc, const xmlChar *content) {
-    xmlNodePtr cur;
-
-    cur = xmlNewComment(content);
-    if (cur != NULL) cur->doc = doc;
-    return(cur);
+    return(xmlNewCharData(doc, XML_COMMENT_NODE, xmlStringComment,
+                          content, -1));
 }
 
 static void
@@ -2457,6 +2897,17 @@ xmlNodeSetDoc(xmlNodePtr node, xmlDocPtr doc) {
     oldDict = oldDoc ? oldDoc->dict : NULL;
     newDict = doc ? doc->dict : NULL;
 
+    /*
+     * Keep arena memory of the node alive. The node may also carry
+     * memory from the heap.
+     */
+    if ((oldDoc != NULL) && (oldDoc->arena != NULL) && (doc != NULL) &&
+        (doc->arena != oldDoc->arena)) {
+        if (xmlDocReferenceArena(doc, oldDoc) < 0)
+            ret = -1;
+    }
+    xmlDocSetMixed(doc);
+
     if ((oldDict != NULL) && (oldDict != newDict)) {
         if ((node->name != NULL) &&
             ((node->type == XML_ELEMENT_NODE) ||
@@ -2711,13 +3162,45 @@ xmlTextSetContent(xmlNodePtr text, xmlChar *content) {
         if ((doc == NULL) ||
             (doc->dict == NULL) ||
             (!xmlDictOwns(doc->dict, text->content)))
-            xmlFree(text->content);
+            xmlDocFreeMem(doc, text->content);
     }
 
     text->content = content;
     text->properties = NULL;
 }
 
+/*
+ * Like xmlStrncatNew but allocates the result from the memory of `doc`.
+ */
+static xmlChar *
+xmlDocStrncatNew(xmlDocPtr doc, const xmlChar *str1, const xmlChar *str2,
+                 int len) {
+    xmlChar *ret;
+    int size;
+
+    if ((doc == NULL) || (doc->arena == NULL) ||
+        (!((xmlArena *) doc->arena)->alloc))
+        return(xmlStrncatNew(str1, str2, len));
+
+    if (len < 0)
+        len = xmlStrlen(str2);
+    size = xmlStrlen(str1);
+    if ((str2 == NULL) || (len == 0))
+        return(xmlDocStrndup(doc, str1, size));
+    if (size > INT_MAX - len)
+        return(NULL);
+
+    ret = xmlDocMalloc(doc, (size_t) size + len + 1);
+    if (ret == NULL)
+        return(NULL);
+    if (size > 0)
+        memcpy(ret, str1, size);
+    memcpy(&ret[size], str2, len);
+    ret[size + len] = 0;
+
+    return(ret);
+}
+
 static int
 xmlTextAddContent(xmlNodePtr text, const xmlChar *content, int len) {
     xmlChar *merged;
@@ -2725,7 +3208,7 @@ xmlTextAddContent(xmlNodePtr text, const xmlChar *content, int len) {
     if (content == NULL)
         return(0);
 
-    merged = xmlStrncatNew(text->content, content, len);
+    merged = xmlDocStrncatNew(text->doc, text->content, content, len);
     if (merged == NULL)
         return(-1);
 
@@ -2801,7 +3284,8 @@ xmlInsertNode(xmlDocPtr doc, xmlNodePtr cur, xmlNodePtr parent,
             if (cur->content != NULL) {
 	        xmlChar *merged;
 
-                merged = xmlStrncatNew(cur->content, next->content, -1);
+                merged = xmlDocStrncatNew(next->doc, cur->content,
+                                          next->content, -1);
                 if (merged == NULL)
                     return(NULL);
                 xmlTextSetContent(next, merged);
@@ -3312,6 +3796,7 @@ void
 xmlFreeNodeList(xmlNode *cur) {
     xmlNodePtr next;
     xmlNodePtr parent;
+    xmlDocPtr doc;
     xmlDictPtr dict = NULL;
     size_t depth = 0;
 
@@ -3320,7 +3805,8 @@ xmlFreeNodeList(xmlNode *cur) {
 	xmlFreeNsList((xmlNsPtr) cur);
 	return;
     }
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    doc = cur->doc;
+    if (doc != NULL) dict = doc->dict;
     while (1) {
         while ((cur->children != NULL) &&
                (cur->type != XML_DOCUMENT_NODE) &&
@@ -3357,13 +3843,13 @@ xmlFreeNodeList(xmlNode *cur) {
 		(cur->type != XML_XINCLUDE_END) &&
 		(cur->type != XML_ENTITY_REF_NODE) &&
 		(cur->content != (xmlChar *) &(cur->properties))) {
-		DICT_FREE(cur->content)
+		DOC_FREE(cur->content)
 	    }
 	    if (((cur->type == XML_ELEMENT_NODE) ||
 	         (cur->type == XML_XINCLUDE_START) ||
 		 (cur->type == XML_XINCLUDE_END)) &&
 		(cur->nsDef != NULL))
-		xmlFreeNsList(cur->nsDef);
+		xmlDocFreeNsList(doc, cur->nsDef);
 
 	    /*
 	     * When a node is a text node or a comment, it uses a global static
@@ -3374,8 +3860,8 @@ xmlFreeNodeList(xmlNode *cur) {
 	    if ((cur->name != NULL) &&
 		(cur->type != XML_TEXT_NODE) &&
 		(cur->type != XML_COMMENT_NODE))
-		DICT_FREE(cur->name)
-	    xmlFree(cur);
+		DOC_FREE(cur->name)
+	    xmlDocFreeMem(doc, cur);
 	}
 
         if (next != NULL) {
@@ -3400,6 +3886,7 @@ xmlFreeNodeList(xmlNode *cur) {
  */
 void
 xmlFreeNode(xmlNode *cur) {
+    xmlDocPtr doc;
     xmlDictPtr dict = NULL;
 
     if (cur == NULL) return;
@@ -3425,7 +3912,8 @@ xmlFreeNode(xmlNode *cur) {
     if ((xmlRegisterCallbacks) && (xmlDeregisterNodeDefaultValue))
 	xmlDeregisterNodeDefaultValue(cur);
 
-    if (cur->doc != NULL) dict = cur->doc->dict;
+    doc = cur->doc;
+    if (doc != NULL) dict = doc->dict;
 
     if ((cur->children != NULL) &&
 	(cur->type != XML_ENTITY_REF_NODE))
@@ -3437,11 +3925,11 @@ xmlFreeNode(xmlNode *cur) {
         if (cur->properties != NULL)
             xmlFreePropList(cur->properties);
         if (cur->nsDef != NULL)
-            xmlFreeNsList(cur->nsDef);
+            xmlDocFreeNsList(doc, cur->nsDef);
     } else if ((cur->content != NULL) &&
                (cur->type != XML_ENTITY_REF_NODE) &&
                (cur->content != (xmlChar *) &(cur->properties))) {
-        DICT_FREE(cur->content)
+        DOC_FREE(cur->content)
     }
 
     /*
@@ -3452,9 +3940,9 @@ xmlFreeNode(xmlNode *cur) {
     if ((cur->name != NULL) &&
         (cur->type != XML_TEXT_NODE) &&
         (cur->type != XML_COMMENT_NODE))
-	DICT_FREE(cur->name)
+	DOC_FREE(cur->name)
 
-    xmlFree(cur);
+    xmlDocFreeMem(doc, cur);
 }
 
 /**
@@ -3611,22 +4099,18 @@ xmlCopyNamespace(xmlNs *cur) {
     return(ret);
 }
 
-/**
- * Copy a namespace list.
- *
- * @param cur  the first namespace
- * @returns the head of the copied list or NULL if a memory
- * allocation failed.
- */
-xmlNs *
-xmlCopyNamespaceList(xmlNs *cur) {
+static xmlNsPtr
+xmlDocCopyNamespaceList(xmlDocPtr doc, xmlNsPtr cur) {
     xmlNsPtr ret = NULL;
     xmlNsPtr p = NULL,q;
 
     while (cur != NULL) {
-        q = xmlCopyNamespace(cur);
+        if (cur->type == XML_LOCAL_NAMESPACE)
+            q = xmlDocNewNs(doc, NULL, cur->href, cur->prefix);
+        else
+            q = NULL;
         if (q == NULL) {
-            xmlFreeNsList(ret);
+            xmlDocFreeNsList(doc, ret);
             return(NULL);
         }
 	if (p == NULL) {
@@ -3640,6 +4124,18 @@ xmlCopyNamespaceList(xmlNs *cur) {
     return(ret);
 }
 
+/**
+ * Copy a namespace list.
+ *
+ * @param cur  the first namespace
+ * @returns the head of the copied list or NULL if a memory
+ * allocation failed.
+ */
+xmlNs *
+xmlCopyNamespaceList(xmlNs *cur) {
+    return(xmlDocCopyNamespaceList(NULL, cur));
+}
+
 static xmlAttrPtr
 xmlCopyPropInternal(xmlDocPtr doc, xmlNodePtr target, xmlAttrPtr cur) {
     xmlAttrPtr ret = NULL;
@@ -3872,7 +4368,7 @@ xmlStaticCopyNode(xmlNode *node, xmlDoc *doc, xmlNode *parent,
     /*
      * Allocate a new node and fill the fields.
      */
-    ret = (xmlNodePtr) xmlMalloc(sizeof(xmlNode));
+    ret = (xmlNodePtr) xmlDocMalloc(doc, sizeof(xmlNode));
     if (ret == NULL)
 	return(NULL);
     memset(ret, 0, sizeof(xmlNode));
@@ -3890,7 +4386,7 @@ xmlStaticCopyNode(xmlNode *node, xmlDoc *doc, xmlNode *parent,
         if ((doc != NULL) && (doc->dict != NULL))
 	    ret->name = xmlDictLookup(doc->dict, node->name, -1);
 	else
-	    ret->name = xmlStrdup(node->name);
+	    ret->name = xmlDocStrdup(doc, node->name);
         if (ret->name == NULL)
             goto error;
     }
@@ -3899,7 +4395,7 @@ xmlStaticCopyNode(xmlNode *node, xmlDoc *doc, xmlNode *parent,
 	(node->type != XML_ENTITY_REF_NODE) &&
 	(node->type != XML_XINCLUDE_END) &&
 	(node->type != XML_XINCLUDE_START)) {
-	ret->content = xmlStrdup(node->content);
+	ret->content = xmlDocStrdup(doc, node->content);
         if (ret->content == NULL)
             goto error;
     }else{
@@ -3911,7 +4407,7 @@ xmlStaticCopyNode(xmlNode *node, xmlDoc *doc, xmlNode *parent,
 	goto out;
     if (((node->type == XML_ELEMENT_NODE) ||
          (node->type == XML_XINCLUDE_START)) && (node->nsDef != NULL)) {
-        ret->nsDef = xmlCopyNamespaceList(node->nsDef);
+        ret->nsDef = xmlDocCopyNamespaceList(doc, node->nsDef);
         if (ret->nsDef == NULL)
             goto error;
     }
@@ -4367,6 +4863,172 @@ error:
  *									*
  ************************************************************************/
 
+/*
+ * Newline index
+ *
+ * Documents parsed with XML_PARSE_OFFSETS store the byte offset of
+ * nodes in the input instead of a line number. The index records the
+ * offset of every line start in the main input and is filled when the
+ * parser discards consumed input, so the input is only scanned once
+ * more with memchr.
+ */
+
+struct _xmlLineIndex {
+    /* offsets of the starts of lines 2, 3, ... */
+    size_t *starts;
+    int nbLines;
+    int maxLines;
+    /* number of bytes indexed */
+    size_t size;
+    /* whether the last byte indexed was a carriage return */
+    int lastCR;
+    /* whether input was skipped and lookups must fail */
+    int broken;
+};
+
+/**
+ * Create an empty newline index.
+ *
+ * @returns the index or NULL if a memory allocation failed
+ */
+xmlLineIndex *
+xmlLineIndexCreate(void) {
+    xmlLineIndex *index;
+
+    index = xmlMalloc(sizeof(*index));
+    if (index == NULL)
+        return(NULL);
+    memset(index, 0, sizeof(*index));
+
+    return(index);
+}
+
+/**
+ * Free a newline index.
+ *
+ * @param index  the index
+ */
+void
+xmlLineIndexFree(xmlLineIndex *index) {
+    if (index == NULL)
+        return;
+    xmlFree(index->starts);
+    xmlFree(index);
+}
+
+static int
+xmlLineIndexPush(xmlLineIndex *index, size_t start) {
+    if (index->nbLines >= index->maxLines) {
+        size_t *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(index->maxLines, sizeof(tmp[0]),
+                                  256, XML_MAX_ITEMS);
+        if (newSize < 0)
+            return(-1);
+        tmp = xmlRealloc(index->starts, newSize * sizeof(tmp[0]));
+        if (tmp == NULL)
+            return(-1);
+        index->starts = tmp;
+        index->maxLines = newSize;
+    }
+
+    index->starts[index->nbLines++] = start;
+    return(0);
+}
+
+/**
+ * Add input to a newline index. `data` holds the input starting at
+ * byte `offset`. Bytes which were already indexed are skipped. Like
+ * the parser, a carriage return followed by a newline counts as a
+ * single line break and a standalone carriage return as a line break.
+ *
+ * @param index  the index
+ * @param offset  offset of the first byte of `data` in the input
+ * @param data  the input
+ * @param len  length of `data`
+ * @returns 0 on success or -1 if a memory allocation failed
+ */
+int
+xmlLineIndexAdd(xmlLineIndex *index, size_t offset, const xmlChar *data,
+                size_t len) {
+    const xmlChar *cur, *end;
+
+    if ((index == NULL) || (index->broken))
+        return(0);
+    if (offset > index->size) {
+        index->broken = 1;
+        return(0);
+    }
+    if (offset + len <= index->size)
+        return(0);
+
+    cur = data + (index->size - offset);
+    end = data + len;
+
+    while (cur < end) {
+        const xmlChar *nl;
+        const xmlChar *cr;
+        size_t avail = end - cur;
+
+        if (index->lastCR) {
+            index->lastCR = 0;
+            if (*cur == '\n') {
+                /* Line start was recorded at the carriage return */
+                index->starts[index->nbLines - 1] += 1;
+                cur++;
+                continue;
+            }
+        }
+
+        nl = memchr(cur, '\n', avail);
+        cr = memchr(cur, '\r', nl ? (size_t) (nl - cur) : avail);
+        if (cr != NULL) {
+            cur = cr + 1;
+            index->lastCR = 1;
+        } else if (nl != NULL) {
+            cur = nl + 1;
+        } else {
+            break;
+        }
+
+        if (xmlLineIndexPush(index, offset + (cur - data)) < 0)
+            return(-1);
+    }
+
+    index->size = offset + len;
+    return(0);
+}
+
+/**
+ * Look up the line number of a byte offset.
+ *
+ * @param index  the index
+ * @param offset  offset in the input
+ * @returns the line number or -1 if the offset wasn't indexed
+ */
+long
+xmlLineIndexLookup(const xmlLineIndex *index, size_t offset) {
+    int lo, hi;
+
+    if ((index == NULL) || (index->broken) || (offset > index->size))
+        return(-1);
+
+    /* Count the line starts at or before offset */
+    lo = 0;
+    hi = index->nbLines;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (index->starts[mid] <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return((long) lo + 1);
+}
+
 /**
  * Get line number of `node`. Try to work around the limitation of
  * line numbers being stored as 16 bits ints. Requires xmlParserOption
@@ -4391,7 +5053,13 @@ xmlGetLineNoInternal(const xmlNode *node, int depth)
 	(node->type == XML_COMMENT_NODE) ||
 	(node->type == XML_PI_NODE)) {
 	if (node->line == 65535) {
-	    if ((node->type == XML_TEXT_NODE) && (node->psvi != NULL))
+            xmlLineIndex *index =
+                (node->doc != NULL) ? node->doc->lineIndex : NULL;
+
+	    if ((index != NULL) && (node->psvi != NULL))
+	        result = xmlLineIndexLookup(index, xmlGetNodeOffset(node));
+	    else if ((index == NULL) && (node->type == XML_TEXT_NODE) &&
+                     (node->psvi != NULL))
 	        result = XML_PTR_TO_INT(node->psvi);
 	    else if ((node->type == XML_ELEMENT_NODE) &&
 	             (node->children != NULL))
@@ -4419,7 +5087,7 @@ xmlGetLineNoInternal(const xmlNode *node, int depth)
 /**
  * Get line number of `node`. Try to work around the limitation of
  * line numbers being stored as 16 bits ints. Requires xmlParserOption
- * XML_PARSE_BIG_LINES to be set when parsing.
+ * XML_PARSE_BIG_LINES or XML_PARSE_OFFSETS to be set when parsing.
  *
  * @param node  valid node
  * @returns the line number if successful, -1 otherwise
@@ -4431,25 +5099,61 @@ xmlGetLineNo(const xmlNode *node)
 }
 
 /**
- * Build a structure based Path for the given node
+ * Get the byte offset of `node` in the parsed input. This is the
+ * offset of the '<' starting an element, comment, processing
+ * instruction or CDATA section, and of the first character or
+ * reference of a text node. Requires xmlParserOption XML_PARSE_OFFSETS
+ * to be set when parsing.
  *
- * @param node  a node
- * @returns the new path or NULL in case of error. The caller must free
- *     the returned string
+ * The offset is stored in the psvi field of the node, plus one to
+ * distinguish offset 0 from a missing offset. Nodes from entities
+ * have no offset.
+ *
+ * @since 2.15.0
+ *
+ * @param node  valid node
+ * @returns the offset if successful, -1 otherwise
  */
-xmlChar *
-xmlGetNodePath(const xmlNode *node)
+long
+xmlGetNodeOffset(const xmlNode *node)
 {
-    const xmlNode *cur, *tmp, *next;
-    xmlChar *buffer = NULL;
-    size_t buf_len, len;
-    xmlChar *buf;
-    const char *sep;
-    const char *name;
-    char nametemp[100];
-    int occur = 0, generic;
+    if ((node == NULL) || (node->doc == NULL) ||
+        (node->doc->lineIndex == NULL) || (node->psvi == NULL))
+        return(-1);
 
-    if ((node == NULL) || (node->type == XML_NAMESPACE_DECL))
+    switch (node->type) {
+        case XML_ELEMENT_NODE:
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+        case XML_ENTITY_REF_NODE:
+        case XML_COMMENT_NODE:
+        case XML_PI_NODE:
+            return((long) XML_PTR_TO_INT(node->psvi) - 1);
+        default:
+            return(-1);
+    }
+}
+
+/**
+ * Build a structure based Path for the given node
+ *
+ * @param node  a node
+ * @returns the new path or NULL in case of error. The caller must free
+ *     the returned string
+ */
+xmlChar *
+xmlGetNodePath(const xmlNode *node)
+{
+    const xmlNode *cur, *tmp, *next;
+    xmlChar *buffer = NULL;
+    size_t buf_len, len;
+    xmlChar *buf;
+    const char *sep;
+    const char *name;
+    char nametemp[100];
+    int occur = 0, generic;
+
+    if ((node == NULL) || (node->type == XML_NAMESPACE_DECL))
         return (NULL);
 
     buf_len = 500;
@@ -4921,7 +5625,7 @@ xmlNodeSetName(xmlNode *cur, const xmlChar *name) {
     if (dict != NULL)
         copy = xmlDictLookup(dict, name, -1);
     else
-        copy = xmlStrdup(name);
+        copy = xmlDocStrdup(doc, name);
     if (copy == NULL)
         return;
 
@@ -4929,7 +5633,7 @@ xmlNodeSetName(xmlNode *cur, const xmlChar *name) {
     cur->name = copy;
     if ((oldName != NULL) &&
         ((dict == NULL) || (!xmlDictOwns(dict, oldName))))
-        xmlFree((xmlChar *) oldName);
+        xmlDocFreeMem(doc, (xmlChar *) oldName);
 }
 
 /**
@@ -5354,9 +6058,9 @@ xmlNodeSetContentInternal(xmlNodePtr cur, const xmlChar *content, int len) {
 
 	    if (content != NULL) {
                 if (len < 0)
-                    copy = xmlStrdup(content);
+                    copy = xmlDocStrdup(cur->doc, content);
                 else
-		    copy = xmlStrndup(content, len);
+		    copy = xmlDocStrndup(cur->doc, content, len);
                 if (copy == NULL)
                     return(-1);
 	    }
@@ -7428,7 +8132,7 @@ xmlDOMWrapNSNormDeclareNsForced(xmlDocPtr doc,
 	    if (xmlSearchNsByPrefixStrict(doc, elem->parent, pref, NULL) == 1)
 		goto ns_next_prefix;
 	}
-	ret = xmlNewNs(NULL, nsName, pref);
+	ret = xmlDocNewNs(elem->doc, NULL, nsName, pref);
 	if (ret == NULL)
 	    return (NULL);
 	if (elem->nsDef == NULL)
@@ -7840,7 +8544,7 @@ next_sibling:
 
     if (listRedund) {
 	for (i = 0, j = 0; i < nbRedund; i++, j += 2) {
-	    xmlFreeNs(listRedund[j]);
+	    xmlDocFreeNs(elem->doc, listRedund[j]);
 	}
 	xmlFree(listRedund);
     }
@@ -8209,6 +8913,8 @@ xmlDOMWrapCloneNode(xmlDOMWrapCtxt *ctxt,
         return (-1);
 
     dict = destDoc->dict;
+    /* Clones are allocated from the heap */
+    xmlDocSetMixed(destDoc);
     /*
     * Reuse the namespace map of the context.
     */
@@ -8827,6 +9533,1401 @@ xmlDOMWrapAdoptNode(xmlDOMWrapCtxt *ctxt,
     return (ret);
 }
 
+/************************************************************************
+ *									*
+ *			Binary snapshots				*
+ *									*
+ ************************************************************************/
+
+/*
+ * A snapshot is a flat serialization of a document tree which can be
+ * turned back into a tree without running the parser.
+ *
+ * All numbers are unsigned LEB128 varints. A snapshot starts with a
+ * magic string, the format version and a table of the names used by
+ * elements, attributes, processing instructions, entity references
+ * and namespaces. Names are referenced by their index in the table
+ * plus one and interned into the dictionary of the new document only
+ * once. Other strings are stored inline as length plus one followed
+ * by the bytes, 0 encodes NULL. Strings which are passed on as C
+ * strings, like DTD declarations, keep their terminating null byte,
+ * so they can be used without copying.
+ *
+ * The table is followed by the document properties, the external
+ * subset and the children of the document in document order. Each
+ * node starts with its type. Elements are followed by their namespace
+ * declarations, their namespace, their line, their attributes and
+ * their children, the last two lists are terminated by a zero. Line
+ * numbers are stored relative to the previous node. Namespaces are
+ * referenced by the index of their declaration in document order
+ * plus two, 1 stands for the XML namespace and 0 for no namespace.
+ * Attribute values consisting of a single text node are stored as a
+ * string, other values as list of nodes.
+ *
+ * DTDs store their notations first, then their declarations in the
+ * order of the children list, so loading can replay them.
+ */
+
+#define XML_SNAPSHOT_VERSION 1
+#define XML_SNAPSHOT_MAX_DEPTH 10000
+
+static const unsigned char xmlSnapshotMagic[8] = {
+    0x89, 'X', 'M', 'L', 'S', 'N', 'A', 'P'
+};
+
+typedef struct {
+    unsigned char *mem;
+    size_t size;
+    size_t max;
+} xmlSnapshotBuf;
+
+typedef struct {
+    xmlDocPtr doc;
+    xmlSnapshotBuf out;
+    xmlSnapshotBuf names;
+    xmlHashTablePtr nameIds;
+    int nbNames;
+    /* namespace declarations in scope and their ids */
+    xmlNsPtr *nsTab;
+    int *nsIds;
+    int nbNs;
+    int maxNs;
+    int nextNsId;
+    /* line number of the previous node */
+    unsigned line;
+    int error;
+} xmlSnapshotWriter;
+
+static void
+xmlSnapshotPutBytes(xmlSnapshotWriter *w, xmlSnapshotBuf *buf,
+                    const void *data, size_t len) {
+    if (w->error)
+        return;
+
+    if (buf->max - buf->size < len) {
+        unsigned char *tmp;
+        size_t newMax = buf->max ? buf->max : 4096;
+
+        if (len > SIZE_MAX / 2 - buf->size) {
+            w->error = 1;
+            return;
+        }
+        while (newMax < buf->size + len)
+            newMax *= 2;
+        tmp = xmlRealloc(buf->mem, newMax);
+        if (tmp == NULL) {
+            w->error = 1;
+            return;
+        }
+        buf->mem = tmp;
+        buf->max = newMax;
+    }
+
+    memcpy(buf->mem + buf->size, data, len);
+    buf->size += len;
+}
+
+static int
+xmlSnapshotEncodeNum(unsigned char *out, size_t val) {
+    int len = 0;
+
+    while (val >= 0x80) {
+        out[len++] = (val & 0x7F) | 0x80;
+        val >>= 7;
+    }
+    out[len++] = val;
+
+    return(len);
+}
+
+static void
+xmlSnapshotPutNum(xmlSnapshotWriter *w, size_t val) {
+    unsigned char tmp[16];
+
+    if ((val < 0x80) && (w->out.size < w->out.max)) {
+        w->out.mem[w->out.size++] = val;
+        return;
+    }
+    xmlSnapshotPutBytes(w, &w->out, tmp, xmlSnapshotEncodeNum(tmp, val));
+}
+
+static void
+xmlSnapshotPutString(xmlSnapshotWriter *w, const xmlChar *str) {
+    size_t len;
+
+    if (str == NULL) {
+        xmlSnapshotPutNum(w, 0);
+        return;
+    }
+    len = strlen((const char *) str);
+    xmlSnapshotPutNum(w, len + 1);
+    xmlSnapshotPutBytes(w, &w->out, str, len + 1);
+}
+
+/*
+ * Like xmlSnapshotPutString, but without the terminating null byte.
+ */
+static void
+xmlSnapshotPutData(xmlSnapshotWriter *w, const xmlChar *str) {
+    size_t len;
+
+    if (str == NULL) {
+        xmlSnapshotPutNum(w, 0);
+        return;
+    }
+    len = strlen((const char *) str);
+    xmlSnapshotPutNum(w, len + 1);
+    xmlSnapshotPutBytes(w, &w->out, str, len);
+}
+
+/*
+ * Line numbers are stored as zigzag encoded difference to the line
+ * of the previous node.
+ */
+static void
+xmlSnapshotPutLine(xmlSnapshotWriter *w, unsigned line) {
+    if (line >= w->line)
+        xmlSnapshotPutNum(w, (size_t) (line - w->line) * 2);
+    else
+        xmlSnapshotPutNum(w, (size_t) (w->line - line) * 2 - 1);
+    w->line = line;
+}
+
+static void
+xmlSnapshotPutName(xmlSnapshotWriter *w, const xmlChar *name) {
+    unsigned char tmp[16];
+    size_t len;
+    int id;
+
+    if (name == NULL) {
+        xmlSnapshotPutNum(w, 0);
+        return;
+    }
+
+    id = XML_PTR_TO_INT(xmlHashLookup(w->nameIds, name));
+    if (id == 0) {
+        if (w->nbNames >= XML_MAX_ITEMS) {
+            w->error = 1;
+            return;
+        }
+        id = w->nbNames + 1;
+        if (xmlHashAdd(w->nameIds, name, XML_INT_TO_PTR(id)) < 0) {
+            w->error = 1;
+            return;
+        }
+        w->nbNames += 1;
+
+        len = strlen((const char *) name);
+        xmlSnapshotPutBytes(w, &w->names, tmp,
+                            xmlSnapshotEncodeNum(tmp, len));
+        xmlSnapshotPutBytes(w, &w->names, name, len + 1);
+    }
+
+    xmlSnapshotPutNum(w, id);
+}
+
+static void
+xmlSnapshotPushNs(xmlSnapshotWriter *w, xmlNsPtr ns) {
+    if (w->nbNs >= w->maxNs) {
+        xmlNsPtr *tab;
+        int *ids;
+        int newSize;
+
+        newSize = xmlGrowCapacity(w->maxNs, sizeof(tab[0]) + sizeof(ids[0]),
+                                  16, XML_MAX_ITEMS);
+        if (newSize < 0) {
+            w->error = 1;
+            return;
+        }
+        tab = xmlRealloc(w->nsTab, newSize * sizeof(tab[0]));
+        if (tab == NULL) {
+            w->error = 1;
+            return;
+        }
+        w->nsTab = tab;
+        ids = xmlRealloc(w->nsIds, newSize * sizeof(ids[0]));
+        if (ids == NULL) {
+            w->error = 1;
+            return;
+        }
+        w->nsIds = ids;
+        w->maxNs = newSize;
+    }
+
+    w->nsTab[w->nbNs] = ns;
+    w->nsIds[w->nbNs] = w->nextNsId++;
+    w->nbNs += 1;
+}
+
+static void
+xmlSnapshotPutNs(xmlSnapshotWriter *w, const xmlNs *ns) {
+    int i;
+
+    if (ns == NULL) {
+        xmlSnapshotPutNum(w, 0);
+        return;
+    }
+
+    for (i = w->nbNs - 1; i >= 0; i--) {
+        if (w->nsTab[i] == ns) {
+            xmlSnapshotPutNum(w, (size_t) w->nsIds[i] + 2);
+            return;
+        }
+    }
+
+    if ((ns == w->doc->oldNs) ||
+        ((xmlStrEqual(ns->prefix, BAD_CAST "xml")) &&
+         (xmlStrEqual(ns->href, XML_XML_NAMESPACE)))) {
+        xmlSnapshotPutNum(w, 1);
+        return;
+    }
+
+    /* Namespace isn't declared in scope */
+    w->error = 1;
+}
+
+/*
+ * Write a node without children or attributes.
+ */
+static void
+xmlSnapshotPutLeaf(xmlSnapshotWriter *w, const xmlNode *cur) {
+    xmlSnapshotPutNum(w, cur->type);
+
+    switch (cur->type) {
+        case XML_TEXT_NODE:
+            xmlSnapshotPutNum(w, cur->name == xmlStringTextNoenc);
+            xmlSnapshotPutLine(w, cur->line);
+            xmlSnapshotPutData(w, cur->content);
+            break;
+        case XML_CDATA_SECTION_NODE:
+            xmlSnapshotPutData(w, cur->content);
+            break;
+        case XML_ENTITY_REF_NODE:
+            xmlSnapshotPutName(w, cur->name);
+            break;
+        case XML_PI_NODE:
+            xmlSnapshotPutName(w, cur->name);
+            xmlSnapshotPutLine(w, cur->line);
+            xmlSnapshotPutData(w, cur->content);
+            break;
+        case XML_COMMENT_NODE:
+            xmlSnapshotPutLine(w, cur->line);
+            xmlSnapshotPutData(w, cur->content);
+            break;
+        default:
+            w->error = 1;
+            break;
+    }
+}
+
+static void
+xmlSnapshotPutNotation(void *payload, void *data,
+                       const xmlChar *name ATTRIBUTE_UNUSED) {
+    xmlNotationPtr nota = payload;
+    xmlSnapshotWriter *w = data;
+
+    xmlSnapshotPutString(w, nota->name);
+    xmlSnapshotPutString(w, nota->PublicID);
+    xmlSnapshotPutString(w, nota->SystemID);
+}
+
+static void
+xmlSnapshotPutContent(xmlSnapshotWriter *w, const xmlElementContent *cont,
+                      int depth) {
+    if (depth > XML_SNAPSHOT_MAX_DEPTH) {
+        w->error = 1;
+        return;
+    }
+
+    /* Sequences and choices are chained through c2 */
+    while (cont != NULL) {
+        xmlSnapshotPutNum(w, cont->type);
+        xmlSnapshotPutNum(w, cont->ocur);
+        xmlSnapshotPutString(w, cont->name);
+        xmlSnapshotPutString(w, cont->prefix);
+        if ((cont->type != XML_ELEMENT_CONTENT_SEQ) &&
+            (cont->type != XML_ELEMENT_CONTENT_OR))
+            return;
+        xmlSnapshotPutContent(w, cont->c1, depth + 1);
+        cont = cont->c2;
+    }
+
+    xmlSnapshotPutNum(w, 0);
+}
+
+static void
+xmlSnapshotPutDtd(xmlSnapshotWriter *w, const xmlDtd *dtd) {
+    const xmlNode *cur;
+
+    xmlSnapshotPutString(w, dtd->name);
+    xmlSnapshotPutString(w, dtd->ExternalID);
+    xmlSnapshotPutString(w, dtd->SystemID);
+
+    if (dtd->notations != NULL) {
+        xmlSnapshotPutNum(w, xmlHashSize(dtd->notations));
+        xmlHashScan(dtd->notations, xmlSnapshotPutNotation, w);
+    } else {
+        xmlSnapshotPutNum(w, 0);
+    }
+
+    for (cur = dtd->children; cur != NULL; cur = cur->next) {
+        switch (cur->type) {
+            case XML_ELEMENT_DECL: {
+                const xmlElement *elem = (const xmlElement *) cur;
+
+                xmlSnapshotPutNum(w, cur->type);
+                xmlSnapshotPutString(w, elem->name);
+                xmlSnapshotPutString(w, elem->prefix);
+                xmlSnapshotPutNum(w, elem->etype);
+                xmlSnapshotPutContent(w, elem->content, 0);
+                break;
+            }
+
+            case XML_ATTRIBUTE_DECL: {
+                const xmlAttribute *attr = (const xmlAttribute *) cur;
+                const xmlEnumeration *value;
+                size_t nbEnum = 0;
+
+                xmlSnapshotPutNum(w, XML_ATTRIBUTE_DECL);
+                xmlSnapshotPutString(w, attr->elem);
+                xmlSnapshotPutString(w, attr->name);
+                xmlSnapshotPutString(w, attr->prefix);
+                xmlSnapshotPutNum(w, attr->atype);
+                xmlSnapshotPutNum(w, attr->def);
+                xmlSnapshotPutString(w, attr->defaultValue);
+                for (value = attr->tree; value != NULL; value = value->next)
+                    nbEnum++;
+                xmlSnapshotPutNum(w, nbEnum);
+                for (value = attr->tree; value != NULL; value = value->next)
+                    xmlSnapshotPutString(w, value->name);
+                break;
+            }
+
+            case XML_ENTITY_DECL: {
+                const xmlEntity *ent = (const xmlEntity *) cur;
+
+                xmlSnapshotPutNum(w, cur->type);
+                xmlSnapshotPutString(w, ent->name);
+                xmlSnapshotPutNum(w, ent->etype);
+                xmlSnapshotPutString(w, ent->ExternalID);
+                xmlSnapshotPutString(w, ent->SystemID);
+                xmlSnapshotPutString(w, ent->content);
+                xmlSnapshotPutString(w, ent->orig);
+                xmlSnapshotPutString(w, ent->URI);
+                break;
+            }
+
+            case XML_PI_NODE:
+            case XML_COMMENT_NODE:
+                xmlSnapshotPutLeaf(w, cur);
+                break;
+
+            default:
+                w->error = 1;
+                break;
+        }
+    }
+
+    xmlSnapshotPutNum(w, 0);
+}
+
+static void
+xmlSnapshotPutTree(xmlSnapshotWriter *w, xmlNodePtr tree) {
+    xmlNodePtr top, cur;
+
+    if (tree == NULL) {
+        xmlSnapshotPutNum(w, 0);
+        return;
+    }
+
+    top = tree->parent;
+    cur = tree;
+    while (w->error == 0) {
+        if (cur->type == XML_ELEMENT_NODE) {
+            xmlAttrPtr attr;
+            xmlNsPtr ns;
+            size_t nbNs = 0;
+
+            xmlSnapshotPutNum(w, cur->type);
+            xmlSnapshotPutName(w, cur->name);
+            for (ns = cur->nsDef; ns != NULL; ns = ns->next)
+                nbNs++;
+            xmlSnapshotPutNum(w, nbNs);
+            for (ns = cur->nsDef; ns != NULL; ns = ns->next) {
+                xmlSnapshotPutName(w, ns->prefix);
+                xmlSnapshotPutName(w, ns->href);
+                xmlSnapshotPushNs(w, ns);
+            }
+            xmlSnapshotPutNs(w, cur->ns);
+            xmlSnapshotPutLine(w, cur->line);
+
+            for (attr = cur->properties; attr != NULL; attr = attr->next) {
+                xmlNodePtr child;
+
+                if (attr->name == NULL) {
+                    w->error = 1;
+                    break;
+                }
+                xmlSnapshotPutName(w, attr->name);
+                xmlSnapshotPutNs(w, attr->ns);
+                xmlSnapshotPutNum(w, attr->atype);
+
+                /* Short form for values consisting of a single text */
+                child = attr->children;
+                if ((child != NULL) && (child->next == NULL) &&
+                    (child->type == XML_TEXT_NODE) &&
+                    (child->name == xmlStringText) &&
+                    (child->line == 0) && (child->content != NULL)) {
+                    xmlSnapshotPutData(w, child->content);
+                    continue;
+                }
+
+                xmlSnapshotPutNum(w, 0);
+                for (child = attr->children; child != NULL;
+                     child = child->next) {
+                    if ((child->type != XML_TEXT_NODE) &&
+                        (child->type != XML_ENTITY_REF_NODE)) {
+                        w->error = 1;
+                        break;
+                    }
+                    xmlSnapshotPutLeaf(w, child);
+                }
+                xmlSnapshotPutNum(w, 0);
+            }
+            xmlSnapshotPutNum(w, 0);
+
+            if (cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+            xmlSnapshotPutNum(w, 0);
+            w->nbNs -= nbNs;
+        } else if (cur->type == XML_DTD_NODE) {
+            if (top != (xmlNodePtr) w->doc) {
+                w->error = 1;
+                break;
+            }
+            xmlSnapshotPutNum(w, cur->type);
+            xmlSnapshotPutDtd(w, (xmlDtdPtr) cur);
+        } else {
+            xmlSnapshotPutLeaf(w, cur);
+        }
+
+        while (cur->next == NULL) {
+            xmlNsPtr ns;
+
+            xmlSnapshotPutNum(w, 0);
+            cur = cur->parent;
+            if (cur == top)
+                return;
+            for (ns = cur->nsDef; ns != NULL; ns = ns->next)
+                w->nbNs -= 1;
+        }
+        cur = cur->next;
+    }
+}
+
+/**
+ * Serialize a document into a binary snapshot which can be loaded
+ * with #xmlReadSnapshotMemory or #xmlReadSnapshotFile much faster
+ * than the document can be parsed.
+ *
+ * Snapshots contain the whole tree including namespaces, attribute
+ * types, line numbers and the internal and external subset. Loading
+ * a snapshot creates a tree which serializes to the same output as
+ * the original document. Snapshots are only meant to be loaded by the
+ * same version of the library, other versions may reject them.
+ *
+ * Namespaces used by nodes must be declared in scope.
+ *
+ * @since 2.15.0
+ *
+ * @param doc  the document
+ * @param mem  pointer to the resulting snapshot, to be freed with
+ * #xmlFree
+ * @param size  pointer to the size of the snapshot
+ * @returns 0 on success, -1 if the document can't be stored in a
+ * snapshot or a memory allocation failed.
+ */
+int
+xmlDocSnapshotMemory(xmlDoc *doc, xmlChar **mem, size_t *size) {
+    xmlSnapshotWriter w;
+    unsigned char header[sizeof(xmlSnapshotMagic) + 32];
+    size_t headerSize;
+    xmlChar *ret = NULL;
+    int res = -1;
+
+    if ((mem == NULL) || (size == NULL))
+        return(-1);
+    *mem = NULL;
+    *size = 0;
+    if ((doc == NULL) ||
+        ((doc->type != XML_DOCUMENT_NODE) &&
+         (doc->type != XML_HTML_DOCUMENT_NODE)))
+        return(-1);
+
+    memset(&w, 0, sizeof(w));
+    w.doc = doc;
+    w.nameIds = xmlHashCreate(0);
+    if (w.nameIds == NULL)
+        return(-1);
+
+    xmlSnapshotPutNum(&w, doc->type);
+    xmlSnapshotPutNum(&w, (size_t) (doc->standalone + 2) & 0xFF);
+    xmlSnapshotPutNum(&w, (unsigned) doc->properties);
+    xmlSnapshotPutNum(&w, (unsigned) doc->parseFlags);
+    xmlSnapshotPutString(&w, doc->version);
+    xmlSnapshotPutString(&w, doc->encoding);
+    xmlSnapshotPutString(&w, doc->URL);
+    if ((doc->extSubset != NULL) && (doc->extSubset != doc->intSubset)) {
+        xmlSnapshotPutNum(&w, 1);
+        xmlSnapshotPutDtd(&w, doc->extSubset);
+    } else {
+        xmlSnapshotPutNum(&w, 0);
+    }
+    xmlSnapshotPutTree(&w, doc->children);
+    if (w.error)
+        goto done;
+
+    memcpy(header, xmlSnapshotMagic, sizeof(xmlSnapshotMagic));
+    headerSize = sizeof(xmlSnapshotMagic);
+    headerSize += xmlSnapshotEncodeNum(header + headerSize,
+                                       XML_SNAPSHOT_VERSION);
+    headerSize += xmlSnapshotEncodeNum(header + headerSize, w.nbNames);
+
+    if (w.names.size + w.out.size > SIZE_MAX - headerSize)
+        goto done;
+    ret = xmlMalloc(headerSize + w.names.size + w.out.size);
+    if (ret == NULL)
+        goto done;
+    memcpy(ret, header, headerSize);
+    if (w.names.size > 0)
+        memcpy(ret + headerSize, w.names.mem, w.names.size);
+    memcpy(ret + headerSize + w.names.size, w.out.mem, w.out.size);
+
+    *mem = ret;
+    *size = headerSize + w.names.size + w.out.size;
+    res = 0;
+
+done:
+    xmlHashFree(w.nameIds, NULL);
+    xmlFree(w.names.mem);
+    xmlFree(w.out.mem);
+    xmlFree(w.nsTab);
+    xmlFree(w.nsIds);
+    return(res);
+}
+
+typedef struct {
+    const unsigned char *cur;
+    const unsigned char *end;
+    xmlDocPtr doc;
+    const xmlChar **names;
+    int nbNames;
+    xmlNsPtr *nsTab;
+    int nbNs;
+    int maxNs;
+    unsigned line;
+    int error;
+} xmlSnapshotReader;
+
+static size_t
+xmlSnapshotGetNum(xmlSnapshotReader *r) {
+    size_t val = 0;
+    unsigned shift = 0;
+
+    if ((r->cur < r->end) && (*r->cur < 0x80))
+        return(*r->cur++);
+
+    while (r->cur < r->end) {
+        unsigned c = *r->cur++;
+
+        if (shift >= sizeof(size_t) * 8)
+            break;
+        val |= (size_t) (c & 0x7F) << shift;
+        if (c < 0x80)
+            return(val);
+        shift += 7;
+    }
+
+    r->error = 1;
+    return(0);
+}
+
+/*
+ * Returns a pointer to a null-terminated string inside the snapshot
+ * and stores its length in `len`.
+ */
+static const xmlChar *
+xmlSnapshotGetString(xmlSnapshotReader *r, size_t *len) {
+    const xmlChar *ret;
+    size_t size;
+
+    size = xmlSnapshotGetNum(r);
+    if (len != NULL)
+        *len = 0;
+    if (size == 0)
+        return(NULL);
+    if ((size > (size_t) (r->end - r->cur)) || (r->cur[size - 1] != 0) ||
+        (size - 1 > INT_MAX)) {
+        r->error = 1;
+        return(NULL);
+    }
+
+    ret = r->cur;
+    r->cur += size;
+    if (len != NULL)
+        *len = size - 1;
+    return(ret);
+}
+
+static const xmlChar *
+xmlSnapshotGetName(xmlSnapshotReader *r) {
+    size_t id = xmlSnapshotGetNum(r);
+
+    if (id == 0)
+        return(NULL);
+    if (id > (size_t) r->nbNames) {
+        r->error = 1;
+        return(NULL);
+    }
+    return(r->names[id - 1]);
+}
+
+static xmlNsPtr
+xmlSnapshotGetNs(xmlSnapshotReader *r) {
+    size_t id = xmlSnapshotGetNum(r);
+    xmlNsPtr ns;
+
+    if (id == 0)
+        return(NULL);
+    if (id == 1) {
+        ns = xmlTreeEnsureXMLDecl(r->doc);
+        if (ns == NULL)
+            r->error = 1;
+        return(ns);
+    }
+    if (id - 2 >= (size_t) r->nbNs) {
+        r->error = 1;
+        return(NULL);
+    }
+    return(r->nsTab[id - 2]);
+}
+
+static void
+xmlSnapshotAddNs(xmlSnapshotReader *r, xmlNodePtr elem) {
+    const xmlChar *prefix, *href;
+    xmlNsPtr ns;
+
+    prefix = xmlSnapshotGetName(r);
+    href = xmlSnapshotGetName(r);
+    if (r->error)
+        return;
+
+    if (r->nbNs >= r->maxNs) {
+        xmlNsPtr *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(r->maxNs, sizeof(tmp[0]),
+                                  16, XML_MAX_ITEMS);
+        if (newSize < 0) {
+            r->error = 1;
+            return;
+        }
+        tmp = xmlRealloc(r->nsTab, newSize * sizeof(tmp[0]));
+        if (tmp == NULL) {
+            r->error = 1;
+            return;
+        }
+        r->nsTab = tmp;
+        r->maxNs = newSize;
+    }
+
+    ns = xmlDocNewNs(r->doc, elem, href, prefix);
+    if (ns == NULL) {
+        r->error = 1;
+        return;
+    }
+    r->nsTab[r->nbNs++] = ns;
+}
+
+static void
+xmlSnapshotLink(xmlNodePtr parent, xmlNodePtr cur) {
+    cur->parent = parent;
+    if (parent->last == NULL) {
+        parent->children = cur;
+    } else {
+        parent->last->next = cur;
+        cur->prev = parent->last;
+    }
+    parent->last = cur;
+}
+
+static xmlNodePtr
+xmlSnapshotNewNode(xmlSnapshotReader *r, xmlElementType type) {
+    xmlNodePtr cur;
+
+    cur = xmlDocMalloc(r->doc, sizeof(xmlNode));
+    if (cur == NULL) {
+        r->error = 1;
+        return(NULL);
+    }
+    memset(cur, 0, sizeof(xmlNode));
+    cur->type = type;
+    cur->doc = r->doc;
+
+    return(cur);
+}
+
+/*
+ * Like xmlSnapshotGetString, but for strings without terminating
+ * null byte.
+ */
+static const xmlChar *
+xmlSnapshotGetData(xmlSnapshotReader *r, size_t *len) {
+    const xmlChar *ret;
+    size_t size;
+
+    size = xmlSnapshotGetNum(r);
+    *len = 0;
+    if (size == 0)
+        return(NULL);
+    if ((size - 1 > (size_t) (r->end - r->cur)) || (size - 1 > INT_MAX)) {
+        r->error = 1;
+        return(NULL);
+    }
+
+    ret = r->cur;
+    r->cur += size - 1;
+    *len = size - 1;
+    return(ret);
+}
+
+static unsigned short
+xmlSnapshotGetLine(xmlSnapshotReader *r) {
+    size_t delta = xmlSnapshotGetNum(r);
+
+    if (delta & 1)
+        r->line -= (delta + 1) / 2;
+    else
+        r->line += delta / 2;
+
+    return(r->line < 65535 ? r->line : 65535);
+}
+
+/*
+ * Read a node without children or attributes and append it to
+ * `parent`.
+ */
+static void
+xmlSnapshotGetLeaf(xmlSnapshotReader *r, xmlNodePtr parent, int type) {
+    xmlDocPtr doc = r->doc;
+    xmlNodePtr cur;
+    const xmlChar *content;
+    size_t len;
+
+    if ((type != XML_TEXT_NODE) && (type != XML_CDATA_SECTION_NODE) &&
+        (type != XML_ENTITY_REF_NODE) && (type != XML_PI_NODE) &&
+        (type != XML_COMMENT_NODE)) {
+        r->error = 1;
+        return;
+    }
+
+    cur = xmlSnapshotNewNode(r, type);
+    if (cur == NULL)
+        return;
+    xmlSnapshotLink(parent, cur);
+
+    switch (type) {
+        case XML_TEXT_NODE:
+            cur->name = xmlSnapshotGetNum(r) ? xmlStringTextNoenc :
+                                               xmlStringText;
+            cur->line = xmlSnapshotGetLine(r);
+            break;
+        case XML_ENTITY_REF_NODE: {
+            xmlEntityPtr ent;
+
+            cur->name = xmlSnapshotGetName(r);
+            if (cur->name == NULL) {
+                r->error = 1;
+                return;
+            }
+            ent = xmlGetDocEntity(doc, cur->name);
+            if (ent != NULL) {
+                cur->content = ent->content;
+                cur->children = (xmlNodePtr) ent;
+                cur->last = (xmlNodePtr) ent;
+            }
+            break;
+        }
+        case XML_PI_NODE:
+            cur->name = xmlSnapshotGetName(r);
+            if (cur->name == NULL)
+                r->error = 1;
+            cur->line = xmlSnapshotGetLine(r);
+            break;
+        case XML_COMMENT_NODE:
+            cur->name = xmlStringComment;
+            cur->line = xmlSnapshotGetLine(r);
+            break;
+        default:
+            break;
+    }
+
+    if (type != XML_ENTITY_REF_NODE) {
+        content = xmlSnapshotGetData(r, &len);
+        if (content != NULL) {
+            cur->content = xmlDocStrndup(doc, content, len);
+            if (cur->content == NULL)
+                r->error = 1;
+        }
+    }
+
+    if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
+        xmlRegisterNodeDefaultValue(cur);
+}
+
+static xmlElementContentPtr
+xmlSnapshotGetContent(xmlSnapshotReader *r, int depth) {
+    xmlDocPtr doc = r->doc;
+    xmlElementContentPtr ret = NULL, parent = NULL, cur;
+    xmlElementContentPtr *link = &ret;
+
+    if (depth > XML_SNAPSHOT_MAX_DEPTH) {
+        r->error = 1;
+        return(NULL);
+    }
+
+    while (1) {
+        const xmlChar *name, *prefix;
+        size_t type, ocur;
+
+        type = xmlSnapshotGetNum(r);
+        if (type == 0)
+            break;
+        ocur = xmlSnapshotGetNum(r);
+        name = xmlSnapshotGetString(r, NULL);
+        prefix = xmlSnapshotGetString(r, NULL);
+        if ((r->error) ||
+            (type > XML_ELEMENT_CONTENT_OR) ||
+            (ocur < XML_ELEMENT_CONTENT_ONCE) ||
+            (ocur > XML_ELEMENT_CONTENT_PLUS))
+            goto error;
+
+        cur = xmlNewDocElementContent(doc, NULL, type);
+        if (cur == NULL)
+            goto error;
+        cur->ocur = ocur;
+        cur->parent = parent;
+        *link = cur;
+        if (name != NULL) {
+            cur->name = xmlDictLookup(doc->dict, name, -1);
+            if (cur->name == NULL)
+                goto error;
+        }
+        if (prefix != NULL) {
+            cur->prefix = xmlDictLookup(doc->dict, prefix, -1);
+            if (cur->prefix == NULL)
+                goto error;
+        }
+
+        if ((type != XML_ELEMENT_CONTENT_SEQ) &&
+            (type != XML_ELEMENT_CONTENT_OR))
+            break;
+
+        cur->c1 = xmlSnapshotGetContent(r, depth + 1);
+        if (r->error)
+            goto error;
+        if (cur->c1 != NULL)
+            cur->c1->parent = cur;
+        parent = cur;
+        link = &cur->c2;
+    }
+
+    return(ret);
+
+error:
+    r->error = 1;
+    xmlFreeDocElementContent(doc, ret);
+    return(NULL);
+}
+
+static void
+xmlSnapshotGetAttributeDecl(xmlSnapshotReader *r, xmlDtdPtr dtd) {
+    const xmlChar *elem, *name, *prefix, *defaultValue;
+    xmlEnumerationPtr tree = NULL, last = NULL;
+    size_t atype, def, nbEnum, i;
+
+    elem = xmlSnapshotGetString(r, NULL);
+    name = xmlSnapshotGetString(r, NULL);
+    prefix = xmlSnapshotGetString(r, NULL);
+    atype = xmlSnapshotGetNum(r);
+    def = xmlSnapshotGetNum(r);
+    defaultValue = xmlSnapshotGetString(r, NULL);
+    nbEnum = xmlSnapshotGetNum(r);
+    if ((r->error) ||
+        (atype < XML_ATTRIBUTE_CDATA) || (atype > XML_ATTRIBUTE_NOTATION) ||
+        (def < XML_ATTRIBUTE_NONE) || (def > XML_ATTRIBUTE_FIXED)) {
+        r->error = 1;
+        return;
+    }
+
+    for (i = 0; i < nbEnum; i++) {
+        xmlEnumerationPtr cur;
+        const xmlChar *value;
+
+        value = xmlSnapshotGetString(r, NULL);
+        if (r->error)
+            break;
+        cur = xmlCreateEnumeration(value);
+        if (cur == NULL) {
+            r->error = 1;
+            break;
+        }
+        if (last == NULL)
+            tree = cur;
+        else
+            last->next = cur;
+        last = cur;
+    }
+    if (r->error) {
+        xmlFreeEnumeration(tree);
+        return;
+    }
+
+    /* Takes ownership of tree */
+    if (xmlAddAttributeDecl(NULL, dtd, elem, name, prefix, atype, def,
+                            defaultValue, tree) == NULL)
+        r->error = 1;
+}
+
+static void
+xmlSnapshotGetDtd(xmlSnapshotReader *r, xmlDtdPtr dtd) {
+    xmlDocPtr doc = r->doc;
+    size_t nbNotations, i;
+
+    nbNotations = xmlSnapshotGetNum(r);
+    for (i = 0; (i < nbNotations) && (!r->error); i++) {
+        const xmlChar *name, *publicId, *systemId;
+
+        name = xmlSnapshotGetString(r, NULL);
+        publicId = xmlSnapshotGetString(r, NULL);
+        systemId = xmlSnapshotGetString(r, NULL);
+        if ((r->error) ||
+            (xmlAddNotationDecl(NULL, dtd, name, publicId,
+                                systemId) == NULL))
+            r->error = 1;
+    }
+
+    while (!r->error) {
+        size_t type = xmlSnapshotGetNum(r);
+
+        if (type == 0)
+            break;
+
+        switch (type) {
+            case XML_ELEMENT_DECL: {
+                const xmlChar *name, *prefix;
+                xmlElementContentPtr content;
+                xmlChar *qname;
+                size_t etype;
+
+                name = xmlSnapshotGetString(r, NULL);
+                prefix = xmlSnapshotGetString(r, NULL);
+                etype = xmlSnapshotGetNum(r);
+                content = xmlSnapshotGetContent(r, 0);
+                if ((r->error) || (name == NULL) ||
+                    (etype > XML_ELEMENT_TYPE_ELEMENT)) {
+                    xmlFreeDocElementContent(doc, content);
+                    r->error = 1;
+                    break;
+                }
+                qname = xmlBuildQName(name, prefix, NULL, 0);
+                if ((qname == NULL) ||
+                    (xmlAddElementDecl(NULL, dtd, qname, etype,
+                                       content) == NULL))
+                    r->error = 1;
+                if (qname != name)
+                    xmlFree(qname);
+                xmlFreeDocElementContent(doc, content);
+                break;
+            }
+
+            case XML_ATTRIBUTE_DECL:
+                xmlSnapshotGetAttributeDecl(r, dtd);
+                break;
+
+            case XML_ENTITY_DECL: {
+                const xmlChar *name, *publicId, *systemId, *content;
+                const xmlChar *orig, *URI;
+                xmlEntityPtr ent;
+                size_t etype;
+
+                name = xmlSnapshotGetString(r, NULL);
+                etype = xmlSnapshotGetNum(r);
+                publicId = xmlSnapshotGetString(r, NULL);
+                systemId = xmlSnapshotGetString(r, NULL);
+                content = xmlSnapshotGetString(r, NULL);
+                orig = xmlSnapshotGetString(r, NULL);
+                URI = xmlSnapshotGetString(r, NULL);
+                if ((r->error) || (etype > INT_MAX) ||
+                    (xmlAddEntity(doc, dtd == doc->extSubset, name, etype,
+                                  publicId, systemId, content,
+                                  &ent) != XML_ERR_OK)) {
+                    r->error = 1;
+                    break;
+                }
+                if (orig != NULL) {
+                    ent->orig = xmlStrdup(orig);
+                    if (ent->orig == NULL)
+                        r->error = 1;
+                }
+                if (URI != NULL) {
+                    ent->URI = xmlStrdup(URI);
+                    if (ent->URI == NULL)
+                        r->error = 1;
+                }
+                break;
+            }
+
+            case XML_PI_NODE:
+            case XML_COMMENT_NODE:
+                xmlSnapshotGetLeaf(r, (xmlNodePtr) dtd, type);
+                break;
+
+            default:
+                r->error = 1;
+                break;
+        }
+    }
+}
+
+static xmlDtdPtr
+xmlSnapshotNewDtd(xmlSnapshotReader *r) {
+    const xmlChar *name, *publicId, *systemId;
+    xmlDtdPtr dtd;
+
+    name = xmlSnapshotGetString(r, NULL);
+    publicId = xmlSnapshotGetString(r, NULL);
+    systemId = xmlSnapshotGetString(r, NULL);
+    if (r->error)
+        return(NULL);
+
+    dtd = xmlNewDtd(NULL, name, publicId, systemId);
+    if (dtd == NULL) {
+        r->error = 1;
+        return(NULL);
+    }
+    dtd->doc = r->doc;
+
+    return(dtd);
+}
+
+static void
+xmlSnapshotGetAttributes(xmlSnapshotReader *r, xmlNodePtr elem) {
+    xmlDocPtr doc = r->doc;
+    xmlAttrPtr last = NULL;
+
+    while (!r->error) {
+        const xmlChar *name, *value;
+        xmlAttrPtr attr;
+        size_t atype, len;
+
+        name = xmlSnapshotGetName(r);
+        if (name == NULL)
+            break;
+
+        attr = xmlDocMalloc(doc, sizeof(xmlAttr));
+        if (attr == NULL) {
+            r->error = 1;
+            break;
+        }
+        memset(attr, 0, sizeof(xmlAttr));
+        attr->type = XML_ATTRIBUTE_NODE;
+        attr->name = name;
+        attr->doc = doc;
+        attr->parent = elem;
+        if (last == NULL) {
+            elem->properties = attr;
+        } else {
+            last->next = attr;
+            attr->prev = last;
+        }
+        last = attr;
+
+        attr->ns = xmlSnapshotGetNs(r);
+        atype = xmlSnapshotGetNum(r);
+        if (atype > XML_ATTRIBUTE_NOTATION) {
+            r->error = 1;
+            break;
+        }
+        attr->atype = atype;
+
+        value = xmlSnapshotGetData(r, &len);
+        if (value != NULL) {
+            xmlNodePtr text = xmlSnapshotNewNode(r, XML_TEXT_NODE);
+
+            if (text == NULL)
+                break;
+            text->name = xmlStringText;
+            xmlSnapshotLink((xmlNodePtr) attr, text);
+            text->content = xmlDocStrndup(doc, value, len);
+            if (text->content == NULL) {
+                r->error = 1;
+                break;
+            }
+            if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
+                xmlRegisterNodeDefaultValue(text);
+        }
+
+        while ((value == NULL) && (!r->error)) {
+            size_t type = xmlSnapshotGetNum(r);
+
+            if (type == 0)
+                break;
+            if ((type != XML_TEXT_NODE) && (type != XML_ENTITY_REF_NODE))
+                r->error = 1;
+            else
+                xmlSnapshotGetLeaf(r, (xmlNodePtr) attr, type);
+        }
+
+        if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
+            xmlRegisterNodeDefaultValue((xmlNodePtr) attr);
+
+        if ((atype == XML_ATTRIBUTE_ID) && (!r->error)) {
+            xmlChar *id;
+
+            id = xmlNodeListGetString(doc, attr->children, 1);
+            if ((id == NULL) || (xmlAddIDSafe(attr, id) < 0))
+                r->error = 1;
+            xmlFree(id);
+        }
+    }
+}
+
+static void
+xmlSnapshotGetTree(xmlSnapshotReader *r) {
+    xmlDocPtr doc = r->doc;
+    xmlNodePtr top = (xmlNodePtr) doc;
+    xmlNodePtr parent = top;
+
+    while (!r->error) {
+        size_t type = xmlSnapshotGetNum(r);
+
+        if (type == 0) {
+            if (parent == top)
+                return;
+            parent = parent->parent;
+            continue;
+        }
+
+        if (type == XML_ELEMENT_NODE) {
+            xmlNodePtr cur;
+            size_t nbNs, i;
+
+            cur = xmlSnapshotNewNode(r, XML_ELEMENT_NODE);
+            if (cur == NULL)
+                return;
+            xmlSnapshotLink(parent, cur);
+
+            cur->name = xmlSnapshotGetName(r);
+            if (cur->name == NULL) {
+                r->error = 1;
+                return;
+            }
+            nbNs = xmlSnapshotGetNum(r);
+            for (i = 0; (i < nbNs) && (!r->error); i++)
+                xmlSnapshotAddNs(r, cur);
+            cur->ns = xmlSnapshotGetNs(r);
+            cur->line = xmlSnapshotGetLine(r);
+            xmlSnapshotGetAttributes(r, cur);
+
+            if ((xmlRegisterCallbacks) && (xmlRegisterNodeDefaultValue))
+                xmlRegisterNodeDefaultValue(cur);
+
+            parent = cur;
+        } else if (type == XML_DTD_NODE) {
+            xmlDtdPtr dtd;
+
+            if ((parent != top) || (doc->intSubset != NULL)) {
+                r->error = 1;
+                return;
+            }
+            dtd = xmlSnapshotNewDtd(r);
+            if (dtd == NULL)
+                return;
+            xmlSnapshotLink(top, (xmlNodePtr) dtd);
+            doc->intSubset = dtd;
+            xmlSnapshotGetDtd(r, dtd);
+        } else {
+            xmlSnapshotGetLeaf(r, parent, type);
+        }
+    }
+}
+
+/**
+ * Load a document from a binary snapshot created with
+ * #xmlDocSnapshotMemory.
+ *
+ * Names are interned into a new dictionary and nodes are created
+ * directly from the snapshot without parsing. The only option
+ * supported is XML_PARSE_ARENA.
+ *
+ * @since 2.15.0
+ *
+ * @param buffer  the snapshot
+ * @param size  the size of the snapshot
+ * @param options  a combination of xmlParserOption
+ * @returns the resulting document tree or NULL if the snapshot is
+ * invalid or a memory allocation failed.
+ */
+xmlDoc *
+xmlReadSnapshotMemory(const void *buffer, size_t size, int options) {
+    xmlSnapshotReader r;
+    xmlDocPtr doc = NULL;
+    const xmlChar *version, *encoding, *URL;
+    size_t type, standalone, properties, parseFlags, nbNames, i;
+
+    if (buffer == NULL)
+        return(NULL);
+    if ((size < sizeof(xmlSnapshotMagic)) ||
+        (memcmp(buffer, xmlSnapshotMagic, sizeof(xmlSnapshotMagic)) != 0))
+        return(NULL);
+
+    memset(&r, 0, sizeof(r));
+    r.cur = (const unsigned char *) buffer + sizeof(xmlSnapshotMagic);
+    r.end = (const unsigned char *) buffer + size;
+
+    if (xmlSnapshotGetNum(&r) != XML_SNAPSHOT_VERSION)
+        return(NULL);
+    nbNames = xmlSnapshotGetNum(&r);
+    /* Every name takes at least two bytes */
+    if ((r.error) || (nbNames > (size_t) (r.end - r.cur) / 2))
+        return(NULL);
+
+    doc = xmlNewDoc(NULL);
+    if (doc == NULL)
+        return(NULL);
+    r.doc = doc;
+    doc->dict = xmlDictCreate();
+    if (doc->dict == NULL)
+        goto error;
+    if ((options & XML_PARSE_ARENA) && (xmlDocEnableArena(doc) < 0))
+        goto error;
+
+    if (nbNames > 0) {
+        r.names = xmlMalloc(nbNames * sizeof(r.names[0]));
+        if (r.names == NULL)
+            goto error;
+    }
+    for (i = 0; i < nbNames; i++) {
+        size_t len = xmlSnapshotGetNum(&r);
+
+        if ((r.error) || (len > INT_MAX) ||
+            (len >= (size_t) (r.end - r.cur)) || (r.cur[len] != 0))
+            goto error;
+        r.names[i] = xmlDictLookup(doc->dict, r.cur, len);
+        if (r.names[i] == NULL)
+            goto error;
+        r.cur += len + 1;
+    }
+    r.nbNames = nbNames;
+
+    type = xmlSnapshotGetNum(&r);
+    standalone = xmlSnapshotGetNum(&r);
+    properties = xmlSnapshotGetNum(&r);
+    parseFlags = xmlSnapshotGetNum(&r);
+    version = xmlSnapshotGetString(&r, NULL);
+    encoding = xmlSnapshotGetString(&r, NULL);
+    URL = xmlSnapshotGetString(&r, NULL);
+    if ((r.error) ||
+        ((type != XML_DOCUMENT_NODE) && (type != XML_HTML_DOCUMENT_NODE)))
+        goto error;
+
+    doc->type = type;
+    doc->standalone = (int) (standalone & 0xFF) - 2;
+    doc->properties = (int) (properties & INT_MAX);
+    doc->parseFlags = (int) (parseFlags & INT_MAX);
+    xmlFree((xmlChar *) doc->version);
+    doc->version = NULL;
+    if (version != NULL) {
+        doc->version = xmlStrdup(version);
+        if (doc->version == NULL)
+            goto error;
+    }
+    if (encoding != NULL) {
+        doc->encoding = xmlStrdup(encoding);
+        if (doc->encoding == NULL)
+            goto error;
+    }
+    if (URL != NULL) {
+        doc->URL = xmlStrdup(URL);
+        if (doc->URL == NULL)
+            goto error;
+    }
+
+    /* The external subset comes first, entity references need it */
+    if (xmlSnapshotGetNum(&r)) {
+        xmlDtdPtr dtd = xmlSnapshotNewDtd(&r);
+
+        if (dtd == NULL)
+            goto error;
+        doc->extSubset = dtd;
+        xmlSnapshotGetDtd(&r, dtd);
+    }
+
+    xmlSnapshotGetTree(&r);
+    if ((r.error) || (r.cur != r.end))
+        goto error;
+
+    xmlFree(r.names);
+    xmlFree(r.nsTab);
+    return(doc);
+
+error:
+    xmlFree(r.names);
+    xmlFree(r.nsTab);
+    xmlFreeDoc(doc);
+    return(NULL);
+}
+
+/**
+ * Load a document from a binary snapshot file created with
+ * #xmlDocSnapshotMemory. Regular files are mapped into memory
+ * if possible.
+ *
+ * See #xmlReadSnapshotMemory.
+ *
+ * @since 2.15.0
+ *
+ * @param filename  a file name or URL
+ * @param options  a combination of xmlParserOption
+ * @returns the resulting document tree or NULL if the file can't be
+ * read, the snapshot is invalid or a memory allocation failed.
+ */
+xmlDoc *
+xmlReadSnapshotFile(const char *filename, int options) {
+    xmlParserInputBufferPtr in;
+    xmlDocPtr doc = NULL;
+    int res;
+
+    if (xmlParserInputBufferCreateUrl(filename, XML_CHAR_ENCODING_NONE,
+                                      XML_INPUT_MMAP, &in) != XML_ERR_OK)
+        return(NULL);
+
+    /* Mapped files are complete, others are read until EOF */
+    do {
+        res = xmlParserInputBufferGrow(in, 64 * 1024);
+    } while (res > 0);
+
+    if (res == 0)
+        doc = xmlReadSnapshotMemory(xmlBufContent(in->buffer),
+                                    xmlBufUse(in->buffer), options);
+
+    xmlFreeParserInputBuffer(in);
+    return(doc);
+}
+
 /************************************************************************
  *									*
  *			XHTML detection					*
@@ -25,6 +25,18 @@
   #include <unistd.h>
 #endif
 
+#if HAVE_DECL_WRITEV
+  #include <sys/uio.h>
+#endif
+
+#if HAVE_DECL_MMAP
+  #include <sys/mman.h>
+  /* seems needed for Solaris */
+  #ifndef MAP_FAILED
+    #define MAP_FAILED ((void *) -1)
+  #endif
+#endif
+
 #ifdef LIBXML_ZLIB_ENABLED
 #include <zlib.h>
 #endif
@@ -45,6 +57,7 @@
 #include "private/enc.h"
 #include "private/error.h"
 #include "private/io.h"
+#include "private/memory.h"
 
 #ifndef SIZE_MAX
   #define SIZE_MAX ((size_t) -1)
@@ -873,6 +886,97 @@ xmlFdClose (void * context) {
     return(XML_ERR_OK);
 }
 
+#if HAVE_DECL_MMAP
+typedef struct {
+    void *map;
+    size_t size;
+} xmlMapIOCtxt;
+
+/**
+ * Unmap a file mapped with #xmlInputMapFd.
+ *
+ * @param context  the I/O context
+ * @returns 0 in case of success and error code otherwise
+ */
+static int
+xmlMapClose(void *context) {
+    xmlMapIOCtxt *mapctxt = context;
+    int ret;
+
+    ret = munmap(mapctxt->map, mapctxt->size);
+
+    xmlFree(mapctxt);
+
+    if (ret < 0)
+        return(xmlIOErr(errno));
+
+    return(XML_ERR_OK);
+}
+
+/**
+ * Map the rest of the regular file `fd` and use the mapping as
+ * static buffer of `buf`.
+ *
+ * The zero-filled remainder of the last page terminates the buffer,
+ * so files whose size is a multiple of the page size aren't mapped.
+ *
+ * @param buf  parser input buffer
+ * @param fd  file descriptor
+ * @returns 0 if the file was mapped, 1 if it should be read instead,
+ * or an xmlParserErrors code.
+ */
+static int
+xmlInputMapFd(xmlParserInputBufferPtr buf, int fd) {
+    xmlMapIOCtxt *mapctxt;
+    xmlBufPtr mem;
+    struct stat st;
+    void *map;
+    size_t size;
+    off_t pos;
+    long pageSize;
+
+    if ((fstat(fd, &st) != 0) || (!S_ISREG(st.st_mode)) ||
+        ((off_t) (size_t) st.st_size != st.st_size))
+        return(1);
+    pos = lseek(fd, 0, SEEK_CUR);
+    if ((pos < 0) || (pos >= st.st_size))
+        return(1);
+    size = st.st_size;
+    pageSize = sysconf(_SC_PAGESIZE);
+    if ((pageSize <= 0) || (size % pageSize == 0))
+        return(1);
+
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return(1);
+#ifdef MADV_SEQUENTIAL
+    /* Request aggressive readahead */
+    madvise(map, size, MADV_SEQUENTIAL);
+#endif
+
+    mapctxt = xmlMalloc(sizeof(*mapctxt));
+    if (mapctxt == NULL) {
+        munmap(map, size);
+        return(XML_ERR_NO_MEMORY);
+    }
+    mapctxt->map = map;
+    mapctxt->size = size;
+
+    mem = xmlBufCreateMem((const xmlChar *) map + pos, size - pos, 1);
+    if (mem == NULL) {
+        xmlMapClose(mapctxt);
+        return(XML_ERR_NO_MEMORY);
+    }
+
+    xmlBufFree(buf->buffer);
+    buf->buffer = mem;
+    buf->context = mapctxt;
+    buf->closecallback = xmlMapClose;
+
+    return(0);
+}
+#endif /* HAVE_DECL_MMAP */
+
 /**
  * @deprecated Internal function, don't use.
  *
@@ -1190,7 +1294,7 @@ xmlIODefaultMatch(const char *filename ATTRIBUTE_UNUSED) {
 
 /**
  * Update the buffer to read from `fd`. Supports the XML_INPUT_UNZIP
- * flag.
+ * and XML_INPUT_MMAP flags.
  *
  * @param buf  parser input buffer
  * @param fd  file descriptor
@@ -1283,6 +1387,15 @@ xmlInputFromFd(xmlParserInputBuffer *buf, int fd,
     }
 #endif /* LIBXML_ZLIB_ENABLED */
 
+#if HAVE_DECL_MMAP
+    if ((flags & XML_INPUT_MMAP) && (buf->encoder == NULL)) {
+        int res = xmlInputMapFd(buf, fd);
+
+        if (res <= 0)
+            return(res);
+    }
+#endif
+
     copy = dup(fd);
     if (copy == -1)
         return(xmlIOErr(errno));
@@ -1360,6 +1473,7 @@ xmlOutputDefaultOpen(xmlOutputBufferPtr buf, const char *filename,
     buf->context = fdctxt;
     buf->writecallback = xmlFdWrite;
     buf->closecallback = xmlFdClose;
+    xmlOutputBufferSetSegmented(buf, XML_OUTPUT_CHUNK_SIZE);
     return(XML_ERR_OK);
 }
 #endif
@@ -1385,7 +1499,7 @@ xmlAllocParserInputBuffer(xmlCharEncoding enc) {
 	return(NULL);
     }
     memset(ret, 0, sizeof(xmlParserInputBuffer));
-    ret->buffer = xmlBufCreate(XML_IO_BUFFER_SIZE);
+    ret->buffer = xmlBufCreateRing(XML_IO_BUFFER_SIZE);
     if (ret->buffer == NULL) {
         xmlFree(ret);
 	return(NULL);
@@ -1456,6 +1570,324 @@ xmlAllocOutputBuffer(xmlCharEncodingHandler *encoder) {
 
     return(ret);
 }
+
+/*
+ * Segmented output
+ *
+ * A segmented output buffer doesn't grow "buffer" beyond the chunk
+ * size. Once it's full, it's moved to the "chunks" array and a new
+ * buffer is started, so large documents are never copied by realloc.
+ * Pending chunks are written out in batches, using writev for file
+ * descriptors, and only flattened if the whole content is requested.
+ *
+ * Chunks always precede the content of "buffer" or, while an encoder
+ * is active, "conv". New chunks are only made without an encoder.
+ */
+
+/**
+ * Switch an output buffer to segmented mode.
+ *
+ * @param out  a buffered output
+ * @param chunkSize  the chunk size, 0 to disable
+ */
+void
+xmlOutputBufferSetSegmented(xmlOutputBuffer *out, size_t chunkSize) {
+    if (out == NULL)
+        return;
+
+    out->chunkSize = chunkSize;
+}
+
+static void
+xmlOutputBufferFreeChunks(xmlOutputBufferPtr out) {
+    int i;
+
+    for (i = 0; i < out->nbChunks; i++)
+        xmlBufFree(out->chunks[i]);
+    xmlFree(out->chunks);
+    out->chunks = NULL;
+    out->nbChunks = 0;
+    out->maxChunks = 0;
+}
+
+/**
+ * Move the current buffer to the list of chunks and start a new one.
+ *
+ * @param out  a segmented output
+ * @returns 0 on success, -1 on error.
+ */
+static int
+xmlOutputBufferPushChunk(xmlOutputBufferPtr out) {
+    xmlBufPtr buf;
+
+    if (out->nbChunks >= out->maxChunks) {
+        xmlBufPtr *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(out->maxChunks, sizeof(tmp[0]),
+                                  XML_OUTPUT_MAX_CHUNKS, INT_MAX);
+        if (newSize < 0) {
+            out->error = XML_ERR_RESOURCE_LIMIT;
+            return(-1);
+        }
+        tmp = xmlRealloc(out->chunks, newSize * sizeof(tmp[0]));
+        if (tmp == NULL) {
+            out->error = XML_ERR_NO_MEMORY;
+            return(-1);
+        }
+        out->chunks = tmp;
+        out->maxChunks = newSize;
+    }
+
+    buf = xmlBufCreate(out->chunkSize);
+    if (buf == NULL) {
+        out->error = XML_ERR_NO_MEMORY;
+        return(-1);
+    }
+
+    out->chunks[out->nbChunks++] = out->buffer;
+    out->buffer = buf;
+
+    return(0);
+}
+
+/**
+ * Drop the first `nb` chunks after they were written.
+ */
+static void
+xmlOutputBufferDropChunks(xmlOutputBufferPtr out, int nb) {
+    int i;
+
+    for (i = 0; i < nb; i++)
+        xmlBufFree(out->chunks[i]);
+    out->nbChunks -= nb;
+    if (out->nbChunks > 0)
+        memmove(out->chunks, &out->chunks[nb],
+                out->nbChunks * sizeof(out->chunks[0]));
+}
+
+#if HAVE_DECL_WRITEV
+/**
+ * Write pending chunks to a file descriptor with writev.
+ *
+ * @param out  a segmented output using xmlFdWrite
+ * @returns the number of bytes written or a negative xmlParserErrors
+ * code.
+ */
+static int
+xmlFdWriteChunks(xmlOutputBufferPtr out) {
+    xmlFdIOCtxt *fdctxt = out->context;
+    struct iovec iov[XML_OUTPUT_MAX_CHUNKS];
+    int ret = 0;
+
+    while (out->nbChunks > 0) {
+        ssize_t bytes;
+        int i, n;
+
+        for (n = 0; (n < out->nbChunks) && (n < XML_OUTPUT_MAX_CHUNKS); n++) {
+            iov[n].iov_base = (void *) xmlBufContent(out->chunks[n]);
+            iov[n].iov_len = xmlBufUse(out->chunks[n]);
+        }
+
+        bytes = writev(fdctxt->fd, iov, n);
+        if (bytes < 0)
+            return(-xmlIOErr(errno));
+        if (bytes == 0)
+            return(-XML_IO_WRITE);
+
+        if (ret > INT_MAX - bytes)
+            ret = INT_MAX;
+        else
+            ret += bytes;
+
+        /* Consume written bytes, keeping a partially written chunk */
+        for (i = 0; i < n; i++) {
+            size_t use = xmlBufUse(out->chunks[i]);
+
+            if ((size_t) bytes < use) {
+                xmlBufShrink(out->chunks[i], bytes);
+                break;
+            }
+            bytes -= use;
+        }
+        xmlOutputBufferDropChunks(out, i);
+    }
+
+    return(ret);
+}
+#endif /* HAVE_DECL_WRITEV */
+
+/**
+ * Write all pending chunks through the write callback.
+ *
+ * @param out  a segmented output
+ * @returns the number of bytes written or -1 in case of error.
+ */
+static int
+xmlOutputBufferWriteChunks(xmlOutputBufferPtr out) {
+    int written = 0;
+    int ret;
+
+    if (out->nbChunks == 0)
+        return(0);
+
+#if HAVE_DECL_WRITEV
+    if (out->writecallback == xmlFdWrite) {
+        ret = xmlFdWriteChunks(out);
+        if (ret < 0) {
+            out->error = -ret;
+            return(-1);
+        }
+        written = ret;
+    }
+#endif
+
+    while (out->nbChunks > 0) {
+        xmlBufPtr buf = out->chunks[0];
+        size_t nbchars = xmlBufUse(buf);
+
+        if (nbchars == 0) {
+            xmlOutputBufferDropChunks(out, 1);
+            continue;
+        }
+
+        ret = out->writecallback(out->context,
+                                 (const char *) xmlBufContent(buf),
+                                 nbchars);
+        if (ret < 0) {
+            out->error = (ret == -1) ? XML_IO_WRITE : -ret;
+            return(-1);
+        }
+        if ((ret == 0) || ((size_t) ret > nbchars)) {
+            out->error = XML_ERR_INTERNAL_ERROR;
+            return(-1);
+        }
+
+        xmlBufShrink(buf, ret);
+        if (written > INT_MAX - ret)
+            written = INT_MAX;
+        else
+            written += ret;
+    }
+
+    if (out->written > INT_MAX - written)
+        out->written = INT_MAX;
+    else
+        out->written += written;
+
+    return(written);
+}
+
+/**
+ * Merge pending chunks and the current buffer into a single buffer.
+ *
+ * @param out  a segmented output
+ * @returns 0 on success, -1 on error.
+ */
+static int
+xmlOutputBufferFlatten(xmlOutputBufferPtr out) {
+    xmlBufPtr buf;
+    size_t size;
+    int i;
+
+    if (out->nbChunks == 0)
+        return(0);
+
+    size = xmlBufUse(out->buffer);
+    for (i = 0; i < out->nbChunks; i++)
+        size += xmlBufUse(out->chunks[i]);
+
+    buf = xmlBufCreate(size);
+    if (buf == NULL) {
+        out->error = XML_ERR_NO_MEMORY;
+        return(-1);
+    }
+
+    for (i = 0; i < out->nbChunks; i++) {
+        if (xmlBufAdd(buf, xmlBufContent(out->chunks[i]),
+                      xmlBufUse(out->chunks[i])) < 0) {
+            xmlBufFree(buf);
+            out->error = XML_ERR_NO_MEMORY;
+            return(-1);
+        }
+    }
+    if (xmlBufAdd(buf, xmlBufContent(out->buffer),
+                  xmlBufUse(out->buffer)) < 0) {
+        xmlBufFree(buf);
+        out->error = XML_ERR_NO_MEMORY;
+        return(-1);
+    }
+
+    xmlOutputBufferFreeChunks(out);
+    xmlBufFree(out->buffer);
+    out->buffer = buf;
+
+    return(0);
+}
+
+/**
+ * Remove the data held in a memory output buffer and return it as
+ * a single zero-terminated string. Pending chunks are released as
+ * soon as they are copied.
+ *
+ * @param out  a buffered output without write callback
+ * @param size  OUT: the size of the data
+ * @returns the data which must be freed by the caller or NULL in
+ * case of error.
+ */
+xmlChar *
+xmlOutputBufferDetach(xmlOutputBuffer *out, size_t *size) {
+    xmlChar *ret;
+    size_t total, use;
+    int i;
+
+    if (size != NULL)
+        *size = 0;
+    if ((out == NULL) || (out->buffer == NULL) || (out->error != 0))
+        return(NULL);
+
+    if (out->nbChunks == 0) {
+        if (size != NULL)
+            *size = xmlBufUse(out->buffer);
+        return(xmlBufDetach(out->buffer));
+    }
+
+    total = xmlBufUse(out->buffer);
+    for (i = 0; i < out->nbChunks; i++) {
+        use = xmlBufUse(out->chunks[i]);
+        if (total > SIZE_MAX - 1 - use) {
+            out->error = XML_ERR_RESOURCE_LIMIT;
+            return(NULL);
+        }
+        total += use;
+    }
+
+    ret = xmlMalloc(total + 1);
+    if (ret == NULL) {
+        out->error = XML_ERR_NO_MEMORY;
+        return(NULL);
+    }
+
+    total = 0;
+    for (i = 0; i < out->nbChunks; i++) {
+        use = xmlBufUse(out->chunks[i]);
+        memcpy(ret + total, xmlBufContent(out->chunks[i]), use);
+        total += use;
+        xmlBufFree(out->chunks[i]);
+        out->chunks[i] = NULL;
+    }
+    out->nbChunks = 0;
+
+    use = xmlBufUse(out->buffer);
+    memcpy(ret + total, xmlBufContent(out->buffer), use);
+    total += use;
+    ret[total] = 0;
+    xmlBufEmpty(out->buffer);
+
+    if (size != NULL)
+        *size = total;
+    return(ret);
+}
 #endif /* LIBXML_OUTPUT_ENABLED */
 
 /**
@@ -1533,6 +1965,7 @@ xmlOutputBufferClose(xmlOutputBuffer *out)
         xmlBufFree(out->buffer);
         out->buffer = NULL;
     }
+    xmlOutputBufferFreeChunks(out);
 
     xmlFree(out);
 
@@ -1883,6 +2316,9 @@ xmlOutputBufferGetContent(xmlOutputBuffer *out) {
     if ((out == NULL) || (out->buffer == NULL) || (out->error != 0))
         return(NULL);
 
+    if (xmlOutputBufferFlatten(out) < 0)
+        return(NULL);
+
     return(xmlBufContent(out->buffer));
 }
 
@@ -1894,10 +2330,17 @@ xmlOutputBufferGetContent(xmlOutputBuffer *out) {
  */
 size_t
 xmlOutputBufferGetSize(xmlOutputBuffer *out) {
+    size_t size;
+    int i;
+
     if ((out == NULL) || (out->buffer == NULL) || (out->error != 0))
         return(0);
 
-    return(xmlBufUse(out->buffer));
+    size = xmlBufUse(out->buffer);
+    for (i = 0; i < out->nbChunks; i++)
+        size += xmlBufUse(out->chunks[i]);
+
+    return(size);
 }
 
 
@@ -1968,6 +2411,31 @@ xmlMemClose(void *vctxt) {
     return(0);
 }
 
+/**
+ * Get the number of bytes left to read from an input buffer, if
+ * this is known in advance.
+ *
+ * @param in  input buffer
+ * @param size  result
+ * @returns 0 if the size is known, -1 otherwise.
+ */
+int
+xmlParserInputBufferRemaining(xmlParserInputBuffer *in, size_t *size) {
+    if ((in == NULL) || (in->error) || (in->encoder != NULL))
+        return(-1);
+
+    if (in->readcallback == NULL) {
+        *size = 0;
+        return(0);
+    }
+    if (in->readcallback == xmlMemRead) {
+        *size = ((xmlMemIOCtxt *) in->context)->size;
+        return(0);
+    }
+
+    return(-1);
+}
+
 /**
  * Create an input buffer for memory.
  *
@@ -2139,6 +2607,7 @@ xmlOutputBufferCreateFd(int fd, xmlCharEncodingHandler *encoder) {
         ret->context = fdctxt;
 	ret->writecallback = xmlFdWrite;
         ret->closecallback = xmlFdFree;
+        xmlOutputBufferSetSegmented(ret, XML_OUTPUT_CHUNK_SIZE);
     }
 
     return(ret);
@@ -2452,6 +2921,21 @@ xmlOutputBufferWrite(xmlOutputBuffer *out, int len, const char *data) {
     if (len < 0)
         return(0);
 
+    if ((out->chunkSize > 0) && (out->encoder == NULL) &&
+        (xmlBufUse(out->buffer) > 0) &&
+        (xmlBufUse(out->buffer) + len > out->chunkSize)) {
+        if (xmlOutputBufferPushChunk(out) < 0)
+            return(-1);
+
+        if ((out->writecallback) &&
+            (out->nbChunks >= XML_OUTPUT_MAX_CHUNKS)) {
+            ret = xmlOutputBufferWriteChunks(out);
+            if (ret < 0)
+                return(-1);
+            written = ret;
+        }
+    }
+
     ret = xmlBufAdd(out->buffer, (const xmlChar *) data, len);
     if (ret != 0) {
         out->error = XML_ERR_NO_MEMORY;
@@ -2489,10 +2973,23 @@ xmlOutputBufferWrite(xmlOutputBuffer *out, int len, const char *data) {
         else
             written = ret;
     } else {
-        if (out->writecallback)
-            buf = out->buffer;
-        else
+        if (out->writecallback) {
+            if (out->chunkSize == 0)
+                buf = out->buffer;
+        } else {
             written = len;
+        }
+    }
+
+    /*
+     * chunks made before an encoding switch precede the converted data
+     */
+    if ((buf != NULL) && (out->nbChunks > 0) &&
+        (xmlBufUse(buf) >= MINLEN)) {
+        ret = xmlOutputBufferWriteChunks(out);
+        if (ret < 0)
+            return(-1);
+        written += ret;
     }
 
     if ((buf != NULL) && (out->writecallback)) {
@@ -2690,7 +3187,7 @@ xmlOutputBufferWriteQuotedString(xmlOutputBuffer *buf,
  */
 int
 xmlOutputBufferFlush(xmlOutputBuffer *out) {
-    int nbchars = 0, ret = 0;
+    int nbchars = 0, ret = 0, chunks = 0;
 
     if ((out == NULL) || (out->error)) return(-1);
     /*
@@ -2710,6 +3207,11 @@ xmlOutputBufferFlush(xmlOutputBuffer *out) {
     /*
      * second flush the stuff to the I/O channel
      */
+    if ((out->nbChunks > 0) && (out->writecallback != NULL)) {
+        chunks = xmlOutputBufferWriteChunks(out);
+        if (chunks < 0)
+            return(-1);
+    }
     if ((out->conv != NULL) && (out->encoder != NULL) &&
 	(out->writecallback != NULL)) {
 	ret = out->writecallback(out->context,
@@ -2733,7 +3235,7 @@ xmlOutputBufferFlush(xmlOutputBuffer *out) {
     else
         out->written += ret;
 
-    return(ret);
+    return(ret > INT_MAX - chunks ? INT_MAX : ret + chunks);
 }
 #endif /* LIBXML_OUTPUT_ENABLED */
 
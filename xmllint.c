@@ -125,6 +125,7 @@ typedef struct {
     int debug;
     int copy;
     int noout;
+    int wfOnly;
 #ifdef LIBXML_OUTPUT_ENABLED
     const char *output;
     const char *encoding;
@@ -170,6 +171,7 @@ typedef struct {
     xmllintReturnCode progresult;
     int quiet;
     int timing;
+    int dictStats;
     int generate;
     int dropdtd;
 #ifdef LIBXML_C14N_ENABLED
@@ -195,6 +197,7 @@ typedef struct {
 #endif
     int options;
     unsigned maxAmpl;
+    int maxThreads;
 
     xmlChar *paths[MAX_PATHS + 1];
     int nbpaths;
@@ -566,6 +569,33 @@ endTimer(xmllintState *lint, const char *fmt, ...)
     fprintf(lint->errStream, " took %ld ms\n", (long) msec);
 }
 
+/************************************************************************
+ *									*
+ *			Dictionary statistics				*
+ *									*
+ ************************************************************************/
+
+/*
+ * Print statistics of the dictionary of a document.
+ */
+static void
+printDictStats(xmllintState *lint, xmlDocPtr doc) {
+    xmlHashStats stats;
+
+    if (xmlDictGetStats(doc->dict, &stats) < 0)
+        return;
+
+    fprintf(lint->errStream,
+            "Dictionary: %lu entries, %lu buckets, probe avg %.2f max %lu, "
+            "%lu resizes, %lu bytes\n",
+            (unsigned long) stats.nbElems, (unsigned long) stats.size,
+            stats.nbElems ?
+                (double) stats.totalProbe / stats.nbElems : 0.0,
+            (unsigned long) stats.maxProbe,
+            (unsigned long) stats.nbGrows,
+            (unsigned long) stats.memory);
+}
+
 /************************************************************************
  *									*
  *			SAX based tests					*
@@ -1754,6 +1784,56 @@ parseFile(xmllintState *lint, const char *filename) {
     return(doc);
 }
 
+/*
+ * Check well-formedness without building a tree.
+ */
+static void
+checkWellFormed(xmllintState *lint, const char *filename) {
+    xmlParserCtxtPtr ctxt = lint->ctxt;
+    xmlParserInputPtr input = NULL;
+    int code = XML_ERR_OK;
+
+    if ((lint->timing) && (lint->repeat == 1))
+	startTimer(lint);
+
+#if HAVE_DECL_MMAP
+    if (lint->memory) {
+        input = xmlNewInputFromMemory(filename,
+                                      lint->memoryData, lint->memorySize,
+                                      XML_INPUT_BUF_STATIC);
+        if (input == NULL)
+            code = XML_ERR_NO_MEMORY;
+    } else
+#endif
+    if (strcmp(filename, "-") == 0) {
+        input = xmlNewInputFromFd("-", STDIN_FILENO, XML_INPUT_UNZIP);
+        if (input == NULL)
+            code = XML_ERR_NO_MEMORY;
+    } else {
+        code = xmlNewInputFromUrl(filename, XML_INPUT_UNZIP, &input);
+    }
+
+    if (input == NULL) {
+        if (code == XML_ERR_NO_MEMORY) {
+            lint->progresult = XMLLINT_ERR_MEM;
+        } else {
+            fprintf(lint->errStream, "Can't open %s\n", filename);
+            lint->progresult = XMLLINT_ERR_RDFILE;
+        }
+        return;
+    }
+
+    if (!xmlCtxtCheckWellFormed(ctxt, input)) {
+        if (ctxt->errNo == XML_ERR_NO_MEMORY)
+            lint->progresult = XMLLINT_ERR_MEM;
+        else
+            lint->progresult = XMLLINT_ERR_RDFILE;
+    }
+
+    if ((lint->timing) && (lint->repeat == 1))
+	endTimer(lint, "Checking");
+}
+
 static void
 parseAndPrintFile(xmllintState *lint, const char *filename) {
     FILE *errStream = lint->errStream;
@@ -1762,6 +1842,11 @@ parseAndPrintFile(xmllintState *lint, const char *filename) {
     /* Avoid unused variable warning */
     (void) errStream;
 
+    if ((lint->wfOnly) && (filename != NULL)) {
+        checkWellFormed(lint, filename);
+        return;
+    }
+
     if ((lint->timing) && (lint->repeat == 1))
 	startTimer(lint);
 
@@ -1776,6 +1861,9 @@ parseAndPrintFile(xmllintState *lint, const char *filename) {
 	endTimer(lint, "Parsing");
     }
 
+    if (lint->dictStats)
+        printDictStats(lint, doc);
+
     if (lint->dropdtd) {
 	xmlDtdPtr dtd;
 
@@ -2275,6 +2363,14 @@ static void usage(FILE *f, const char *name) {
     fprintf(f, "\t--copy : used to test the internal copy implementation\n");
     fprintf(f, "\t--recover : output what was parsable on broken XML documents\n");
     fprintf(f, "\t--huge : remove any internal arbitrary parser limits\n");
+    fprintf(f, "\t--indexed : parse documents with the indexed engine\n");
+#if HAVE_DECL_MMAP
+    fprintf(f, "\t--mmap : map input files into memory\n");
+#endif
+    fprintf(f, "\t--threads n : parse large documents with up to n threads\n");
+    fprintf(f, "\t--arena : allocate the document tree from an arena\n");
+    fprintf(f, "\t--offsets : record node offsets for exact line numbers\n");
+    fprintf(f, "\t--wf-only : only check well-formedness, imply --noout\n");
     fprintf(f, "\t--noent : substitute entity references by their value\n");
     fprintf(f, "\t--noenc : ignore any encoding specified inside the document\n");
     fprintf(f, "\t--noout : don't output the result tree\n");
@@ -2291,6 +2387,7 @@ static void usage(FILE *f, const char *name) {
 #endif /* LIBXML_VALID_ENABLED */
     fprintf(f, "\t--quiet : be quiet when succeeded\n");
     fprintf(f, "\t--timing : print some timings\n");
+    fprintf(f, "\t--dict-stats : print statistics of the document dictionary\n");
     fprintf(f, "\t--repeat : repeat 100 times, for timing or profiling\n");
     fprintf(f, "\t--dropdtd : remove the DOCTYPE of the input docs\n");
 #ifdef LIBXML_HTML_ENABLED
@@ -2435,7 +2532,9 @@ skipArgs(const char *arg) {
         (!strcmp(arg, "--xpath")) ||
 #endif
         (!strcmp(arg, "-max-ampl")) ||
-        (!strcmp(arg, "--max-ampl"))
+        (!strcmp(arg, "--max-ampl")) ||
+        (!strcmp(arg, "-threads")) ||
+        (!strcmp(arg, "--threads"))
     ) {
         return(1);
     }
@@ -2500,6 +2599,24 @@ xmllintParseOptions(xmllintState *lint, int argc, const char **argv) {
 #ifdef LIBXML_HTML_ENABLED
             lint->htmlOptions |= HTML_PARSE_HUGE;
 #endif
+        } else if ((!strcmp(argv[i], "-indexed")) ||
+                   (!strcmp(argv[i], "--indexed"))) {
+            lint->options |= XML_PARSE_INDEXED;
+#if HAVE_DECL_MMAP
+        } else if ((!strcmp(argv[i], "-mmap")) ||
+                   (!strcmp(argv[i], "--mmap"))) {
+            lint->options |= XML_PARSE_MMAP;
+#endif
+        } else if ((!strcmp(argv[i], "-arena")) ||
+                   (!strcmp(argv[i], "--arena"))) {
+            lint->options |= XML_PARSE_ARENA;
+        } else if ((!strcmp(argv[i], "-offsets")) ||
+                   (!strcmp(argv[i], "--offsets"))) {
+            lint->options |= XML_PARSE_OFFSETS;
+        } else if ((!strcmp(argv[i], "-wf-only")) ||
+                   (!strcmp(argv[i], "--wf-only"))) {
+            lint->wfOnly = 1;
+            lint->noout = 1;
         } else if ((!strcmp(argv[i], "-noent")) ||
                    (!strcmp(argv[i], "--noent"))) {
             lint->options |= XML_PARSE_NOENT;
@@ -2573,6 +2690,9 @@ xmllintParseOptions(xmllintState *lint, int argc, const char **argv) {
         } else if ((!strcmp(argv[i], "-timing")) ||
                    (!strcmp(argv[i], "--timing"))) {
             lint->timing = 1;
+        } else if ((!strcmp(argv[i], "-dict-stats")) ||
+                   (!strcmp(argv[i], "--dict-stats"))) {
+            lint->dictStats = 1;
         } else if ((!strcmp(argv[i], "-auto")) ||
                    (!strcmp(argv[i], "--auto"))) {
             lint->generate = 1;
@@ -2767,6 +2887,17 @@ xmllintParseOptions(xmllintState *lint, int argc, const char **argv) {
                              1, UINT_MAX) < 0)
                 return(XMLLINT_ERR_UNCLASS);
             lint->maxAmpl = val;
+        } else if ((!strcmp(argv[i], "-threads")) ||
+                   (!strcmp(argv[i], "--threads"))) {
+            i++;
+            if (i >= argc) {
+                fprintf(errStream, "threads: missing integer value\n");
+                return(XMLLINT_ERR_UNCLASS);
+            }
+            if (parseInteger(&val, errStream, "threads", argv[i],
+                             1, 1024) < 0)
+                return(XMLLINT_ERR_UNCLASS);
+            lint->maxThreads = val;
         } else {
             fprintf(errStream, "Unknown option %s\n", argv[i]);
             usage(errStream, argv[0]);
@@ -3055,6 +3186,8 @@ xmllintMain(int argc, const char **argv, FILE *errStream,
             xmlCtxtSetResourceLoader(ctxt, xmllintResourceLoader, lint);
             if (lint->maxAmpl > 0)
                 xmlCtxtSetMaxAmplification(ctxt, lint->maxAmpl);
+            if (lint->maxThreads > 0)
+                xmlCtxtSetMaxThreads(ctxt, lint->maxThreads);
 
             lint->ctxt = ctxt;
 
@@ -4722,6 +4722,8 @@ xmlTextReaderSetup(xmlTextReader *reader,
      * since usr applications should never modify the tree
      */
     options |= XML_PARSE_COMPACT;
+    /* the reader frees and recycles nodes one by one */
+    options &= ~XML_PARSE_ARENA;
 
     reader->doc = NULL;
     reader->entNr = 0;
@@ -2444,15 +2444,18 @@ xmlDocDumpFormatMemoryEnc(xmlDoc *out_doc, xmlChar **doc_txt_ptr,
         xmlSaveErrMemory(NULL);
         return;
     }
+    xmlOutputBufferSetSegmented(buf, XML_OUTPUT_CHUNK_SIZE);
 
     xmlDocDumpInternal(buf, out_doc, txt_encoding, format);
 
     xmlOutputBufferFlush(buf);
 
     if (!buf->error) {
-        if (doc_txt_len != NULL)
-            *doc_txt_len = xmlBufUse(buf->buffer);
-        *doc_txt_ptr = xmlBufDetach(buf->buffer);
+        size_t size;
+
+        *doc_txt_ptr = xmlOutputBufferDetach(buf, &size);
+        if ((*doc_txt_ptr != NULL) && (doc_txt_len != NULL))
+            *doc_txt_len = size <= INT_MAX ? size : INT_MAX;
     }
 
     xmlOutputBufferClose(buf);
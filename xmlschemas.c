@@ -20848,6 +20848,35 @@ exit:
     }
     return(ret);
 }
+
+/**
+ * Freeze the component tables of a schema. They are only modified
+ * again if further schemas are assembled during validation.
+ *
+ * @param schema  a schema
+ */
+static void
+xmlSchemaFreezeTables(xmlSchemaPtr schema)
+{
+    xmlHashFreeze(schema->typeDecl);
+    xmlHashFreeze(schema->attrDecl);
+    xmlHashFreeze(schema->attrgrpDecl);
+    xmlHashFreeze(schema->elemDecl);
+    xmlHashFreeze(schema->notaDecl);
+    xmlHashFreeze(schema->groupDecl);
+    xmlHashFreeze(schema->idcDef);
+}
+
+static void
+xmlSchemaFreezeImport(void *payload, void *data ATTRIBUTE_UNUSED,
+                      const xmlChar *name ATTRIBUTE_UNUSED)
+{
+    xmlSchemaImportPtr import = (xmlSchemaImportPtr) payload;
+
+    if (import->schema != NULL)
+        xmlSchemaFreezeTables(import->schema);
+}
+
 /**
  * parse a schema definition resource and build an internal
  * XML Schema structure which can be used to validate instances.
@@ -20933,6 +20962,15 @@ xmlSchemaParse(xmlSchemaParserCtxt *ctxt)
     if (xmlSchemaFixupComponents(ctxt, WXS_CONSTRUCTOR(ctxt)->mainBucket) == -1)
 	goto exit_failure;
 
+    if (ctxt->nberrors == 0) {
+        /*
+        * The component tables are only used for lookups from now on.
+        */
+        xmlSchemaFreezeTables(mainSchema);
+        xmlHashScan(mainSchema->schemasImports, xmlSchemaFreezeImport, NULL);
+        xmlHashFreeze(mainSchema->schemasImports);
+    }
+
     /*
     * TODO: This is not nice, since we cannot distinguish from the
     * result if there was an internal error or not.
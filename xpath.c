@@ -12078,4 +12078,1953 @@ xmlXPathRegisterAllFunctions(xmlXPathContext *ctxt ATTRIBUTE_UNUSED)
 {
 }
 
+/************************************************************************
+ *									*
+ *			Compact documents				*
+ *									*
+ ************************************************************************/
+
+/*
+ * A compact document stores a frozen copy of a tree as parallel arrays
+ * indexed by node number. Nodes are numbered in document order, the
+ * attributes of an element directly following the element and
+ * preceding its children. Since every subtree occupies a contiguous
+ * range of indices, "ends" is enough to navigate: the first child of
+ * a node is the first non-attribute node after it and its next
+ * sibling starts right after its last descendant. Names are interned
+ * in a private dictionary, so node tests compare pointers, and the
+ * content of leaf nodes is stored in a single text pool.
+ */
+
+#define XPATH_COMPACT_ERROR (-1)
+#define XPATH_COMPACT_UNSUPPORTED (-2)
+
+typedef struct {
+    const xmlChar *prefix;
+    const xmlChar *href;
+} xmlXPathCompactNs;
+
+struct _xmlXPathCompactDoc {
+    int nbNodes;
+    int maxNodes;
+    unsigned char *types;	/* xmlElementType of each node */
+    int *parents;		/* parent index, -1 for the document */
+    int *ends;			/* index of the last node in the subtree */
+    const xmlChar **names;	/* local names, interned in dict */
+    int *nsIds;			/* index into nsTab or -1 */
+    int *contents;		/* offset into text or -1 */
+
+    xmlChar *text;
+    int textSize;
+    int textMax;
+
+    xmlXPathCompactNs *nsTab;
+    int nbNs;
+    int maxNs;
+
+    xmlDictPtr dict;
+};
+
+static int
+xmlXPathCompactGrowNodes(xmlXPathCompactDocPtr cdoc) {
+    unsigned char *types;
+    int *parents, *ends, *nsIds, *contents;
+    const xmlChar **names;
+    int newSize;
+
+    newSize = xmlGrowCapacity(cdoc->maxNodes, sizeof(names[0]),
+                              256, XML_MAX_ITEMS);
+    if (newSize < 0)
+        return(-1);
+
+    /*
+     * Arrays which were already enlarged stay valid if a later
+     * reallocation fails, maxNodes is only updated at the end.
+     */
+    types = xmlRealloc(cdoc->types, newSize * sizeof(types[0]));
+    if (types == NULL)
+        return(-1);
+    cdoc->types = types;
+    parents = xmlRealloc(cdoc->parents, newSize * sizeof(parents[0]));
+    if (parents == NULL)
+        return(-1);
+    cdoc->parents = parents;
+    ends = xmlRealloc(cdoc->ends, newSize * sizeof(ends[0]));
+    if (ends == NULL)
+        return(-1);
+    cdoc->ends = ends;
+    names = xmlRealloc(cdoc->names, newSize * sizeof(names[0]));
+    if (names == NULL)
+        return(-1);
+    cdoc->names = names;
+    nsIds = xmlRealloc(cdoc->nsIds, newSize * sizeof(nsIds[0]));
+    if (nsIds == NULL)
+        return(-1);
+    cdoc->nsIds = nsIds;
+    contents = xmlRealloc(cdoc->contents, newSize * sizeof(contents[0]));
+    if (contents == NULL)
+        return(-1);
+    cdoc->contents = contents;
+
+    cdoc->maxNodes = newSize;
+    return(0);
+}
+
+static int
+xmlXPathCompactAddText(xmlXPathCompactDocPtr cdoc, const xmlChar *str) {
+    size_t len;
+    int offset;
+
+    if (str == NULL)
+        str = BAD_CAST "";
+    len = strlen((const char *) str);
+    if (len >= (size_t) (INT_MAX - cdoc->textSize))
+        return(-1);
+
+    while ((size_t) (cdoc->textMax - cdoc->textSize) < len + 1) {
+        xmlChar *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(cdoc->textMax, 1, 4096, INT_MAX);
+        if (newSize < 0)
+            return(-1);
+        tmp = xmlRealloc(cdoc->text, newSize);
+        if (tmp == NULL)
+            return(-1);
+        cdoc->text = tmp;
+        cdoc->textMax = newSize;
+    }
+
+    offset = cdoc->textSize;
+    memcpy(cdoc->text + offset, str, len + 1);
+    cdoc->textSize += len + 1;
+    return(offset);
+}
+
+static int
+xmlXPathCompactAddNode(xmlXPathCompactDocPtr cdoc, xmlElementType type,
+                       int parent, const xmlChar *name, int nsId,
+                       const xmlChar *content) {
+    int id;
+
+    if ((cdoc->nbNodes >= cdoc->maxNodes) &&
+        (xmlXPathCompactGrowNodes(cdoc) < 0))
+        return(-1);
+
+    id = cdoc->nbNodes;
+    cdoc->types[id] = type;
+    cdoc->parents[id] = parent;
+    cdoc->ends[id] = id;
+    cdoc->nsIds[id] = nsId;
+    cdoc->contents[id] = -1;
+
+    if (name != NULL) {
+        name = xmlDictLookup(cdoc->dict, name, -1);
+        if (name == NULL)
+            return(-1);
+    }
+    cdoc->names[id] = name;
+
+    if ((type != XML_ELEMENT_NODE) &&
+        (type != XML_DOCUMENT_NODE) &&
+        (type != XML_HTML_DOCUMENT_NODE)) {
+        cdoc->contents[id] = xmlXPathCompactAddText(cdoc, content);
+        if (cdoc->contents[id] < 0)
+            return(-1);
+    }
+
+    cdoc->nbNodes += 1;
+    return(id);
+}
+
+static int
+xmlXPathCompactNsId(xmlXPathCompactDocPtr cdoc, xmlHashTablePtr nsHash,
+                    xmlNsPtr ns) {
+    const xmlChar *href, *prefix;
+    void *data;
+    int id;
+
+    if (ns == NULL)
+        return(-1);
+
+    href = (ns->href != NULL) ? ns->href : BAD_CAST "";
+    data = xmlHashLookup2(nsHash, href, ns->prefix);
+    if (data != NULL)
+        return((int) ((ptrdiff_t) data - 1));
+
+    if (cdoc->nbNs >= cdoc->maxNs) {
+        xmlXPathCompactNs *tmp;
+        int newSize;
+
+        newSize = xmlGrowCapacity(cdoc->maxNs, sizeof(tmp[0]),
+                                  4, XML_MAX_ITEMS);
+        if (newSize < 0)
+            return(-2);
+        tmp = xmlRealloc(cdoc->nsTab, newSize * sizeof(tmp[0]));
+        if (tmp == NULL)
+            return(-2);
+        cdoc->nsTab = tmp;
+        cdoc->maxNs = newSize;
+    }
+
+    href = xmlDictLookup(cdoc->dict, href, -1);
+    if (href == NULL)
+        return(-2);
+    prefix = NULL;
+    if (ns->prefix != NULL) {
+        prefix = xmlDictLookup(cdoc->dict, ns->prefix, -1);
+        if (prefix == NULL)
+            return(-2);
+    }
+
+    id = cdoc->nbNs;
+    if (xmlHashAdd2(nsHash, href, prefix, (void *) (ptrdiff_t) (id + 1)) < 0)
+        return(-2);
+    cdoc->nsTab[id].prefix = prefix;
+    cdoc->nsTab[id].href = href;
+    cdoc->nbNs += 1;
+
+    return(id);
+}
+
+static int
+xmlXPathCompactAddAttr(xmlXPathCompactDocPtr cdoc, xmlHashTablePtr nsHash,
+                       xmlAttrPtr attr, int parent) {
+    xmlChar *value = NULL;
+    const xmlChar *content;
+    int nsId, id;
+
+    nsId = xmlXPathCompactNsId(cdoc, nsHash, attr->ns);
+    if (nsId < -1)
+        return(-1);
+
+    if (attr->children == NULL) {
+        content = BAD_CAST "";
+    } else if ((attr->children->next == NULL) &&
+               (attr->children->type == XML_TEXT_NODE)) {
+        content = attr->children->content;
+    } else {
+        value = xmlNodeGetContent((xmlNodePtr) attr);
+        if (value == NULL)
+            return(-1);
+        content = value;
+    }
+
+    id = xmlXPathCompactAddNode(cdoc, XML_ATTRIBUTE_NODE, parent,
+                                attr->name, nsId, content);
+    xmlFree(value);
+
+    return(id);
+}
+
+/**
+ * Create a compact, read-only copy of a document for XPath queries.
+ *
+ * The copy stores the document node, elements, attributes, text,
+ * CDATA sections, comments and processing instructions. Entity
+ * references, the DTD and namespace declarations are left out, so
+ * the document should be parsed with XML_PARSE_NOENT if it contains
+ * entity references. Nodes are identified by their index in document
+ * order, the document node having index 0.
+ *
+ * The copy doesn't reference the original tree which can be freed
+ * afterwards.
+ *
+ * @param doc  the document
+ * @returns the compact document or NULL if a memory allocation failed.
+ */
+xmlXPathCompactDoc *
+xmlXPathCompactDocNew(xmlDoc *doc) {
+    xmlXPathCompactDocPtr cdoc;
+    xmlHashTablePtr nsHash = NULL;
+    xmlNodePtr cur;
+    int parent, id;
+
+    if (doc == NULL)
+        return(NULL);
+
+    cdoc = xmlMalloc(sizeof(*cdoc));
+    if (cdoc == NULL)
+        return(NULL);
+    memset(cdoc, 0, sizeof(*cdoc));
+
+    cdoc->dict = xmlDictCreate();
+    if (cdoc->dict == NULL)
+        goto error;
+    nsHash = xmlHashCreate(0);
+    if (nsHash == NULL)
+        goto error;
+
+    if (xmlXPathCompactAddNode(cdoc, doc->type, -1, NULL, -1, NULL) < 0)
+        goto error;
+
+    parent = 0;
+    cur = doc->children;
+    while (cur != NULL) {
+        switch (cur->type) {
+            case XML_ELEMENT_NODE: {
+                xmlAttrPtr attr;
+                int nsId;
+
+                nsId = xmlXPathCompactNsId(cdoc, nsHash, cur->ns);
+                if (nsId < -1)
+                    goto error;
+                id = xmlXPathCompactAddNode(cdoc, XML_ELEMENT_NODE, parent,
+                                            cur->name, nsId, NULL);
+                if (id < 0)
+                    goto error;
+
+                for (attr = cur->properties; attr != NULL;
+                     attr = attr->next) {
+                    if (xmlXPathCompactAddAttr(cdoc, nsHash, attr, id) < 0)
+                        goto error;
+                }
+                cdoc->ends[id] = cdoc->nbNodes - 1;
+
+                if (cur->children != NULL) {
+                    parent = id;
+                    cur = cur->children;
+                    continue;
+                }
+                break;
+            }
+
+            case XML_TEXT_NODE:
+            case XML_CDATA_SECTION_NODE:
+            case XML_COMMENT_NODE:
+                if (xmlXPathCompactAddNode(cdoc, cur->type, parent, NULL, -1,
+                                           cur->content) < 0)
+                    goto error;
+                break;
+
+            case XML_PI_NODE:
+                if (xmlXPathCompactAddNode(cdoc, cur->type, parent,
+                                           cur->name, -1, cur->content) < 0)
+                    goto error;
+                break;
+
+            default:
+                break;
+        }
+
+        while (cur->next == NULL) {
+            cur = cur->parent;
+            if ((cur == NULL) || (cur == (xmlNodePtr) doc))
+                goto done;
+            cdoc->ends[parent] = cdoc->nbNodes - 1;
+            parent = cdoc->parents[parent];
+        }
+        cur = cur->next;
+    }
+
+done:
+    cdoc->ends[0] = cdoc->nbNodes - 1;
+    xmlHashFree(nsHash, NULL);
+
+    /*
+     * Release the slack left by growing the arrays.
+     */
+    if (cdoc->textSize < cdoc->textMax) {
+        xmlChar *text = xmlRealloc(cdoc->text, cdoc->textSize);
+
+        if (text != NULL) {
+            cdoc->text = text;
+            cdoc->textMax = cdoc->textSize;
+        }
+    }
+    if (cdoc->nbNodes < cdoc->maxNodes) {
+        int nbNodes = cdoc->nbNodes;
+        void *tmp;
+
+        tmp = xmlRealloc(cdoc->types, nbNodes * sizeof(cdoc->types[0]));
+        if (tmp != NULL)
+            cdoc->types = tmp;
+        tmp = xmlRealloc(cdoc->parents, nbNodes * sizeof(cdoc->parents[0]));
+        if (tmp != NULL)
+            cdoc->parents = tmp;
+        tmp = xmlRealloc(cdoc->ends, nbNodes * sizeof(cdoc->ends[0]));
+        if (tmp != NULL)
+            cdoc->ends = tmp;
+        tmp = xmlRealloc(cdoc->names, nbNodes * sizeof(cdoc->names[0]));
+        if (tmp != NULL)
+            cdoc->names = tmp;
+        tmp = xmlRealloc(cdoc->nsIds, nbNodes * sizeof(cdoc->nsIds[0]));
+        if (tmp != NULL)
+            cdoc->nsIds = tmp;
+        tmp = xmlRealloc(cdoc->contents,
+                         nbNodes * sizeof(cdoc->contents[0]));
+        if (tmp != NULL)
+            cdoc->contents = tmp;
+        cdoc->maxNodes = nbNodes;
+    }
+
+    return(cdoc);
+
+error:
+    xmlHashFree(nsHash, NULL);
+    xmlXPathCompactDocFree(cdoc);
+    return(NULL);
+}
+
+/**
+ * Free a compact document.
+ *
+ * @param cdoc  the compact document
+ */
+void
+xmlXPathCompactDocFree(xmlXPathCompactDoc *cdoc) {
+    if (cdoc == NULL)
+        return;
+    xmlFree(cdoc->types);
+    xmlFree(cdoc->parents);
+    xmlFree(cdoc->ends);
+    xmlFree(cdoc->names);
+    xmlFree(cdoc->nsIds);
+    xmlFree(cdoc->contents);
+    xmlFree(cdoc->text);
+    xmlFree(cdoc->nsTab);
+    xmlDictFree(cdoc->dict);
+    xmlFree(cdoc);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @returns the number of nodes in the compact document.
+ */
+int
+xmlXPathCompactDocSize(const xmlXPathCompactDoc *cdoc) {
+    if (cdoc == NULL)
+        return(0);
+    return(cdoc->nbNodes);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the type of a node or 0 if the index is invalid.
+ */
+xmlElementType
+xmlXPathCompactNodeType(const xmlXPathCompactDoc *cdoc, int node) {
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes))
+        return(0);
+    return((xmlElementType) cdoc->types[node]);
+}
+
+/**
+ * Return the local name of an element or attribute, or the target
+ * of a processing instruction.
+ *
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the name or NULL.
+ */
+const xmlChar *
+xmlXPathCompactNodeName(const xmlXPathCompactDoc *cdoc, int node) {
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes))
+        return(NULL);
+    return(cdoc->names[node]);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the namespace URI of an element or attribute or NULL.
+ */
+const xmlChar *
+xmlXPathCompactNodeNsURI(const xmlXPathCompactDoc *cdoc, int node) {
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes) ||
+        (cdoc->nsIds[node] < 0))
+        return(NULL);
+    return(cdoc->nsTab[cdoc->nsIds[node]].href);
+}
+
+/**
+ * Return the content of an attribute, text node, CDATA section,
+ * comment or processing instruction.
+ *
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the content or NULL for elements and the document node.
+ */
+const xmlChar *
+xmlXPathCompactNodeContent(const xmlXPathCompactDoc *cdoc, int node) {
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes) ||
+        (cdoc->contents[node] < 0))
+        return(NULL);
+    return(cdoc->text + cdoc->contents[node]);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the index of the parent of a node or -1. The parent of an
+ * attribute is its element.
+ */
+int
+xmlXPathCompactNodeParent(const xmlXPathCompactDoc *cdoc, int node) {
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes))
+        return(-1);
+    return(cdoc->parents[node]);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the index of the first child of a node or -1. Attributes
+ * aren't children.
+ */
+int
+xmlXPathCompactNodeFirstChild(const xmlXPathCompactDoc *cdoc, int node) {
+    int cur;
+
+    if ((cdoc == NULL) || (node < 0) || (node >= cdoc->nbNodes))
+        return(-1);
+    for (cur = node + 1; cur <= cdoc->ends[node]; cur++) {
+        if (cdoc->types[cur] != XML_ATTRIBUTE_NODE)
+            return(cur);
+    }
+    return(-1);
+}
+
+/**
+ * @param cdoc  the compact document
+ * @param node  the node index
+ * @returns the index of the next sibling of a node or -1.
+ */
+int
+xmlXPathCompactNodeNextSibling(const xmlXPathCompactDoc *cdoc, int node) {
+    int parent, next;
+
+    if ((cdoc == NULL) || (node <= 0) || (node >= cdoc->nbNodes))
+        return(-1);
+    if (cdoc->types[node] == XML_ATTRIBUTE_NODE)
+        return(-1);
+    parent = cdoc->parents[node];
+    next = cdoc->ends[node] + 1;
+    if (next > cdoc->ends[parent])
+        return(-1);
+    return(next);
+}
+
+/*
+ * Evaluation of compiled expressions over compact documents
+ */
+
+typedef struct {
+    xmlXPathObjectType type;
+    int nodeNr;
+    int nodeMax;
+    int *nodeTab;		/* sorted node indices */
+    int boolval;
+    double floatval;
+    xmlChar *stringval;
+} xmlXPathCompactValue;
+typedef xmlXPathCompactValue *xmlXPathCompactValuePtr;
+
+typedef struct {
+    xmlXPathContextPtr ctxt;
+    xmlXPathCompExprPtr comp;
+    const xmlXPathCompactDoc *cdoc;
+    int depth;
+} xmlXPathCompactEvalCtxt;
+typedef xmlXPathCompactEvalCtxt *xmlXPathCompactEvalCtxtPtr;
+
+static int
+xmlXPathCompactEvalOp(xmlXPathCompactEvalCtxtPtr ectxt, int opIdx,
+                      int node, int pos, int size,
+                      xmlXPathCompactValuePtr ret);
+
+static void
+xmlXPathCompactValueClear(xmlXPathCompactValuePtr val) {
+    xmlFree(val->nodeTab);
+    xmlFree(val->stringval);
+    memset(val, 0, sizeof(*val));
+}
+
+static int
+xmlXPathCompactValueReserve(xmlXPathCompactValuePtr val, int extra) {
+    int *tmp;
+    int newSize;
+
+    if (extra <= val->nodeMax - val->nodeNr)
+        return(0);
+
+    newSize = val->nodeMax;
+    do {
+        newSize = xmlGrowCapacity(newSize, sizeof(tmp[0]), 16,
+                                  XML_MAX_ITEMS);
+        if (newSize < 0)
+            return(-1);
+    } while (extra > newSize - val->nodeNr);
+
+    tmp = xmlRealloc(val->nodeTab, newSize * sizeof(tmp[0]));
+    if (tmp == NULL)
+        return(-1);
+    val->nodeTab = tmp;
+    val->nodeMax = newSize;
+    return(0);
+}
+
+static int
+xmlXPathCompactValueAdd(xmlXPathCompactValuePtr val, int node) {
+    if ((val->nodeNr >= val->nodeMax) &&
+        (xmlXPathCompactValueReserve(val, 1) < 0))
+        return(-1);
+    val->nodeTab[val->nodeNr++] = node;
+    return(0);
+}
+
+static int
+xmlXPathCompactCmpIndex(const void *a, const void *b) {
+    int i1 = *(const int *) a;
+    int i2 = *(const int *) b;
+
+    return((i1 > i2) - (i1 < i2));
+}
+
+/*
+ * Node indices are in document order, so sorting a node-set is an
+ * integer sort. Duplicates are removed.
+ */
+static void
+xmlXPathCompactValueSort(xmlXPathCompactValuePtr val) {
+    int i, j;
+
+    for (i = 1; i < val->nodeNr; i++) {
+        if (val->nodeTab[i - 1] >= val->nodeTab[i])
+            break;
+    }
+    if (i >= val->nodeNr)
+        return;
+
+    qsort(val->nodeTab, val->nodeNr, sizeof(val->nodeTab[0]),
+          xmlXPathCompactCmpIndex);
+    for (i = 1, j = 1; i < val->nodeNr; i++) {
+        if (val->nodeTab[i] != val->nodeTab[j - 1])
+            val->nodeTab[j++] = val->nodeTab[i];
+    }
+    val->nodeNr = j;
+}
+
+static void
+xmlXPathCompactValueReverse(xmlXPathCompactValuePtr val, int start) {
+    int i = start, j = val->nodeNr - 1;
+
+    while (i < j) {
+        int tmp = val->nodeTab[i];
+
+        val->nodeTab[i++] = val->nodeTab[j];
+        val->nodeTab[j--] = tmp;
+    }
+}
+
+/*
+ * Return the string value of a node. The result points into the text
+ * pool unless the text of several descendants had to be concatenated,
+ * in which case *alloc receives the string to free.
+ */
+static const xmlChar *
+xmlXPathCompactStringValue(const xmlXPathCompactDoc *cdoc, int node,
+                           xmlChar **alloc) {
+    const xmlChar *first = NULL;
+    xmlChar *ret;
+    size_t len = 0;
+    int i, count = 0;
+
+    *alloc = NULL;
+    if (cdoc->contents[node] >= 0)
+        return(cdoc->text + cdoc->contents[node]);
+
+    for (i = node + 1; i <= cdoc->ends[node]; i++) {
+        if ((cdoc->types[i] == XML_TEXT_NODE) ||
+            (cdoc->types[i] == XML_CDATA_SECTION_NODE)) {
+            const xmlChar *str = cdoc->text + cdoc->contents[i];
+
+            if (first == NULL)
+                first = str;
+            len += strlen((const char *) str);
+            count++;
+        }
+    }
+    if (count == 0)
+        return(BAD_CAST "");
+    if (count == 1)
+        return(first);
+    if (len >= INT_MAX)
+        return(NULL);
+
+    ret = xmlMalloc(len + 1);
+    if (ret == NULL)
+        return(NULL);
+    len = 0;
+    for (i = node + 1; i <= cdoc->ends[node]; i++) {
+        if ((cdoc->types[i] == XML_TEXT_NODE) ||
+            (cdoc->types[i] == XML_CDATA_SECTION_NODE)) {
+            const xmlChar *str = cdoc->text + cdoc->contents[i];
+            size_t l = strlen((const char *) str);
+
+            memcpy(ret + len, str, l);
+            len += l;
+        }
+    }
+    ret[len] = 0;
+
+    *alloc = ret;
+    return(ret);
+}
+
+static int
+xmlXPathCompactNodeNumber(const xmlXPathCompactDoc *cdoc, int node,
+                          double *number) {
+    const xmlChar *str;
+    xmlChar *alloc;
+
+    str = xmlXPathCompactStringValue(cdoc, node, &alloc);
+    if (str == NULL)
+        return(-1);
+    *number = xmlXPathStringEvalNumber(str);
+    xmlFree(alloc);
+    return(0);
+}
+
+static int
+xmlXPathCompactToBoolean(xmlXPathCompactValuePtr val) {
+    switch (val->type) {
+        case XPATH_NODESET:
+            return(val->nodeNr != 0);
+        case XPATH_BOOLEAN:
+            return(val->boolval);
+        case XPATH_NUMBER:
+            return(xmlXPathCastNumberToBoolean(val->floatval));
+        case XPATH_STRING:
+            return((val->stringval != NULL) && (val->stringval[0] != 0));
+        default:
+            return(0);
+    }
+}
+
+static int
+xmlXPathCompactCastToBoolean(xmlXPathCompactValuePtr val) {
+    int boolval = xmlXPathCompactToBoolean(val);
+
+    xmlXPathCompactValueClear(val);
+    val->type = XPATH_BOOLEAN;
+    val->boolval = boolval;
+    return(0);
+}
+
+static int
+xmlXPathCompactCastToString(const xmlXPathCompactDoc *cdoc,
+                            xmlXPathCompactValuePtr val) {
+    xmlChar *str = NULL;
+
+    switch (val->type) {
+        case XPATH_STRING:
+            return(0);
+        case XPATH_NODESET:
+            if (val->nodeNr == 0) {
+                str = xmlStrdup(BAD_CAST "");
+            } else {
+                const xmlChar *content;
+
+                content = xmlXPathCompactStringValue(cdoc, val->nodeTab[0],
+                                                     &str);
+                if ((content != NULL) && (str == NULL))
+                    str = xmlStrdup(content);
+            }
+            break;
+        case XPATH_BOOLEAN:
+            str = xmlStrdup(val->boolval ? BAD_CAST "true" : BAD_CAST "false");
+            break;
+        case XPATH_NUMBER:
+            str = xmlXPathCastNumberToString(val->floatval);
+            break;
+        default:
+            return(XPATH_COMPACT_UNSUPPORTED);
+    }
+    if (str == NULL)
+        return(XPATH_COMPACT_ERROR);
+
+    xmlXPathCompactValueClear(val);
+    val->type = XPATH_STRING;
+    val->stringval = str;
+    return(0);
+}
+
+static int
+xmlXPathCompactCastToNumber(const xmlXPathCompactDoc *cdoc,
+                            xmlXPathCompactValuePtr val) {
+    double number;
+
+    switch (val->type) {
+        case XPATH_NUMBER:
+            return(0);
+        case XPATH_NODESET:
+            if (val->nodeNr == 0)
+                number = xmlXPathNAN;
+            else if (xmlXPathCompactNodeNumber(cdoc, val->nodeTab[0],
+                                               &number) < 0)
+                return(XPATH_COMPACT_ERROR);
+            break;
+        case XPATH_BOOLEAN:
+            number = val->boolval ? 1.0 : 0.0;
+            break;
+        case XPATH_STRING:
+            number = xmlXPathStringEvalNumber(val->stringval);
+            break;
+        default:
+            return(XPATH_COMPACT_UNSUPPORTED);
+    }
+
+    xmlXPathCompactValueClear(val);
+    val->type = XPATH_NUMBER;
+    val->floatval = number;
+    return(0);
+}
+
+static int
+xmlXPathCompactCompareNumbers(double n1, double n2, int inf, int strict) {
+    /* Comparisons involving NaN are false in C as in XPath. */
+    if (inf && strict)
+        return(n1 < n2);
+    if (inf)
+        return(n1 <= n2);
+    if (strict)
+        return(n1 > n2);
+    return(n1 >= n2);
+}
+
+/*
+ * Implement '=' and '!=' following the rules of XPath 1.0 section 3.4.
+ */
+static int
+xmlXPathCompactEqual(const xmlXPathCompactDoc *cdoc,
+                     xmlXPathCompactValuePtr arg1,
+                     xmlXPathCompactValuePtr arg2, int neq, int *res) {
+    const xmlChar *str;
+    xmlChar *alloc;
+    int i, j, ret;
+
+    *res = 0;
+
+    if (arg1->type != XPATH_NODESET) {
+        xmlXPathCompactValuePtr tmp = arg1;
+
+        arg1 = arg2;
+        arg2 = tmp;
+    }
+
+    if (arg1->type != XPATH_NODESET) {
+        if ((arg1->type == XPATH_BOOLEAN) || (arg2->type == XPATH_BOOLEAN)) {
+            ret = (xmlXPathCompactToBoolean(arg1) ==
+                   xmlXPathCompactToBoolean(arg2));
+        } else if ((arg1->type == XPATH_NUMBER) ||
+                   (arg2->type == XPATH_NUMBER)) {
+            if ((xmlXPathCompactCastToNumber(cdoc, arg1) < 0) ||
+                (xmlXPathCompactCastToNumber(cdoc, arg2) < 0))
+                return(XPATH_COMPACT_ERROR);
+            ret = (arg1->floatval == arg2->floatval);
+        } else {
+            ret = xmlStrEqual(arg1->stringval, arg2->stringval);
+        }
+        *res = ret ^ neq;
+        return(0);
+    }
+
+    switch (arg2->type) {
+        case XPATH_BOOLEAN:
+            *res = ((arg1->nodeNr != 0) == arg2->boolval) ^ neq;
+            return(0);
+
+        case XPATH_NUMBER:
+            for (i = 0; i < arg1->nodeNr; i++) {
+                double number;
+
+                if (xmlXPathCompactNodeNumber(cdoc, arg1->nodeTab[i],
+                                              &number) < 0)
+                    return(XPATH_COMPACT_ERROR);
+                if ((number == arg2->floatval) ^ neq) {
+                    *res = 1;
+                    break;
+                }
+            }
+            return(0);
+
+        case XPATH_STRING:
+            for (i = 0; i < arg1->nodeNr; i++) {
+                str = xmlXPathCompactStringValue(cdoc, arg1->nodeTab[i],
+                                                 &alloc);
+                if (str == NULL)
+                    return(XPATH_COMPACT_ERROR);
+                ret = xmlStrEqual(str, arg2->stringval) ^ neq;
+                xmlFree(alloc);
+                if (ret) {
+                    *res = 1;
+                    break;
+                }
+            }
+            return(0);
+
+        case XPATH_NODESET: {
+            const xmlChar **values2;
+            xmlChar **allocs2;
+
+            if ((arg1->nodeNr == 0) || (arg2->nodeNr == 0))
+                return(0);
+
+            /* Both sets are sorted, look for a common node. */
+            if (!neq) {
+                i = 0;
+                j = 0;
+                while ((i < arg1->nodeNr) && (j < arg2->nodeNr)) {
+                    if (arg1->nodeTab[i] == arg2->nodeTab[j]) {
+                        *res = 1;
+                        return(0);
+                    }
+                    if (arg1->nodeTab[i] < arg2->nodeTab[j])
+                        i++;
+                    else
+                        j++;
+                }
+            }
+
+            values2 = xmlMalloc(arg2->nodeNr * sizeof(values2[0]));
+            if (values2 == NULL)
+                return(XPATH_COMPACT_ERROR);
+            allocs2 = xmlMalloc(arg2->nodeNr * sizeof(allocs2[0]));
+            if (allocs2 == NULL) {
+                xmlFree(values2);
+                return(XPATH_COMPACT_ERROR);
+            }
+            ret = 0;
+            for (j = 0; j < arg2->nodeNr; j++) {
+                values2[j] = xmlXPathCompactStringValue(cdoc,
+                        arg2->nodeTab[j], &allocs2[j]);
+                if (values2[j] == NULL)
+                    ret = XPATH_COMPACT_ERROR;
+            }
+            for (i = 0; (ret == 0) && (i < arg1->nodeNr); i++) {
+                str = xmlXPathCompactStringValue(cdoc, arg1->nodeTab[i],
+                                                 &alloc);
+                if (str == NULL) {
+                    ret = XPATH_COMPACT_ERROR;
+                    break;
+                }
+                for (j = 0; j < arg2->nodeNr; j++) {
+                    if (xmlStrEqual(str, values2[j]) ^ neq) {
+                        *res = 1;
+                        break;
+                    }
+                }
+                xmlFree(alloc);
+                if (*res)
+                    break;
+            }
+            for (j = 0; j < arg2->nodeNr; j++)
+                xmlFree(allocs2[j]);
+            xmlFree(allocs2);
+            xmlFree(values2);
+            return(ret);
+        }
+
+        default:
+            return(XPATH_COMPACT_UNSUPPORTED);
+    }
+}
+
+/*
+ * Implement '<', '<=', '>' and '>=' following the rules of XPath 1.0
+ * section 3.4.
+ */
+static int
+xmlXPathCompactCompare(const xmlXPathCompactDoc *cdoc,
+                       xmlXPathCompactValuePtr arg1,
+                       xmlXPathCompactValuePtr arg2, int inf, int strict,
+                       int *res) {
+    double *values2;
+    int i, j;
+
+    *res = 0;
+
+    if (arg1->type != XPATH_NODESET) {
+        if (arg2->type == XPATH_NODESET) {
+            xmlXPathCompactValuePtr tmp = arg1;
+
+            arg1 = arg2;
+            arg2 = tmp;
+            inf = !inf;
+        } else {
+            if ((xmlXPathCompactCastToNumber(cdoc, arg1) < 0) ||
+                (xmlXPathCompactCastToNumber(cdoc, arg2) < 0))
+                return(XPATH_COMPACT_ERROR);
+            *res = xmlXPathCompactCompareNumbers(arg1->floatval,
+                                                 arg2->floatval, inf, strict);
+            return(0);
+        }
+    }
+
+    if (arg2->type == XPATH_BOOLEAN) {
+        *res = xmlXPathCompactCompareNumbers(arg1->nodeNr != 0 ? 1.0 : 0.0,
+                                             arg2->boolval ? 1.0 : 0.0,
+                                             inf, strict);
+        return(0);
+    }
+
+    if (arg2->type != XPATH_NODESET) {
+        if (xmlXPathCompactCastToNumber(cdoc, arg2) < 0)
+            return(XPATH_COMPACT_ERROR);
+        for (i = 0; i < arg1->nodeNr; i++) {
+            double number;
+
+            if (xmlXPathCompactNodeNumber(cdoc, arg1->nodeTab[i],
+                                          &number) < 0)
+                return(XPATH_COMPACT_ERROR);
+            if (xmlXPathCompactCompareNumbers(number, arg2->floatval,
+                                              inf, strict)) {
+                *res = 1;
+                break;
+            }
+        }
+        return(0);
+    }
+
+    if ((arg1->nodeNr == 0) || (arg2->nodeNr == 0))
+        return(0);
+    values2 = xmlMalloc(arg2->nodeNr * sizeof(values2[0]));
+    if (values2 == NULL)
+        return(XPATH_COMPACT_ERROR);
+    for (j = 0; j < arg2->nodeNr; j++) {
+        if (xmlXPathCompactNodeNumber(cdoc, arg2->nodeTab[j],
+                                      &values2[j]) < 0) {
+            xmlFree(values2);
+            return(XPATH_COMPACT_ERROR);
+        }
+    }
+    for (i = 0; (i < arg1->nodeNr) && (*res == 0); i++) {
+        double number;
+
+        if (xmlXPathCompactNodeNumber(cdoc, arg1->nodeTab[i],
+                                      &number) < 0) {
+            xmlFree(values2);
+            return(XPATH_COMPACT_ERROR);
+        }
+        for (j = 0; j < arg2->nodeNr; j++) {
+            if (xmlXPathCompactCompareNumbers(number, values2[j],
+                                              inf, strict)) {
+                *res = 1;
+                break;
+            }
+        }
+    }
+    xmlFree(values2);
+    return(0);
+}
+
+/*
+ * Keep the nodes of a set for which the predicate expression is true.
+ * Positions follow the order of the set.
+ */
+static int
+xmlXPathCompactFilter(xmlXPathCompactEvalCtxtPtr ectxt, int opIdx,
+                      xmlXPathCompactValuePtr set) {
+    xmlXPathCompactValue res;
+    int i, j, size, ret, keep;
+
+    size = set->nodeNr;
+    for (i = 0, j = 0; i < size; i++) {
+        memset(&res, 0, sizeof(res));
+        ret = xmlXPathCompactEvalOp(ectxt, opIdx, set->nodeTab[i], i + 1,
+                                    size, &res);
+        if (ret < 0)
+            return(ret);
+
+        if (res.type == XPATH_NUMBER)
+            keep = (res.floatval == i + 1);
+        else
+            keep = xmlXPathCompactToBoolean(&res);
+        xmlXPathCompactValueClear(&res);
+
+        if (keep)
+            set->nodeTab[j++] = set->nodeTab[i];
+    }
+    set->nodeNr = j;
+
+    return(0);
+}
+
+/*
+ * Apply a chain of predicates, innermost first.
+ */
+static int
+xmlXPathCompactPredicates(xmlXPathCompactEvalCtxtPtr ectxt, int opIdx,
+                          xmlXPathCompactValuePtr set) {
+    xmlXPathStepOpPtr op = &ectxt->comp->steps[opIdx];
+    int ret;
+
+    if (op->op != XPATH_OP_PREDICATE)
+        return(XPATH_COMPACT_UNSUPPORTED);
+    if (ectxt->depth >= XPATH_MAX_RECURSION_DEPTH)
+        return(XPATH_COMPACT_UNSUPPORTED);
+
+    if (op->ch1 != -1) {
+        ectxt->depth += 1;
+        ret = xmlXPathCompactPredicates(ectxt, op->ch1, set);
+        ectxt->depth -= 1;
+        if (ret < 0)
+            return(ret);
+    }
+    if ((op->ch2 != -1) && (set->nodeNr > 0))
+        return(xmlXPathCompactFilter(ectxt, op->ch2, set));
+
+    return(0);
+}
+
+typedef struct {
+    xmlXPathTestVal test;
+    xmlXPathTypeVal type;
+    int principal;
+    const xmlChar *name;
+    const xmlChar *uri;
+} xmlXPathCompactNodeTest;
+
+static int
+xmlXPathCompactTest(const xmlXPathCompactDoc *cdoc,
+                    const xmlXPathCompactNodeTest *t, int node) {
+    int type = cdoc->types[node];
+    int nsId;
+
+    switch (t->test) {
+        case NODE_TEST_TYPE:
+            if (t->type == NODE_TYPE_NODE)
+                return(1);
+            return((type == (int) t->type) ||
+                   ((t->type == NODE_TYPE_TEXT) &&
+                    (type == XML_CDATA_SECTION_NODE)));
+
+        case NODE_TEST_PI:
+            return((type == XML_PI_NODE) &&
+                   ((t->name == NULL) || (cdoc->names[node] == t->name)));
+
+        case NODE_TEST_ALL:
+            if (type != t->principal)
+                return(0);
+            if (t->uri == NULL)
+                return(1);
+            nsId = cdoc->nsIds[node];
+            return((nsId >= 0) && (cdoc->nsTab[nsId].href == t->uri));
+
+        case NODE_TEST_NAME:
+            if ((type != t->principal) || (cdoc->names[node] != t->name))
+                return(0);
+            nsId = cdoc->nsIds[node];
+            if (t->uri != NULL)
+                return((nsId >= 0) && (cdoc->nsTab[nsId].href == t->uri));
+            if (nsId < 0)
+                return(1);
+            /* Unprefixed attribute names match the default namespace */
+            return((type == XML_ATTRIBUTE_NODE) &&
+                   (cdoc->nsTab[nsId].prefix == NULL));
+
+        default:
+            return(0);
+    }
+}
+
+/*
+ * Select the nodes on an axis which pass a node test. Nodes are added
+ * in axis order, so positions in predicates count backwards on
+ * reverse axes.
+ */
+static int
+xmlXPathCompactAxis(const xmlXPathCompactDoc *cdoc, xmlXPathAxisVal axis,
+                    const xmlXPathCompactNodeTest *t, int node,
+                    xmlXPathCompactValuePtr seq) {
+    const unsigned char *types = cdoc->types;
+    const int *ends = cdoc->ends;
+    int isAttr = (types[node] == XML_ATTRIBUTE_NODE);
+    int cur, start, parent;
+
+#define XP_COMPACT_VISIT(n) \
+    do { \
+        if ((xmlXPathCompactTest(cdoc, t, n)) && \
+            (xmlXPathCompactValueAdd(seq, n) < 0)) \
+            return(XPATH_COMPACT_ERROR); \
+    } while (0)
+
+    switch (axis) {
+        case AXIS_SELF:
+            XP_COMPACT_VISIT(node);
+            break;
+
+        case AXIS_CHILD:
+            if (isAttr)
+                break;
+            cur = node + 1;
+            while ((cur <= ends[node]) && (types[cur] == XML_ATTRIBUTE_NODE))
+                cur++;
+            while (cur <= ends[node]) {
+                XP_COMPACT_VISIT(cur);
+                cur = ends[cur] + 1;
+            }
+            break;
+
+        case AXIS_ATTRIBUTE:
+            if (types[node] != XML_ELEMENT_NODE)
+                break;
+            for (cur = node + 1;
+                 (cur <= ends[node]) && (types[cur] == XML_ATTRIBUTE_NODE);
+                 cur++) {
+                XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        case AXIS_DESCENDANT_OR_SELF:
+            XP_COMPACT_VISIT(node);
+            /* Falls through. */
+        case AXIS_DESCENDANT:
+            if (isAttr)
+                break;
+            for (cur = node + 1; cur <= ends[node]; cur++) {
+                if (types[cur] != XML_ATTRIBUTE_NODE)
+                    XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        case AXIS_PARENT:
+            if (node > 0)
+                XP_COMPACT_VISIT(cdoc->parents[node]);
+            break;
+
+        case AXIS_ANCESTOR_OR_SELF:
+            XP_COMPACT_VISIT(node);
+            /* Falls through. */
+        case AXIS_ANCESTOR:
+            for (cur = cdoc->parents[node]; cur >= 0;
+                 cur = cdoc->parents[cur]) {
+                XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        case AXIS_FOLLOWING_SIBLING:
+            if ((isAttr) || (node == 0))
+                break;
+            parent = cdoc->parents[node];
+            for (cur = ends[node] + 1; cur <= ends[parent];
+                 cur = ends[cur] + 1) {
+                XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        case AXIS_PRECEDING_SIBLING:
+            if ((isAttr) || (node == 0))
+                break;
+            parent = cdoc->parents[node];
+            start = seq->nodeNr;
+            cur = parent + 1;
+            while (types[cur] == XML_ATTRIBUTE_NODE)
+                cur++;
+            for (; cur < node; cur = ends[cur] + 1) {
+                XP_COMPACT_VISIT(cur);
+            }
+            xmlXPathCompactValueReverse(seq, start);
+            break;
+
+        case AXIS_FOLLOWING:
+            /* Like the tree walker, skip the children of an attribute's
+             * element. */
+            start = isAttr ? cdoc->parents[node] : node;
+            for (cur = ends[start] + 1; cur < cdoc->nbNodes; cur++) {
+                if (types[cur] != XML_ATTRIBUTE_NODE)
+                    XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        case AXIS_PRECEDING:
+            start = isAttr ? cdoc->parents[node] : node;
+            for (cur = start - 1; cur > 0; cur--) {
+                /* Skip attributes and ancestors */
+                if ((types[cur] != XML_ATTRIBUTE_NODE) &&
+                    (ends[cur] < start))
+                    XP_COMPACT_VISIT(cur);
+            }
+            break;
+
+        default:
+            return(XPATH_COMPACT_UNSUPPORTED);
+    }
+
+#undef XP_COMPACT_VISIT
+
+    return(0);
+}
+
+static int
+xmlXPathCompactCollect(xmlXPathCompactEvalCtxtPtr ectxt,
+                       xmlXPathStepOpPtr op, int node, int pos, int size,
+                       xmlXPathCompactValuePtr ret) {
+    const xmlXPathCompactDoc *cdoc = ectxt->cdoc;
+    xmlXPathAxisVal axis = (xmlXPathAxisVal) op->value;
+    const xmlChar *prefix = op->value4;
+    const xmlChar *name = op->value5;
+    xmlXPathCompactNodeTest t;
+    xmlXPathCompactValue input, seq;
+    int i, res, empty = 0;
+
+    if ((op->ch1 == -1) || (axis == AXIS_NAMESPACE))
+        return(XPATH_COMPACT_UNSUPPORTED);
+
+    memset(&t, 0, sizeof(t));
+    t.test = (xmlXPathTestVal) op->value2;
+    t.type = (xmlXPathTypeVal) op->value3;
+    t.principal = (axis == AXIS_ATTRIBUTE) ? XML_ATTRIBUTE_NODE :
+                                             XML_ELEMENT_NODE;
+
+    /*
+     * Resolve names to pointers into the dictionary. A name which isn't
+     * in the dictionary can't match any node.
+     */
+    if (prefix != NULL) {
+        const xmlChar *uri;
+
+        if (ectxt->ctxt == NULL)
+            return(XPATH_COMPACT_UNSUPPORTED);
+        uri = xmlXPathNsLookup(ectxt->ctxt, prefix);
+        if (uri == NULL)
+            return(XPATH_COMPACT_UNSUPPORTED);
+        if ((t.test == NODE_TEST_ALL) || (t.test == NODE_TEST_NAME)) {
+            t.uri = xmlDictExists(cdoc->dict, uri, -1);
+            if (t.uri == NULL)
+                empty = 1;
+        }
+    }
+    if ((name != NULL) &&
+        ((t.test == NODE_TEST_PI) || (t.test == NODE_TEST_NAME))) {
+        t.name = xmlDictExists(cdoc->dict, name, -1);
+        if (t.name == NULL)
+            empty = 1;
+    }
+    if ((t.test == NODE_TEST_NS) || (t.test == NODE_TEST_NONE))
+        empty = 1;
+
+    memset(&input, 0, sizeof(input));
+    res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size, &input);
+    if (res < 0)
+        return(res);
+    if (input.type != XPATH_NODESET) {
+        xmlXPathCompactValueClear(&input);
+        return(XPATH_COMPACT_UNSUPPORTED);
+    }
+
+    ret->type = XPATH_NODESET;
+    if (empty) {
+        xmlXPathCompactValueClear(&input);
+        return(0);
+    }
+
+    memset(&seq, 0, sizeof(seq));
+    for (i = 0; i < input.nodeNr; i++) {
+        seq.nodeNr = 0;
+        res = xmlXPathCompactAxis(cdoc, axis, &t, input.nodeTab[i], &seq);
+        if ((res == 0) && (op->ch2 != -1) && (seq.nodeNr > 0))
+            res = xmlXPathCompactPredicates(ectxt, op->ch2, &seq);
+        if ((res == 0) && (seq.nodeNr > 0)) {
+            if (xmlXPathCompactValueReserve(ret, seq.nodeNr) < 0) {
+                res = XPATH_COMPACT_ERROR;
+            } else {
+                memcpy(ret->nodeTab + ret->nodeNr, seq.nodeTab,
+                       seq.nodeNr * sizeof(seq.nodeTab[0]));
+                ret->nodeNr += seq.nodeNr;
+            }
+        }
+        if (res < 0)
+            break;
+    }
+    xmlXPathCompactValueClear(&seq);
+    xmlXPathCompactValueClear(&input);
+    if (res < 0)
+        return(res);
+
+    xmlXPathCompactValueSort(ret);
+    return(0);
+}
+
+typedef enum {
+    XP_COMPACT_FUNC_LAST,
+    XP_COMPACT_FUNC_POSITION,
+    XP_COMPACT_FUNC_COUNT,
+    XP_COMPACT_FUNC_LOCAL_NAME,
+    XP_COMPACT_FUNC_NAMESPACE_URI,
+    XP_COMPACT_FUNC_NAME,
+    XP_COMPACT_FUNC_STRING,
+    XP_COMPACT_FUNC_CONCAT,
+    XP_COMPACT_FUNC_STARTS_WITH,
+    XP_COMPACT_FUNC_CONTAINS,
+    XP_COMPACT_FUNC_STRING_LENGTH,
+    XP_COMPACT_FUNC_BOOLEAN,
+    XP_COMPACT_FUNC_NOT,
+    XP_COMPACT_FUNC_TRUE,
+    XP_COMPACT_FUNC_FALSE,
+    XP_COMPACT_FUNC_NUMBER,
+    XP_COMPACT_FUNC_SUM,
+    XP_COMPACT_FUNC_FLOOR,
+    XP_COMPACT_FUNC_CEILING
+} xmlXPathCompactFunc;
+
+static const struct {
+    const char *name;
+    int minArgs;
+    int maxArgs;
+} xmlXPathCompactFuncs[] = {
+    { "last", 0, 0 },
+    { "position", 0, 0 },
+    { "count", 1, 1 },
+    { "local-name", 0, 1 },
+    { "namespace-uri", 0, 1 },
+    { "name", 0, 1 },
+    { "string", 0, 1 },
+    { "concat", 2, INT_MAX },
+    { "starts-with", 2, 2 },
+    { "contains", 2, 2 },
+    { "string-length", 0, 1 },
+    { "boolean", 1, 1 },
+    { "not", 1, 1 },
+    { "true", 0, 0 },
+    { "false", 0, 0 },
+    { "number", 0, 1 },
+    { "sum", 1, 1 },
+    { "floor", 1, 1 },
+    { "ceiling", 1, 1 }
+};
+
+static int
+xmlXPathCompactSetString(xmlXPathCompactValuePtr ret, const xmlChar *str) {
+    ret->stringval = xmlStrdup(str);
+    if (ret->stringval == NULL)
+        return(XPATH_COMPACT_ERROR);
+    ret->type = XPATH_STRING;
+    return(0);
+}
+
+/*
+ * Implement local-name(), namespace-uri() and name() for the first
+ * node of a set.
+ */
+static int
+xmlXPathCompactNameFunc(const xmlXPathCompactDoc *cdoc,
+                        xmlXPathCompactFunc func,
+                        xmlXPathCompactValuePtr arg,
+                        xmlXPathCompactValuePtr ret) {
+    const xmlChar *name;
+    int node, type, nsId;
+
+    if (arg->nodeNr == 0)
+        return(xmlXPathCompactSetString(ret, BAD_CAST ""));
+
+    node = arg->nodeTab[0];
+    type = cdoc->types[node];
+    nsId = cdoc->nsIds[node];
+    name = cdoc->names[node];
+    if ((name == NULL) ||
+        ((type != XML_ELEMENT_NODE) && (type != XML_ATTRIBUTE_NODE) &&
+         (type != XML_PI_NODE)) ||
+        (name[0] == ' '))
+        name = BAD_CAST "";
+
+    if (func == XP_COMPACT_FUNC_NAMESPACE_URI) {
+        if (nsId < 0)
+            return(xmlXPathCompactSetString(ret, BAD_CAST ""));
+        return(xmlXPathCompactSetString(ret, cdoc->nsTab[nsId].href));
+    }
+
+    if ((func == XP_COMPACT_FUNC_NAME) && (name[0] != 0) && (nsId >= 0) &&
+        (cdoc->nsTab[nsId].prefix != NULL)) {
+        ret->stringval = xmlStrdup(cdoc->nsTab[nsId].prefix);
+        ret->stringval = xmlStrcat(ret->stringval, BAD_CAST ":");
+        ret->stringval = xmlStrcat(ret->stringval, name);
+        if (ret->stringval == NULL)
+            return(XPATH_COMPACT_ERROR);
+        ret->type = XPATH_STRING;
+        return(0);
+    }
+
+    return(xmlXPathCompactSetString(ret, name));
+}
+
+static int
+xmlXPathCompactFunction(xmlXPathCompactEvalCtxtPtr ectxt,
+                        xmlXPathStepOpPtr op, int node, int pos, int size,
+                        xmlXPathCompactValuePtr ret) {
+    const xmlXPathCompactDoc *cdoc = ectxt->cdoc;
+    xmlXPathCompactValue *args;
+    xmlXPathCompactFunc func;
+    int nargs = op->value;
+    int i, arg, res = 0;
+
+    if ((op->value5 != NULL) || (op->value4 == NULL))
+        return(XPATH_COMPACT_UNSUPPORTED);
+    for (i = 0; i < (int) (sizeof(xmlXPathCompactFuncs) /
+                           sizeof(xmlXPathCompactFuncs[0])); i++) {
+        if (xmlStrEqual(op->value4, BAD_CAST xmlXPathCompactFuncs[i].name))
+            break;
+    }
+    if (i >= (int) (sizeof(xmlXPathCompactFuncs) /
+                    sizeof(xmlXPathCompactFuncs[0])))
+        return(XPATH_COMPACT_UNSUPPORTED);
+    func = (xmlXPathCompactFunc) i;
+    if ((nargs < xmlXPathCompactFuncs[func].minArgs) ||
+        (nargs > xmlXPathCompactFuncs[func].maxArgs))
+        return(XPATH_COMPACT_UNSUPPORTED);
+
+    /*
+     * A missing argument defaults to a node-set containing the context
+     * node.
+     */
+    args = xmlMalloc((nargs > 0 ? nargs : 1) * sizeof(args[0]));
+    if (args == NULL)
+        return(XPATH_COMPACT_ERROR);
+    memset(args, 0, (nargs > 0 ? nargs : 1) * sizeof(args[0]));
+    if (nargs == 0) {
+        args[0].type = XPATH_NODESET;
+        if (xmlXPathCompactValueAdd(&args[0], node) < 0) {
+            res = XPATH_COMPACT_ERROR;
+            goto done;
+        }
+    }
+
+    arg = op->ch1;
+    for (i = nargs - 1; i >= 0; i--) {
+        xmlXPathStepOpPtr argOp;
+
+        if (arg == -1) {
+            res = XPATH_COMPACT_UNSUPPORTED;
+            goto done;
+        }
+        argOp = &ectxt->comp->steps[arg];
+        if ((argOp->op != XPATH_OP_ARG) || (argOp->ch2 == -1)) {
+            res = XPATH_COMPACT_UNSUPPORTED;
+            goto done;
+        }
+        res = xmlXPathCompactEvalOp(ectxt, argOp->ch2, node, pos, size,
+                                    &args[i]);
+        if (res < 0)
+            goto done;
+        arg = argOp->ch1;
+    }
+
+    switch (func) {
+        case XP_COMPACT_FUNC_LAST:
+            ret->type = XPATH_NUMBER;
+            ret->floatval = size;
+            break;
+
+        case XP_COMPACT_FUNC_POSITION:
+            ret->type = XPATH_NUMBER;
+            ret->floatval = pos;
+            break;
+
+        case XP_COMPACT_FUNC_COUNT:
+            if (args[0].type != XPATH_NODESET) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            ret->type = XPATH_NUMBER;
+            ret->floatval = args[0].nodeNr;
+            break;
+
+        case XP_COMPACT_FUNC_LOCAL_NAME:
+        case XP_COMPACT_FUNC_NAMESPACE_URI:
+        case XP_COMPACT_FUNC_NAME:
+            if (args[0].type != XPATH_NODESET) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            res = xmlXPathCompactNameFunc(cdoc, func, &args[0], ret);
+            break;
+
+        case XP_COMPACT_FUNC_STRING:
+            res = xmlXPathCompactCastToString(cdoc, &args[0]);
+            if (res == 0) {
+                *ret = args[0];
+                memset(&args[0], 0, sizeof(args[0]));
+            }
+            break;
+
+        case XP_COMPACT_FUNC_CONCAT:
+            ret->type = XPATH_STRING;
+            ret->stringval = xmlStrdup(BAD_CAST "");
+            for (i = 0; i < nargs; i++) {
+                res = xmlXPathCompactCastToString(cdoc, &args[i]);
+                if (res < 0)
+                    break;
+                ret->stringval = xmlStrcat(ret->stringval,
+                                           args[i].stringval);
+                if (ret->stringval == NULL) {
+                    res = XPATH_COMPACT_ERROR;
+                    break;
+                }
+            }
+            break;
+
+        case XP_COMPACT_FUNC_STARTS_WITH:
+        case XP_COMPACT_FUNC_CONTAINS:
+            res = xmlXPathCompactCastToString(cdoc, &args[0]);
+            if (res == 0)
+                res = xmlXPathCompactCastToString(cdoc, &args[1]);
+            if (res < 0)
+                break;
+            ret->type = XPATH_BOOLEAN;
+            if (func == XP_COMPACT_FUNC_CONTAINS)
+                ret->boolval = (xmlStrstr(args[0].stringval,
+                                          args[1].stringval) != NULL);
+            else
+                ret->boolval = (xmlStrncmp(args[0].stringval,
+                                           args[1].stringval,
+                                           xmlStrlen(args[1].stringval)) == 0);
+            break;
+
+        case XP_COMPACT_FUNC_STRING_LENGTH:
+            res = xmlXPathCompactCastToString(cdoc, &args[0]);
+            if (res < 0)
+                break;
+            ret->type = XPATH_NUMBER;
+            ret->floatval = xmlUTF8Strlen(args[0].stringval);
+            break;
+
+        case XP_COMPACT_FUNC_BOOLEAN:
+        case XP_COMPACT_FUNC_NOT:
+            ret->type = XPATH_BOOLEAN;
+            ret->boolval = xmlXPathCompactToBoolean(&args[0]);
+            if (func == XP_COMPACT_FUNC_NOT)
+                ret->boolval = !ret->boolval;
+            break;
+
+        case XP_COMPACT_FUNC_TRUE:
+        case XP_COMPACT_FUNC_FALSE:
+            ret->type = XPATH_BOOLEAN;
+            ret->boolval = (func == XP_COMPACT_FUNC_TRUE);
+            break;
+
+        case XP_COMPACT_FUNC_NUMBER:
+        case XP_COMPACT_FUNC_FLOOR:
+        case XP_COMPACT_FUNC_CEILING:
+            res = xmlXPathCompactCastToNumber(cdoc, &args[0]);
+            if (res < 0)
+                break;
+            ret->type = XPATH_NUMBER;
+            ret->floatval = args[0].floatval;
+            if (func == XP_COMPACT_FUNC_FLOOR)
+                ret->floatval = floor(ret->floatval);
+            else if (func == XP_COMPACT_FUNC_CEILING)
+                ret->floatval = ceil(ret->floatval);
+            break;
+
+        case XP_COMPACT_FUNC_SUM:
+            if (args[0].type != XPATH_NODESET) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            ret->type = XPATH_NUMBER;
+            ret->floatval = 0.0;
+            for (i = 0; i < args[0].nodeNr; i++) {
+                double number;
+
+                res = xmlXPathCompactNodeNumber(cdoc, args[0].nodeTab[i],
+                                                &number);
+                if (res < 0)
+                    break;
+                ret->floatval += number;
+            }
+            break;
+    }
+
+done:
+    for (i = 0; i < (nargs > 0 ? nargs : 1); i++)
+        xmlXPathCompactValueClear(&args[i]);
+    xmlFree(args);
+    return(res);
+}
+
+static int
+xmlXPathCompactEvalOp(xmlXPathCompactEvalCtxtPtr ectxt, int opIdx,
+                      int node, int pos, int size,
+                      xmlXPathCompactValuePtr ret) {
+    const xmlXPathCompactDoc *cdoc = ectxt->cdoc;
+    xmlXPathStepOpPtr op;
+    xmlXPathCompactValue arg2;
+    int res = 0, boolval;
+
+    if ((opIdx < 0) || (opIdx >= ectxt->comp->nbStep) ||
+        (ectxt->depth >= XPATH_MAX_RECURSION_DEPTH))
+        return(XPATH_COMPACT_UNSUPPORTED);
+    ectxt->depth += 1;
+
+    op = &ectxt->comp->steps[opIdx];
+    memset(&arg2, 0, sizeof(arg2));
+
+    switch (op->op) {
+        case XPATH_OP_AND:
+        case XPATH_OP_OR:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if (res < 0)
+                break;
+            xmlXPathCompactCastToBoolean(ret);
+            if (ret->boolval == (op->op == XPATH_OP_OR))
+                break;
+            res = xmlXPathCompactEvalOp(ectxt, op->ch2, node, pos, size,
+                                        &arg2);
+            if (res < 0)
+                break;
+            ret->boolval = xmlXPathCompactToBoolean(&arg2);
+            break;
+
+        case XPATH_OP_EQUAL:
+        case XPATH_OP_CMP:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if (res == 0)
+                res = xmlXPathCompactEvalOp(ectxt, op->ch2, node, pos, size,
+                                            &arg2);
+            if (res < 0)
+                break;
+            if (op->op == XPATH_OP_EQUAL)
+                res = xmlXPathCompactEqual(cdoc, ret, &arg2, !op->value,
+                                           &boolval);
+            else
+                res = xmlXPathCompactCompare(cdoc, ret, &arg2, op->value,
+                                             op->value2, &boolval);
+            if (res < 0)
+                break;
+            xmlXPathCompactValueClear(ret);
+            ret->type = XPATH_BOOLEAN;
+            ret->boolval = boolval;
+            break;
+
+        case XPATH_OP_PLUS:
+        case XPATH_OP_MULT:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if (res == 0)
+                res = xmlXPathCompactCastToNumber(cdoc, ret);
+            if ((res == 0) && (op->ch2 != -1)) {
+                res = xmlXPathCompactEvalOp(ectxt, op->ch2, node, pos, size,
+                                            &arg2);
+                if (res == 0)
+                    res = xmlXPathCompactCastToNumber(cdoc, &arg2);
+            }
+            if (res < 0)
+                break;
+            if (op->op == XPATH_OP_MULT) {
+                if (op->ch2 == -1)
+                    res = XPATH_COMPACT_UNSUPPORTED;
+                else if (op->value == 0)
+                    ret->floatval *= arg2.floatval;
+                else if (op->value == 1)
+                    ret->floatval /= arg2.floatval;
+                else
+                    ret->floatval = fmod(ret->floatval, arg2.floatval);
+            } else if ((op->value == 0) || (op->value == 1)) {
+                if (op->ch2 == -1)
+                    res = XPATH_COMPACT_UNSUPPORTED;
+                else if (op->value == 0)
+                    ret->floatval -= arg2.floatval;
+                else
+                    ret->floatval += arg2.floatval;
+            } else if (op->value == 2) {
+                ret->floatval = -ret->floatval;
+            }
+            break;
+
+        case XPATH_OP_UNION:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if (res == 0)
+                res = xmlXPathCompactEvalOp(ectxt, op->ch2, node, pos, size,
+                                            &arg2);
+            if (res < 0)
+                break;
+            if ((ret->type != XPATH_NODESET) ||
+                (arg2.type != XPATH_NODESET)) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            if (xmlXPathCompactValueReserve(ret, arg2.nodeNr) < 0) {
+                res = XPATH_COMPACT_ERROR;
+                break;
+            }
+            if (arg2.nodeNr > 0) {
+                memcpy(ret->nodeTab + ret->nodeNr, arg2.nodeTab,
+                       arg2.nodeNr * sizeof(arg2.nodeTab[0]));
+                ret->nodeNr += arg2.nodeNr;
+            }
+            xmlXPathCompactValueSort(ret);
+            break;
+
+        case XPATH_OP_ROOT:
+            ret->type = XPATH_NODESET;
+            if (xmlXPathCompactValueAdd(ret, 0) < 0)
+                res = XPATH_COMPACT_ERROR;
+            break;
+
+        case XPATH_OP_NODE:
+            if ((op->ch1 != -1) || (op->ch2 != -1)) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            ret->type = XPATH_NODESET;
+            if (xmlXPathCompactValueAdd(ret, node) < 0)
+                res = XPATH_COMPACT_ERROR;
+            break;
+
+        case XPATH_OP_COLLECT:
+            res = xmlXPathCompactCollect(ectxt, op, node, pos, size, ret);
+            break;
+
+        case XPATH_OP_VALUE:
+        case XPATH_OP_VARIABLE: {
+            xmlXPathObjectPtr obj;
+
+            if (op->op == XPATH_OP_VALUE) {
+                obj = op->value4;
+            } else {
+                if ((op->ch1 != -1) || (op->value5 != NULL) ||
+                    (ectxt->ctxt == NULL)) {
+                    res = XPATH_COMPACT_UNSUPPORTED;
+                    break;
+                }
+                obj = xmlXPathVariableLookup(ectxt->ctxt, op->value4);
+            }
+            if (obj == NULL) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            switch (obj->type) {
+                case XPATH_BOOLEAN:
+                    ret->type = XPATH_BOOLEAN;
+                    ret->boolval = obj->boolval;
+                    break;
+                case XPATH_NUMBER:
+                    ret->type = XPATH_NUMBER;
+                    ret->floatval = obj->floatval;
+                    break;
+                case XPATH_STRING:
+                    res = xmlXPathCompactSetString(ret, obj->stringval);
+                    break;
+                default:
+                    /* Tree nodes can't be mapped to compact nodes */
+                    res = XPATH_COMPACT_UNSUPPORTED;
+                    break;
+            }
+            if (op->op == XPATH_OP_VARIABLE)
+                xmlXPathFreeObject(obj);
+            break;
+        }
+
+        case XPATH_OP_FUNCTION:
+            res = xmlXPathCompactFunction(ectxt, op, node, pos, size, ret);
+            break;
+
+        case XPATH_OP_PREDICATE:
+        case XPATH_OP_FILTER:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if (res < 0)
+                break;
+            if (ret->type != XPATH_NODESET) {
+                res = XPATH_COMPACT_UNSUPPORTED;
+                break;
+            }
+            if ((op->ch2 != -1) && (ret->nodeNr > 0))
+                res = xmlXPathCompactFilter(ectxt, op->ch2, ret);
+            break;
+
+        case XPATH_OP_SORT:
+            res = xmlXPathCompactEvalOp(ectxt, op->ch1, node, pos, size,
+                                        ret);
+            if ((res == 0) && (ret->type == XPATH_NODESET))
+                xmlXPathCompactValueSort(ret);
+            break;
+
+        default:
+            res = XPATH_COMPACT_UNSUPPORTED;
+            break;
+    }
+
+    xmlXPathCompactValueClear(&arg2);
+    if (res < 0)
+        xmlXPathCompactValueClear(ret);
+    ectxt->depth -= 1;
+    return(res);
+}
+
+/**
+ * Evaluate a compiled XPath expression over a compact document.
+ *
+ * Expressions must return a node-set. The supported subset covers
+ * location paths on all axes except the namespace axis, predicates,
+ * unions, comparisons, arithmetic, variables with scalar values and
+ * the core functions last(), position(), count(), local-name(),
+ * namespace-uri(), name(), string(), concat(), starts-with(),
+ * contains(), string-length(), boolean(), not(), true(), false(),
+ * number(), sum(), floor() and ceiling(). Other expressions, as well
+ * as expressions which would raise an XPath error, aren't evaluated
+ * and the caller should fall back to #xmlXPathCompiledEval on the
+ * original tree.
+ *
+ * The XPath context is optional. It's used to resolve namespace
+ * prefixes and variables and provides the initial context position
+ * and size.
+ *
+ * @param ctxt  the XPath context (optional)
+ * @param comp  the compiled XPath expression
+ * @param cdoc  the compact document
+ * @param node  index of the context node
+ * @param nodes  pointer to an array receiving the indices of the
+ * selected nodes in document order, to be freed with xmlFree. Set
+ * to NULL if the result is empty.
+ * @returns the number of selected nodes, -1 if an argument was
+ * invalid or a memory allocation failed, -2 if the expression isn't
+ * supported.
+ */
+int
+xmlXPathCompactEval(xmlXPathContext *ctxt, xmlXPathCompExpr *comp,
+                    const xmlXPathCompactDoc *cdoc, int node, int **nodes) {
+    xmlXPathCompactEvalCtxt ectxt;
+    xmlXPathCompactValue res;
+    int pos = 1, size = 1, ret;
+
+    if (nodes != NULL)
+        *nodes = NULL;
+    if ((comp == NULL) || (cdoc == NULL) || (nodes == NULL) ||
+        (node < 0) || (node >= cdoc->nbNodes))
+        return(-1);
+    if ((comp->nbStep <= 0) || (comp->last < 0))
+        return(XPATH_COMPACT_UNSUPPORTED);
+
+    if (ctxt != NULL) {
+        pos = ctxt->proximityPosition;
+        size = ctxt->contextSize;
+    }
+
+    memset(&ectxt, 0, sizeof(ectxt));
+    ectxt.ctxt = ctxt;
+    ectxt.comp = comp;
+    ectxt.cdoc = cdoc;
+
+    memset(&res, 0, sizeof(res));
+    ret = xmlXPathCompactEvalOp(&ectxt, comp->last, node, pos, size, &res);
+    if (ret < 0)
+        return(ret);
+    if (res.type != XPATH_NODESET) {
+        xmlXPathCompactValueClear(&res);
+        return(XPATH_COMPACT_UNSUPPORTED);
+    }
+
+    if (res.nodeNr > 0)
+        *nodes = res.nodeTab;
+    else
+        xmlFree(res.nodeTab);
+    return(res.nodeNr);
+}
+
 #endif /* LIBXML_XPATH_ENABLED */